@@ -16,6 +16,8 @@
 #include "file_utils.h"
 #include "draw_utils.h"
 #include "tree_leaf.h"
+#include "profiler.h"
+#include "telemetry.h"
 #include <set>
 
 #ifdef _WIN32 // wglew.h seems to be Windows only
@@ -73,7 +75,7 @@ char *lighting_file[NUM_LIGHTING_TYPES] = {0};
 bool combined_gu(0), underwater(0), kbd_text_mode(0), univ_stencil_shadows(1), use_waypoint_app_spots(0), enable_tiled_mesh_ao(0), tiled_terrain_only(0);
 bool show_lightning(0), disable_shader_effects(0), use_waypoints(0), group_back_face_cull(0), start_maximized(0), claim_planet(0), skip_light_vis_test(0);
 bool no_smoke_over_mesh(0), enable_model3d_tex_comp(0), global_lighting_update(0), lighting_update_offline(0), mesh_difuse_tex_comp(1), smoke_dlights(0), keep_keycards_on_death(0);
-bool texture_alpha_in_red_comp(0), use_model3d_tex_mipmaps(1), mt_cobj_tree_build(0), two_sided_lighting(0), inf_terrain_scenery(1), invert_model_nmap_bscale(0);
+bool texture_alpha_in_red_comp(0), use_model3d_tex_mipmaps(1), mt_cobj_tree_build(0), cobj_tree_soa_nodes(0), cobj_tree_sah_build(0), cobj_tree_build_stats(0), two_sided_lighting(0), inf_terrain_scenery(1), invert_model_nmap_bscale(0);
 bool gen_tree_roots(1), fast_water_reflect(0), vsync_enabled(0), use_voxel_cobjs(0), disable_sound(0), enable_depth_clamp(0), volume_lighting(0), no_subdiv_model(0);
 bool detail_normal_map(0), init_core_context(0), use_core_context(0), enable_multisample(1), dynamic_smap_bias(0), model3d_wn_normal(0), snow_shadows(0), user_action_key(0);
 bool enable_dlight_shadows(1), tree_indir_lighting(0), ctrl_key_pressed(0), only_pine_palm_trees(0), enable_gamma_correct(0), use_z_prepass(0), reflect_dodgeballs(0);
@@ -85,6 +87,7 @@ bool disable_model_textures(0), start_in_inf_terrain(0), allow_shader_invariants
 bool enable_timing_profiler(0), fast_transparent_spheres(0), force_ref_cmap_update(0), use_instanced_pine_trees(0), enable_postproc_recolor(0), draw_building_interiors(0);
 bool toggle_room_light(0), teleport_to_screenshot(0), merge_model_objects(0), display_frame_time(0), reverse_3ds_vert_winding_order(1), disable_dlights(0);
 bool enable_hcopter_shadows(0), pre_load_full_tiled_terrain(0), disable_blood(0), enable_model_animations(1), rotate_trees(0), invert_model3d_faces(0);
+bool headless_mode(0); // no window or GL context; set from the command line
 int xoff(0), yoff(0), xoff2(0), yoff2(0), rand_gen_index(0), mesh_rgen_index(0), camera_change(1), camera_in_air(0), auto_time_adv(0);
 int animate(1), animate2(1), draw_model(0), init_x(STARTING_INIT_X), fire_key(0), do_run(0), init_num_balls(-1), change_wmode_frame(0);
 int game_mode(0), map_mode(0), load_hmv(0), load_coll_objs(1), read_landscape(0), screen_reset(0), mesh_seed(0), rgen_seed(1);
@@ -103,10 +106,11 @@ int read_snow_file(0), write_snow_file(0), mesh_detail_tex(NOISE_TEX);
 int read_light_files[NUM_LIGHTING_TYPES] = {0}, write_light_files[NUM_LIGHTING_TYPES] = {0};
 unsigned num_snowflakes(0), create_voxel_landscape(0), hmap_filter_width(0), num_dynam_parts(100), snow_coverage_resolution(2);
 unsigned num_birds_per_tile(2), num_fish_per_tile(15), num_bflies_per_tile(4);
-unsigned erosion_iters(0), erosion_iters_tt(0), skybox_tid(0), tiled_terrain_gen_heightmap_sz(0);
+unsigned erosion_iters(0), erosion_iters_tt(0), skybox_tid(0), tiled_terrain_gen_heightmap_sz(0), cobj_line_bench_lines(0);
 float NEAR_CLIP(DEF_NEAR_CLIP), FAR_CLIP(DEF_FAR_CLIP), system_max_orbit(1.0), sky_occlude_scale(0.0), tree_slope_thresh(5.0), mouse_sensitivity(1.0), tt_grass_scale_factor(1.0);
 float water_plane_z(0.0), base_gravity(1.0), crater_depth(1.0), crater_radius(1.0), disabled_mesh_z(FAR_CLIP), vegetation(1.0), atmosphere(1.0), biome_x_offset(0.0);
 float mesh_file_scale(1.0), mesh_file_tz(0.0), speed_mult(1.0), mesh_z_cutoff(-FAR_CLIP), relh_adj_tex(0.0), dodgeball_metalness(1.0), ray_step_size_mult(1.0);
+float cobj_tree_refit_thresh(1.5);
 float water_h_off(0.0), water_h_off_rel(0.0), perspective_fovy(0.0), perspective_nclip(0.0), read_mesh_zmm(0.0), indir_light_exp(1.0), cloud_height_offset(0.0);
 float snow_depth(0.0), snow_random(0.0), cobj_z_bias(DEF_Z_BIAS), init_temperature(DEF_TEMPERATURE), indir_vert_offset(0.25), sm_tree_density(1.0), fog_dist_scale(1.0);
 float CAMERA_RADIUS(DEF_CAMERA_RADIUS), C_STEP_HEIGHT(0.6), waypoint_sz_thresh(1.0), model3d_alpha_thresh(0.9), model3d_texture_anisotropy(1.0), dist_to_fire_sq(0.0);
@@ -117,7 +121,7 @@ float model_hemi_lighting_scale(0.5), pine_tree_radius_scale(1.0), sunlight_brig
 float light_int_scale[NUM_LIGHTING_TYPES] = {1.0, 1.0, 1.0, 1.0, 1.0}, first_ray_weight[NUM_LIGHTING_TYPES] = {1.0, 1.0, 1.0, 1.0, 1.0};
 double camera_zh(0.0);
 point mesh_origin(all_zeros), camera_pos(all_zeros), cube_map_center(all_zeros);
-string user_text, cobjs_out_fn, sphere_materials_fn, hmap_out_fn, skybox_cube_map_name, coll_damage_name, assimp_alpha_exclude_str;
+string user_text, cobjs_out_fn, sphere_materials_fn, hmap_out_fn, skybox_cube_map_name, coll_damage_name, assimp_alpha_exclude_str, trace_profiler_file;
 colorRGB ambient_lighting_scale(1,1,1), mesh_color_scale(1,1,1);
 colorRGBA flower_color(ALPHA0);
 set<unsigned char> keys, keyset;
@@ -133,20 +137,20 @@ char player_name[MAX_CHARS] = "Player";
 bool vert_opt_flags[3] = {0}; // {enable, full_opt, verbose}
 
 
-extern bool clear_landscape_vbo, use_dense_voxels, tree_4th_branches, model_calc_tan_vect, water_is_lava, use_grass_tess, def_tex_compress, ship_cube_map_reflection, flashlight_on;
+extern bool compact_lighting_files, lmap_sparse_z, clear_landscape_vbo, use_dense_voxels, tree_4th_branches, model_calc_tan_vect, model3d_lazy_materials, obj_file_parallel_parse, tt_bkg_tile_gen, tt_horizon_shadows, water_is_lava, use_grass_tess, def_tex_compress, ship_cube_map_reflection, flashlight_on;
 extern int camera_flight, DISABLE_WATER, DISABLE_SCENERY, camera_invincible, onscreen_display, mesh_freq_filter, show_waypoints, last_inventory_frame;
 extern int tree_coll_level, GLACIATE, UNLIMITED_WEAPONS, destroy_thresh, MAX_RUN_DIST, mesh_gen_mode, mesh_gen_shape, map_drag_x, map_drag_y;
 extern unsigned NPTS, NRAYS, LOCAL_RAYS, GLOBAL_RAYS, DYNAMIC_RAYS, NUM_THREADS, MAX_RAY_BOUNCES, grass_density, max_unique_trees, shadow_map_sz;
-extern unsigned scene_smap_vbo_invalid, spheres_mode, max_cube_map_tex_sz, DL_GRID_BS;
+extern unsigned scene_smap_vbo_invalid, spheres_mode, max_cube_map_tex_sz, DL_GRID_BS, telemetry_frames, indir_light_batch_size, progressive_lighting_passes;
 extern float fticks, team_damage, self_damage, player_damage, smiley_damage, smiley_speed, tree_deadness, tree_dead_prob, lm_dz_adj, nleaves_scale, flower_density, universe_ambient_scale;
 extern float mesh_scale, tree_scale, mesh_height_scale, smiley_acc, hmv_scale, last_temp, grass_length, grass_width, branch_radius_scale, tree_height_scale, planet_update_rate;
-extern float MESH_START_MAG, MESH_START_FREQ, MESH_MAG_MULT, MESH_FREQ_MULT, def_tex_aniso;
+extern float MESH_START_MAG, MESH_START_FREQ, MESH_MAG_MULT, MESH_FREQ_MULT, def_tex_aniso, tt_tile_prefetch_dist, tt_tile_gen_budget_ms, tt_tile_cache_mem_mb, progressive_lighting_tol;
 extern double map_x, map_y;
 extern point hmv_pos, camera_last_pos;
 extern colorRGBA sunlight_color;
 extern int coll_id[];
 extern float tree_lod_scales[4];
-extern string read_hmap_modmap_fn, write_hmap_modmap_fn, read_voxel_brush_fn, write_voxel_brush_fn, font_texture_atlas_fn;
+extern string read_hmap_modmap_fn, write_hmap_modmap_fn, read_voxel_brush_fn, write_voxel_brush_fn, font_texture_atlas_fn, texture_decode_cache_dir, tt_tile_cache_dir, telemetry_file, building_indir_cache_dir;
 extern vector<bbox> team_starts;
 extern player_state *sstates;
 extern pt_line_drawer obj_pld;
@@ -187,6 +191,8 @@ float get_player_building_speed_mult();
 void toggle_city_spectate_mode();
 
 float get_tt_building_sound_gain();
+bool is_command_line_benchmark(int argc, char const *const *argv);
+int run_command_line_benchmark(int argc, char const *const *argv);
 
 
 // all OpenGL error handling goes through these functions
@@ -257,10 +263,15 @@ void quit_3dworld() { // called once at the end for proper cleanup
 	cout << "quitting" << endl;
 	kill_current_raytrace_threads();
 	end_building_rt_job();
+	print_building_indir_cache_stats();
+	if (trace_profiler_enabled) {trace_profiler_write_json(trace_profiler_file);}
+	if (telemetry_frames > 0) {dump_telemetry();}
 	clear_context();
 	exit_openal();
 
 	if (!universe_only) {
+		flush_tiled_terrain_cache();
+		print_tiled_terrain_cache_stats();
 		free_models();
 		free_scenery_cobjs();
 		delete_matrices();
@@ -943,6 +954,7 @@ void keyboard_proc(unsigned char key, int x, int y) {
 	case 'f': // print framerate and stats
 		show_framerate = 1;
 		timing_profiler_stats();
+		if (world_mode == WMODE_INF_TERRAIN) {print_tiled_terrain_cache_stats();}
 		break;
 	case 'g': // pause/resume playback of eventlist
 		pause_frame = !pause_frame;
@@ -1011,6 +1023,9 @@ void keyboard_proc(unsigned char key, int x, int y) {
 	case 'u': // toggle timing profiler
 		toggle_timing_profiler(); // show_bool_option_change()?
 		break;
+	case 'P': // write frame time and memory telemetry
+		dump_telemetry();
+		break;
 
 	case '=': // increase temp
 		temperature += TEMP_INCREMENT;
@@ -1702,16 +1717,23 @@ int load_config(string const &config_file) {
 	kwmb.add("group_back_face_cull", group_back_face_cull);
 	kwmb.add("inf_terrain_scenery", inf_terrain_scenery);
 	kwmb.add("enable_tiled_mesh_ao", enable_tiled_mesh_ao);
+	kwmb.add("tiled_terrain_bkg_tile_gen", tt_bkg_tile_gen);
+	kwmb.add("tiled_terrain_horizon_shadows", tt_horizon_shadows);
 	kwmb.add("fast_water_reflect", fast_water_reflect);
 	kwmb.add("disable_shader_effects", disable_shader_effects);
 	kwmb.add("enable_model3d_tex_comp", enable_model3d_tex_comp);
 	kwmb.add("texture_alpha_in_red_comp", texture_alpha_in_red_comp);
 	kwmb.add("use_model3d_tex_mipmaps", use_model3d_tex_mipmaps);
 	kwmb.add("use_dense_voxels", use_dense_voxels);
+	kwmb.add("lmap_sparse_z", lmap_sparse_z);
 	kwmb.add("use_voxel_cobjs", use_voxel_cobjs);
 	kwmb.add("mt_cobj_tree_build", mt_cobj_tree_build);
+	kwmb.add("cobj_tree_soa_nodes", cobj_tree_soa_nodes);
+	kwmb.add("cobj_tree_sah_build", cobj_tree_sah_build);
+	kwmb.add("cobj_tree_build_stats", cobj_tree_build_stats);
 	kwmb.add("global_lighting_update", global_lighting_update);
 	kwmb.add("lighting_update_offline", lighting_update_offline);
+	kwmb.add("compact_lighting_files", compact_lighting_files);
 	kwmb.add("two_sided_lighting", two_sided_lighting);
 	kwmb.add("disable_sound", disable_sound);
 	kwmb.add("start_maximized", start_maximized);
@@ -1748,6 +1770,8 @@ int load_config(string const &config_file) {
 	kwmb.add("no_store_model_textures_in_memory", no_store_model_textures_in_memory);
 	kwmb.add("no_subdiv_model", no_subdiv_model);
 	kwmb.add("merge_model_objects", merge_model_objects);
+	kwmb.add("model3d_lazy_materials", model3d_lazy_materials);
+	kwmb.add("obj_file_parallel_parse", obj_file_parallel_parse);
 	kwmb.add("use_grass_tess", use_grass_tess);
 	kwmb.add("use_instanced_pine_trees", use_instanced_pine_trees);
 	kwmb.add("enable_dpart_shadows", enable_dpart_shadows);
@@ -1834,6 +1858,10 @@ int load_config(string const &config_file) {
 	kwmu.add("snow_coverage_resolution", snow_coverage_resolution);
 	kwmu.add("dlight_grid_bitshift", DL_GRID_BS);
 	kwmu.add("tiled_terrain_gen_heightmap_sz", tiled_terrain_gen_heightmap_sz);
+	kwmu.add("cobj_line_bench_lines", cobj_line_bench_lines);
+	kwmu.add("telemetry_frames", telemetry_frames);
+	kwmu.add("building_indir_light_batch_size", indir_light_batch_size);
+	kwmu.add("progressive_lighting_passes", progressive_lighting_passes);
 
 	kw_to_val_map_t<float> kwmf(error);
 	kwmf.add("gravity", base_gravity);
@@ -1906,6 +1934,7 @@ int load_config(string const &config_file) {
 	kwmf.add("erode_amount", erode_amount);
 	kwmf.add("ambient_scale", ambient_scale);
 	kwmf.add("ray_step_size_mult", ray_step_size_mult);
+	kwmf.add("cobj_tree_refit_thresh", cobj_tree_refit_thresh);
 	kwmf.add("system_max_orbit", system_max_orbit);
 	kwmf.add("sky_occlude_scale", sky_occlude_scale);
 	kwmf.add("mouse_sensitivity", mouse_sensitivity);
@@ -1936,6 +1965,10 @@ int load_config(string const &config_file) {
 	kwmr.add("tree_branch_radius",  branch_radius_scale, FP_CHECK_POS);
 	kwmr.add("model3d_alpha_thresh",model3d_alpha_thresh,FP_CHECK_01);
 	kwmr.add("snow_depth",          snow_depth,          FP_CHECK_NONNEG);
+	kwmr.add("progressive_lighting_tol", progressive_lighting_tol, FP_CHECK_NONNEG);
+	kwmr.add("tiled_terrain_prefetch_dist",    tt_tile_prefetch_dist, FP_CHECK_NONNEG);
+	kwmr.add("tiled_terrain_tile_gen_budget_ms", tt_tile_gen_budget_ms, FP_CHECK_NONNEG);
+	kwmr.add("tiled_terrain_tile_cache_mem_mb",  tt_tile_cache_mem_mb,  FP_CHECK_NONNEG);
 
 	kw_to_val_map_t<string> kwms(error);
 	kwms.add("cobjs_out_filename", cobjs_out_fn);
@@ -1949,6 +1982,11 @@ int load_config(string const &config_file) {
 	kwms.add("write_heightmap_png", hmap_out_fn);
 	kwms.add("skybox_cube_map", skybox_cube_map_name);
 	kwms.add("assimp_alpha_exclude_str", assimp_alpha_exclude_str);
+	kwms.add("texture_decode_cache_dir", texture_decode_cache_dir);
+	kwms.add("tiled_terrain_tile_cache_dir", tt_tile_cache_dir);
+	kwms.add("building_indir_light_cache_dir", building_indir_cache_dir);
+	kwms.add("trace_profiler_file", trace_profiler_file);
+	kwms.add("telemetry_file", telemetry_file);
 
 	while (read_str(fp, strc)) { // slow but should be OK: these ones require special handling
 		string const str(strc);
@@ -2276,7 +2314,9 @@ void init_debug_callback() {
 int main(int argc, char** argv) {
 
 	cout << "Starting 3DWorld" << endl;
-	if (argc == 2) {read_ueventlist(argv[1]);}
+	bool const model3d_conv(argc >= 3 && strcmp(argv[1], "-convert_model3d") == 0); // 3dworld -convert_model3d <in.model3d> [<out.model3d>]
+	headless_mode = (model3d_conv || is_command_line_benchmark(argc, argv)); // 3dworld -headless [<output.json>], or one of the -xxx_bench options
+	if (argc == 2 && !headless_mode) {read_ueventlist(argv[1]);}
 	int rs(1);
 	if      (srand_param == 1) {rs = GET_TIME_MS();}
 	else if (srand_param != 0) {rs = srand_param;}
@@ -2286,6 +2326,14 @@ int main(int argc, char** argv) {
 	load_texture_names(); // needs to be before config file load
 	load_top_level_config(defaults_file);
 	gen_gauss_rand_arr(); // after reading seed from config file
+	if (!trace_profiler_file.empty()) {enable_trace_profiler();} // written on exit
+	if (telemetry_frames > 0) {register_default_telemetry();} // sampled each frame and written on exit or with the 'P' key
+	if (model3d_conv) {return (convert_model3d_file(argv[2], ((argc >= 4) ? argv[3] : argv[2])) ? 0 : 1);} // convert to the current version and exit
+	if (headless_mode) { // run the benchmark, report stats, and exit without creating a window
+		int const ret(run_command_line_benchmark(argc, argv));
+		if (trace_profiler_enabled) {trace_profiler_write_json(trace_profiler_file);}
+		return ret;
+	}
 	cout << "Loading."; cout.flush();
 	
  	// Initialize GLUT
@@ -380,6 +380,15 @@ template<typename T> unsigned hash_vect_as_int(vector<T> const &v) {
 	return jenkins_one_at_a_time_hash((int const*)v.data(), sizeof(T)*v.size()/sizeof(int));
 }
 
+struct fnv1a_hash_t { // 64-bit FNV-1a hash of raw bytes; used for file cache keys and determinism checks, so must be stable across runs
+	uint64_t hash;
+	fnv1a_hash_t(uint64_t hash_=14695981039346656037ULL) : hash(hash_) {} // pass a previous hash value to continue it
+	void add_bytes(void const *data, size_t sz) {
+		for (size_t i = 0; i < sz; ++i) {hash = 1099511628211ULL*(hash ^ ((unsigned char const *)data)[i]);}
+	}
+	template<typename T> void add(T const &v) {add_bytes(&v, sizeof(T));} // T should have no padding
+};
+
 
 struct vector4d : public vector3d { // size = 16
 	float w;
@@ -1063,6 +1072,10 @@ public:
 	void free_data() {gl_delete(); free_client_mem();}
 	void gl_delete();
 	void load(int index, bool allow_diff_width_height=0, bool allow_two_byte_grayscale=0, bool ignore_word_alignment=0);
+	std::string get_decode_cache_fn(int index, bool allow_diff_width_height, bool allow_two_byte_grayscale, bool ignore_word_alignment) const;
+	bool read_from_decode_cache(std::string const &cache_fn);
+	void write_to_decode_cache (std::string const &cache_fn) const;
+	uint64_t get_load_cost() const;
 	void set_image_size(int w, int h, bool allow_diff_width_height);
 	void load_raw_bmp(int index, bool allow_diff_width_height, bool allow_two_byte_grayscale);
 	void load_targa(int index, bool allow_diff_width_height);
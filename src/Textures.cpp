@@ -7,6 +7,7 @@
 #include "textures.h"
 #include "gl_ext_arb.h"
 #include "shaders.h"
+#include <thread>
 
 
 float const TEXTURE_SMOOTH        = 0.01;
@@ -176,6 +177,8 @@ texture_t(0, 6, 0,    0,    1, 3, 1, "keycard.png", 0, 1, 4.0), // 512x512
 };
 
 vector<texture_t> textures;
+unsigned const TEXTURES_RESERVE = 4096; // capacity reserved so that adding textures doesn't move textures that other threads may be reading
+std::thread::id const textures_main_thread(std::this_thread::get_id()); // static init runs on the main thread
 
 
 // zval should depend on def_water_level and temperature
@@ -230,6 +233,7 @@ bool is_tex_disabled(int i) {
 void load_texture_names() {
 
 	if (!texture_name_map.empty()) return; // already loaded
+	textures.reserve(TEXTURES_RESERVE);
 	textures.resize(sizeof(def_textures)/sizeof(texture_t));
 
 	for (unsigned i = 0; i < textures.size(); ++i) {
@@ -263,11 +267,20 @@ void load_textures() {
 	if (using_custom_landscape_texture()) {set_landscape_texture_from_file();} // must be done first
 	load_texture_names();
 
-#pragma omp parallel for schedule(dynamic)
-	for (int i = 0; i < (int)textures.size(); ++i) {
+	vector<pair<uint64_t, unsigned>> load_order; // {cost, index}
+
+	for (unsigned i = 0; i < textures.size(); ++i) {
+		if (!is_tex_disabled(i)) {load_order.emplace_back(textures[i].get_load_cost(), i);}
+	}
+	// start the largest textures first so that threads don't sit idle waiting for one big decode at the end
+	sort(load_order.begin(), load_order.end(), [](pair<uint64_t, unsigned> const &a, pair<uint64_t, unsigned> const &b) {return (a.first > b.first);});
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < (int)load_order.size(); ++i) {
 		//cout << "."; cout.flush();
-		if (!is_tex_disabled(i)) {textures[i].load(i, 0, 0, 1);} // ignore word alignment here, since resizing isn't thread safe
+		unsigned const ix(load_order[i].second);
+		textures[ix].load(ix, 0, 0, 1); // ignore word alignment here, since resizing isn't thread safe
 	}
+	print_texture_decode_cache_stats();
 	for (int i = 0; i < (int)textures.size(); ++i) {
 		if (!is_tex_disabled(i)) {textures[i].fix_word_alignment();}
 	}
@@ -319,10 +332,22 @@ void print_texture_memory_usage() { // full cities scene: 142MB / 272MB (660MB u
 
 
 int texture_lookup(string const &name) {
-	name_map_t::const_iterator it(texture_name_map.find(name));
-	return ((it != texture_name_map.end()) ? it->second : -1);
+	int tid(-1);
+#pragma omp critical(texture_name_map) // may be called from a background thread while textures are being loaded on the main thread
+	{
+		name_map_t::const_iterator it(texture_name_map.find(name));
+		if (it != texture_name_map.end()) {tid = it->second;}
+	}
+	return tid;
 }
 
+// textures can't be loaded on background threads because that requires a GL context and modifies the textures vector; get_texture_by_name() returns
+// no texture for unloaded textures on any other thread; threads that set this flag expect this, and must check texture_load_was_skipped() and redo their work on the main thread
+thread_local bool disable_texture_load(0), skipped_texture_load(0);
+
+void set_texture_load_disabled_for_thread(bool disabled) {disable_texture_load = disabled; skipped_texture_load = 0;}
+bool texture_load_was_skipped() {return skipped_texture_load;}
+
 int get_texture_by_name(string const &name, bool is_normal_map, bool invert_y, int wrap_mir, float aniso,
 	bool allow_compress, int use_mipmaps, unsigned ncolors, bool is_alpha_mask)
 {
@@ -330,21 +355,45 @@ int get_texture_by_name(string const &name, bool is_normal_map, bool invert_y, i
 	if (ix > 0 || ix == -1 || name == "0") return ix; // a number was specified
 	if (name == "none" || name == "null")  return -1; // no texture
 	int tid(texture_lookup(name));
-	if (tid >= 0) {assert((unsigned)tid < textures.size()); return tid;}
+	if (tid >= 0) return tid;
+
+	if (std::this_thread::get_id() != textures_main_thread) { // only the main thread can add textures, so a texture is never loaded twice
+		if (!disable_texture_load) {
+			static bool had_warning(0);
+			if (!had_warning) {std::cerr << "Warning: Texture " << name << " requested from a background thread; returning no texture" << endl; had_warning = 1;}
+		}
+		skipped_texture_load = 1;
+		return -1;
+	}
+	if (disable_texture_load) {skipped_texture_load = 1; return -1;}
 	//timer_t timer("Load Texture " + name);
 	// try to load/add the texture directly from a file: assume it's RGB with wrap and mipmaps
-	tid = textures.size();
 	bool const do_compress(allow_compress && def_tex_compress && !is_normal_map);
 	// type format width height wrap_mir ncolors use_mipmaps name [invert_y=0 [do_compress=1 [anisotropy=1.0 [mipmap_alpha_weight=1.0 [normal_map=0]]]]]
 	texture_t new_tex(0, IMG_FMT_AUTO, 0, 0, wrap_mir, ncolors, use_mipmaps, name, invert_y, do_compress,
 		((aniso > 0.0) ? aniso : def_tex_aniso), 1.0, is_normal_map);
+	if (textures.size() == textures.capacity()) {cout << "Warning: Texture count exceeds " << textures.size() << "; textures may move while other threads are reading them" << endl;}
+	bool added(0);
+#pragma omp critical(texture_name_map)
+	{
+		auto it(texture_name_map.find(name)); // second lookup under the lock
+
+		if (it != texture_name_map.end()) {tid = it->second;}
+		else { // reserve the slot; the name isn't added to the map until the texture is loaded, so other threads can't use it yet
+			tid   = textures.size();
+			added = 1;
+			textures.push_back(new_tex);
+		}
+	}
+	if (!added) return tid;
 
-	if (textures_inited) {
-		new_tex.load(tid);
-		if ((is_alpha_mask || ncolors == 1) && new_tex.ncolors == 4) {new_tex.fill_to_grayscale_color(255);} // alpha mask - fill color to white
-		new_tex.init();
+	if (textures_inited) { // on the main thread, so the GL context is valid
+		texture_t &tex(textures[tid]);
+		tex.load(tid);
+		if ((is_alpha_mask || ncolors == 1) && tex.ncolors == 4) {tex.fill_to_grayscale_color(255);} // alpha mask - fill color to white
+		tex.init();
 	}
-	textures.push_back(new_tex);
+#pragma omp critical(texture_name_map)
 	texture_name_map[name] = tid;
 	return tid;
 }
@@ -55,7 +55,7 @@ extern int is_cloudy, num_smileys, load_coll_objs, world_mode, start_ripple, has
 extern int num_dodgeballs, display_mode, game_mode, num_trees, tree_mode, has_scenery2, UNLIMITED_WEAPONS, ground_effects_level;
 extern float temperature, zmin, TIMESTEP, base_gravity, orig_timestep, fticks, tstep, sun_rot, czmax, czmin, dodgeball_metalness;
 extern point cpos2, orig_camera, orig_cdir;
-extern unsigned create_voxel_landscape, scene_smap_vbo_invalid, num_dynam_parts, max_num_mat_spheres, init_item_counts[];
+extern unsigned create_voxel_landscape, scene_smap_vbo_invalid, num_dynam_parts, max_num_mat_spheres, init_item_counts[], cobj_line_bench_lines;
 extern obj_type object_types[];
 extern string cobjs_out_fn;
 extern coll_obj_group coll_objects;
@@ -884,6 +884,7 @@ void add_all_coll_objects(const char *filename, bool re_add) {
 	pre_rt_bvh_build_hook(); // required for light ray tracing so that BVH nodes are properly expanded
 	build_cobj_tree(0, verbose);
 	post_rt_bvh_build_hook(); // required for light ray tracing (unexpand cobjs but leave BVH nodes expanded)
+	if (verbose && cobj_line_bench_lines > 0) {run_cobj_tree_line_query_benchmark(cobj_line_bench_lines);}
 	check_contained_cube_sides();
 	flag_cobjs_indoors_outdoors();
 }
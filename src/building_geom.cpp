@@ -2144,6 +2144,24 @@ void building_t::update_stats(building_stats_t &s) const { // calculate all of t
 	s.nobjs  += interior->room_geom->objs.size();
 	s.nverts += interior->room_geom->get_num_verts();
 }
+// hash of the generated room objects, used to check that room details generation is deterministic; explicitly hashes each field to avoid struct padding
+uint64_t building_t::get_room_objs_hash() const {
+	if (!has_room_geom()) return 0;
+	fnv1a_hash_t hash;
+	auto add_val = [&hash](uint32_t v) {hash.add(v);};
+	auto add_fp  = [&hash](float    v) {hash.add(v);};
+
+	for (room_object_t const &o : interior->room_geom->objs) {
+		for (unsigned d = 0; d < 3; ++d) {add_fp(o.d[d][0]); add_fp(o.d[d][1]);}
+		add_val(o.type + (o.shape << 8) + (o.room_id << 16) + (o.dim << 24) + (o.dir << 25));
+		add_val(o.flags);
+		add_val(o.obj_id + (o.drawer_flags << 16));
+		add_val(o.item_flags + (o.state_flags << 16));
+		add_fp(o.light_amt);
+		UNROLL_4X(add_fp(o.color[i_]);)
+	}
+	return hash.hash;
+}
 
 bool door_opens_inward(door_base_t const &door, cube_t const &room) {
 	return (room.is_all_zeros() || (door.d[door.dim][0] < room.get_center_dim(door.dim)) == door.open_dir); // null room always returns 1 (conservative)
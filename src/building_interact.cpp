@@ -21,6 +21,7 @@ extern float fticks, CAMERA_RADIUS, office_chair_rot_rate;
 extern double tfticks;
 extern building_dest_t cur_player_building_loc;
 extern building_t const *player_building;
+extern building_params_t global_building_params;
 
 
 bool player_can_open_door(door_t const &door);
@@ -511,7 +512,10 @@ bool building_t::apply_player_action_key(point const &closest_to_in, vector3d co
 	else { // interior door
 		door_t &door(interior->doors[door_ix]);
 		if (!player_can_open_door(door)) return 0; // locked/blocked
-		if (door.locked && !player_has_room_key()) {door.locked = 0;} // don't lock door when closing, to prevent the player from locking themselves in a room
+		if (door.locked && !player_has_room_key()) { // don't lock door when closing, to prevent the player from locking themselves in a room
+			door.locked = 0;
+			invalidate_nav_path_cache(); // AI may now be able to open this door
+		}
 		toggle_door_state(door_ix, 1, 1, closest_to); // toggle state if interior door; player_in_this_building=1, by_player=1, at player pos
 		//interior->room_geom->modified_by_player = 1; // should door state always be preserved?
 	}
@@ -806,6 +810,8 @@ void building_t::toggle_door_state(unsigned door_ix, bool player_in_this_buildin
 	door.toggle_open_state(by_player/*player_in_this_building*/); // allow partial open/animated door if player is in this building - no, if done by the player
 	// we changed the door state, but navigation should adapt to this, except for doors on stairs (which are special)
 	if (door.on_stairs) {invalidate_nav_graph();} // any in-progress paths may have people walking to and stopping at closed/locked doors
+	// cached paths may use this door, or may now have a shorter route through it; skip if the AI can open it, since it's passable either way
+	else if (!global_building_params.ai_opens_doors || door.locked) {invalidate_nav_path_cache();}
 	interior->door_state_updated = 1; // required for AI navigation logic to adjust to this change
 	if (has_room_geom()) {interior->room_geom->invalidate_mats_mask |= (1 << MAT_TYPE_DOORS);} // need to recreate doors VBO
 
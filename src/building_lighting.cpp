@@ -7,16 +7,23 @@
 #include "lightmap.h" // for light_source
 #include "cobj_bsp_tree.h"
 #include "profiler.h"
+#include "binary_file_io.h"
+#include "mapped_file.h" // for create_dir_if_missing()
 #include <thread>
+#include <iomanip>
 
 bool  const USE_BKG_THREAD      = 1;
 bool  const INDIR_BASEMENT_EN   = 1;
 bool  const INDIR_ATTIC_ENABLE  = 1;
 bool  const INDIR_BLDG_ENABLE   = 1;
 unsigned INDIR_LIGHT_FLOOR_SPAN = 5; // in number of floors, generally an odd number to represent current floor and floors above/below; 0 is unlimited
+unsigned indir_light_batch_size(0); // number of lights to ray cast in parallel, one per thread; 0 or 1 processes one light at a time using all threads
 float const ATTIC_LIGHT_RADIUS_SCALE = 2.0; // larger radius in attic, since space is larger
+unsigned const INDIR_CACHE_MAGIC   = 0x43494233; // "3BIC"
+unsigned const INDIR_CACHE_VERSION = 1;
+string building_indir_cache_dir; // directory for cached building indirect lighting volumes; empty = disabled
 
-extern bool camera_in_building, player_in_attic, some_person_has_idle_animation;
+extern bool camera_in_building, player_in_attic, some_person_has_idle_animation, headless_mode;
 extern int MESH_Z_SIZE, display_mode, display_framerate, camera_surf_collide, animate2, frame_counter, building_action_key, player_in_basement, player_in_elevator;
 extern unsigned LOCAL_RAYS, MAX_RAY_BOUNCES, NUM_THREADS;
 extern float indir_light_exp, fticks;
@@ -401,14 +408,81 @@ colorRGBA get_outdoor_light_color() {
 
 unsigned const IS_WINDOW_BIT = (1<<24); // if this bit is set, the light is from a window; if not, it's from a light room object
 
+struct indir_cache_header_t { // written directly to files, so all padding is explicit and zeroed
+	unsigned magic=0, version=0;
+	uint64_t key=0;
+	unsigned data_size=0, num_lights=0;
+	float compute_ms=0.0; // ray casting time of the cached lighting
+	unsigned pad=0;
+};
+static_assert(sizeof(indir_cache_header_t) == 32, "indir_cache_header_t has implicit padding");
+
+struct indir_cache_stats_t {
+	unsigned hits=0, misses=0, writes=0, errors=0;
+	double saved_ms=0.0, load_ms=0.0;
+	float get_hit_rate() const {return ((hits + misses) ? float(hits)/(hits + misses) : 0.0f);}
+	void print() const {
+		if (hits + misses == 0) return; // cache unused
+		cout << "Building indir lighting cache: " << hits << " hits, " << misses << " misses, hit rate " << 100.0*get_hit_rate() << "%, " << writes << " writes, "
+			 << errors << " errors, " << load_ms << "ms loading, " << saved_ms << "ms of ray casting saved" << endl;
+	}
+};
+indir_cache_stats_t indir_cache_stats;
+
+// local lighting is written as runs of consecutive nonzero cells, since most of the volume is outside the lit floors and rooms
+bool write_indir_cache_file(string const &fn, indir_cache_header_t const &header, lmap_manager_t const &lmgr) {
+	vector<unsigned> runs; // {start, count} pairs
+	vector<float> vals;
+
+	for (unsigned i = 0; i < header.data_size; ++i) {
+		float const *const lc(lmgr.get_cell(i).lc);
+		if (lc[0] == 0.0f && lc[1] == 0.0f && lc[2] == 0.0f) continue;
+		if (runs.empty() || runs[runs.size()-2] + runs.back() != i) {runs.push_back(i); runs.push_back(0);} // start a new run
+		++runs.back();
+		vals.insert(vals.end(), lc, lc+3);
+	}
+	unsigned const sizes[2] = {(unsigned)runs.size(), (unsigned)vals.size()};
+	binary_file_writer w;
+	if (!w.open(fn)) return 0;
+	return (w.write(&header, sizeof(header), 1) && w.write(sizes, sizeof(unsigned), 2) && (runs.empty() || (w.write(runs.data(), sizeof(unsigned), runs.size()) &&
+		w.write(vals.data(), sizeof(float), vals.size()))));
+}
+bool read_indir_cache_file(string const &fn, uint64_t key, indir_cache_header_t &header, lmap_manager_t &lmgr) {
+	binary_file_reader r;
+	if (!r.open(fn)) return 0;
+	unsigned sizes[2] = {0};
+	if (!r.read(&header, sizeof(header), 1) || !r.read(sizes, sizeof(unsigned), 2)) return 0;
+	if (header.magic != INDIR_CACHE_MAGIC || header.version != INDIR_CACHE_VERSION || header.key != key || header.data_size != lmgr.size()) return 0; // stale or invalid
+	if ((sizes[0] & 1) || sizes[0] > 2*header.data_size || sizes[1] > 3*header.data_size) return 0; // invalid sizes
+	vector<unsigned> runs(sizes[0]);
+	vector<float> vals(sizes[1]);
+	if (!runs.empty() && (!r.read(runs.data(), sizeof(unsigned), runs.size()) || !r.read(vals.data(), sizeof(float), vals.size()))) return 0;
+	unsigned pos(0);
+
+	for (unsigned i = 0; i < runs.size(); i += 2) { // validate before modifying lmgr
+		if (runs[i] > header.data_size || runs[i+1] > header.data_size - runs[i]) return 0;
+		pos += 3*runs[i+1];
+	}
+	if (pos != vals.size()) return 0;
+	pos = 0;
+
+	for (unsigned i = 0; i < runs.size(); i += 2) {
+		for (unsigned c = runs[i]; c < runs[i] + runs[i+1]; ++c, pos += 3) {UNROLL_3X(lmgr.get_cell(c).lc[i_] = vals[pos+i_];)}
+	}
+	return 1;
+}
+
 class building_indir_light_mgr_t {
+	enum {CACHE_UNCHECKED=0, CACHE_MISS, CACHE_DONE, CACHE_DIRTY}; // CACHE_MISS = computing lighting that can be written to the cache
 	bool is_running, kill_thread, lighting_updated, needs_to_join, need_bvh_rebuild, update_windows, is_negative_light, in_ext_basement;
-	int cur_bix, cur_light, cur_floor;
-	unsigned cur_tid;
+	int cur_bix, cur_floor;
+	unsigned cur_tid, cache_state;
+	float compute_ms; // ray casting time since lighting was invalidated
 	colorRGBA outdoor_color;
 	cube_t valid_area, light_bounds;
 	vector<unsigned char> tex_data;
-	vector<unsigned> light_ids;
+	vector<unsigned> light_ids, cur_lights; // cur_lights are processed together; a light removal is always processed alone
+	vector<lmap_local_accum_t> thread_accums; // per-thread lighting for batches of lights
 	vector<pair<float, unsigned>> lights_to_sort;
 	deque<unsigned> remove_queue;
 	set<unsigned> lights_complete, lights_seen;
@@ -425,19 +499,19 @@ class building_indir_light_mgr_t {
 		lmgr.alloc(tot_sz, MESH_X_SIZE, MESH_Y_SIZE, MESH_SIZE[2], (unsigned char **)nullptr, init_lmcell);
 	}
 	void start_lighting_compute(building_t const &b) {
-		assert(cur_light >= 0);
+		assert(!cur_lights.empty());
 		init_lmgr(0); // clear_lighting=0
 		is_running = 1;
 		lighting_updated = 1;
 
-		if (USE_BKG_THREAD) { // start a thread to compute cur_light for building b
-			rt_thread = std::thread(&building_indir_light_mgr_t::cast_light_rays, this, b);
+		if (USE_BKG_THREAD) { // start a thread to compute cur_lights for building b
+			rt_thread = std::thread(&building_indir_light_mgr_t::cast_cur_light_rays, this, b);
 			needs_to_join = 1;
 		}
 		else {
 			// per-light time for large office building: orig: 194ms, per-floor BVH: 96ms, clip rays to floor: 44ms, now 37ms
 			highres_timer_t timer("Ray Cast Building Light");
-			cast_light_rays(b);
+			cast_cur_light_rays(b);
 		}
 	}
 	vector3d get_reflect_dir(vector3d const &dir, vector3d const &cnorm) {
@@ -452,9 +526,23 @@ class building_indir_light_mgr_t {
 		if (dot_product(dir, cnorm) < 0.0) {dir.negate();} // make sure it points away from the surface (is this needed?)
 		pos = cpos + tolerance*dir; // move slightly away from the surface
 	}
-	void cast_light_rays(building_t const &b) {
+	void cast_cur_light_rays(building_t const &b) {
 		// Note: modifies lmgr, but otherwise thread safe
 		unsigned const num_rt_threads(max(1U, (NUM_THREADS - (USE_BKG_THREAD ? 1 : 0)))); // reserve a thread for the main thread if running in the background
+
+		auto const start(high_resolution_clock::now());
+		if (cur_lights.size() == 1) {cast_light_rays(b, cur_lights.front(), num_rt_threads, nullptr);} // split rays across threads
+		else { // one light per thread; accumulate into per-thread buffers to avoid races between lights, then merge
+			thread_accums.resize(num_rt_threads);
+#pragma omp parallel for schedule(dynamic,1) num_threads(num_rt_threads)
+			for (int i = 0; i < (int)cur_lights.size(); ++i) {cast_light_rays(b, cur_lights[i], 1, &thread_accums[omp_get_thread_num_3dw()]);}
+			if (kill_thread) {for (lmap_local_accum_t &a : thread_accums) {a.clear();}} // lighting will be reset anyway
+			else {lmap_local_accum_t::merge_into(thread_accums, lmgr);}
+		}
+		compute_ms += 1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - start).count();
+		is_running = 0; // flag as done
+	}
+	void cast_light_rays(building_t const &b, unsigned cur_light, unsigned num_rt_threads, lmap_local_accum_t *accum) {
 		unsigned base_num_rays(LOCAL_RAYS), dim(2), dir(0); // default dim is z; dir=2 is omnidirectional
 		cube_t const scene_bounds(get_scene_bounds_bcube()); // expected by lmap update code
 		point const ray_scale(scene_bounds.get_size()/light_bounds.get_size()), llc_shift(scene_bounds.get_llc() - light_bounds.get_llc()*ray_scale);
@@ -466,7 +554,6 @@ class building_indir_light_mgr_t {
 		cube_t light_cube;
 		colorRGBA lcolor;
 		vector3d light_dir;
-		assert(cur_light >= 0);
 
 		if (is_window) { // window
 			unsigned const window_ix(cur_light & ~IS_WINDOW_BIT);
@@ -551,7 +638,7 @@ class building_indir_light_mgr_t {
 			// room lights already contribute direct lighting, so we skip this ray; however, windows don't, so we add their primary ray contribution
 			if (is_window && init_cpos != origin) {
 				point const p1(origin*ray_scale + llc_shift), p2(init_cpos*ray_scale + llc_shift); // transform building space to global scene space
-				add_path_to_lmcs(&lmgr, nullptr, p1, p2, weight, lcolor*NUM_PRI_SPLITS, LIGHTING_LOCAL, 0); // local light, no bcube; scale color based on splits
+				add_path_to_lmcs(&lmgr, nullptr, p1, p2, weight, lcolor*NUM_PRI_SPLITS, LIGHTING_LOCAL, 0, accum); // local light, no bcube; scale color based on splits
 			}
 			if (!hit) continue; // done
 			colorRGBA const init_color(lcolor.modulate_with(ccolor));
@@ -570,7 +657,7 @@ class building_indir_light_mgr_t {
 
 					if (cpos != pos) { // accumulate light along the ray from pos to cpos (which is always valid) with color cur_color
 						point const p1(pos*ray_scale + llc_shift), p2(cpos*ray_scale + llc_shift); // transform building space to global scene space
-						add_path_to_lmcs(&lmgr, nullptr, p1, p2, weight, cur_color, LIGHTING_LOCAL, 0); // local light, no bcube
+						add_path_to_lmcs(&lmgr, nullptr, p1, p2, weight, cur_color, LIGHTING_LOCAL, 0, accum); // local light, no bcube
 					}
 					if (!hit) break; // done
 					cur_color = cur_color.modulate_with(ccolor);
@@ -579,7 +666,6 @@ class building_indir_light_mgr_t {
 				} // for bounce
 			} // for splits
 		} // for n
-		is_running = 0; // flag as done
 	}
 	void wait_for_finish(bool force_kill) {
 		// Note: for now the time taken to process a light should be pretty fast so we just block until finished; set kill_thread=1 to be faster
@@ -589,6 +675,7 @@ class building_indir_light_mgr_t {
 	}
 	void update_volume_light_texture() { // full update, 6.6ms for z=128
 		init_lmgr(0); // init on first call; clear_lighting=0
+		if (headless_mode) return; // no GL context
 		//highres_timer_t timer("Lighting Tex Create");
 		indir_light_tex_from_lmap(cur_tid, lmgr, tex_data, MESH_X_SIZE, MESH_Y_SIZE, MESH_SIZE[2], indir_light_exp, 1); // local_only=1
 	}
@@ -626,19 +713,103 @@ class building_indir_light_mgr_t {
 		for (auto const &light : lights_to_sort) {light_ids.push_back(light.second);}
 		lights_to_sort.clear();
 	}
+	void invalidate_cache_state() { // lighting no longer matches the deterministic building state, or has been incrementally updated
+		if (cache_state == CACHE_MISS) {cache_state = CACHE_DIRTY;}
+	}
+	// the key includes the building's geometry, room objects (including light on/off state), doors, windows, the set of lights, and the lighting parameters
+	uint64_t get_cache_key(building_t const &b) const {
+		fnv1a_hash_t hash(b.get_room_objs_hash()); // continue the hash
+		auto add_bytes([&hash](void const *data, size_t sz) {hash.add_bytes(data, sz);});
+		int const ivals[] = {(int)INDIR_CACHE_VERSION, cur_bix, cur_floor, in_ext_basement, (int)LOCAL_RAYS, (int)MAX_RAY_BOUNCES, (int)INDIR_LIGHT_FLOOR_SPAN,
+			MESH_X_SIZE, MESH_Y_SIZE, MESH_SIZE[2], (int)light_ids.size(), (int)windows.size()};
+		add_bytes(ivals, sizeof(ivals));
+		add_bytes(&b.bcube, sizeof(cube_t));
+		add_bytes(&light_bounds, sizeof(cube_t));
+		if (!windows.empty()) {add_bytes(&outdoor_color, sizeof(colorRGBA));}
+		vector<unsigned> lights(light_ids);
+		sort(lights.begin(), lights.end()); // light_ids are sorted by distance to the player
+		add_bytes(lights.data(), lights.size()*sizeof(unsigned));
+		for (cube_with_ix_t const &w : windows) {add_bytes(&w, sizeof(cube_with_ix_t));}
+
+		if (b.interior) {
+			for (door_t const &d : b.interior->doors) {
+				float const vals[2] = {float(d.open), d.open_amt};
+				add_bytes(vals, sizeof(vals));
+			}
+		}
+		return hash.hash;
+	}
+	static string get_cache_fn(uint64_t key) {
+		std::ostringstream oss;
+		oss << building_indir_cache_dir << "/bindir_" << std::hex << std::setw(16) << std::setfill('0') << key << ".lmap.gz";
+		return oss.str();
+	}
+	void read_from_cache(building_t const &b) {
+		if (building_indir_cache_dir.empty() || light_ids.empty()) return;
+		auto const start(high_resolution_clock::now());
+		uint64_t const key(get_cache_key(b));
+		string const fn(get_cache_fn(key));
+		uint64_t mtime(0), fsize(0);
+		cache_state = CACHE_MISS;
+
+		if (get_file_mod_time_and_size(fn, mtime, fsize)) { // file exists
+			init_lmgr(0); // clear_lighting=0; lmgr was reset when lighting was invalidated
+			indir_cache_header_t header;
+
+			if (read_indir_cache_file(fn, key, header, lmgr)) {
+				lights_complete.insert(light_ids.begin(), light_ids.end());
+				update_volume_light_texture();
+				lighting_updated = 0;
+				cache_state = CACHE_DONE;
+				float const load_ms(1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - start).count());
+				++indir_cache_stats.hits;
+				indir_cache_stats.load_ms  += load_ms;
+				indir_cache_stats.saved_ms += max(0.0f, (header.compute_ms - load_ms));
+			}
+			else {
+				lmgr.reset_all(); // may have been partially read
+				++indir_cache_stats.errors;
+			}
+		}
+		if (cache_state == CACHE_MISS) {++indir_cache_stats.misses;}
+	}
+	void write_to_cache(building_t const &b) {
+		cache_state = CACHE_DONE; // only try once
+
+		if (!create_dir_if_missing(building_indir_cache_dir)) {
+			std::cerr << "Error: Failed to create building indir lighting cache directory " << building_indir_cache_dir << endl;
+			++indir_cache_stats.errors;
+			return;
+		}
+		indir_cache_header_t header;
+		header.magic      = INDIR_CACHE_MAGIC;
+		header.version    = INDIR_CACHE_VERSION;
+		header.key        = get_cache_key(b);
+		header.data_size  = lmgr.size();
+		header.num_lights = lights_complete.size();
+		header.compute_ms = compute_ms;
+		string const fn(get_cache_fn(header.key));
+		if (write_indir_cache_file(fn, header, lmgr)) {++indir_cache_stats.writes; return;}
+		remove(fn.c_str()); // don't leave a partially written file
+		++indir_cache_stats.errors;
+	}
 public:
 	building_indir_light_mgr_t() : is_running(0), kill_thread(0), lighting_updated(0), needs_to_join(0), need_bvh_rebuild(0),
-		update_windows(0), is_negative_light(0), in_ext_basement(0), cur_bix(-1), cur_light(-1), cur_floor(-1), cur_tid(0) {}
+		update_windows(0), is_negative_light(0), in_ext_basement(0), cur_bix(-1), cur_floor(-1), cur_tid(0), cache_state(CACHE_UNCHECKED), compute_ms(0.0) {}
 
 	cube_t get_light_bounds() const {return light_bounds;}
+	bool all_lights_complete() const {return (!is_running && cur_lights.empty() && remove_queue.empty());}
+	unsigned get_num_lights_complete() const {return lights_complete.size();}
 
 	void invalidate_lighting() {
+		end_rt_job(); // must finish before cur_lights is cleared
 		is_negative_light = in_ext_basement = 0;
-		cur_light = -1;
+		cache_state = CACHE_UNCHECKED;
+		compute_ms  = 0.0;
+		cur_lights.clear();
 		remove_queue.clear();
 		lights_complete.clear();
 		lights_seen.clear();
-		end_rt_job();
 		lmgr.reset_all(); // clear lighting values back to 0
 	}
 	void clear() {
@@ -706,12 +877,11 @@ public:
 		if (!need_rebuild) {need_bvh_rebuild |= floor_change;} // rebuild on player floor change if not rebuilt above
 		if (need_bvh_rebuild) {build_bvh(b, target);}
 		
-		if (cur_light >= 0) {
-			if (!is_negative_light) {lights_complete.insert(cur_light);} // mark the most recent light as complete if not a light removal
-			cur_light = -1;
-		}
+		if (!is_negative_light) {lights_complete.insert(cur_lights.begin(), cur_lights.end());} // mark the most recent lights as complete if not a light removal
+		cur_lights.clear();
+
 		if (!remove_queue.empty()) { // remove an existing light; must run even when player_in_elevator==2 to remove elevator light at old pos
-			cur_light = remove_queue.front();
+			cur_lights.push_back(remove_queue.front());
 			remove_queue.pop_front();
 			is_negative_light = 1;
 		}
@@ -721,13 +891,17 @@ public:
 			b.get_lights_with_priorities(target, valid_area, lights_to_sort);
 			add_window_lights(b, target);
 			sort_lights_by_priority();
+			if (cache_state == CACHE_UNCHECKED && lights_complete.empty()) {read_from_cache(b);} // marks all lights as complete on a cache hit
+			unsigned const batch_size(max(1U, indir_light_batch_size));
 
 			for (auto i = light_ids.begin(); i != light_ids.end(); ++i) {
 				lights_seen.insert(*i); // must track lights across all floors seen for correct progress update
-				if (cur_light < 0 && lights_complete.find(*i) == lights_complete.end()) {cur_light = *i;} // find an incomplete light
+				// find the nearest incomplete lights
+				if (cur_lights.size() < batch_size && lights_complete.find(*i) == lights_complete.end()) {cur_lights.push_back(*i);}
 			}
 		}
-		if (cur_light >= 0) {start_lighting_compute(b);} // this light is next
+		if (!cur_lights.empty()) {start_lighting_compute(b);} // these lights are next
+		else if (cache_state == CACHE_MISS && remove_queue.empty()) {write_to_cache(b);} // all lights have been added
 		tid = cur_tid;
 	}
 	void register_light_state_change(unsigned light_ix, bool light_is_on, bool in_elevator, bool geom_changed) {
@@ -736,8 +910,9 @@ public:
 			return;
 		}
 		unsigned const num_erased(lights_complete.erase(light_ix)); // light is no longer completed; erase its state
-		bool const is_cur_light((int)light_ix == cur_light && is_running);
-		// Note: we can't just stop in the middle, because that will leave cur_light in an invalid/incomplete state
+		invalidate_cache_state();
+		bool const is_cur_light(is_running && std::find(cur_lights.begin(), cur_lights.end(), light_ix) != cur_lights.end());
+		// Note: we can't just stop in the middle, because that will leave cur_lights in an invalid/incomplete state
 		// Note: if door state changed since this light was turned on, removing it may leave some light
 		if ((geom_changed || !light_is_on || (in_elevator && num_erased)) && (num_erased || is_cur_light)) {add_to_remove_queue(light_ix);} // must remove the light instead
 	}
@@ -785,15 +960,21 @@ public:
 		bvh.build_tree_top(0); // verbose=0
 		need_bvh_rebuild = 0;
 	}
-	void invalidate_bvh    () {need_bvh_rebuild = 1;} // Note: can't directly clear bvh because a thread may be using it
-	void invalidate_windows() {update_windows = 1;}
+	void invalidate_bvh    () {need_bvh_rebuild = 1; invalidate_cache_state();} // Note: can't directly clear bvh because a thread may be using it
+	void invalidate_windows() {update_windows = 1; invalidate_cache_state();}
 	cube_bvh_t const &get_bvh() const {return bvh;}
 };
 
 building_indir_light_mgr_t building_indir_light_mgr;
 
 void free_building_indir_texture() {building_indir_light_mgr.free_indir_texture();}
+void get_building_indir_cache_stats(unsigned &hits, unsigned &misses, double &saved_ms) {
+	hits     = indir_cache_stats.hits;
+	misses   = indir_cache_stats.misses;
+	saved_ms = indir_cache_stats.saved_ms;
+}
 void end_building_rt_job() {building_indir_light_mgr.end_rt_job();}
+void print_building_indir_cache_stats() {indir_cache_stats.print();}
 cube_t get_building_indir_light_bounds() {return building_indir_light_mgr.get_light_bounds();}
 
 void building_t::create_building_volume_light_texture(unsigned bix, point const &target, unsigned &tid) const {
@@ -801,6 +982,48 @@ void building_t::create_building_volume_light_texture(unsigned bix, point const
 	building_indir_light_mgr.register_cur_building(*this, bix, target, tid);
 }
 
+// returns the number of lights on the floor above ground with the most lights, and a player position below the center light of that floor
+unsigned building_t::get_indir_lighting_bench_target(point &target) const {
+	if (!has_room_geom()) return 0;
+	vect_room_object_t const &objs(interior->room_geom->objs);
+	auto objs_end(interior->room_geom->get_placed_objs_end()); // skip buttons/stairs/elevators
+	map<unsigned, vector<unsigned>> lights_by_floor;
+
+	for (auto i = objs.begin(); i != objs_end; ++i) {
+		if (i->type != TYPE_LIGHT || !i->is_light_on() || i->in_attic() || i->in_elevator() || i->z1() < ground_floor_z1) continue;
+		lights_by_floor[get_floor_for_zval(i->zc())].push_back(i - objs.begin());
+	}
+	vector<unsigned> const *best(nullptr);
+
+	for (auto const &f : lights_by_floor) {
+		if (best == nullptr || f.second.size() > best->size()) {best = &f.second;}
+	}
+	if (best == nullptr) return 0;
+	room_object_t const &light(objs[(*best)[best->size()/2]]);
+	target = light.get_cube_center();
+	target.z = light.z1() - 0.25*get_window_vspace(); // at head height below the light
+	return best->size();
+}
+
+// runs indirect lighting from target until all lights in range have been added, in batches of batch_size lights; used for benchmarking;
+// returns the time taken in ms and the number of lights added
+float building_t::run_indir_lighting_to_convergence(unsigned bix, point const &target, unsigned batch_size, unsigned &num_lights) const {
+	unsigned const prev_batch_size(indir_light_batch_size);
+	unsigned tid(0);
+	building_indir_light_mgr.clear(); // start from no lighting
+	indir_light_batch_size = batch_size;
+	trace_zone_t zone("Indir Lighting Converge");
+	auto const start(high_resolution_clock::now());
+	create_building_volume_light_texture(bix, target, tid);
+	while (!building_indir_light_mgr.all_lights_complete()) {sleep_for_ms(1); create_building_volume_light_texture(bix, target, tid);}
+	float const ms(1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - start).count());
+	zone.end();
+	indir_light_batch_size = prev_batch_size;
+	num_lights = building_indir_light_mgr.get_num_lights_complete();
+	building_indir_light_mgr.clear();
+	return ms;
+}
+
 bool building_t::ray_cast_camera_dir(point const &camera_bs, point &cpos, colorRGBA &ccolor) const { // unused - for debugging; excludes attic and extended basement
 	assert(!USE_BKG_THREAD); // not legal to call when running lighting in a background thread
 	building_indir_light_mgr.build_bvh(*this, camera_bs);
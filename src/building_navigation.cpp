@@ -5,10 +5,18 @@
 #include "function_registry.h"
 #include "buildings.h"
 #include "city.h" // for person_t
+#include "profiler.h" // for high_resolution_clock
 #include <queue>
+#include <atomic>
+#include <unordered_map>
+#include <cfloat> // for FLT_MAX
 
 
 float const COLL_RADIUS_SCALE = 0.75; // somewhat smaller than radius, but larger than PED_WIDTH_SCALE
+size_t const MAX_PATH_CACHE_ENTRIES = (1<<22); // max next-hop table entries per building before the path cache is cleared
+unsigned const FLOW_FIELD_MAX_CELLS = 512; // max flow field grid cells in each dim
+unsigned const FLOW_FIELD_MAX_STEPS = 128; // max flow field cells followed for each path
+unsigned const FLOW_DIST_INF        = UINT_MAX;
 
 int player_hiding_frame(0);
 building_dest_t cur_player_building_loc, prev_player_building_loc;
@@ -31,6 +39,32 @@ unsigned get_shower_cubes(room_object_t const &c, cube_t sides[2]);
 
 point get_cube_center_zval(cube_t const &c, float zval) {return point(c.xc(), c.yc(), zval);}
 
+struct nav_path_stats_t {
+	std::atomic<uint64_t> queries, cache_hits, tables_built, invalidations;
+	nav_path_stats_t() : queries(0), cache_hits(0), tables_built(0), invalidations(0) {}
+	void reset() {queries = cache_hits = tables_built = invalidations = 0;}
+};
+nav_path_stats_t nav_path_stats;
+
+void get_building_nav_path_stats(uint64_t &queries, uint64_t &cache_hits, uint64_t &tables_built, uint64_t &invalidations) {
+	queries       = nav_path_stats.queries;
+	cache_hits    = nav_path_stats.cache_hits;
+	tables_built  = nav_path_stats.tables_built;
+	invalidations = nav_path_stats.invalidations;
+}
+void reset_building_nav_path_stats() {nav_path_stats.reset();}
+
+struct flow_field_stats_t {
+	unsigned grid_builds=0, room_builds=0, player_builds=0;
+};
+flow_field_stats_t flow_field_stats;
+
+void get_building_flow_field_stats(unsigned &grid_builds, unsigned &room_builds, unsigned &player_builds) {
+	grid_builds   = flow_field_stats.grid_builds;
+	room_builds   = flow_field_stats.room_builds;
+	player_builds = flow_field_stats.player_builds;
+}
+
 // Note: this should go into building_t/buildings.h at some point, but is temporarily here
 class building_nav_graph_t {
 	struct conn_room_t { // size=16
@@ -58,11 +92,27 @@ class building_nav_graph_t {
 		float g_score, h_score, f_score;
 		a_star_node_state_t() : came_from_ix(-1), g_score(0), h_score(0), f_score(0) {}
 	};
+	struct path_scratch_t { // per-thread buffers reused across path queries
+		vector<a_star_node_state_t> state;
+		vector<uint8_t> open, closed; // tentative/already evaluated nodes
+		vector<pair<float, unsigned>> open_queue; // heap of {-cost, node}
+		vector<float> dist;
+	};
+	// lazily computed next-hop tables toward a dest node for one floor, used in place of running A* for each path query;
+	// floors are joined through stairs and ramp nodes by find_route_to_point(), which queries each floor separately
+	struct path_cache_t {
+		std::unordered_map<uint64_t, vector<int>> tables; // {dest, floor, flags} => next node toward dest for each node; -1 = unreachable
+		unsigned door_state_version=0; // version of door open/locked state the tables were computed for
+		size_t num_entries=0;
+		void clear() {tables.clear(); num_entries = 0;}
+	};
 
 	unsigned num_rooms=0, num_stairs=0;
 	float stairs_extend=0;
 	bool has_pg_ramp=0;
 	vector<node_t> nodes;
+	mutable path_cache_t path_cache; // Note: not thread safe; each building's people are updated by a single thread
+	std::atomic<unsigned> door_state_version;
 	node_t       &get_node(unsigned room)       {assert(room < nodes.size()); return nodes[room];}
 	node_t const &get_node(unsigned room) const {assert(room < nodes.size()); return nodes[room];}
 
@@ -74,9 +124,19 @@ class building_nav_graph_t {
 		}
 		assert(0); // must be found - should not get here
 	}
+	conn_room_t const &get_conn(unsigned from, unsigned to) const {
+		for (conn_room_t const &c : get_node(from).conn_rooms) {if (c.ix == to) return c;}
+		assert(0); // must be found - should not get here
+		return get_node(from).conn_rooms.front();
+	}
+	static path_scratch_t &get_path_scratch() {
+		static thread_local path_scratch_t scratch;
+		return scratch;
+	}
 public:
 	bool invalid=0;
-	building_nav_graph_t(float stairs_extend_) : stairs_extend(stairs_extend_) {}
+	building_nav_graph_t(float stairs_extend_) : stairs_extend(stairs_extend_), door_state_version(0) {}
+	void invalidate_path_cache() {++door_state_version;} // Note: this is safe to call in one thread while using in another
 
 	void set_num_rooms(unsigned num_rooms_, unsigned num_stairs_, bool has_pg_ramp_) {
 		num_rooms   = num_rooms_;
@@ -122,6 +182,7 @@ public:
 		assert(room1 != room2 && room1 < num_rooms && room2 < num_rooms);
 		remove_connection(room1, room2);
 		remove_connection(room2, room1);
+		path_cache.clear();
 	}
 	bool is_room_connected_to(unsigned room1, unsigned room2, vect_door_t const &doors, float zval, bool has_key) const {
 		// Note: likely faster than running full A* algorithm
@@ -460,8 +521,65 @@ public:
 		return 1; // Note: we can get here for complex floorplan office buildings with bad interior walls (-4.18, 4.28, -3.46)
 	}
 	
-	// A* algorithm; Note: path is stored backwards
-	bool find_path_points(unsigned room1, unsigned room2, unsigned ped_ix, float radius, float height, bool use_stairs, bool is_first_path,
+	// Dijkstra's algorithm from dest, using the same edge costs and door checks as A*; since the graph is bidirectional with the same connection points
+	// and doors in both directions, the resulting tables give the shortest path from every node to dest; stairs and ramps are only used as the start unless use_stairs=1
+	void calc_next_hops(unsigned dest, float zval, bool use_stairs, bool up_or_down, vect_door_t const &doors, bool has_key, vector<int> &next) const {
+		path_scratch_t &scratch(get_path_scratch());
+		vector<float> &dist(scratch.dist);
+		vector<pair<float, unsigned>> &open_queue(scratch.open_queue);
+		dist.clear();
+		dist.resize(nodes.size(), FLT_MAX);
+		next.clear();
+		next.resize(nodes.size(), -1);
+		open_queue.clear();
+		dist[dest] = 0.0;
+		open_queue.emplace_back(0.0, dest);
+
+		while (!open_queue.empty()) {
+			std::pop_heap(open_queue.begin(), open_queue.end());
+			float const cur_dist(-open_queue.back().first);
+			unsigned const cur(open_queue.back().second);
+			open_queue.pop_back();
+			if (cur_dist > dist[cur]) continue; // already reached with a lower cost
+			node_t const &cur_node(get_node(cur));
+			if (cur_node.is_vert_conn() && !use_stairs && cur != dest) continue; // stairs/ramp can't be an intermediate node in this mode
+			point const center(cur_node.get_center(zval));
+
+			for (auto i = cur_node.conn_rooms.begin(); i != cur_node.conn_rooms.end(); ++i) {
+				assert(i->ix < nodes.size());
+				if (!can_use_conn(*i, doors, zval, has_key)) continue; // blocked by closed or locked door
+				vector2d const &pt(i->pt[up_or_down]);
+				float const new_dist(cur_dist + p2p_dist_xy(center, pt) + p2p_dist_xy(pt, get_node(i->ix).get_center(zval)));
+				if (new_dist >= dist[i->ix]) continue; // not better
+				dist[i->ix] = new_dist;
+				next[i->ix] = cur;
+				open_queue.emplace_back(-new_dist, i->ix);
+				std::push_heap(open_queue.begin(), open_queue.end());
+			} // for i
+		} // end while()
+	}
+	vector<int> const &get_next_hops(unsigned dest, unsigned floor_ix, float zval, bool use_stairs, bool up_or_down, vect_door_t const &doors, bool has_key) const {
+		unsigned const version(door_state_version);
+
+		if (path_cache.door_state_version != version) { // a door was opened, closed, locked, or unlocked
+			if (!path_cache.tables.empty()) {++nav_path_stats.invalidations;}
+			path_cache.clear();
+			path_cache.door_state_version = version;
+		}
+		bool const key_opens(has_key && global_building_params.ai_opens_doors); // has_key has no effect if the AI doesn't open doors
+		uint64_t const key(dest | (uint64_t(floor_ix) << 32) | (uint64_t(use_stairs) << 61) | (uint64_t(up_or_down) << 62) | (uint64_t(key_opens) << 63));
+		auto it(path_cache.tables.find(key));
+		if (it != path_cache.tables.end()) {++nav_path_stats.cache_hits; return it->second;}
+		if (path_cache.num_entries + nodes.size() > MAX_PATH_CACHE_ENTRIES) {path_cache.clear();} // too large; start over
+		vector<int> &next(path_cache.tables[key]);
+		calc_next_hops(dest, zval, use_stairs, up_or_down, doors, has_key, next);
+		path_cache.num_entries += next.size();
+		++nav_path_stats.tables_built;
+		return next;
+	}
+
+	// uses the cached next-hop tables if enabled, otherwise the A* algorithm; Note: path is stored backwards
+	bool find_path_points(unsigned room1, unsigned room2, unsigned floor_ix, unsigned ped_ix, float radius, float height, bool use_stairs, bool is_first_path,
 		bool up_or_down, unsigned ped_rseed, vect_cube_t const &avoid, building_t const &building, point const &cur_pt,
 		vect_door_t const &doors, bool has_key, point const *const custom_dest, vector<point> &path) const
 	{
@@ -469,19 +587,42 @@ public:
 		assert(room1 < nodes.size() && room2 < nodes.size());
 		assert(room1 != room2);
 		path.clear();
-		vector<a_star_node_state_t> state(nodes.size());
-		vector<uint8_t> open(nodes.size(), 0), closed(nodes.size(), 0); // tentative/already evaluated nodes
-		std::priority_queue<pair<float, unsigned> > open_queue;
+		++nav_path_stats.queries;
+		path_scratch_t &scratch(get_path_scratch());
+		vector<a_star_node_state_t> &state(scratch.state);
+
+		if (global_building_params.ai_path_cache) {
+			vector<int> const &next(get_next_hops(room2, floor_ix, cur_pt.z, use_stairs, up_or_down, doors, has_key));
+			if (next[room1] < 0) return 0; // failed - no path from room1 to room2
+			if (state.size() < nodes.size()) {state.resize(nodes.size());}
+			state[room1].came_from_ix = -1; // only nodes along the path are read, so there's no need to reset the others
+
+			for (unsigned n = room1; n != room2;) { // fill in the same state that A* would have produced
+				unsigned const n2(next[n]);
+				vector2d const &pt(get_conn(n, n2).pt[up_or_down]);
+				state[n2].came_from_ix = n;
+				state[n2].path_pt.assign(pt.x, pt.y, cur_pt.z);
+				n = n2;
+			}
+			return reconstruct_path(state, avoid, building, cur_pt, radius, height, room2, room1, ped_ix, is_first_path, up_or_down, ped_rseed, custom_dest, path);
+		}
+		vector<uint8_t> &open(scratch.open), &closed(scratch.closed);
+		vector<pair<float, unsigned>> &open_queue(scratch.open_queue);
+		state .assign(nodes.size(), a_star_node_state_t());
+		open  .assign(nodes.size(), 0);
+		closed.assign(nodes.size(), 0);
+		open_queue.clear();
 		point const dest_pos(get_node(room2).get_center(cur_pt.z)); // Note: approximate, actual dest may be different
 		a_star_node_state_t &start(state[room1]);
 		start.g_score = 0.0;
 		start.h_score = start.f_score = p2p_dist_xy(get_node(room1).get_center(cur_pt.z), dest_pos); // estimated total cost from start to goal through current
 		open[room1]   = 1;
-		open_queue.push(make_pair(-start.f_score, room1));
+		open_queue.emplace_back(-start.f_score, room1);
 
 		while (!open_queue.empty()) {
-			unsigned const cur(open_queue.top().second);
-			open_queue.pop();
+			std::pop_heap(open_queue.begin(), open_queue.end());
+			unsigned const cur(open_queue.back().second);
+			open_queue.pop_back();
 			assert(!closed[cur]);
 			node_t const &cur_node(get_node(cur));
 			point const center(cur_node.get_center(cur_pt.z));
@@ -510,13 +651,216 @@ public:
 				sn.g_score = new_g_score;
 				sn.h_score = p2p_dist_xy(conn_center, dest_pos);
 				sn.f_score = sn.g_score + sn.h_score;
-				open_queue.push(make_pair(-sn.f_score, i->ix));
+				open_queue.emplace_back(-sn.f_score, i->ix);
+				std::push_heap(open_queue.begin(), open_queue.end());
 			} // for i
 		} // end while()
 		return 0; // failed - no path from room1 to room2
 	}
 }; // end building_nav_graph_t
 
+
+// shared distance fields over a coarse grid of one floor, sampled by all people pursuing the player on that floor rather than finding a path for each person;
+// room_dist is the distance to the player's room, and is only recomputed when the player changes rooms or floors, or when a door or room object changes state;
+// player_dist is the distance to the player within the player's room, and is recomputed over only the cells of that room when the player changes cells;
+// the grid is built for the largest person radius seen so far so that it's valid for everyone, and treats locked doors as closed since it's shared by people without keys
+class building_flow_field_t {
+	cube_t area;
+	float cell_sz=0.0;
+	unsigned nx=0, ny=0;
+	int player_cell=-1, player_src_cell=-1;
+	vector<uint8_t> walkable, in_room;
+	vector<unsigned> room_cells, room_dist, player_dist; // distances are in tenths of a cell
+	vector<pair<unsigned, unsigned>> open_queue; // min heap of {dist, cell}
+	point adj_target_in, adj_target_out; // cached result of move_ai_target_to_valid_pos() for the last target and person size
+	float adj_target_radius=0.0, adj_target_height=0.0; // radius of 0 marks the cache as invalid
+
+	bool is_valid_step(int x, int y, int dx, int dy, bool room_only) const {
+		int const x2(x + dx), y2(y + dy);
+		if (x2 < 0 || y2 < 0 || x2 >= (int)nx || y2 >= (int)ny) return 0;
+		vector<uint8_t> const &valid(room_only ? in_room : walkable);
+		if (!valid[y2*nx + x2]) return 0;
+		if (dx && dy && (!valid[y*nx + x2] || !valid[y2*nx + x])) return 0; // don't cut corners
+		return 1;
+	}
+	bool get_cell_range(cube_t const &c, int range[2][2]) const { // cells with centers inside c
+		for (unsigned d = 0; d < 2; ++d) {
+			range[d][0] = max(0, int(ceil((c.d[d][0] - area.d[d][0])/cell_sz - 0.5f)));
+			range[d][1] = min((int(d ? ny : nx) - 1), int(floor((c.d[d][1] - area.d[d][0])/cell_sz - 0.5f)));
+			if (range[d][0] > range[d][1]) return 0;
+		}
+		return 1;
+	}
+	void mark_cells(cube_t const &c, vector<uint8_t> &v, uint8_t val) {
+		int range[2][2];
+		if (!get_cell_range(c, range)) return;
+
+		for (int y = range[1][0]; y <= range[1][1]; ++y) {
+			for (int x = range[0][0]; x <= range[0][1]; ++x) {v[y*nx + x] = val;}
+		}
+	}
+	int get_cell(point const &pos) const { // returns -1 if outside the grid
+		int const x(floor((pos.x - area.x1())/cell_sz)), y(floor((pos.y - area.y1())/cell_sz));
+		if (x < 0 || y < 0 || x >= (int)nx || y >= (int)ny) return -1;
+		return (y*nx + x);
+	}
+	point get_cell_center(unsigned cell, float zval) const {return point((area.x1() + ((cell % nx) + 0.5f)*cell_sz), (area.y1() + ((cell / nx) + 0.5f)*cell_sz), zval);}
+
+	// returns the closest cell to pos within two cells that is walkable (and in the room if room_only) with a valid dist, if specified; returns -1 if there are none
+	int find_valid_cell(point const &pos, bool room_only, vector<unsigned> const *const dist) const {
+		int const cx(floor((pos.x - area.x1())/cell_sz)), cy(floor((pos.y - area.y1())/cell_sz));
+		vector<uint8_t> const &valid(room_only ? in_room : walkable);
+		int best(-1);
+		float dmin_sq(0.0);
+
+		for (int y = max(0, cy-2); y <= min(int(ny)-1, cy+2); ++y) {
+			for (int x = max(0, cx-2); x <= min(int(nx)-1, cx+2); ++x) {
+				unsigned const cell(y*nx + x);
+				if (!valid[cell] || (dist && (*dist)[cell] == FLOW_DIST_INF)) continue;
+				float const dsq(p2p_dist_xy_sq(pos, get_cell_center(cell, pos.z)));
+				if (best < 0 || dsq < dmin_sq) {best = cell; dmin_sq = dsq;}
+			}
+		}
+		return best;
+	}
+	// Dijkstra's algorithm over 8-connected cells from the current contents of open_queue; dist must be reset by the caller
+	void calc_dists(vector<unsigned> &dist, bool room_only) {
+		std::make_heap(open_queue.begin(), open_queue.end(), std::greater<pair<unsigned, unsigned>>());
+
+		while (!open_queue.empty()) {
+			std::pop_heap(open_queue.begin(), open_queue.end(), std::greater<pair<unsigned, unsigned>>());
+			pair<unsigned, unsigned> const cur(open_queue.back());
+			open_queue.pop_back();
+			if (cur.first > dist[cur.second]) continue; // already reached with a lower cost
+			int const x(cur.second % nx), y(cur.second / nx);
+
+			for (int dy = -1; dy <= 1; ++dy) {
+				for (int dx = -1; dx <= 1; ++dx) {
+					if ((dx == 0 && dy == 0) || !is_valid_step(x, y, dx, dy, room_only)) continue;
+					unsigned const cell((y + dy)*nx + (x + dx)), d(cur.first + ((dx && dy) ? 14 : 10));
+					if (d >= dist[cell]) continue; // not better
+					dist[cell] = d;
+					open_queue.emplace_back(d, cell);
+					std::push_heap(open_queue.begin(), open_queue.end(), std::greater<pair<unsigned, unsigned>>());
+				}
+			}
+		} // end while()
+	}
+public:
+	std::atomic<unsigned> door_state_version;
+	unsigned built_door_version=0, built_objs_version=0;
+	int floor_ix=-1, room_ix=-1;
+	float radius=0.0;
+	bool had_room_geom=0, has_locked_door=0; // has_locked_door: a locked door on this floor was treated as closed
+
+	building_flow_field_t() : door_state_version(0) {}
+	void invalidate() {++door_state_version;} // Note: this is safe to call in one thread while using in another
+	void clear_adj_target() {adj_target_radius = 0.0;}
+
+	bool get_adj_target(point const &pos, float radius_, float height, point &adj_pos) const {
+		if (adj_target_radius == 0.0 || radius_ != adj_target_radius || height != adj_target_height || pos != adj_target_in) return 0;
+		adj_pos = adj_target_out;
+		return 1;
+	}
+	void set_adj_target(point const &pos, float radius_, float height, point const &adj_pos) {
+		adj_target_in  = pos;
+		adj_target_out = adj_pos;
+		adj_target_radius = radius_;
+		adj_target_height = height;
+	}
+	unsigned get_num_cells() const {return nx*ny;}
+	float get_cell_sz() const {return cell_sz;}
+
+	void init_grid(cube_t const &area_, float cell_sz_) {
+		area    = area_;
+		cell_sz = cell_sz_;
+		nx = max(1U, unsigned(ceil(area.dx()/cell_sz)));
+		ny = max(1U, unsigned(ceil(area.dy()/cell_sz)));
+		walkable.clear();
+		walkable.resize(nx*ny, 0);
+		room_ix = player_cell = -1; // must recompute fields
+	}
+	void mark_walkable(cube_t const &c, bool val) {mark_cells(c, walkable, val);}
+
+	void set_target_room(int room_ix_, cube_t const &walk_area) { // computes room_dist
+		room_ix     = room_ix_;
+		player_cell = player_src_cell = -1;
+		in_room.clear();
+		in_room.resize(nx*ny, 0);
+		mark_cells(walk_area, in_room, 1);
+		room_cells.clear();
+		room_dist.clear();
+		room_dist.resize(nx*ny, FLOW_DIST_INF);
+		player_dist.clear();
+		player_dist.resize(nx*ny, FLOW_DIST_INF);
+		open_queue.clear();
+
+		for (unsigned i = 0; i < in_room.size(); ++i) {
+			in_room[i] &= walkable[i];
+			if (!in_room[i]) continue;
+			room_cells.push_back(i);
+			room_dist[i] = 0;
+			open_queue.emplace_back(0, i);
+		}
+		calc_dists(room_dist, 0); // room_only=0
+	}
+	bool update_player_pos(point const &player_pos) { // computes player_dist if the player changed cells; returns 1 if updated
+		int const cell(get_cell(player_pos));
+		if (cell == player_cell) return 0; // no change
+		player_cell = cell;
+		for (unsigned c : room_cells) {player_dist[c] = FLOW_DIST_INF;} // only room cells can be set
+		player_src_cell = find_valid_cell(player_pos, 1, nullptr); // room_only=1
+		if (player_src_cell < 0) return 1; // player is unreachable; leave all cells at FLOW_DIST_INF
+		player_dist[player_src_cell] = 0;
+		open_queue.clear();
+		open_queue.emplace_back(0, player_src_cell);
+		calc_dists(player_dist, 1); // room_only=1
+		return 1;
+	}
+	// follows the fields downhill from pos for up to FLOW_FIELD_MAX_STEPS cells, adding a path point at each turn; Note: path is stored backwards
+	bool get_path(point const &pos, point const &player_pos, vector<point> &path) const { // player_pos should be a valid target position for this person
+		if (room_ix < 0 || player_src_cell < 0) return 0; // no target
+		int cur(find_valid_cell(pos, 0, &room_dist)); // room_only=0
+		if (cur < 0) return 0; // can't reach the player's room
+		if (in_room[cur] && player_dist[cur] == FLOW_DIST_INF) return 0; // in the player's room, but can't reach the player
+		static thread_local vector<point> pts; // in forward order
+		pts.clear();
+		if (cur != get_cell(pos)) {pts.push_back(get_cell_center(cur, pos.z));} // start by moving to the closest valid cell
+		int last_dx(0), last_dy(0);
+
+		for (unsigned n = 0; n < FLOW_FIELD_MAX_STEPS; ++n) {
+			bool const room_only(in_room[cur] != 0);
+			vector<unsigned> const &dist(room_only ? player_dist : room_dist);
+			if (room_only && dist[cur] == 0) break; // reached the player's cell
+			int const x(cur % nx), y(cur / nx);
+			int best(-1), best_dx(0), best_dy(0);
+			unsigned best_dist(dist[cur]);
+
+			for (int dy = -1; dy <= 1; ++dy) {
+				for (int dx = -1; dx <= 1; ++dx) {
+					if ((dx == 0 && dy == 0) || !is_valid_step(x, y, dx, dy, room_only)) continue;
+					unsigned const cell((y + dy)*nx + (x + dx));
+					if (dist[cell] >= best_dist) continue;
+					best     = cell;
+					best_dx  = dx;
+					best_dy  = dy;
+					best_dist = dist[cell];
+				}
+			}
+			if (best < 0) break; // local minimum; shouldn't get here
+			if (n > 0 && (best_dx != last_dx || best_dy != last_dy)) {pts.push_back(get_cell_center(cur, pos.z));} // turn
+			last_dx = best_dx;
+			last_dy = best_dy;
+			cur     = best;
+		} // for n
+		bool const at_player(cur == player_src_cell && get_cell(player_pos) == player_src_cell);
+		pts.push_back(at_player ? point(player_pos.x, player_pos.y, pos.z) : get_cell_center(cur, pos.z));
+		path.clear();
+		path.insert(path.end(), pts.rbegin(), pts.rend());
+		return 1;
+	}
+}; // end building_flow_field_t
+
 cube_t building_t::get_walkable_room_bounds(room_t const &room) const {
 	cube_t c(room);
 	// Note: regular house rooms start and end at the walls;
@@ -587,6 +931,10 @@ void building_t::build_nav_graph() const { // Note: does not depend on room geom
 void building_t::invalidate_nav_graph() { // Note: this is safe to call in one thread while using in another
 	if (interior && interior->nav_graph) {interior->nav_graph->invalid = 1;}
 }
+void building_t::invalidate_nav_path_cache() { // called when a door is opened, closed, locked, or unlocked; also safe to call from another thread
+	if (interior && interior->nav_graph ) {interior->nav_graph ->invalidate_path_cache();}
+	if (interior && interior->flow_field) {interior->flow_field->invalidate();}
+}
 
 unsigned building_t::count_connected_room_components() {
 	if (!interior) return 0;
@@ -734,49 +1082,54 @@ bool building_t::choose_dest_goal(person_t &person, rand_gen_t &rgen) const { //
 			if      (player_z1 + fc_thick < person_z1) {person.target_pos.z -= floor_spacing;} // move down one floor
 			else if (player_z1 - fc_thick > person_z1) {person.target_pos.z += floor_spacing;} // move up   one floor
 		}
-		float const z2_add(person.get_height() - person.radius), coll_dist(COLL_RADIUS_SCALE*person.radius);
-		cube_t ai_bcube;
-		if (has_basement() && person.target_pos.z < ground_floor_z1) {ai_bcube = get_full_basement_bcube();} // in the basement
-		else {ai_bcube = bcube;} // above ground
-		cube_t legal_area(ai_bcube);
-		legal_area.expand_by_xy(-coll_dist);
-		legal_area.z1() += person.radius;
-		legal_area.z2() -= z2_add;
-		assert(legal_area.is_strictly_normalized());
-		legal_area.clamp_pt(person.target_pos); // clamp to building interior
-		float dmin_sq(bcube.get_max_extent()); // start at a large value
-		cube_t closest_part;
-
-		for (auto p = parts.begin(); p != get_real_parts_end_inc_sec(); ++p) { // there shouldn't be any people in secondary buildings, but include them anyway
-			if (p->contains_pt(person.target_pos)) {dmin_sq = 0; break;} // done
-			float const dsq(p2p_dist_sq(person.target_pos, p->closest_pt(person.target_pos)));
-			if (dsq < dmin_sq) {closest_part = *p;}
-		}
-		if (has_ext_basement()) {
-			float const dsq(p2p_dist_sq(person.target_pos, interior->basement_ext_bcube.closest_pt(person.target_pos)));
-			if (dsq < dmin_sq) {closest_part = interior->basement_ext_bcube;}
-		}
-		if (dmin_sq > 0.0 && !closest_part.is_all_zeros()) {closest_part.clamp_pt(person.target_pos);} // clamp to closest part
-		static vect_cube_t avoid; // reuse across frames/people
-		// same_as_player=1, skip_stairs=1
-		interior->get_avoid_cubes(avoid, (person.target_pos.z - person.radius), (person.target_pos.z + z2_add), 0.5*person.radius, get_floor_thickness(), 1, 1);
-
-		// check for initial collisions at the player's location, but exclude stairs in case the player is standing on them;
-		// this may no longer be required since complete_path_within_room() now ignores initial collisions with the dest, but is likely still a good idea
-		for (unsigned n = 0; n < 4; ++n) { // iterate a few times in case a collision moves pos into another object
-			bool any_updated(0);
-
-			for (auto i = avoid.begin(); i != avoid.end(); ++i) { // move target_pos to avoid room objects
-				cube_t c(*i);
-				c.expand_by_xy(coll_dist);
-				any_updated |= sphere_cube_int_update_pos(person.target_pos, 1.01*coll_dist, c, person.pos, 1); // skip_z=1, ignore return value
-			}
-			if (!any_updated) break; // done
-		} // for n
+		move_ai_target_to_valid_pos(person, person.target_pos);
 	}
 	return 1;
 }
 
+// clamps target_pos to the building interior and moves it out of room objects so that the person can reach it; must be called *after* any floor zval adjustment
+void building_t::move_ai_target_to_valid_pos(person_t const &person, point &target_pos) const {
+	float const z2_add(person.get_height() - person.radius), coll_dist(COLL_RADIUS_SCALE*person.radius);
+	cube_t ai_bcube;
+	if (has_basement() && target_pos.z < ground_floor_z1) {ai_bcube = get_full_basement_bcube();} // in the basement
+	else {ai_bcube = bcube;} // above ground
+	cube_t legal_area(ai_bcube);
+	legal_area.expand_by_xy(-coll_dist);
+	legal_area.z1() += person.radius;
+	legal_area.z2() -= z2_add;
+	assert(legal_area.is_strictly_normalized());
+	legal_area.clamp_pt(target_pos); // clamp to building interior
+	float dmin_sq(bcube.get_max_extent()); // start at a large value
+	cube_t closest_part;
+
+	for (auto p = parts.begin(); p != get_real_parts_end_inc_sec(); ++p) { // there shouldn't be any people in secondary buildings, but include them anyway
+		if (p->contains_pt(target_pos)) {dmin_sq = 0; break;} // done
+		float const dsq(p2p_dist_sq(target_pos, p->closest_pt(target_pos)));
+		if (dsq < dmin_sq) {closest_part = *p;}
+	}
+	if (has_ext_basement()) {
+		float const dsq(p2p_dist_sq(target_pos, interior->basement_ext_bcube.closest_pt(target_pos)));
+		if (dsq < dmin_sq) {closest_part = interior->basement_ext_bcube;}
+	}
+	if (dmin_sq > 0.0 && !closest_part.is_all_zeros()) {closest_part.clamp_pt(target_pos);} // clamp to closest part
+	static vect_cube_t avoid; // reuse across frames/people
+	// same_as_player=1, skip_stairs=1
+	interior->get_avoid_cubes(avoid, (target_pos.z - person.radius), (target_pos.z + z2_add), 0.5*person.radius, get_floor_thickness(), 1, 1);
+
+	// check for initial collisions at the player's location, but exclude stairs in case the player is standing on them;
+	// this may no longer be required since complete_path_within_room() now ignores initial collisions with the dest, but is likely still a good idea
+	for (unsigned n = 0; n < 4; ++n) { // iterate a few times in case a collision moves pos into another object
+		bool any_updated(0);
+
+		for (auto i = avoid.begin(); i != avoid.end(); ++i) { // move target_pos to avoid room objects
+			cube_t c(*i);
+			c.expand_by_xy(coll_dist);
+			any_updated |= sphere_cube_int_update_pos(target_pos, 1.01*coll_dist, c, person.pos, 1); // skip_z=1, ignore return value
+		}
+		if (!any_updated) break; // done
+	} // for n
+}
+
 bool building_t::select_person_dest_in_room(person_t &person, rand_gen_t &rgen, room_t const &room) const {
 	float const height(0.7*get_window_vspace()), radius(COLL_RADIUS_SCALE*person.radius);
 	point dest_pos(room.get_cube_center());
@@ -1082,13 +1435,13 @@ bool building_t::find_route_to_point(person_t const &person, float radius, bool
 			vector<point> from_path;
 			// Note: passing use_stairs=0 here because it's unclear if we want to go through stairs nodes in our A* algorithm
 			// from => stairs/ramp
-			if (!interior->nav_graph->find_path_points(loc1.room_ix, stairs_room_ix, person.ssn, radius, height, 0, is_first_path,
+			if (!interior->nav_graph->find_path_points(loc1.room_ix, stairs_room_ix, loc1.floor_ix, person.ssn, radius, height, 0, is_first_path,
 				up_or_down, person.cur_rseed, avoid, *this, from, interior->doors, person.has_key, nullptr, from_path)) continue; // no custom_dest
 			point const seg2_start(interior->nav_graph->get_stairs_entrance_pt(to.z, stairs_room_ix, !up_or_down)); // other end
 			// new floor, new zval, new avoid cubes
 			interior->get_avoid_cubes(avoid, (seg2_start.z - radius), (seg2_start.z + z2_add), 0.5*radius, get_floor_thickness(), following_player);
 			// stairs/ramp => to
-			if (!interior->nav_graph->find_path_points(stairs_room_ix, loc2.room_ix, person.ssn, radius, height, 0, is_first_path,
+			if (!interior->nav_graph->find_path_points(stairs_room_ix, loc2.room_ix, loc2.floor_ix, person.ssn, radius, height, 0, is_first_path,
 				!up_or_down, person.cur_rseed, avoid, *this, seg2_start, interior->doors, person.has_key, nullptr, path)) continue; // no custom_dest
 			assert(!path.empty() && !from_path.empty());
 			path.push_back(seg2_start); // other end of the stairs
@@ -1129,12 +1482,127 @@ bool building_t::find_route_to_point(person_t const &person, float radius, bool
 	assert(loc1.room_ix != loc2.room_ix);
 	// if the target is an elevator, use that as the preferred destination rather than the center of the room
 	point const *const custom_dest((person.goal_type == GOAL_TYPE_ELEVATOR) ? &person.target_pos : nullptr);
-	if (!interior->nav_graph->find_path_points(loc1.room_ix, loc2.room_ix, person.ssn, radius, height, 0, is_first_path,
+	if (!interior->nav_graph->find_path_points(loc1.room_ix, loc2.room_ix, loc1.floor_ix, person.ssn, radius, height, 0, is_first_path,
 		0, person.cur_rseed, avoid, *this, from, interior->doors, person.has_key, custom_dest, path)) return 0;
 	assert(!path.empty());
 	return 1;
 }
 
+// marks the grid cells on floor_ix that a person of the given radius can walk through: rooms, connected hallways, and passable doorways, minus room objects
+void building_t::build_flow_field_grid(building_flow_field_t &ff, unsigned floor_ix, float radius) const {
+	assert(interior);
+	float const floor_spacing(get_window_vspace()), wall_thickness(get_wall_thickness());
+	float const floor_z(get_bcube_z1_inc_ext_basement() + floor_ix*floor_spacing), zval(floor_z + 0.5*floor_spacing); // zval is mid-floor
+	cube_t const area(get_bcube_inc_extensions());
+	ff.init_grid(area, max(radius, max(area.dx(), area.dy())/FLOW_FIELD_MAX_CELLS));
+
+	for (auto r = interior->rooms.begin(); r != interior->rooms.end(); ++r) {
+		if (zval < r->z1() || zval > r->z2()) continue; // room not on this floor
+		cube_t walk_area(get_walkable_room_bounds(*r));
+		walk_area.expand_by_xy(-radius);
+		if (walk_area.is_strictly_normalized()) {ff.mark_walkable(walk_area, 1);}
+		if (!r->is_hallway) continue;
+
+		for (auto r2 = r+1; r2 != interior->rooms.end(); ++r2) { // connected hallways, as in build_nav_graph()
+			if (!r2->is_hallway || r2->z1() != r->z1()) continue;
+			cube_t conn(*r), r2_exp(*r2);
+			conn  .expand_by_xy(radius + wall_thickness);
+			r2_exp.expand_by_xy(radius + wall_thickness);
+			if (!conn.intersects(r2_exp)) continue;
+			conn.intersect_with_cube(r2_exp); // strip along the shared edge
+			bool const long_dim(conn.dx() < conn.dy());
+			conn.expand_in_dim(long_dim, -radius); // keep away from the corners
+			if (conn.is_strictly_normalized()) {ff.mark_walkable(conn, 1);}
+		} // for r2
+	} // for r
+	ff.has_locked_door = 0;
+
+	for (door_t const &door : interior->doors) {
+		if (zval < door.z1() || zval > door.z2()) continue; // door not on this floor
+		
+		if (!door.open && !(global_building_params.ai_opens_doors && !door.locked)) { // not passable; same as can_use_conn() without a key
+			ff.has_locked_door |= (door.locked && global_building_params.ai_opens_doors);
+			continue;
+		}
+		cube_t doorway(door);
+		doorway.expand_in_dim( door.dim, (0.5*wall_thickness + radius + ff.get_cell_sz())); // extend into the rooms on either side
+		// shrink to the width usable by a person of this radius, but keep at least one cell wide so that narrow doorways aren't lost between cell centers
+		doorway.expand_in_dim(!door.dim, -min(min(radius, 0.4f*door.get_width()), max(0.0f, 0.5f*(door.get_width() - ff.get_cell_sz()))));
+		ff.mark_walkable(doorway, 1);
+	}
+	static vect_cube_t avoid;
+	get_avoid_cubes((floor_z + get_fc_thickness() + radius), 0.7*floor_spacing, radius, avoid, 1); // following_player=1
+
+	for (cube_t c : avoid) {
+		c.expand_by_xy(radius);
+		ff.mark_walkable(c, 0);
+	}
+}
+
+// lazily rebuilds the parts of the flow field that depend on the target's floor, room, and position, the doors, the room objects, and the max radius
+void building_t::update_player_flow_field(building_dest_t const &target, float radius) const {
+	assert(interior && target.room_ix >= 0);
+	if (!interior->flow_field) {interior->flow_field.reset(new building_flow_field_t);}
+	building_flow_field_t &ff(*interior->flow_field);
+	unsigned const door_version(ff.door_state_version), objs_version(has_room_geom() ? interior->room_geom->objs_version : 0);
+	bool const has_rgeom(has_room_geom());
+
+	if (ff.floor_ix != (int)target.floor_ix || ff.built_door_version != door_version || ff.had_room_geom != has_rgeom ||
+		ff.built_objs_version != objs_version || radius > ff.radius)
+	{
+		ff.radius = max(ff.radius, radius); // a grid built for a larger radius is conservative for smaller people
+		build_flow_field_grid(ff, target.floor_ix, ff.radius);
+		ff.floor_ix           = target.floor_ix;
+		ff.built_door_version = door_version;
+		ff.built_objs_version = objs_version;
+		ff.had_room_geom      = has_rgeom;
+		ff.clear_adj_target(); // doors or room objects may have changed
+		++flow_field_stats.grid_builds;
+	}
+	if (ff.room_ix != target.room_ix) {
+		cube_t walk_area(get_walkable_room_bounds(get_room(target.room_ix)));
+		walk_area.expand_by_xy(-ff.radius);
+		ff.set_target_room(target.room_ix, walk_area);
+		++flow_field_stats.room_builds;
+	}
+	if (ff.update_player_pos(target.pos)) {++flow_field_stats.player_builds;}
+}
+
+// sets the path of a person on the same floor as target to follow the shared flow field; returns 0 if not on the same floor or the target is unreachable;
+// unreachable rooms have no room_dist, which replaces the is_room_connected_to() check of choose_dest_goal(), and the final point is adjusted in the same way
+bool building_t::get_flow_field_path(person_t &person, building_dest_t const &target, float radius) const {
+	if (target.room_ix < 0 || target.stairs_ix >= 0) return 0; // target is not in a room, or is on the stairs
+	if (get_floor_for_zval(person.pos.z) != target.floor_ix) return 0; // different floor; must use the stairs
+	update_player_flow_field(target, radius);
+	// the grid treats locked doors as closed; people with keys may have a shorter path through a locked door, so let them find their own paths
+	building_flow_field_t &ff(*interior->flow_field);
+	if (person.has_key && ff.has_locked_door) return 0;
+	point const target_pos_in(target.pos.x, target.pos.y, person.pos.z);
+	point target_pos(target_pos_in);
+
+	// the adjusted target is the same for everyone of the same size on this floor, so compute it once per player move rather than per person;
+	// the direction a target is pushed out of an object depends on the person's position, but any such position is valid for everyone
+	if (!ff.get_adj_target(target_pos_in, person.radius, person.get_height(), target_pos)) {
+		move_ai_target_to_valid_pos(person, target_pos);
+		ff.set_adj_target(target_pos_in, person.radius, person.get_height(), target_pos);
+	}
+	if (!ff.get_path(person.pos, target_pos, person.path)) return 0;
+	person.goal_type    = GOAL_TYPE_PLAYER;
+	person.cur_room     = get_room_containing_pt(person.pos);
+	person.dest_room    = target.room_ix;
+	person.target_pos   = person.path.front();
+	person.is_on_stairs = 0;
+	return 1;
+}
+
+// people pursuing the player on the player's floor share one flow field rather than each choosing a goal and finding a path;
+// returns 0 if the flow field can't be used, in which case the caller should fall back to choose_dest_goal() and find_route_to_point()
+bool building_t::follow_player_flow_field(person_t &person, float radius) const {
+	if (!global_building_params.ai_flow_field || !global_building_params.ai_target_player) return 0; // disabled
+	if (!can_target_player(person)) return 0; // following a sound rather than the player
+	return get_flow_field_path(person, cur_player_building_loc, radius);
+}
+
 bool person_t::waiting_for_same_elevator_as(person_t const &other, float floor_spacing) const {
 	if (&other == this) return 0; // skip ourself
 	if (other.ai_state != AI_WAIT_ELEVATOR) return 0; // other person is not also waiting for the elevator
@@ -1231,6 +1699,141 @@ bool building_t::place_people_if_needed(unsigned building_ix, float radius, vect
 	return 1;
 }
 
+// simulates num_people people who start in random rooms and floors of this building, then repeatedly choose a destination with choose_dest_room(),
+// find a path there, and move there instantly; a random interior door is toggled every door_toggle_period queries so that path cache invalidation
+// is included, and toggled back at the end; returns the time spent in find_route_to_point() in ms
+float building_t::run_nav_path_benchmark(unsigned num_people, unsigned num_queries, unsigned door_toggle_period, unsigned &num_found) {
+	num_found = 0;
+	if (!interior || interior->rooms.empty() || num_people == 0) return 0.0;
+	float const window_vspacing(get_window_vspace()), floor_thickness(get_floor_thickness()), fc_thick(0.5*floor_thickness);
+	float const radius(ped_manager_t::get_ped_radius());
+	vector<room_cand_t> room_cands;
+
+	for (auto r = interior->rooms.begin(); r != interior->rooms.end(); ++r) { // same rooms as place_people_if_needed()
+		if (r->is_sec_bldg || min(r->dx(), r->dy()) < 3.0*radius) continue;
+		unsigned const num_floors(calc_num_floors(*r, window_vspacing, floor_thickness));
+		for (unsigned f = 0; f < num_floors; ++f) {room_cands.emplace_back((r - interior->rooms.begin()), f);}
+	}
+	if (room_cands.empty()) return 0.0;
+	rand_gen_t rgen;
+	rgen.set_state(num_people+1, num_queries+1);
+	rgen.rand_mix();
+	auto choose_pos([&]() {
+		room_cand_t const &cand(room_cands[rgen.rand() % room_cands.size()]);
+		room_t const &room(get_room(cand.room_ix));
+		return point(room.xc(), room.yc(), (room.z1() + fc_thick + window_vspacing*cand.floor_ix + radius));
+	});
+	vector<person_t> people(num_people, person_t(radius));
+	vector<unsigned> toggled_doors;
+
+	for (unsigned i = 0; i < num_people; ++i) {
+		people[i].pos = choose_pos();
+		people[i].ssn = i;
+	}
+	float ms(0.0);
+
+	for (unsigned n = 0; n < num_queries; ++n) {
+		if (door_toggle_period > 0 && n > 0 && (n % door_toggle_period) == 0 && !interior->doors.empty()) {
+			unsigned const door_ix(rgen.rand() % interior->doors.size());
+
+			if (!interior->doors[door_ix].on_stairs) { // skip stairs doors, which rebuild the nav graph
+				toggle_door_state(door_ix, 0, 0, all_zeros);
+				toggled_doors.push_back(door_ix);
+			}
+		}
+		build_nav_graph();
+		person_t &person(people[n % num_people]);
+		if (choose_dest_room(person, rgen) != 1) continue; // no valid dest; not counted in the time
+		auto const start(high_resolution_clock::now());
+		bool const found(find_route_to_point(person, radius, 0, 0, person.path)); // is_first_path=0, following_player=0
+		ms += 1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - start).count();
+		if (!found) continue;
+		person.pos = person.target_pos;
+		++num_found;
+	} // for n
+	for (auto d = toggled_doors.rbegin(); d != toggled_doors.rend(); ++d) {toggle_door_state(*d, 0, 0, all_zeros);} // restore the original door states
+	return ms;
+}
+
+// simulates num_pursuers people chasing a simulated player on the floor of this building with the most rooms for num_frames frames;
+// the player circles within a room and moves to a random room every 30 frames; each frame, every pursuer either follows the shared flow field
+// or finds its own path as choose_dest_goal() + find_route_to_point() do, then moves along its path; num_contacts counts pursuer frames touching the player;
+// returns the total time in ms
+float building_t::run_pursuit_benchmark(unsigned num_pursuers, unsigned num_frames, bool use_flow_field, unsigned &num_paths, unsigned &num_contacts) {
+	num_paths = num_contacts = 0;
+	if (!interior || interior->rooms.empty() || num_pursuers == 0) return 0.0;
+	float const window_vspacing(get_window_vspace()), floor_thickness(get_floor_thickness()), fc_thick(0.5*floor_thickness);
+	float const radius(ped_manager_t::get_ped_radius()), coll_dist(COLL_RADIUS_SCALE*radius), step_dist(0.5*radius);
+	vector<vector<unsigned>> floor_rooms; // indexed by floor_ix
+
+	for (auto r = interior->rooms.begin(); r != interior->rooms.end(); ++r) { // same rooms as place_people_if_needed()
+		if (r->is_sec_bldg || min(r->dx(), r->dy()) < 3.0*radius) continue;
+		unsigned const num_floors(calc_num_floors(*r, window_vspacing, floor_thickness));
+
+		for (unsigned f = 0; f < num_floors; ++f) {
+			unsigned const floor_ix(get_floor_for_zval(r->z1() + fc_thick + window_vspacing*f + radius));
+			if (floor_ix >= floor_rooms.size()) {floor_rooms.resize(floor_ix+1);}
+			floor_rooms[floor_ix].push_back(r - interior->rooms.begin());
+		}
+	} // for r
+	unsigned floor_ix(0);
+	for (unsigned f = 1; f < floor_rooms.size(); ++f) {if (floor_rooms[f].size() > floor_rooms[floor_ix].size()) {floor_ix = f;}}
+	if (floor_rooms.empty() || floor_rooms[floor_ix].empty()) return 0.0;
+	vector<unsigned> const &rooms(floor_rooms[floor_ix]);
+	float const zval(get_bcube_z1_inc_ext_basement() + window_vspacing*floor_ix + fc_thick + radius);
+	rand_gen_t rgen;
+	rgen.set_state(num_pursuers+1, num_frames+1);
+	rgen.rand_mix();
+	vector<person_t> people(num_pursuers, person_t(radius));
+
+	for (unsigned i = 0; i < num_pursuers; ++i) {
+		people[i].pos = gen_xy_pos_in_area(get_room(rooms[rgen.rand() % rooms.size()]), radius, rgen, zval);
+		people[i].ssn = i;
+	}
+	unsigned player_room(rooms[rgen.rand() % rooms.size()]);
+	auto const start(high_resolution_clock::now());
+
+	for (unsigned f = 0; f < num_frames; ++f) {
+		if (f > 0 && (f % 30) == 0) {player_room = rooms[rgen.rand() % rooms.size()];}
+		room_t const &room(get_room(player_room));
+		float const angle(0.1*f), circle_radius(0.25*min(room.dx(), room.dy()));
+		point const player_pos((room.xc() + circle_radius*cosf(angle)), (room.yc() + circle_radius*sinf(angle)), zval);
+		building_dest_t const target(get_building_loc_for_pt(player_pos), player_pos);
+		build_nav_graph();
+
+		for (person_t &person : people) {
+			if (dist_xy_less_than(person.pos, player_pos, 2.0*radius)) {++num_contacts; continue;} // touching the player
+			bool found(use_flow_field && get_flow_field_path(person, target, coll_dist));
+
+			if (!found) { // find a path for this person
+				building_loc_t const loc(get_building_loc_for_pt(person.pos));
+
+				if (loc.room_ix >= 0 && target.room_ix >= 0 &&
+					interior->nav_graph->is_room_connected_to(loc.room_ix, target.room_ix, interior->doors, person.pos.z, person.has_key))
+				{
+					person.target_pos = point(player_pos.x, player_pos.y, person.pos.z);
+					found = find_route_to_point(person, coll_dist, 0, 1, person.path); // is_first_path=0, following_player=1
+				}
+			}
+			if (!found) continue;
+			++num_paths;
+			person.next_path_pt(1);
+
+			for (float move = step_dist; ;) { // move along the path
+				vector3d const delta((person.target_pos.x - person.pos.x), (person.target_pos.y - person.pos.y), 0.0);
+				float const dist(delta.mag());
+				if (dist > move) {person.pos += (move/dist)*delta; break;}
+				person.pos.x = person.target_pos.x;
+				person.pos.y = person.target_pos.y;
+				move -= dist;
+				if (person.path.empty()) break;
+				person.next_path_pt(0);
+			}
+		} // for person
+	} // for f
+	return 1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - start).count();
+}
+
 bool can_ai_follow_player(person_t const &person, bool allow_diff_building) {
 	if (!ai_follow_player()) return 0; // disabled
 	if (!cur_player_building_loc.is_valid()) return 0; // no target
@@ -1637,8 +2240,9 @@ int building_t::ai_room_update(person_t &person, float delta_dir, unsigned perso
 	person.has_room_geom = has_rgeom;
 
 	if (update_path) { // need to update based on player movement; higher priority than choose_dest
-		if (choose_dest_goal(person, rgen) != 1 || // check if person can reach the target
-			!find_route_to_point(person, coll_dist, 0, 1, person.path)) // is_first_path=0, following_player=1
+		if (!follow_player_flow_field(person, coll_dist) && // try the shared flow field first
+			(choose_dest_goal(person, rgen) != 1 || // check if person can reach the target
+			!find_route_to_point(person, coll_dist, 0, 1, person.path))) // is_first_path=0, following_player=1
 		{
 			choose_dest = 1; // or increment person.cur_rseed and return AI_WAITING? or restore person to prev value?
 		}
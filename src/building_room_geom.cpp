@@ -3545,7 +3545,7 @@ void building_room_geom_t::add_cabinet(room_object_t const &c, float tscale, boo
 	bool const any_doors_open(c.drawer_flags > 0), is_counter(c.type == TYPE_COUNTER); // Note: counter does not include the section with the sink
 	unsigned const skip_front_face(~get_face_mask(c.dim, c.dir)); // used in the any_doors_open=1 case
 	colorRGBA const cabinet_color(apply_wood_light_color(c));
-	static vect_cube_t doors, drawers;
+	static thread_local vect_cube_t doors, drawers; // per-thread since static geom may be generated on a background thread
 	doors  .clear();
 	drawers.clear();
 	float const door_width(get_cabinet_doors(c, doors, drawers, 1)); // front_only=1
@@ -3774,7 +3774,7 @@ void building_room_geom_t::add_potted_plant(room_object_t const &c, bool inc_pot
 		// draw plant leaves
 		s_plant plant;
 		plant.create_no_verts(base_pos, (c.z2() - base_pos.z), stem_radius, c.obj_id, 0, 1); // land_plants_only=1
-		static vector<vert_norm_comp> points;
+		static thread_local vector<vert_norm_comp> points;
 		points.clear();
 		plant.create_leaf_points(points, 10.0, 1.5, 4); // plant_scale=10.0 seems to work well; more levels and rings
 		auto &leaf_verts(mats_amask.get_material(tid_nm_pair_t(plant.get_leaf_tid()), 1).quad_verts);
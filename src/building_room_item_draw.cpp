@@ -7,6 +7,8 @@
 #include "city.h" // for object_model_loader_t
 #include "subdiv.h" // for sd_sphere_d
 #include "profiler.h"
+#include <thread>
+#include <atomic>
 
 unsigned const MAX_ROOM_GEOM_GEN_PER_FRAME = 1;
 
@@ -22,12 +24,14 @@ extern pos_dir_up camera_pdu;
 extern building_t const *player_building;
 extern carried_item_t player_held_object;
 extern building_params_t global_building_params;
+extern unsigned NUM_THREADS;
 
 unsigned get_num_screenshot_tids();
 tid_nm_pair_t get_phone_tex(room_object_t const &c);
 template< typename T > void gen_quad_ixs(vector<T> &ixs, unsigned size, unsigned ix_offset);
 void draw_car_in_pspace(car_t &car, shader_t &s, vector3d const &xlate, bool shadow_only);
 void set_car_model_color(car_t &car);
+void finish_room_geom_bkg_gen(building_room_geom_t &rgeom, bool do_upload);
 bldg_obj_type_t get_taken_obj_type(room_object_t const &obj);
 
 bool has_key_3d_model() {return building_obj_model_loader.is_model_valid(OBJ_MODEL_KEY);}
@@ -332,6 +336,10 @@ public:
 #pragma omp critical(rgeom_alloc)
 		alloc(s);
 	}
+	void free_safe(rgeom_storage_t &s) {
+#pragma omp critical(rgeom_alloc)
+		free(s);
+	}
 	void alloc(rgeom_storage_t &s) { // attempt to use free_list entry to reuse existing capacity
 		if (free_list.empty()) return; // no pre-alloc
 		//cout << TXT(free_list.size()) << TXT(free_list.back().get_tot_vert_capacity()) << endl; // total mem usage is 913/1045
@@ -361,7 +369,7 @@ public:
 	}
 	unsigned size() const {return free_list.size();}
 };
-rgeom_alloc_t rgeom_alloc; // static allocator with free list, shared across all buildings; not thread safe
+rgeom_alloc_t rgeom_alloc; // static allocator with free list, shared across all buildings; only the *_safe() functions are thread safe
 
 
 vbo_cache_t::vbo_cache_entry_t vbo_cache_t::alloc(unsigned size, bool is_index) {
@@ -455,7 +463,7 @@ void rgeom_mat_t::create_vbo(building_t const &building) {
 		rotate_verts(itri_verts, building);
 	}
 	create_vbo_inner();
-	rgeom_alloc.free(*this); // vertex and index data is no longer needed and can be cleared
+	rgeom_alloc.free_safe(*this); // vertex and index data is no longer needed and can be cleared; may be allocated on a background thread
 }
 void rgeom_mat_t::create_vbo_inner() {
 	assert(itri_verts.empty() == indices.empty());
@@ -717,6 +725,7 @@ void building_room_geom_t::check_invalid_draw_data() {
 	invalidate_mats_mask = 0; // reset for next frame
 }
 void building_room_geom_t::invalidate_draw_data_for_obj(room_object_t const &obj, bool was_taken) {
+	++objs_version; // may affect AI avoid cubes
 	if (obj.is_dynamic() || (obj.type == TYPE_BUTTON && obj.in_elevator())) { // elevator buttons are drawn as dynamic objects
 		update_dynamic_draw_data();
 		return;
@@ -770,11 +779,12 @@ void room_object_t::set_as_bottle(unsigned rand_id, unsigned max_type, bool no_e
 	color  = bottle_params[get_bottle_type()].color;
 }
 
-void building_room_geom_t::create_static_vbos(building_t const &building) {
+// Note: thread safe as long as texture loading is disabled for this thread and no other thread modifies this building's objects or static materials
+void building_room_geom_t::gen_static_verts(building_t const &building) {
 	//highres_timer_t timer("Gen Room Geom"); // 2.35ms
 	float const tscale(2.0/obj_scale);
 	tid_nm_pair_t const &wall_tex(building.get_material().wall_tex);
-	static vect_room_object_t rugs;
+	static thread_local vect_room_object_t rugs;
 	rugs.clear();
 
 	for (auto i = objs.begin(); i != objs.end(); ++i) {
@@ -829,6 +839,9 @@ void building_room_geom_t::create_static_vbos(building_t const &building) {
 	} // for i
 	add_skylights_details(building);
 	for (room_object_t &rug : rugs) {add_rug(rug);} // rugs are added last so that alpha blending of their edges works
+}
+void building_room_geom_t::upload_static_vbos(building_t const &building) {
+	create_obj_model_insts(building);
 	// Note: verts are temporary, but cubes are needed for things such as collision detection with the player and ray queries for indir lighting
 	//highres_timer_t timer2("Gen Room Geom VBOs"); // < 2ms
 	mats_static  .create_vbos(building);
@@ -836,6 +849,11 @@ void building_room_geom_t::create_static_vbos(building_t const &building) {
 	mats_exterior.create_vbos(building); // Note: ideally we want to include window dividers from trim_objs, but that may not have been created yet
 	//cout << "static: size: " << rgeom_alloc.size() << " mem: " << rgeom_alloc.get_mem_usage() << endl; // start=47MB, peak=132MB
 }
+void building_room_geom_t::clear_static_verts() { // for discarding partially generated static geom
+	mats_static  .clear();
+	mats_alpha   .clear();
+	mats_exterior.clear();
+}
 
 void building_room_geom_t::create_small_static_vbos() {
 	//highres_timer_t timer("Gen Room Geom Small"); // 7.8ms, slow building at 26,16
@@ -1243,16 +1261,22 @@ void building_t::gen_and_draw_room_geom(brg_batch_draw_t *bbd, shader_t &s, shad
 		if (!any_part_visible) return;
 	}
 	if (!has_room_geom()) {
-		rand_gen_t rgen;
-		rgen.set_state(building_ix, parts.size()); // set to something canonical per building
-		gen_room_details(rgen, building_ix); // generate so that we can draw it
+		gen_room_details_if_needed(building_ix); // generate so that we can draw it
 		assert(has_room_geom());
 	}
 	if (has_room_geom() && inc_small >= 2) {add_wall_and_door_trim_if_needed();} // gen trim (exterior and interior) when close to the player
 	draw_room_geom(bbd, s, amask_shader, oc, xlate, building_ix, shadow_only, reflection_pass, inc_small, player_in_building);
 }
+// Note: the seed only depends on the building, so the result doesn't depend on generation order or which thread this is called on
+void building_t::gen_room_details_if_needed(unsigned building_ix) {
+	if (!interior || has_room_geom()) return;
+	rand_gen_t rgen;
+	rgen.set_state(building_ix, parts.size()); // set to something canonical per building
+	gen_room_details(rgen, building_ix);
+}
 void building_t::clear_room_geom() {
 	if (!has_room_geom()) return;
+	finish_room_geom_bkg_gen(*interior->room_geom, 0); // do_upload=0
 	if (interior->room_geom->modified_by_player) return; // keep the player's modifications and don't delete the room geom
 	interior->room_geom->clear(); // free VBO data before deleting the room_geom object
 	interior->room_geom.reset();
@@ -1336,6 +1360,147 @@ void brg_batch_draw_t::draw_obj_models(shader_t &s, vector3d const &xlate, bool
 	if (!models_to_draw.empty()) {check_mvm_update();}
 }
 
+// generates static room geom vertex data for buildings the player is approaching on a background thread, closest first;
+// the VBO upload is done on the main thread, limited to room_geom_upload_budget_ms per frame
+class room_geom_bkg_gen_mgr_t {
+	struct request_t {
+		building_t const *building;
+		building_room_geom_t *rgeom;
+		float dist_sq;
+		bool failed=0; // a texture needed to be loaded, so this must be generated on the main thread
+		high_resolution_clock::time_point req_time;
+
+		request_t(building_t const &b, building_room_geom_t &r, float dsq) : building(&b), rgeom(&r), dist_sq(dsq), req_time(high_resolution_clock::now()) {}
+		bool operator<(request_t const &r) const {return (dist_sq < r.dist_sq);} // sort closest first
+	};
+	vector<request_t> pending, running, completed; // running is only accessed by the worker thread while it's active
+	std::thread worker;
+	std::atomic<bool> worker_done;
+	bool needs_to_join=0;
+	int last_frame=-1;
+	room_geom_bkg_gen_stats_t stats;
+	unsigned last_num_printed=0;
+
+	void run_jobs() { // called on the worker thread
+		int const num_jobs(running.size());
+#pragma omp parallel for schedule(dynamic) num_threads(max(1U, NUM_THREADS-1)) // leave one thread for the main thread
+		for (int i = 0; i < num_jobs; ++i) {
+			request_t &r(running[i]);
+			set_texture_load_disabled_for_thread(1);
+			r.rgeom->gen_static_verts(*r.building);
+			r.failed = texture_load_was_skipped();
+			set_texture_load_disabled_for_thread(0);
+		}
+		worker_done = 1;
+	}
+	void join_worker() {
+		if (!needs_to_join) return;
+		worker.join();
+		needs_to_join = 0;
+		vector_add_to(running, completed);
+		running.clear();
+	}
+	float get_elapsed_ms(high_resolution_clock::time_point const &t) const {return 1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - t).count();}
+
+	void upload(request_t const &r) {
+		building_room_geom_t &rgeom(*r.rgeom);
+		rgeom.static_bkg_gen_state = 0;
+
+		if (r.failed) { // discard and regenerate on the main thread, which will load the texture
+			rgeom.clear_static_verts();
+			rgeom.static_bkg_gen_state = 2;
+			++stats.num_failed;
+			return;
+		}
+		rgeom.upload_static_vbos(*r.building);
+		float const latency(get_elapsed_ms(r.req_time));
+		stats.tot_latency_ms += latency;
+		max_eq(stats.max_latency_ms, latency);
+		++stats.num_generated;
+	}
+	template<typename T> static bool remove_request(vector<request_t> &v, building_room_geom_t const &rgeom, T const &func) {
+		for (auto i = v.begin(); i != v.end(); ++i) {
+			if (i->rgeom != &rgeom) continue;
+			func(*i);
+			v.erase(i);
+			return 1;
+		}
+		return 0;
+	}
+	static bool contains(vector<request_t> const &v, building_room_geom_t const &rgeom) {
+		for (request_t const &r : v) {if (r.rgeom == &rgeom) return 1;}
+		return 0;
+	}
+public:
+	room_geom_bkg_gen_mgr_t() : worker_done(0) {}
+	~room_geom_bkg_gen_mgr_t() {if (needs_to_join) {worker.join();}}
+	unsigned get_queue_depth() const {return (pending.size() + running.size() + completed.size());}
+	room_geom_bkg_gen_stats_t get_stats() const {
+		room_geom_bkg_gen_stats_t ret(stats);
+		ret.queue_depth = get_queue_depth();
+		return ret;
+	}
+	void add_request(building_t const &b, building_room_geom_t &rgeom, float dist_sq) {
+		assert(rgeom.static_bkg_gen_state == 0);
+		pending.emplace_back(b, rgeom, dist_sq);
+		rgeom.static_bkg_gen_state = 1;
+	}
+	// removes rgeom from the queue, waiting for the worker thread if needed; if do_upload=1, uploads any completed data
+	void finish(building_room_geom_t &rgeom, bool do_upload) {
+		if (rgeom.static_bkg_gen_state != 1) return; // not queued
+		auto discard([](request_t const &r) {r.rgeom->clear_static_verts(); r.rgeom->static_bkg_gen_state = 0;});
+		if (remove_request(pending, rgeom, [](request_t const &r) {r.rgeom->static_bkg_gen_state = 0;})) return; // not yet started
+		if (contains(running, rgeom)) {join_worker();} // wait for the worker to finish this batch
+		if (do_upload) {remove_request(completed, rgeom, [this](request_t const &r) {upload(r);});}
+		else           {remove_request(completed, rgeom, discard);}
+	}
+	void finish_all() { // discards all requests
+		join_worker();
+		for (request_t const &r : completed) {r.rgeom->clear_static_verts(); r.rgeom->static_bkg_gen_state = 0;}
+		for (request_t const &r : pending  ) {r.rgeom->static_bkg_gen_state = 0;}
+		completed.clear();
+		pending  .clear();
+	}
+	void next_frame(float upload_budget_ms) { // called once per frame on the main thread
+		if (frame_counter == last_frame) return; // already called this frame
+		last_frame = frame_counter;
+		if (needs_to_join && worker_done) {join_worker();}
+
+		if (!completed.empty()) { // upload closest buildings first within the time budget; always upload at least one so that we make progress
+			high_resolution_clock::time_point const start(high_resolution_clock::now());
+			sort(completed.begin(), completed.end());
+			unsigned num_uploaded(0);
+
+			while (num_uploaded < completed.size()) {
+				upload(completed[num_uploaded++]);
+				if (get_elapsed_ms(start) > upload_budget_ms) break;
+			}
+			completed.erase(completed.begin(), completed.begin()+num_uploaded);
+		}
+		max_eq(stats.max_queue_depth, get_queue_depth());
+
+		if (!needs_to_join && !pending.empty()) { // start the next batch, closest first
+			unsigned const batch_size(min((unsigned)pending.size(), 2*max(1U, NUM_THREADS)));
+			sort(pending.begin(), pending.end());
+			running.assign(pending.begin(), pending.begin()+batch_size);
+			pending.erase(pending.begin(), pending.begin()+batch_size);
+			worker_done   = 0;
+			needs_to_join = 1;
+			worker = std::thread(&room_geom_bkg_gen_mgr_t::run_jobs, this);
+		}
+		if (get_queue_depth() == 0 && stats.num_generated > last_num_printed) { // print stats when the queue drains
+			cout << "Background room geom: " << stats.num_generated << " generated, " << stats.num_failed << " main thread, max queue depth " << stats.max_queue_depth
+				 << ", latency avg " << stats.get_avg_latency_ms() << "ms max " << stats.max_latency_ms << "ms" << endl;
+			last_num_printed = stats.num_generated;
+		}
+	}
+};
+room_geom_bkg_gen_mgr_t room_geom_bkg_gen_mgr;
+
+room_geom_bkg_gen_stats_t get_room_geom_bkg_gen_stats() {return room_geom_bkg_gen_mgr.get_stats();}
+void finish_room_geom_bkg_gen(building_room_geom_t &rgeom, bool do_upload) {room_geom_bkg_gen_mgr.finish(rgeom, do_upload);}
+void finish_all_room_geom_bkg_gen() {room_geom_bkg_gen_mgr.finish_all();}
+
 // Note: non-const because it creates the VBO; inc_small: 0=large only, 1=large+small, 2=large+small+ext detail, 3=large+small+ext detail+int detail
 void building_room_geom_t::draw(brg_batch_draw_t *bbd, shader_t &s, shader_t &amask_shader, building_t const &building, occlusion_checker_noncity_t &oc,
 	vector3d const &xlate, unsigned building_ix, bool shadow_only, bool reflection_pass, unsigned inc_small, bool player_in_building)
@@ -1362,19 +1527,36 @@ void building_room_geom_t::draw(brg_batch_draw_t *bbd, shader_t &s, shader_t &am
 		if (enable_indir != last_enable_indir) {invalidate_mats_mask |= 0xFF;} // update all geom when material lighting changes due to indir
 		last_enable_indir = enable_indir;
 	}
+	bool const bkg_gen(global_building_params.bkg_room_geom_gen);
+
+	if (bkg_gen) {
+		room_geom_bkg_gen_mgr.next_frame(global_building_params.room_geom_upload_budget_ms);
+
+		if (static_bkg_gen_state == 1) { // queued for background generation
+			// shadow maps may be cached and must be complete, and the player may modify objects in the building they're in, so finish it now in these cases
+			if (!shadow_only && !player_in_building) return; // not yet generated; draw it in a later frame
+			room_geom_bkg_gen_mgr.finish(*this, 1); // do_upload=1
+		}
+	}
 	if (has_pictures && num_pic_tids != num_screenshot_tids) {
 		invalidate_static_geom(); // user created a new screenshot texture, and this building has pictures - recreate room geom
 		num_pic_tids = num_screenshot_tids;
 	}
 	check_invalid_draw_data();
+
+	// initial static geom generation for buildings the player isn't in is done in the background; regeneration after invalidation is done here to avoid flicker
+	if (bkg_gen && !shadow_only && !reflection_pass && !player_in_building && static_bkg_gen_state == 0 && mats_static.empty()) {
+		room_geom_bkg_gen_mgr.add_request(building, *this, p2p_dist_sq(camera_bs, building.bcube.closest_pt(camera_bs)));
+		return; // not yet generated; draw it in a later frame
+	}
 	// generate vertex data in the shadow pass or if we haven't hit our generation limit; must be consistent for static and small geom
 	// Note that the distance cutoff for mats_static and mats_small is different, so we generally won't be creating them both
 	// unless the player just appeared by this building, or we need to update the geometry; in either case this is higher priority and we want to update both
 	if (shadow_only || num_geom_this_frame < MAX_ROOM_GEOM_GEN_PER_FRAME) {
 		if (!mats_static.valid) { // create static materials if needed
-			create_obj_model_insts(building);
 			create_static_vbos(building);
 			if (!shadow_only) {++num_geom_this_frame;}
+			static_bkg_gen_state = 0; // done with main thread generation
 		}
 		bool const create_small(inc_small && !mats_small.valid), create_text(draw_int_detail_objs && !mats_text.valid);
 		//highres_timer_t timer("Create Small + Text VBOs", (create_small || create_text));
@@ -149,8 +149,8 @@ void building_t::get_doorways_for_room(cube_t const &room, float zval, vect_door
 		if (i->intersects(room_exp)) {doorways.push_back(*i);}
 	}
 }
-vect_door_stack_t &building_t::get_doorways_for_room(cube_t const &room, float zval) const { // interior doorways; not thread safe
-	static vect_door_stack_t doorways; // reuse across rooms
+vect_door_stack_t &building_t::get_doorways_for_room(cube_t const &room, float zval) const { // interior doorways
+	static thread_local vect_door_stack_t doorways; // reuse across rooms; per-thread since room details can be generated in parallel
 	get_doorways_for_room(room, zval, doorways);
 	return doorways;
 }
@@ -1475,7 +1475,7 @@ bool building_t::add_kitchen_objs(rand_gen_t rgen, room_t const &room, float zva
 		cube_t c;
 		set_cube_zvals(c, zval, zval+height);
 		set_cube_zvals(cabinet_area, zval, (zval + vspace - floor_thickness));
-		static vect_cube_t blockers;
+		static thread_local vect_cube_t blockers;
 		int const table_blocker_ix(gather_room_placement_blockers(cabinet_area, objs_start, blockers, 1, 1)); // inc_open_doors=1, ignore_chairs=1
 		bool const have_toaster(building_obj_model_loader.is_model_valid(OBJ_MODEL_TOASTER));
 		vector3d const toaster_sz(have_toaster ? building_obj_model_loader.get_model_world_space_size(OBJ_MODEL_TOASTER) : zero_vector); // L, D, H
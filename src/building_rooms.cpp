@@ -64,7 +64,9 @@ bool building_t::can_be_bedroom_or_bathroom(room_t const &room, unsigned floor,
 
 			if (!is_rotated() && is_cube() && !has_complex_floorplan) { // too strong for rotated or non-cube buildings, where door placement can sometimes fail
 				assert(!doors.empty());
-				assert(!door_rooms.empty());
+				bool has_ground_door(0); // placement can also fail for buildings with a roof access door, which isn't adjacent to any room
+				for (auto d = doors.begin(); d != doors.end(); ++d) {has_ground_door |= (d->is_exterior_door() && d->type != tquad_with_ix_t::TYPE_RDOOR);}
+				assert(!door_rooms.empty() || !has_ground_door);
 			}
 			for (auto d = door_rooms.begin(); d != door_rooms.end(); ++d) {
 				for (auto s = stairs_rooms.begin(); s != stairs_rooms.end(); ++s) {
@@ -105,6 +107,16 @@ unsigned calc_num_floors_room(room_t const &r, float window_vspacing, float floo
 	return (r.is_sec_bldg ? 1 : calc_num_floors(r, window_vspacing, floor_thickness));
 }
 
+// object types, building models, and textures are lazily initialized on first use, which isn't thread safe; do this on the main thread before generating on worker threads
+void setup_for_parallel_room_details_gen() {
+	static bool was_setup(0);
+	if (was_setup) return; // nothing to do
+	was_setup = 1;
+	setup_bldg_obj_types();
+	for (unsigned id = 0; id < OBJ_MODEL_FHYDRANT; ++id) {building_obj_model_loader.is_model_valid(id);} // building models only; loads all sub-models
+	get_concrete_tid(); // used for bathroom flooring; sheet textures are loaded with the building params
+}
+
 void building_t::gen_room_details(rand_gen_t &rgen, unsigned building_ix) {
 
 	assert(interior);
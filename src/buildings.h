@@ -69,6 +69,7 @@ inline colorRGBA gen_box_color(rand_gen_t &rgen) {return colorRGBA(rgen.rand_uni
 class light_source;
 class lmap_manager_t;
 class building_nav_graph_t;
+class building_flow_field_t;
 struct building_t;
 class building_creator_t;
 struct elevator_t;
@@ -261,6 +262,10 @@ struct building_params_t {
 
 	bool flatten_mesh=0, has_normal_map=0, tex_mirror=0, tex_inv_y=0, tt_only=0, infinite_buildings=0, dome_roof=0, onion_roof=0;
 	bool gen_building_interiors=1, add_city_interiors=0, enable_rotated_room_geom=0, add_secondary_buildings=0, add_office_basements=0, add_office_br_basements=0;
+	bool parallel_interior_gen=0; // generate office interiors and room objects on multiple threads
+	bool bkg_room_geom_gen=0; // generate room geom vertex data on a background thread
+	bool use_building_bvh=0; // use a BVH rather than the uniform grid for building collision, line, and occlusion queries
+	float room_geom_upload_budget_ms=2.0; // per-frame time limit for uploading background generated room geom
 	unsigned num_place=0, num_tries=10, cur_prob=1, max_shadow_maps=32, buildings_rand_seed=0, max_ext_basement_hall_branches=4, max_ext_basement_room_depth=4;
 	float ao_factor=0.0, sec_extra_spacing=0.0, player_coll_radius_scale=1.0, interior_view_dist_scale=1.0;
 	float window_width=0.0, window_height=0.0, window_xspace=0.0, window_yspace=0.0; // windows
@@ -270,7 +275,7 @@ struct building_params_t {
 	float house_same_mat_prob =0.0, house_same_size_prob =0.0, house_same_geom_prob =0.0, house_same_per_city_prob =0.0;
 	float office_same_mat_prob=0.0, office_same_size_prob=0.0, office_same_geom_prob=0.0, office_same_per_city_prob=0.0;
 	// building people/AI params
-	bool enable_people_ai=0, ai_target_player=1, ai_follow_player=0, allow_elevator_line=1, no_coll_enter_exit_elevator=1;
+	bool enable_people_ai=0, ai_target_player=1, ai_follow_player=0, allow_elevator_line=1, no_coll_enter_exit_elevator=1, ai_path_cache=0, ai_flow_field=1;
 	unsigned ai_opens_doors=1; // 0=don't open doors, 1=only open if player closed door after path selection; 2=always open doors
 	unsigned ai_player_vis_test=0; // 0=no test, 1=LOS, 2=LOS+FOV, 3=LOS+FOV+lit
 	unsigned ai_sees_player_hide=2; // 0=doesn't see the player, 1=sees the player and waits outside the hiding spot, 2=opens the door and comes in
@@ -820,9 +825,10 @@ public:
 struct building_room_geom_t {
 
 	bool has_elevators, has_pictures, has_garage_car, modified_by_player;
-	unsigned char num_pic_tids, invalidate_mats_mask;
+	unsigned char num_pic_tids, invalidate_mats_mask, static_bkg_gen_state; // static_bkg_gen_state: 0=none, 1=queued for background generation, 2=main thread only
 	float obj_scale;
 	unsigned wall_ps_start, buttons_start, stairs_start; // index of first object of {TYPE_PG_*|TYPE_PSPACE, TYPE_BUTTON, TYPE_STAIR}
+	unsigned objs_version; // incremented when an object is added, removed, moved, opened, or closed; used to rebuild the AI flow field
 	point tex_origin;
 	colorRGBA wood_color;
 	// objects in rooms; expanded_objs is for things that have been expanded for player interaction; model_objs is for models in drawers; trim_objs is for wall/door/window trim
@@ -842,7 +848,7 @@ struct building_room_geom_t {
 	fire_manager_t fire_manager;
 
 	building_room_geom_t(point const &tex_origin_=all_zeros) : has_elevators(0), has_pictures(0), has_garage_car(0), modified_by_player(0),
-		num_pic_tids(0), invalidate_mats_mask(0), obj_scale(1.0), wall_ps_start(0), buttons_start(0), stairs_start(0), tex_origin(tex_origin_), wood_color(WHITE) {}
+		num_pic_tids(0), invalidate_mats_mask(0), static_bkg_gen_state(0), obj_scale(1.0), wall_ps_start(0), buttons_start(0), stairs_start(0), objs_version(0), tex_origin(tex_origin_), wood_color(WHITE) {}
 	bool empty() const {return objs.empty();}
 	void clear();
 	void clear_materials();
@@ -1011,9 +1017,13 @@ struct building_room_geom_t {
 		point const &camera_bs, bool shadow_only, bool reflection_pass, bool check_clip_cube) const;
 	unsigned allocate_dynamic_state();
 	room_obj_dstate_t &get_dstate(room_object_t const &obj);
+	// static geom can be generated on a background thread, and then uploaded on the main thread
+	void gen_static_verts(building_t const &building);
+	void upload_static_vbos(building_t const &building);
+	void clear_static_verts();
 private:
 	building_materials_t &get_building_mat(tid_nm_pair_t const &tex, bool dynamic, unsigned small, bool transparent, bool exterior);
-	void create_static_vbos(building_t const &building);
+	void create_static_vbos(building_t const &building) {gen_static_verts(building); upload_static_vbos(building);}
 	void create_small_static_vbos();
 	void create_text_vbos();
 	void create_detail_vbos(building_t const &building);
@@ -1246,6 +1256,7 @@ struct building_interior_t {
 	vector<person_t> people;
 	std::unique_ptr<building_room_geom_t> room_geom;
 	std::unique_ptr<building_nav_graph_t> nav_graph;
+	std::unique_ptr<building_flow_field_t> flow_field; // for people pursuing the player
 	std::unique_ptr<building_conn_info_t> conn_info;
 	cube_with_ix_t pg_ramp, attic_access; // ix stores {dim, dir}
 	cube_t basement_ext_bcube;
@@ -1291,6 +1302,19 @@ struct building_interior_t {
 	void assign_master_bedroom(float window_vspacing, float floor_thickness);
 };
 
+struct room_geom_bkg_gen_stats_t {
+	unsigned queue_depth=0, max_queue_depth=0, num_generated=0, num_failed=0; // num_failed is the number that had to be generated on the main thread
+	float tot_latency_ms=0.0, max_latency_ms=0.0; // latency is from request to upload
+	float get_avg_latency_ms() const {return (num_generated ? tot_latency_ms/num_generated : 0.0f);}
+};
+
+struct building_query_bench_t { // grid vs. BVH building query timing; arrays are indexed by use_bvh
+	unsigned num_buildings=0, num_queries=0, bvh_nodes=0, bvh_mem=0;
+	unsigned sphere_hits[2]={}, line_hits[2]={}, num_occluders[2]={};
+	float sphere_ms[2]={}, line_ms[2]={}, occluder_ms[2]={};
+	bool results_match() const {return (sphere_hits[0] == sphere_hits[1] && line_hits[0] == line_hits[1] && num_occluders[0] == num_occluders[1]);}
+};
+
 struct building_stats_t {
 	unsigned nbuildings, nparts, ndetails, ntquads, ndoors, ninterior, nrooms, nceils, nfloors, nwalls, nrgeom, nobjs, nverts;
 	building_stats_t() : nbuildings(0), nparts(0), ndetails(0), ntquads(0), ndoors(0), ninterior(0), nrooms(0), nceils(0), nfloors(0), nwalls(0), nrgeom(0), nobjs(0), nverts(0) {}
@@ -1423,6 +1447,8 @@ struct building_t : public building_geom_t {
 	bool ray_cast_interior(point const &pos, vector3d const &dir, cube_t const &valid_area, cube_bvh_t const &bvh, bool in_attic, bool in_ext_basement,
 		point &cpos, vector3d &cnorm, colorRGBA &ccolor, rand_gen_t *rgen=nullptr) const;
 	void create_building_volume_light_texture(unsigned bix, point const &target, unsigned &tid) const;
+	unsigned get_indir_lighting_bench_target(point &target) const;
+	float run_indir_lighting_to_convergence(unsigned bix, point const &target, unsigned batch_size, unsigned &num_lights) const;
 	bool ray_cast_camera_dir(point const &camera_bs, point &cpos, colorRGBA &ccolor) const;
 	void calc_bcube_from_parts();
 	void adjust_part_zvals_for_floor_spacing(cube_t &c) const;
@@ -1523,11 +1549,13 @@ struct building_t : public building_geom_t {
 	void draw_cars_in_building(shader_t &s, vector3d const &xlate, bool player_in_building, bool shadow_only) const;
 	void debug_people_in_building(shader_t &s) const;
 	void add_split_roof_shadow_quads(building_draw_t &bdraw) const;
+	void gen_room_details_if_needed(unsigned building_ix);
 	void clear_room_geom();
 	void update_grass_exclude_at_pos(point const &pos, vector3d const &xlate, bool camera_in_building) const;
 	void add_signs(vector<sign_t> &signs) const;
 	void add_flags(vector<city_flag_t> &flags) const;
 	void update_stats(building_stats_t &s) const;
+	uint64_t get_room_objs_hash() const;
 	bool are_rooms_connected_without_using_room(unsigned room1, unsigned room2, unsigned room_exclude) const;
 	bool is_room_adjacent_to_ext_door(cube_t const &room, bool front_door_only=0) const;
 	room_t const &get_room(unsigned room_ix) const {assert(interior); return interior->get_room(room_ix);}
@@ -1537,6 +1565,8 @@ struct building_t : public building_geom_t {
 	// building AI people
 	unsigned count_connected_room_components();
 	bool place_people_if_needed(unsigned building_ix, float radius, vector<point> &locs) const;
+	float run_nav_path_benchmark(unsigned num_people, unsigned num_queries, unsigned door_toggle_period, unsigned &num_found);
+	float run_pursuit_benchmark(unsigned num_pursuers, unsigned num_frames, bool use_flow_field, unsigned &num_paths, unsigned &num_contacts);
 	void all_ai_room_update(rand_gen_t &rgen, float delta_dir);
 	int ai_room_update(person_t &person, float delta_dir, unsigned person_ix, rand_gen_t &rgen);
 	int run_ai_elevator_logic(person_t &person, float delta_dir, rand_gen_t &rgen);
@@ -1546,10 +1576,15 @@ private:
 	void build_nav_graph() const;
 	bool is_valid_ai_placement(point const &pos, float radius, bool skip_nocoll) const;
 	bool choose_dest_goal(person_t &person, rand_gen_t &rgen) const;
+	void move_ai_target_to_valid_pos(person_t const &person, point &target_pos) const;
 	int  choose_dest_room(person_t &person, rand_gen_t &rgen) const;
 	bool select_person_dest_in_room(person_t &person, rand_gen_t &rgen, room_t const &room) const;
 	void get_avoid_cubes(float zval, float height, float radius, vect_cube_t &avoid, bool following_player, cube_t const *const fires_select_cube=nullptr) const;
 	bool find_route_to_point(person_t const &person, float radius, bool is_first_path, bool following_player, vector<point> &path) const;
+	void build_flow_field_grid(building_flow_field_t &ff, unsigned floor_ix, float radius) const;
+	void update_player_flow_field(building_dest_t const &target, float radius) const;
+	bool get_flow_field_path(person_t &person, building_dest_t const &target, float radius) const;
+	bool follow_player_flow_field(person_t &person, float radius) const;
 	bool stairs_contained_in_part(stairwell_t const &s, cube_t const &p) const;
 	void find_nearest_stairs_or_ramp(point const &p1, point const &p2, vector<unsigned> &nearest_stairs, int part_ix=-1) const;
 	int find_nearest_elevator_this_floor(point const &pos) const;
@@ -1639,6 +1674,7 @@ public:
 	cube_t get_attic_access_door_avoid() const;
 	void get_all_door_centers_for_room(cube_t const &room, float zval, vector<point> &door_centers) const;
 	void invalidate_nav_graph();
+	void invalidate_nav_path_cache();
 	point local_to_camera_space(point const &pos) const;
 	void play_door_open_close_sound(point const &pos, bool open, float gain=1.0, float pitch=1.0) const;
 	void play_open_close_sound(room_object_t const &obj, point const &sound_origin) const;
@@ -8,6 +8,7 @@
 #include "lightmap.h" // for light_source
 #include "profiler.h"
 #include <cfloat> // for FLT_MAX
+#include <omp.h>
 
 bool const DYNAMIC_HELICOPTERS = 1;
 float const MIN_CAR_STOP_SEP   = 0.25; // in units of car lengths
@@ -995,6 +996,47 @@ bool car_manager_t::check_car_for_ped_colls(car_t &car) const {
 	return 0;
 }
 
+// cars are mostly still in order from the previous frame, so use an insertion sort, which is linear time when few cars have changed order;
+// fall back to a full sort when too many cars are out of order, such as after the camera moves far enough to change the order of parked cars
+void car_manager_t::sort_cars(comp_car_road_then_pos const &sort_func) {
+	unsigned const max_moves(cars.size()/8 + 64);
+	unsigned num_moves(0);
+
+	for (auto i = cars.begin(); i != cars.end(); ++i) {
+		if (i == cars.begin() || !sort_func(*i, *(i-1))) continue; // already in order
+		car_t const car(*i);
+		auto j(i);
+		for (; j != cars.begin() && sort_func(car, *(j-1)); --j, ++num_moves) {*j = *(j-1);}
+		*j = car;
+
+		if (num_moves > max_moves) {
+			sort(cars.begin(), cars.end(), sort_func);
+			++num_full_sorts;
+			return;
+		}
+	} // for i
+	++num_incr_sorts;
+}
+
+// checks for collisions between moving cars on the same city and road in [start, end); these cars are only compared with each other,
+// so runs can be processed in parallel, and the result doesn't depend on the number of threads
+void car_manager_t::check_road_run_collisions(unsigned start, unsigned end) {
+	auto const run_end(cars.begin() + end);
+
+	for (auto i = cars.begin()+start; i != run_end; ++i) {
+		bool const on_conn_road(i->cur_city == CONN_CITY_IX);
+		float const length(i->get_length()), max_check_dist(max(3.0f*length, (length + i->get_max_lookahead_dist()))); // max of collision dist and car-in-front dist
+
+		for (auto j = i+1; j != run_end; ++j) { // check for collisions with cars on the same road (can't test seg because they can be on diff segs but still collide)
+			if (!on_conn_road && i->cur_road_type == j->cur_road_type && abs((int)i->cur_seg - (int)j->cur_seg) > (on_conn_road ? 1 : 0)) break; // diff road segs or diff isects
+			check_collision(*i, *j);
+			i->register_adj_car(*j);
+			j->register_adj_car(*i);
+			if (!dist_xy_less_than(i->get_center(), j->get_center(), max_check_dist)) break;
+		}
+	} // for i
+}
+
 void car_manager_t::next_frame(ped_manager_t const &ped_manager, float car_speed) {
 	if (!animate2) return;
 	helicopters_next_frame(car_speed);
@@ -1006,16 +1048,27 @@ void car_manager_t::next_frame(ped_manager_t const &ped_manager, float car_speed
 #pragma omp critical(modify_car_data)
 	{
 		if (car_destroyed) {remove_destroyed_cars();} // at least one car was destroyed in the previous frame - remove it/them
-		sort(cars.begin(), cars.end(), sort_func); // sort by city/road/position for intersection tests and tile shadow map binds
+		sort_cars(sort_func); // sort by city/road/position for intersection tests and tile shadow map binds
 	}
 	entering_city.clear();
 	car_blocks.clear();
+	road_runs.clear();
 	float const speed(CAR_SPEED_SCALE*car_speed*get_clamped_fticks());
+	// Note: when called from the city update thread of the parallel draw section, nested parallel regions are disabled and these loops run serially
+	int const num_threads(city_params.car_sim_threads ? city_params.car_sim_threads : omp_get_max_threads());
+	bool const use_threads(num_threads > 1 && cars.size() >= 256);
+
+	// move cars; each car only reads and writes its own state
+#pragma omp parallel for schedule(static) num_threads(num_threads) if (use_threads)
+	for (int i = 0; i < (int)cars.size(); ++i) {
+		car_t &car(cars[i]);
+		car.car_in_front = nullptr; // reset for this frame
+		if (!car.is_parked()) {car.move(speed);} // no update for parked cars
+	}
 	bool saw_parked(0);
 
-	for (auto i = cars.begin(); i != cars.end(); ++i) { // move cars
+	for (auto i = cars.begin(); i != cars.end(); ++i) { // serial pass for shared state
 		unsigned const cix(i - cars.begin());
-		i->car_in_front = nullptr; // reset for this frame
 
 		if (car_blocks.empty() || i->cur_city != car_blocks.back().cur_city) {
 			if (!saw_parked && !car_blocks.empty()) {car_blocks.back().first_parked = cix;} // no parked cars in prev city
@@ -1025,30 +1078,33 @@ void car_manager_t::next_frame(ped_manager_t const &ped_manager, float car_speed
 		if (i->is_parked()) {
 			if (!saw_parked) {car_blocks.back().first_parked = cix; saw_parked = 1;}
 			i->maybe_wake(rgen);
-			continue; // no update for parked cars
+			continue;
 		}
-		i->move(speed);
+		if (road_runs.empty() || i->cur_city != (i-1)->cur_city || i->cur_road != (i-1)->cur_road || (i-1)->is_parked()) {road_runs.push_back(cix);} // start a new run
 		if (i->entering_city) {entering_city.push_back(cix);} // record for use in collision detection
 		if (!i->stopped_at_light && i->is_almost_stopped() && i->in_isect()) {get_car_isec(*i).stoplight.mark_blocked(i->dim, i->dir);} // blocking intersection
 		register_car_at_city(*i);
 	} // for i
 	if (!saw_parked && !car_blocks.empty()) {car_blocks.back().first_parked = cars.size();} // no parked cars in final city
 	car_blocks.emplace_back(cars.size(), 0); // add terminator
-
-	for (auto i = cars.begin(); i != cars.end(); ++i) { // collision detection
+	road_runs.push_back(cars.size()); // add terminator
+	// Note: parked cars are sorted last in each city, so the last run may end at the first parked car
+	for (auto cb = car_blocks.begin(); cb+1 < car_blocks.end(); ++cb) {
+		if (cb->first_parked == (cb+1)->start) continue; // no parked cars
+		auto it(std::lower_bound(road_runs.begin(), road_runs.end(), cb->first_parked));
+		if (*it != cb->first_parked) {road_runs.insert(it, cb->first_parked);} // parked cars are excluded below
+	}
+	int const num_runs(road_runs.size() - 1);
+	// collision detection between cars on the same road; writes to both cars, but runs are disjoint
+#pragma omp parallel for schedule(dynamic,4) num_threads(num_threads) if (use_threads && num_runs > 1)
+	for (int r = 0; r < num_runs; ++r) {
+		if (!cars[road_runs[r]].is_parked()) {check_road_run_collisions(road_runs[r], road_runs[r+1]);}
+	}
+	// collision detection across roads: connector roads entering cities, intersections, and pedestrians; this is serial and in car order
+	for (auto i = cars.begin(); i != cars.end(); ++i) {
 		if (i->is_parked()) continue; // no collisions for parked cars
-		bool const on_conn_road(i->cur_city == CONN_CITY_IX);
-		float const length(i->get_length()), max_check_dist(max(3.0f*length, (length + i->get_max_lookahead_dist()))); // max of collision dist and car-in-front dist
 
-		for (auto j = i+1; j != cars.end(); ++j) { // check for collisions with cars on the same road (can't test seg because they can be on diff segs but still collide)
-			if (i->cur_city != j->cur_city || i->cur_road != j->cur_road) break; // different cities or roads
-			if (!on_conn_road && i->cur_road_type == j->cur_road_type && abs((int)i->cur_seg - (int)j->cur_seg) > (on_conn_road ? 1 : 0)) break; // diff road segs or diff isects
-			check_collision(*i, *j);
-			i->register_adj_car(*j);
-			j->register_adj_car(*i);
-			if (!dist_xy_less_than(i->get_center(), j->get_center(), max_check_dist)) break;
-		}
-		if (on_conn_road) { // on connector road, check before entering intersection to a city
+		if (i->cur_city == CONN_CITY_IX) { // on connector road, check before entering intersection to a city
 			for (auto ix = entering_city.begin(); ix != entering_city.end(); ++ix) {
 				if (*ix != unsigned(i - cars.begin())) {check_collision(*i, cars[*ix]);}
 			}
@@ -1063,7 +1119,7 @@ void car_manager_t::next_frame(ped_manager_t const &ped_manager, float car_speed
 
 	if (map_mode) { // create cars_by_road
 		// cars have moved since the last sort and may no longer be in city/road order, so we need to re-sort them
-		sort(cars.begin(), cars.end(), sort_func);
+		sort_cars(sort_func);
 		car_blocks_by_road.clear();
 		cars_by_road.clear();
 		unsigned cur_city(1<<31), cur_road(1<<31); // start at invalid values
@@ -61,9 +61,9 @@ struct city_params_t {
 	unsigned add_tlines; // 0=never, 1=always, 2=only when there are no secondary buildings
 	bool assign_house_plots, new_city_conn_road_alg;
 	// cars
-	unsigned num_cars;
-	float car_speed, traffic_balance_val, new_city_prob, max_car_scale;
-	bool enable_car_path_finding, convert_model_files, cars_use_driveways;
+	unsigned num_cars, car_sim_threads; // car_sim_threads: 0 = OpenMP default
+	float car_speed, traffic_balance_val, new_city_prob, max_car_scale, route_congestion_weight, route_refresh_secs;
+	bool enable_car_path_finding, convert_model_files, cars_use_driveways, car_route_tables, car_trip_stats;
 	vector<city_model_t> car_model_files, ped_model_files, hc_model_files;
 	// parking lots
 	unsigned min_park_spaces, min_park_rows;
@@ -77,7 +77,7 @@ struct city_params_t {
 	// detail objects
 	unsigned max_benches_per_plot;
 	// pedestrians
-	unsigned num_peds;
+	unsigned num_peds, ped_sim_threads; // ped_sim_threads: 0 = OpenMP default
 	float ped_speed;
 	bool ped_respawn_at_dest, use_animated_people;
 	bool any_model_has_animations; // calculated, not specified in the config file
@@ -92,10 +92,11 @@ struct city_params_t {
 
 	city_params_t() : num_cities(0), num_samples(100), num_conn_tries(50), city_size_min(0), city_size_max(0), city_border(0), road_border(0), slope_width(0),
 		num_rr_tracks(0), park_rate(0), road_width(0.0), road_spacing(0.0), road_spacing_rand(0.0), road_spacing_xy_add(0.0), conn_road_seg_len(1000.0),
-		max_road_slope(1.0), max_track_slope(1.0), residential_probability(0.0), make_4_way_ints(0), add_tlines(2), assign_house_plots(0), new_city_conn_road_alg(0), num_cars(0),
-		car_speed(0.0), traffic_balance_val(0.5), new_city_prob(1.0), max_car_scale(1.0), enable_car_path_finding(0), convert_model_files(0), cars_use_driveways(0),
+		max_road_slope(1.0), max_track_slope(1.0), residential_probability(0.0), make_4_way_ints(0), add_tlines(2), assign_house_plots(0), new_city_conn_road_alg(0), num_cars(0), car_sim_threads(0),
+		car_speed(0.0), traffic_balance_val(0.5), new_city_prob(1.0), max_car_scale(1.0), route_congestion_weight(4.0), route_refresh_secs(5.0), enable_car_path_finding(0),
+		convert_model_files(0), cars_use_driveways(0), car_route_tables(0), car_trip_stats(0),
 		min_park_spaces(12), min_park_rows(1), min_park_density(0.0), max_park_density(1.0), car_shadows(0), max_lights(1024), max_shadow_maps(0), smap_size(0),
-		max_trees_per_plot(0), tree_spacing(1.0), max_benches_per_plot(0), num_peds(0), ped_speed(0.0), ped_respawn_at_dest(0), use_animated_people(0),
+		max_trees_per_plot(0), tree_spacing(1.0), max_benches_per_plot(0), num_peds(0), ped_sim_threads(0), ped_speed(0.0), ped_respawn_at_dest(0), use_animated_people(0),
 		any_model_has_animations(0), read_error_flag(0),
 		kwmb(read_error_flag, "city"), kwmu(read_error_flag, "city"), kwmr(read_error_flag, "city") {init_kw_maps();}
 	bool enabled() const {return (num_cities > 0 && city_size_min > 0);}
@@ -149,12 +150,12 @@ struct car_t : public car_base_t, public waiting_obj_t { // size = 100
 	bool is_truck, entering_city, in_tunnel, dest_valid, destroyed, in_reverse, engine_running;
 	uint8_t color_id, front_car_turn_dir, model_id;
 	uint16_t dest_city, dest_isec;
-	float height, dz, rot_z, turn_val, waiting_pos, wake_time;
+	float height, dz, rot_z, turn_val, waiting_pos, wake_time, dest_time; // dest_time is the tfticks value when the current dest was chosen
 	car_t const *car_in_front;
 
 	car_t() : prev_bcube(all_zeros), is_truck(0), entering_city(0), in_tunnel(0), dest_valid(0), destroyed(0), in_reverse(0), engine_running(0),
 		color_id(0), front_car_turn_dir(TURN_UNSPEC), model_id(0), dest_city(0), dest_isec(0), height(0.0), dz(0.0), rot_z(0.0),
-		turn_val(0.0), waiting_pos(0.0), wake_time(0.0), car_in_front(nullptr) {}
+		turn_val(0.0), waiting_pos(0.0), wake_time(0.0), dest_time(0.0), car_in_front(nullptr) {}
 	void set_bcube(point const &center, vector3d const &sz);
 	bool is_valid   () const {return !bcube.is_all_zeros();}
 	bool is_sleeping() const {return (wake_time > 0.0);}
@@ -557,6 +558,37 @@ private:
 };
 
 
+// graph of the intersections of a road network connected by chains of road segments, with a table of travel costs from every node to every destination;
+// edge costs are segment lengths plus a congestion term from the smoothed number of cars on each segment, and the tables are refreshed over a period of time
+class road_router_t {
+	struct edge_t {
+		unsigned src, dest, segs_start, segs_end; // segs is a range into seg_ixs
+		float length, cost;
+		edge_t(unsigned s, unsigned d, unsigned ss, unsigned se, float len) : src(s), dest(d), segs_start(ss), segs_end(se), length(len), cost(len) {}
+	};
+	vector<edge_t> edges;
+	vector<int> node_edges; // 4 per node, one per outgoing orient; -1 if there's no edge
+	vector<unsigned> seg_ixs, in_edge_start, in_edges; // in_edges is CSR for reverse traversal
+	vector<float> seg_cars, dists; // smoothed cars per segment; dists is {dest, node}
+	unsigned num_nodes=0, next_dest=0;
+
+	void update_edge_costs();
+	void calc_dists_to(unsigned dest);
+public:
+	bool empty() const {return edges.empty();}
+	void clear();
+	void init(unsigned num_nodes_, unsigned num_segs);
+	void add_edge(unsigned src, unsigned dest, unsigned orient, float length, vector<unsigned> const &segs);
+	void finalize(); // builds reverse edges and computes all tables
+	void add_seg_car_count(unsigned seg_ix, unsigned count) {assert(seg_ix < seg_cars.size()); seg_cars[seg_ix] += 0.02f*(count - seg_cars[seg_ix]);} // called once per frame
+	void next_frame(float frame_secs);
+	// returns the outgoing orient from src in valid_mask with the lowest cost to dest, or -1 if dest is unreachable
+	int choose_orient(unsigned src, unsigned dest, unsigned valid_mask) const;
+	size_t get_mem() const {return (edges.capacity()*sizeof(edge_t) + (dists.capacity() + seg_cars.capacity())*sizeof(float) +
+		(node_edges.capacity() + seg_ixs.capacity() + in_edge_start.capacity() + in_edges.capacity())*sizeof(unsigned));}
+};
+
+
 struct road_connector_t : public road_t, public streetlights_t {
 	road_t src_road;
 
@@ -691,7 +723,8 @@ class city_spectate_manager_t;
 struct pedestrian_t : public person_base_t { // city pedestrian
 	point dest_car_center; // since cars are sorted each frame, we can't find their positions by index so we need to cache them here
 	unsigned plot, next_plot, dest_plot, dest_bldg; // Note: can probably be made unsigned short later, though these are global plot and building indices
-	unsigned short city, colliding_ped;
+	unsigned short city;
+	unsigned colliding_ped; // ped index, which may be above 64K
 	unsigned char stuck_count;
 	bool collided, ped_coll, in_the_road, at_crosswalk, at_dest, has_dest_bldg, has_dest_car, destroyed;
 
@@ -705,9 +738,8 @@ struct pedestrian_t : public person_base_t { // city pedestrian
 	void destroy() {destroyed = 1;} // that's it, no other effects
 	void move(ped_manager_t const &ped_mgr, cube_t const &plot_bcube, cube_t const &next_plot_bcube, float &delta_dir);
 	bool check_for_safe_road_crossing(ped_manager_t const &ped_mgr, cube_t const &plot_bcube, cube_t const &next_plot_bcube, vect_cube_t *dbg_cubes=nullptr) const;
-	bool check_ped_ped_coll_range(vector<pedestrian_t> &peds, unsigned pid, unsigned ped_start, unsigned target_plot, float prox_radius, vector3d &force);
-	bool check_ped_ped_coll(ped_manager_t const &ped_mgr, vector<pedestrian_t> &peds, unsigned pid, float delta_dir);
-	bool check_ped_ped_coll_stopped(vector<pedestrian_t> &peds, unsigned pid);
+	bool check_ped_ped_coll_range(ped_manager_t const &ped_mgr, unsigned pid, unsigned target_plot, float prox_radius, vector3d &force);
+	bool check_ped_ped_coll(ped_manager_t const &ped_mgr, unsigned pid, float delta_dir);
 	bool check_inside_plot(ped_manager_t &ped_mgr, point const &prev_pos, cube_t &plot_bcube, cube_t &next_plot_bcube);
 	bool check_road_coll(ped_manager_t const &ped_mgr, cube_t const &plot_bcube, cube_t const &next_plot_bcube) const;
 	bool is_valid_pos(vect_cube_t const &colliders, bool &ped_at_dest, ped_manager_t const *const ped_mgr) const;
@@ -715,7 +747,8 @@ struct pedestrian_t : public person_base_t { // city pedestrian
 	point get_dest_pos(cube_t const &plot_bcube, cube_t const &next_plot_bcube, ped_manager_t const &ped_mgr, int &debug_state) const;
 	bool choose_alt_next_plot(ped_manager_t const &ped_mgr);
 	void get_avoid_cubes(ped_manager_t const &ped_mgr, vect_cube_t const &colliders, cube_t const &plot_bcube, cube_t const &next_plot_bcube, point &dest_pos, vect_cube_t &avoid) const;
-	void next_frame(ped_manager_t &ped_mgr, vector<pedestrian_t> &peds, unsigned pid, rand_gen_t &rgen, float delta_dir);
+	void update_dest(ped_manager_t &ped_mgr);
+	void next_frame(ped_manager_t &ped_mgr, unsigned pid, rand_gen_t &rgen, float delta_dir);
 	void register_at_dest();
 	void debug_draw(ped_manager_t &ped_mgr) const;
 private:
@@ -723,6 +756,50 @@ private:
 	void get_plot_bcubes_inc_sidewalks(ped_manager_t const &ped_mgr, cube_t &plot_bcube, cube_t &next_plot_bcube) const;
 };
 
+struct ped_snapshot_t { // ped state at the start of the frame, used for ped-ped collisions so that the update order of peds doesn't matter
+	point pos;
+	vector3d vel;
+	float coll_radius;
+	unsigned plot;
+	bool destroyed;
+};
+
+class ped_grid_t { // uniform grid of peds within each plot, for finding nearby peds without iterating over the entire plot
+	struct plot_grid_t {
+		float x0=0.0, y0=0.0, x1=0.0, y1=0.0, inv_dx=0.0, inv_dy=0.0;
+		unsigned nx=0, ny=0, cell_start=0; // nx=0 => no peds
+	};
+	vector<plot_grid_t> plots;
+	vector<unsigned> cell_start, ped_ixs; // cell_start has one entry per cell plus a terminator
+	vector<unsigned> cell_pos; // temporary, used during build
+
+	static unsigned get_cell_ix(float v, float v0, float inv_d, unsigned n) {return min(n-1, unsigned(max(0.0f, (v - v0)*inv_d)));}
+	unsigned get_cell(plot_grid_t const &pg, point const &pos) const {
+		return (pg.cell_start + get_cell_ix(pos.y, pg.y0, pg.inv_dy, pg.ny)*pg.nx + get_cell_ix(pos.x, pg.x0, pg.inv_dx, pg.nx));
+	}
+public:
+	// ranges are [start, end) ped index ranges with disjoint sets of plots that are processed in parallel; cell_sz is the target cell size
+	void build(vector<ped_snapshot_t> const &peds, vector<pair<unsigned, unsigned>> const &ranges, unsigned num_plots, float cell_sz);
+	size_t get_mem() const {return (plots.capacity()*sizeof(plot_grid_t) + (cell_start.capacity() + ped_ixs.capacity() + cell_pos.capacity())*sizeof(unsigned));}
+
+	// calls func(ped_ix) for peds in cells within radius of pos in this plot, in a consistent order; stops and returns 1 if func returns true
+	template<typename F> bool iterate_near(unsigned plot, point const &pos, float radius, F const &func) const {
+		if (plot >= plots.size()) return 0;
+		plot_grid_t const &pg(plots[plot]);
+		if (pg.nx == 0) return 0; // no peds in this plot
+		unsigned const x1(get_cell_ix(pos.x-radius, pg.x0, pg.inv_dx, pg.nx)), x2(get_cell_ix(pos.x+radius, pg.x0, pg.inv_dx, pg.nx));
+		unsigned const y1(get_cell_ix(pos.y-radius, pg.y0, pg.inv_dy, pg.ny)), y2(get_cell_ix(pos.y+radius, pg.y0, pg.inv_dy, pg.ny));
+
+		for (unsigned y = y1; y <= y2; ++y) {
+			for (unsigned x = x1; x <= x2; ++x) {
+				unsigned const cell(pg.cell_start + y*pg.nx + x);
+				for (unsigned i = cell_start[cell]; i < cell_start[cell+1]; ++i) {if (func(ped_ixs[i])) return 1;}
+			}
+		}
+		return 0;
+	}
+};
+
 struct ped_city_vect_t {
 	vector<vector<vector<sphere_t>>> peds; // per city per road
 	void add_ped(pedestrian_t const &ped, unsigned road_ix);
@@ -754,8 +831,8 @@ class car_manager_t { // and trucks and helicopters
 	ped_city_vect_t peds_crossing_roads;
 	car_draw_state_t dstate;
 	rand_gen_t rgen;
-	vector<unsigned> entering_city;
-	unsigned first_parked_car;
+	vector<unsigned> entering_city, road_runs; // road_runs: start index of each run of moving cars on the same city and road, with terminator
+	unsigned first_parked_car, num_incr_sorts, num_full_sorts;
 	bool car_destroyed;
 
 	cube_t get_cb_bcube(car_block_t const &cb ) const;
@@ -766,6 +843,8 @@ class car_manager_t { // and trucks and helicopters
 	void add_car();
 	void get_car_ix_range_for_cube(vector<car_block_t>::const_iterator cb, cube_t const &bc, unsigned &start, unsigned &end) const;
 	void remove_destroyed_cars();
+	void sort_cars(comp_car_road_then_pos const &sort_func);
+	void check_road_run_collisions(unsigned start, unsigned end);
 	void update_cars();
 	int find_next_car_after_turn(car_t &car);
 	void setup_occluders();
@@ -774,7 +853,7 @@ class car_manager_t { // and trucks and helicopters
 public:
 	friend class city_spectate_manager_t;
 	car_manager_t(city_road_gen_t const &road_gen_) :
-		road_gen(road_gen_), dstate(car_model_loader, helicopter_model_loader), first_parked_car(0), car_destroyed(0) {}
+		road_gen(road_gen_), dstate(car_model_loader, helicopter_model_loader), first_parked_car(0), num_incr_sorts(0), num_full_sorts(0), car_destroyed(0) {}
 	bool empty() const {return cars.empty();}
 	void clear() {cars.clear(); car_blocks.clear();}
 	bool has_car_models() const {return !car_model_loader.empty();}
@@ -795,6 +874,8 @@ public:
 	bool line_intersect_cars(point const &p1, point const &p2, float &t) const;
 	bool check_car_for_ped_colls(car_t &car) const;
 	void next_frame(ped_manager_t const &ped_manager, float car_speed);
+	void get_sort_stats(unsigned &incr, unsigned &full) const {incr = num_incr_sorts; full = num_full_sorts;}
+	unsigned get_num_cars() const {return cars.size();}
 	void helicopters_next_frame(float car_speed);
 	bool check_helicopter_coll(cube_t const &bc) const;
 	void draw(int trans_op_mask, vector3d const &xlate, bool use_dlights, bool shadow_only, bool is_dlight_shadows);
@@ -858,18 +939,35 @@ class ped_manager_t { // pedestrians
 	vector<car_city_vect_t> cars_by_city;
 	vector<point> bldg_ppl_pos;
 	vector<person_t const *> to_draw;
+	vector<ped_snapshot_t> prev_peds; // start of frame state, indexed by ped
+	vector<pair<unsigned, unsigned>> active_ped_ranges; // ped index ranges of cities updated this frame
+	vector<unsigned> active_plots;
+	vector<path_finder_t> path_finders; // one per thread
+	ped_grid_t ped_grid;
 	rand_gen_t rgen;
 	ao_draw_state_t dstate;
 	int selected_ped_ssn;
-	unsigned animation_id;
+	unsigned animation_id, sim_frame_ix;
 	bool ped_destroyed, need_to_sort_peds, prev_choose_zombie;
 
+	struct sim_state_t { // for restarting the simulation in benchmarks
+		vector<pedestrian_t> peds;
+		vector<city_ixs_t> by_city;
+		vector<unsigned> by_plot;
+		vector<unsigned char> need_to_sort_city;
+		rand_gen_t rgen;
+		unsigned sim_frame_ix=0;
+		bool need_to_sort_peds=0;
+	};
+	sim_state_t saved_state;
+
 	void assign_ped_model(person_base_t &ped);
 	void maybe_reassign_ped_model(person_base_t &ped);
 	bool gen_ped_pos(pedestrian_t &ped);
 	void expand_cube_for_ped(cube_t &cube) const;
 	void remove_destroyed_peds();
 	void sort_by_city_and_plot();
+	void build_ped_grid();
 	road_isec_t const &get_car_isec(car_base_t const &car) const;
 	void register_ped_new_plot(pedestrian_t const &ped);
 	int get_road_ix_for_ped_crossing(pedestrian_t const &ped, bool road_dim) const;
@@ -879,7 +977,9 @@ class ped_manager_t { // pedestrians
 public:
 	friend class city_spectate_manager_t;
 	// for use in pedestrian_t, mostly for collisions and path finding
-	path_finder_t path_finder;
+	path_finder_t &get_path_finder();
+	ped_snapshot_t const &get_prev_ped(unsigned pid) const {assert(pid < prev_peds.size()); return prev_peds[pid];}
+	ped_grid_t const &get_ped_grid() const {return ped_grid;}
 	vect_cube_t const &get_colliders_for_plot(unsigned city_ix, unsigned plot_ix) const;
 	road_plot_t const &get_city_plot_for_peds(unsigned city_ix, unsigned plot_ix) const;
 	dw_query_t get_nearby_driveway(unsigned city_ix, unsigned plot_ix, point const &pos, float dist) const;
@@ -903,7 +1003,7 @@ public:
 	bool choose_dest_parked_car(unsigned city_id, unsigned &plot_id, unsigned &car_ix, point &car_center);
 public:
 	ped_manager_t(city_road_gen_t const &road_gen_, car_manager_t const &car_manager_) :
-		road_gen(road_gen_), car_manager(car_manager_), selected_ped_ssn(-1), animation_id(1), ped_destroyed(0), need_to_sort_peds(0), prev_choose_zombie(0) {}
+		road_gen(road_gen_), car_manager(car_manager_), selected_ped_ssn(-1), animation_id(1), sim_frame_ix(0), ped_destroyed(0), need_to_sort_peds(0), prev_choose_zombie(0) {}
 	void next_animation();
 	static float get_ped_radius();
 	void clear() {peds.clear(); by_city.clear();}
@@ -915,7 +1015,11 @@ public:
 	bool proc_sphere_coll(point &pos, float radius, vector3d *cnorm) const;
 	bool line_intersect_peds(point const &p1, point const &p2, float &t) const;
 	void destroy_peds_in_radius(point const &pos_in, float radius);
-	void next_frame();
+	void next_frame(bool bench_mode=0); // bench_mode: update peds in all cities regardless of player distance, and skip building people
+	unsigned get_num_peds() const {return peds.size();}
+	void save_sim_state();
+	void restore_sim_state();
+	uint64_t get_sim_state_hash() const;
 	pedestrian_t const *get_ped_at(point const &p1, point const &p2) const;
 	unsigned get_first_ped_at_plot(unsigned plot) const {assert(plot < by_plot.size()); return by_plot[plot];}
 	void get_peds_crossing_roads(ped_city_vect_t &pcv) const;
@@ -38,13 +38,19 @@ void city_params_t::init_kw_maps() {
 	kwmr.add("residential_probability", residential_probability, FP_CHECK_01);
 	// cars
 	kwmu.add("num_cars", num_cars);
+	kwmu.add("car_sim_threads", car_sim_threads);
 	kwmb.add("enable_car_path_finding", enable_car_path_finding);
 	kwmb.add("cars_use_driveways",  cars_use_driveways);
+	kwmb.add("car_route_tables",    car_route_tables);
+	kwmb.add("car_trip_stats",      car_trip_stats);
+	kwmr.add("route_congestion_weight", route_congestion_weight, FP_CHECK_NONNEG);
+	kwmr.add("route_refresh_secs",      route_refresh_secs,      FP_CHECK_POS);
 	kwmr.add("car_speed",           car_speed,           FP_CHECK_NONNEG);
 	kwmr.add("traffic_balance_val", traffic_balance_val, FP_CHECK_01);
 	kwmr.add("new_city_prob",       new_city_prob,       FP_CHECK_01);
 	// pedestrians
 	kwmu.add("num_peds", num_peds);
+	kwmu.add("ped_sim_threads", ped_sim_threads);
 	kwmb.add("ped_respawn_at_dest", ped_respawn_at_dest);
 	kwmb.add("use_animated_people", use_animated_people);
 	kwmr.add("ped_speed",           ped_speed, FP_CHECK_NONNEG);
@@ -245,6 +251,8 @@ void building_params_t::init_kw_maps() {
 	kwmu.add("ai_opens_doors",      ai_opens_doors); // 0=don't open doors, 1=only open if player closed door after path selection; 2=always open doors
 	kwmb.add("ai_target_player",    ai_target_player);
 	kwmb.add("ai_follow_player",    ai_follow_player);
+	kwmb.add("ai_path_cache",       ai_path_cache); // cache per-floor room-to-room next-hop tables rather than running A* for each path
+	kwmb.add("ai_flow_field",       ai_flow_field); // people pursuing the player on the same floor follow a shared flow field rather than finding their own paths
 	kwmu.add("ai_player_vis_test",  ai_player_vis_test); // 0=no test, 1=LOS, 2=LOS+FOV, 3=LOS+FOV+lit
 	kwmu.add("ai_sees_player_hide", ai_sees_player_hide); // 0=doesn't see the player, 1=sees the player and waits outside the hiding spot, 2=opens the door and comes in
 	kwmu.add("people_per_office_min", people_per_office_min);
@@ -293,11 +301,15 @@ void building_params_t::init_kw_maps() {
 	kwmr.add("basement_prob_office", basement_prob_office, FP_CHECK_01);
 	kwmr.add("ball_prob",            ball_prob,            FP_CHECK_01);
 	kwmf.add("player_weight_limit",  player_weight_limit);
+	kwmr.add("room_geom_upload_budget_ms", room_geom_upload_budget_ms, FP_CHECK_NONNEG);
 	// special commands
 	kwmu.add("probability",              cur_prob); // for building materials
 	kwmb.add("add_city_interiors",       add_city_interiors);
 	kwmb.add("gen_building_interiors",   gen_building_interiors);
 	kwmb.add("enable_rotated_room_geom", enable_rotated_room_geom);
+	kwmb.add("parallel_interior_gen",    parallel_interior_gen);
+	kwmb.add("bkg_room_geom_gen",        bkg_room_geom_gen);
+	kwmb.add("use_building_bvh",         use_building_bvh);
 }
 bool building_params_t::parse_buildings_option(FILE *fp) {
 
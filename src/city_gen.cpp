@@ -22,7 +22,8 @@ city_params_t city_params;
 point pre_smap_player_pos(all_zeros);
 
 extern bool enable_dlight_shadows, dl_smap_enabled, flashlight_on, camera_in_building, have_indir_smoke_tex, disable_city_shadow_maps;
-extern int rand_gen_index, display_mode, animate2, draw_model, player_in_basement;
+extern int rand_gen_index, display_mode, animate2, draw_model, player_in_basement, frame_counter;
+extern double tfticks;
 extern unsigned shadow_map_sz, cur_display_iter;
 extern float shadow_map_pcf_offset, cobj_z_bias, rain_wetness;
 extern building_params_t global_building_params;
@@ -414,6 +415,7 @@ class road_network_t : public streetlights_t { // AKA city center
 	vector<cube_t> conn_roads; // connector road bounding cubes (contain multiple adjacent connected roads with different slopes/zvals)
 	vector<road_isec_t> isecs[3]; // for drawing with textures: {2-way, 3-way, 4-way}
 	vector<road_plot_t> plots; // plots of land that can hold buildings (city blocks)
+	road_router_t router; // intersection graph for car routing; only built when car_route_tables is enabled
 	vector<bridge_t> bridges; // bridges, part of global road network
 	vector<tunnel_t> tunnels; // tunnels, part of global road network
 	vector<road_t> tracks, track_segs; // railroad tracks (for global road network)
@@ -474,6 +476,27 @@ class road_network_t : public streetlights_t { // AKA city center
 		assert(seg_ix < segs.size());
 		return segs[seg_ix];
 	}
+	unsigned get_num_isecs() const {return (isecs[0].size() + isecs[1].size() + isecs[2].size());}
+	unsigned get_flat_isec_ix(unsigned isec_type, unsigned ix) const { // flat index over {2-way, 3-way, 4-way}, as used for car dest_isec
+		assert(isec_type < 3 && ix < isecs[isec_type].size());
+		for (unsigned n = 0; n < isec_type; ++n) {ix += isecs[n].size();}
+		return ix;
+	}
+	int get_flat_isec_ix(road_isec_t const *isec) const {
+		unsigned offset(0);
+
+		for (unsigned n = 0; n < 3; ++n) {
+			if (isec >= isecs[n].data() && isec < isecs[n].data()+isecs[n].size()) {return (offset + (isec - isecs[n].data()));}
+			offset += isecs[n].size();
+		}
+		return -1; // not found
+	}
+	int get_route_dest_node(car_t const &car) const {
+		if (!road_to_city.empty()) {return (get_num_isecs() + car.dest_city);} // global network: node for the entrance to the dest city
+		if (car.dest_city == city_id) {return car.dest_isec;} // local destination
+		auto it(cix_to_isec.find(car.dest_city)); // destination in another city; route to the connector road intersection
+		return ((it == cix_to_isec.end()) ? -1 : get_flat_isec_ix(it->second));
+	}
 public:
 	road_network_t() : bcube(all_zeros), city_id(CONN_CITY_IX), cluster_id(0), plot_id_offset(0), tot_road_len(0.0), num_cars(0), is_residential(0) {} // global road network ctor
 		
@@ -1466,7 +1489,9 @@ public:
 				dir = (move_dir ? ((dx < 0) ? 0 : 1) : ((dy < 0) ? 2 : 3));	
 			}
 			else { // take a detour in a random direction
-				static rand_gen_t rgen;
+				rand_gen_t rgen; // seeded from the inputs and time rather than static so that parallel ped updates are thread safe and deterministic
+				rgen.set_state((global_plot + 1), (global_dest_plot + unsigned(tfticks)));
+				rgen.rand_mix();
 				bool rand_dir(rgen.rand_bool());
 				dir = (move_dir ? (rand_dir ? 0 : 1) : (rand_dir ? 2 : 3));
 					
@@ -1779,8 +1804,8 @@ public:
 				orients[TURN_LEFT ] = stoplight_ns::conn_left [orient_in];
 				orients[TURN_RIGHT] = stoplight_ns::conn_right[orient_in];
 
-				// use dest_seg.car_count to estimate traffic and route around?
-				if (car.dest_valid && car.cur_city != CONN_CITY_IX) { // Note: don't need to update dest logic on connector roads since there are no choices to make
+				if (car_rn.choose_routed_turn_dir(car, isec, orients)) {} // routing tables route around traffic using segment car counts
+				else if (car.dest_valid && car.cur_city != CONN_CITY_IX) { // Note: don't need to update dest logic on connector roads since there are no choices to make
 					vector3d dest_dir;
 						
 					if (is_car_at_dest_isec(car)) { // this intersection is our destination
@@ -1843,6 +1868,66 @@ public:
 		}
 		assert(get_car_rn(car, road_networks, global_rn).get_road_bcube_for_car(car, global_rn).intersects_xy(car.bcube)); // sanity check
 	}
+	// chooses the turn dir with the lowest routing cost to the car's dest; returns 0 if routing is disabled or there's no route
+	bool choose_routed_turn_dir(car_t &car, road_isec_t const &isec, unsigned const orients[3]) const {
+		if (router.empty() || !car.dest_valid) return 0;
+		int const dest(get_route_dest_node(car));
+		if (dest < 0) return 0;
+		unsigned valid_mask(0);
+
+		for (unsigned tdir = 0; tdir < 3; ++tdir) {
+			if (isec.is_orient_currently_valid(orients[tdir], tdir)) {valid_mask |= (1 << orients[tdir]);}
+		}
+		int const orient(router.choose_orient(get_flat_isec_ix(car.get_isec_type(), car.cur_seg), dest, valid_mask));
+		if (orient < 0) return 0; // at dest or no route
+
+		for (unsigned tdir = 0; tdir < 3; ++tdir) {
+			if (orients[tdir] == (unsigned)orient) {car.turn_dir = tdir; return 1;}
+		}
+		assert(0); // orient must be one of the valid orients
+		return 0;
+	}
+	void build_router() { // must be called after calc_ix_values()
+		unsigned const num_isecs(get_num_isecs());
+		bool const is_global(!road_to_city.empty());
+		router.init((num_isecs + (is_global ? city_to_seg.size() : 0)), segs.size()); // the global network adds a node for the entrance to each city
+		vector<unsigned> edge_segs;
+
+		for (unsigned n = 0; n < 3; ++n) { // {2-way, 3-way, 4-way}
+			for (unsigned i = 0; i < isecs[n].size(); ++i) {
+				road_isec_t const &isec(isecs[n][i]);
+
+				for (unsigned orient = 0; orient < 4; ++orient) {
+					if (!(isec.conn & (1<<orient)) || isec.conn_ix[orient] < 0) continue; // not connected, or connector road to another city
+					bool const dir(orient & 1);
+					unsigned seg_ix(isec.conn_ix[orient]);
+					float length(isec.get_sz_dim(orient >> 1)); // distance across the intersection
+					int dest(-1);
+					edge_segs.clear();
+
+					while (edge_segs.size() <= segs.size()) { // follow the chain of segments to the next intersection
+						road_seg_t const &seg(get_seg(seg_ix));
+						edge_segs.push_back(seg_ix);
+						length += seg.get_length();
+						if (seg.conn_type[dir] == TYPE_RSEG) {seg_ix = seg.conn_ix[dir]; continue;}
+						if (!is_isect(seg.conn_type[dir])) break; // dead end
+
+						if (is_global) {
+							assert(seg.road_ix < road_to_city.size());
+							unsigned const city(road_to_city[seg.road_ix].id[dir]);
+							if (city != CONN_CITY_IX) {dest = num_isecs + city; break;} // entrance to a city
+						}
+						dest = get_flat_isec_ix((seg.conn_type[dir] - TYPE_ISEC2), seg.conn_ix[dir]);
+						break;
+					} // end while
+					if (dest >= 0) {router.add_edge(get_flat_isec_ix(n, i), dest, orient, length, edge_segs);}
+				} // for orient
+			} // for i
+		} // for n
+		router.finalize();
+	}
+	size_t get_router_mem() const {return router.get_mem();}
+
 	bool is_car_at_dest_isec(car_t const &car) const {
 		unsigned const isec_type(car.get_isec_type());
 		unsigned flat_isec_ix(car.cur_seg);
@@ -1937,6 +2022,10 @@ public:
 		for (unsigned n = 1; n < 3; ++n) { // {2-way, 3-way, 4-way} - Note: 2-way can be skipped
 			for (auto i = isecs[n].begin(); i != isecs[n].end(); ++i) {i->next_frame();} // update stoplight state
 		}
+		if (!router.empty()) { // sample car counts for congestion weights before they're reset
+			for (unsigned i = 0; i < segs.size(); ++i) {router.add_seg_car_count(i, segs[i].car_count);}
+			router.next_frame(fticks/TICKS_PER_SECOND);
+		}
 		for (auto i = segs.begin(); i != segs.end(); ++i) {i->next_frame();}
 		//cout << TXT(city_id) << TXT(tot_road_len) << TXT(num_cars) << TXT(get_traffic_density()) << endl;
 		num_cars = 0;
@@ -2026,6 +2115,12 @@ public:
 class city_road_gen_t : public road_gen_base_t {
 	vector<road_network_t> road_networks; // one per city
 	road_network_t global_rn; // connects cities together; no plots
+
+	struct car_trip_stats_t {
+		unsigned num_trips=0;
+		double trip_secs=0.0, start_time=0.0;
+	};
+	mutable car_trip_stats_t trip_stats; // updated by cars through const functions
 	vector<transmission_line_t> transmission_lines;
 	cube_t cities_bcube;
 	road_draw_state_t dstate;
@@ -2533,6 +2628,14 @@ public:
 		global_rn.calc_ix_values(road_networks, global_rn, global_plot_id);
 		for (auto i = road_networks.begin(); i != road_networks.end(); ++i) {i->calc_ix_values(road_networks, global_rn, global_plot_id);}
 	}
+	void build_routers() {
+		if (!city_params.car_route_tables || !city_params.enable_car_path_finding) return; // only used for cars with destinations
+		timer_t timer("Build Road Routing Tables");
+		size_t mem(0);
+		global_rn.build_router();
+		for (auto i = road_networks.begin(); i != road_networks.end(); ++i) {i->build_router(); mem += i->get_router_mem();}
+		cout << "Road routing tables for " << road_networks.size() << " cities use " << (mem + global_rn.get_router_mem())/1024 << "KB" << endl;
+	}
 	void gen_parking_lots_and_place_objects(vector<car_t> &cars, bool have_cars) {
 		for (auto i = road_networks.begin(); i != road_networks.end(); ++i) {i->gen_parking_lots_and_place_objects(cars, have_cars, have_plot_dividers);}
 	}
@@ -2651,6 +2754,19 @@ public:
 		//for (auto r = road_networks.begin(); r != road_networks.end(); ++r) {cout << r->get_traffic_density() << " ";} cout << endl;
 		for (auto r = road_networks.begin(); r != road_networks.end(); ++r) {r->next_frame();}
 		global_rn.next_frame(); // not needed since there are no 3/4-way intersections/stoplights?
+		if (city_params.car_trip_stats) {report_car_trip_stats();}
+	}
+	// prints trips completed per simulated minute and average trip time, for comparing routing tables with greedy turns
+	void report_car_trip_stats() {
+		car_trip_stats_t &ts(trip_stats);
+		if (ts.start_time == 0.0) {ts.start_time = tfticks; return;}
+		double const elapsed((tfticks - ts.start_time)/TICKS_PER_SECOND);
+		if (elapsed < 60.0) return;
+		cout << "Car trips (" << (city_params.car_route_tables ? "routing tables" : "greedy turns") << "): " << ts.num_trips*60.0/elapsed << " per simulated minute, average trip time "
+			 << ((ts.num_trips > 0) ? ts.trip_secs/ts.num_trips : 0.0) << "s" << endl;
+		ts.num_trips = 0;
+		ts.trip_secs = 0.0;
+		ts.start_time = tfticks;
 	}
 	void register_car_at_city(unsigned city_id) const {get_city(city_id).register_car();} // Note: must be const
 	
@@ -2672,7 +2788,13 @@ public:
 		if (car.dest_valid && !car_at_dest(car)) return 0; // not yet at destination, keep existing dest
 		assert(!car.dest_valid || car.dest_city == car.cur_city); // sanity check
 		static rand_gen_t rgen; // reused across calls
+
+		if (car.dest_valid && car.dest_time > 0.0) { // completed a trip
+			++trip_stats.num_trips;
+			trip_stats.trip_secs += (tfticks - car.dest_time)/TICKS_PER_SECOND;
+		}
 		choose_new_car_dest(car, rgen);
+		car.dest_time = tfticks;
 		return 1;
 	}
 	void choose_new_car_dest(car_t &car, rand_gen_t &rgen) const {
@@ -2707,7 +2829,7 @@ public:
 	
 	void update_car(car_t &car, vector<car_t> const &cars, rand_gen_t &rgen) const {
 		if (car.cur_city == NO_CITY_IX) return; // not in a city (in a garage), nothing to update
-		//update_car_seg_stats(car); // not needed - stats not yet used
+		if (city_params.car_route_tables) {update_car_seg_stats(car);} // segment car counts are used for routing congestion weights
 		get_car_rn(car).update_car(car, cars, rgen, road_networks, global_rn);
 		if (city_params.enable_car_path_finding) {update_car_dest(car);}
 	}
@@ -2961,6 +3083,7 @@ public:
 		road_gen.connect_all_cities(heightmap, xsize, ysize, city_params.road_width, city_params.road_spacing);
 		road_gen.add_streetlights();
 		road_gen.gen_tile_blocks();
+		road_gen.build_routers();
 		car_manager.init_cars(city_params.num_cars);
 		init_city_spectate_manager(car_manager, ped_manager);
 	}
@@ -3032,10 +3155,14 @@ public:
 		if (!city_params.enabled()) return;
 
 		if (!use_threads_2_3 || omp_get_thread_num_3dw() == 1) { // thread 1
+			trace_zone_t const zone("Update Roads and Cars");
 			road_gen.next_frame(); // update stoplights; must be before car_manager next_frame() call
 			car_manager.next_frame(ped_manager, city_params.car_speed);
 		}
-		if (!use_threads_2_3 || omp_get_thread_num_3dw() == 2) {ped_manager.next_frame();} // thread=2
+		if (!use_threads_2_3 || omp_get_thread_num_3dw() == 2) { // thread=2
+			trace_zone_t const zone("Update Pedestrians");
+			ped_manager.next_frame();
+		}
 	}
 	void draw(int shadow_only, int reflection_pass, int trans_op_mask, vector3d const &xlate) { // shadow_only: 0=non-shadow pass, 1=sun/moon shadow, 2=dynamic shadow
 		if (player_in_basement >= 2)         return; // player is fully in the basement, not on stairs - don't draw anything
@@ -3073,6 +3200,65 @@ public:
 	void next_ped_animation() {ped_manager.next_animation();}
 	void free_context() {car_manager.free_context(); ped_manager.free_context();}
 	unsigned get_model_gpu_mem() const {return (ped_manager.get_model_gpu_mem() + car_manager.get_model_gpu_mem());}
+
+	// steps roads and cars (but not pedestrians) for num_frames fixed length frames with num_threads car threads; returns the average time per frame in ms
+	float run_car_sim_frames(unsigned num_frames, unsigned num_threads) {
+		if (!city_params.enabled() || car_manager.empty() || num_frames == 0) return 0.0;
+		unsigned const prev_threads(city_params.car_sim_threads);
+		int const prev_animate2(animate2);
+		float const prev_fticks(fticks);
+		city_params.car_sim_threads = num_threads;
+		animate2 = 1;
+		fticks   = 1.0; // one nominal frame
+		auto const start(high_resolution_clock::now());
+
+		for (unsigned n = 0; n < num_frames; ++n) {
+			road_gen.next_frame(); // update stoplights
+			car_manager.next_frame(ped_manager, city_params.car_speed);
+			tfticks += fticks;
+		}
+		float const ms(1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - start).count());
+		city_params.car_sim_threads = prev_threads;
+		animate2 = prev_animate2;
+		fticks   = prev_fticks;
+		return ms/num_frames;
+	}
+	unsigned get_num_cars() const {return car_manager.get_num_cars();}
+
+	// steps pedestrians in all cities for num_frames fixed length frames with num_threads threads; returns the average time per frame in ms;
+	// if restore_state is set, the peds and time are restored afterward so that each call starts from the same state
+	float run_ped_sim_frames(unsigned num_frames, unsigned num_threads, bool restore_state, uint64_t &state_hash) {
+		if (!city_params.enabled() || ped_manager.get_num_peds() == 0 || num_frames == 0) return 0.0;
+		unsigned const prev_threads(city_params.ped_sim_threads);
+		int const prev_animate2(animate2), prev_frame_counter(frame_counter);
+		float const prev_fticks(fticks);
+		double const prev_tfticks(tfticks);
+		if (restore_state) {ped_manager.save_sim_state();}
+		city_params.ped_sim_threads = num_threads;
+		animate2 = 1;
+		fticks   = 1.0; // one nominal frame
+		auto const start(high_resolution_clock::now());
+
+		for (unsigned n = 0; n < num_frames; ++n) {
+			ped_manager.next_frame(1); // bench_mode=1
+			tfticks += fticks;
+			++frame_counter;
+		}
+		float const ms(1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - start).count());
+		state_hash = ped_manager.get_sim_state_hash();
+		city_params.ped_sim_threads = prev_threads;
+		animate2 = prev_animate2;
+		fticks   = prev_fticks;
+
+		if (restore_state) {
+			ped_manager.restore_sim_state();
+			tfticks       = prev_tfticks;
+			frame_counter = prev_frame_counter;
+		}
+		return ms/num_frames;
+	}
+	unsigned get_num_peds() const {return ped_manager.get_num_peds();}
+	void get_car_sort_stats(unsigned &incr, unsigned &full) const {car_manager.get_sort_stats(incr, full);}
 }; // city_gen_t
 
 city_gen_t city_gen;
@@ -3091,6 +3277,7 @@ float get_min_obj_spacing() {return 4.0*ped_manager_t::get_ped_radius();} // all
 
 void gen_cities(float *heightmap, unsigned xsize, unsigned ysize) {
 	if (!have_cities()) return; // nothing to do
+	highres_timer_t timer("Gen Cities"); // roads and plots
 	city_gen.init(heightmap, xsize, ysize); // only need to call once for any given heightmap
 	city_gen.gen_cities();
 	city_gen.invalidate_heightmap();
@@ -3102,6 +3289,15 @@ void get_city_bcubes(vect_cube_t &bcubes) {city_gen.get_city_bcubes(bcubes);}
 void get_city_road_bcubes(vect_cube_t &bcubes, bool connector_only) {city_gen.get_all_road_bcubes(bcubes, connector_only);}
 void get_city_plot_zones(vect_city_zone_t &zones) {city_gen.get_all_plot_zones(zones);}
 void next_city_frame(bool use_threads_2_3) {city_gen.next_frame(use_threads_2_3);}
+void set_city_num_cars(unsigned num_cars) {city_params.num_cars = num_cars;} // must be called before gen_city_details()
+unsigned get_city_num_cars() {return city_gen.get_num_cars();}
+float run_car_sim_bench_frames(unsigned num_frames, unsigned num_threads) {return city_gen.run_car_sim_frames(num_frames, num_threads);}
+void get_car_sort_stats(unsigned &incr, unsigned &full) {city_gen.get_car_sort_stats(incr, full);}
+void set_city_num_peds(unsigned num_peds) {city_params.num_peds = num_peds;} // must be called before gen_city_details()
+unsigned get_city_num_peds() {return city_gen.get_num_peds();}
+float run_ped_sim_bench_frames(unsigned num_frames, unsigned num_threads, bool restore_state, uint64_t &state_hash) {
+	return city_gen.run_ped_sim_frames(num_frames, num_threads, restore_state, state_hash);
+}
 void draw_cities(int shadow_only, int reflection_pass, int trans_op_mask, vector3d const &xlate) {city_gen.draw(shadow_only, reflection_pass, trans_op_mask, xlate);}
 void draw_city_roads(int trans_op_mask, vector3d const &xlate) {city_gen.draw_roads(trans_op_mask, xlate);}
 void setup_city_lights(vector3d const &xlate) {city_gen.setup_city_lights(xlate);}
@@ -0,0 +1,113 @@
+// 3D World - Road Network Routing Tables for Cars
+// by Frank Gennari
+// 10/16/26
+#include "city.h"
+#include <queue>
+#include <cfloat> // for FLT_MAX
+
+extern city_params_t city_params;
+
+
+void road_router_t::clear() {
+	edges.clear();
+	node_edges.clear();
+	seg_ixs.clear();
+	in_edge_start.clear();
+	in_edges.clear();
+	seg_cars.clear();
+	dists.clear();
+	num_nodes = next_dest = 0;
+}
+
+void road_router_t::init(unsigned num_nodes_, unsigned num_segs) {
+	clear();
+	num_nodes = num_nodes_;
+	node_edges.resize(4*num_nodes, -1);
+	seg_cars.resize(num_segs, 0.0);
+}
+
+void road_router_t::add_edge(unsigned src, unsigned dest, unsigned orient, float length, vector<unsigned> const &segs) {
+	assert(src < num_nodes && dest < num_nodes && orient < 4);
+	assert(node_edges[4*src + orient] < 0); // only one edge per orient
+	for (unsigned s : segs) {assert(s < seg_cars.size());}
+	node_edges[4*src + orient] = edges.size();
+	edges.emplace_back(src, dest, seg_ixs.size(), (seg_ixs.size() + segs.size()), length);
+	vector_add_to(segs, seg_ixs);
+}
+
+void road_router_t::finalize() {
+	if (edges.empty()) return;
+	//timer_t timer("Build Road Routing Tables");
+	in_edge_start.clear();
+	in_edge_start.resize(num_nodes+1, 0);
+	for (edge_t const &e : edges) {++in_edge_start[e.dest+1];}
+	for (unsigned n = 0; n < num_nodes; ++n) {in_edge_start[n+1] += in_edge_start[n];}
+	in_edges.resize(edges.size());
+	vector<unsigned> pos(in_edge_start.begin(), in_edge_start.end()-1);
+	for (unsigned i = 0; i < edges.size(); ++i) {in_edges[pos[edges[i].dest]++] = i;}
+	dists.resize(num_nodes*num_nodes);
+	update_edge_costs();
+	for (unsigned d = 0; d < num_nodes; ++d) {calc_dists_to(d);}
+}
+
+void road_router_t::update_edge_costs() {
+	float const car_len(city_params.get_nom_car_size().x), weight(city_params.route_congestion_weight*car_len);
+
+	for (edge_t &e : edges) { // each car on the edge adds route_congestion_weight car lengths of delay
+		float cars(0.0);
+		for (unsigned i = e.segs_start; i < e.segs_end; ++i) {cars += seg_cars[seg_ixs[i]];}
+		e.cost = e.length + weight*cars;
+	}
+}
+
+// Dijkstra's algorithm from dest over the reversed edges
+void road_router_t::calc_dists_to(unsigned dest) {
+	assert(dest < num_nodes);
+	float *const dist(dists.data() + dest*num_nodes);
+	for (unsigned n = 0; n < num_nodes; ++n) {dist[n] = FLT_MAX;}
+	dist[dest] = 0.0;
+	typedef pair<float, unsigned> qval_t;
+	std::priority_queue<qval_t, vector<qval_t>, std::greater<qval_t>> open;
+	open.emplace(0.0, dest);
+
+	while (!open.empty()) {
+		qval_t const cur(open.top());
+		open.pop();
+		if (cur.first > dist[cur.second]) continue; // already reached with a lower cost
+
+		for (unsigned i = in_edge_start[cur.second]; i < in_edge_start[cur.second+1]; ++i) {
+			edge_t const &e(edges[in_edges[i]]);
+			float const d(cur.first + e.cost);
+			if (d < dist[e.src]) {dist[e.src] = d; open.emplace(d, e.src);}
+		}
+	}
+}
+
+// recomputes an even share of the destination tables each frame so that each one is updated once per route_refresh_secs;
+// edge costs are updated from the current congestion at the start of each pass
+void road_router_t::next_frame(float frame_secs) {
+	if (dists.empty()) return;
+	if (next_dest == 0) {update_edge_costs();}
+	unsigned const num_per_frame(max(1U, unsigned(ceil(num_nodes*frame_secs/city_params.route_refresh_secs))));
+	unsigned const end_dest(min(num_nodes, next_dest+num_per_frame));
+	for (; next_dest < end_dest; ++next_dest) {calc_dists_to(next_dest);}
+	if (next_dest == num_nodes) {next_dest = 0;} // start a new pass
+}
+
+int road_router_t::choose_orient(unsigned src, unsigned dest, unsigned valid_mask) const {
+	if (dists.empty() || src >= num_nodes || dest >= num_nodes || src == dest) return -1;
+	float const *const dist(dists.data() + dest*num_nodes);
+	float best_cost(FLT_MAX);
+	int best_orient(-1);
+
+	for (unsigned orient = 0; orient < 4; ++orient) {
+		if (!(valid_mask & (1<<orient))) continue;
+		int const eix(node_edges[4*src + orient]);
+		if (eix < 0) continue; // no edge in this orient
+		edge_t const &e(edges[eix]);
+		if (dist[e.dest] == FLT_MAX) continue; // dest is unreachable
+		float const cost(e.cost + dist[e.dest]);
+		if (cost < best_cost) {best_cost = cost; best_orient = orient;}
+	}
+	return best_orient;
+}
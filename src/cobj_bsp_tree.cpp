@@ -4,14 +4,22 @@
 
 #include "3DWorld.h"
 #include "cobj_bsp_tree.h"
+#include "profiler.h"
+#include <immintrin.h> // SSE/AVX
+#include <omp.h>
 
 
 unsigned const MAX_LEAF_SIZE = 2;
+unsigned const NUM_SAH_BINS  = 16;
+unsigned const MAX_SAH_LEAF_SIZE = 8; // max objects in a leaf when the SAH cost of a leaf is lower than the cost of splitting
+unsigned const SAH_TASK_MIN_OBJS = 4096; // min objects in a node to build its children in parallel
+unsigned const NUM_STATS_LINES   = 10000;
 float const POLY_TOLER       = 1.0E-6;
 float const OVERLAP_AMT      = 0.02;
 
 
-extern bool mt_cobj_tree_build, begin_motion;
+extern bool mt_cobj_tree_build, cobj_tree_soa_nodes, cobj_tree_sah_build, cobj_tree_build_stats, begin_motion;
+extern float cobj_tree_refit_thresh;
 extern int display_mode, frame_counter, cobj_counter;
 extern coll_obj_group coll_objects;
 extern vector<unsigned> falling_cobjs;
@@ -72,6 +80,38 @@ bool cobj_tree_base::check_for_leaf(unsigned num, unsigned skip_dims) {
 	return 0;
 }
 
+void cobj_tree_base::calc_tree_stats() { // for trees built without calling register_leaf(); root next_node_id must be set
+
+	max_depth = max_leaf_count = num_leaf_nodes = 0;
+	vector<unsigned> subtree_ends; // stack of next_node_id values of the ancestors of the current node
+
+	for (unsigned nix = 0; nix < nodes.size(); ++nix) {
+		while (!subtree_ends.empty() && subtree_ends.back() <= nix) {subtree_ends.pop_back();}
+		tree_node const &n(nodes[nix]);
+		max_depth = max(max_depth, (unsigned)subtree_ends.size());
+		if (n.start < n.end) {register_leaf(n.end - n.start);}
+		subtree_ends.push_back(n.next_node_id);
+	}
+}
+
+// returns the average number of node bbox tests for random lines through the tree, not counting early termination due to object hits
+float cobj_tree_base::calc_avg_nodes_visited(unsigned num_lines) const {
+
+	if (nodes.empty() || num_lines == 0) return 0.0;
+	rand_gen_t rgen; // fixed seed so that results are comparable across builds
+	cube_t const &bcube(nodes[0]);
+	float const line_len(bcube.get_size().mag());
+	unsigned const num_nodes((unsigned)nodes.size());
+	unsigned long long num_visited(0);
+
+	for (unsigned i = 0; i < num_lines; ++i) {
+		point const p1(rgen.gen_rand_cube_point(bcube)), p2(p1 + line_len*rgen.signed_rand_vector_norm());
+		node_ix_mgr nixm(nodes, p1, p2);
+		for (unsigned nix = 0; nix < num_nodes; ++num_visited) {nixm.check_node(nix);} // Note: modifies nix
+	}
+	return float(num_visited)/float(num_lines);
+}
+
 
 // performance critical
 template<bool xneg, bool yneg, bool zneg> bool get_line_clip(point const &p1, vector3d const &dinv, float const d[3][2]) {
@@ -204,26 +244,147 @@ template<typename T> void cobj_tree_simple_type_t<T>::build_tree(unsigned nix, u
 }
 
 
-template<typename T> void cobj_tree_simple_type_t<T>::build_tree_top(bool verbose) {
+// builds a binary tree where each split is chosen by binning object centers and minimizing the surface area heuristic cost;
+// the root of the subtree is tnodes[nix]; subtrees with many objects are built in parallel when called from within an OpenMP parallel region
+template<typename T> void cobj_tree_simple_type_t<T>::build_tree_sah(vector<tree_node> &tnodes, unsigned nix) {
+
+	calc_node_bbox(tnodes[nix]);
+	unsigned const start(tnodes[nix].start), end(tnodes[nix].end), num(end - start);
+	if (num <= MAX_LEAF_SIZE) return; // leaf
+	float cmin[3], cmax[3]; // bounds of object centers
+
+	for (unsigned i = start; i < end; ++i) {
+		for (unsigned d = 0; d < 3; ++d) {
+			float const c(0.5f*(get_vlo(objects[i], d) + get_vhi(objects[i], d)));
+			if (i == start) {cmin[d] = cmax[d] = c;} else {cmin[d] = min(cmin[d], c); cmax[d] = max(cmax[d], c);}
+		}
+	}
+	auto get_bin([&](T const &obj, unsigned d) {
+		float const c(0.5f*(get_vlo(obj, d) + get_vhi(obj, d)));
+		return min(NUM_SAH_BINS-1, unsigned(NUM_SAH_BINS*(c - cmin[d])/(cmax[d] - cmin[d])));
+	});
+	float const leaf_cost(tnodes[nix].get_area()*num);
+	float best_cost(0.0);
+	int best_dim(-1);
+	unsigned best_bin(0);
+
+	for (unsigned d = 0; d < 3; ++d) {
+		if (cmax[d] <= cmin[d]) continue; // can't split in this dim
+		unsigned counts[NUM_SAH_BINS] = {}, right_counts[NUM_SAH_BINS] = {};
+		cube_t bin_bcubes[NUM_SAH_BINS];
+		float right_areas[NUM_SAH_BINS] = {};
+
+		for (unsigned i = start; i < end; ++i) {
+			T const &obj(objects[i]);
+			unsigned const bin(get_bin(obj, d));
+			cube_t bc;
+			for (unsigned e = 0; e < 3; ++e) {bc.d[e][0] = get_vlo(obj, e); bc.d[e][1] = get_vhi(obj, e);}
+			if (counts[bin] == 0) {bin_bcubes[bin] = bc;} else {bin_bcubes[bin].union_with_cube(bc);}
+			++counts[bin];
+		}
+		cube_t acc;
+		unsigned acc_count(0);
+
+		for (unsigned b = NUM_SAH_BINS-1; b > 0; --b) { // sweep from the right
+			if (counts[b] > 0) {
+				if (acc_count == 0) {acc = bin_bcubes[b];} else {acc.union_with_cube(bin_bcubes[b]);}
+				acc_count += counts[b];
+			}
+			right_counts[b] = acc_count;
+			right_areas [b] = (acc_count ? acc.get_area() : 0.0f);
+		}
+		acc_count = 0;
+
+		for (unsigned b = 0; b+1 < NUM_SAH_BINS; ++b) { // sweep from the left; split is after bin b
+			if (counts[b] > 0) {
+				if (acc_count == 0) {acc = bin_bcubes[b];} else {acc.union_with_cube(bin_bcubes[b]);}
+				acc_count += counts[b];
+			}
+			if (acc_count == 0 || right_counts[b+1] == 0) continue; // empty side
+			float const cost(acc.get_area()*acc_count + right_areas[b+1]*right_counts[b+1]);
+			if (best_dim < 0 || cost < best_cost) {best_cost = cost; best_dim = d; best_bin = b;}
+		}
+	} // for d
+	if (best_dim < 0) return; // can't split, all object centers are the same
+	if (num <= MAX_SAH_LEAF_SIZE && (tnodes[nix].get_area() + best_cost) >= leaf_cost) return; // splitting doesn't help (traversal cost = 1)
+	auto const mid_it(std::partition((objects.begin() + start), (objects.begin() + end), [&](T const &obj) {return (get_bin(obj, best_dim) <= best_bin);}));
+	unsigned const mid(unsigned(mid_it - objects.begin()));
+	assert(mid > start && mid < end);
+	tnodes[nix].start = tnodes[nix].end = 0; // branch node has no leaves
+	unsigned const ranges[2][2] = {{start, mid}, {mid, end}};
+
+	if (num >= SAH_TASK_MIN_OBJS && omp_in_parallel()) { // build both children in parallel into their own node vectors, then append them
+		vector<tree_node> kids[2];
+
+		for (unsigned k = 0; k < 2; ++k) {
+			kids[k].push_back(tree_node(ranges[k][0], ranges[k][1]));
+#pragma omp task shared(kids) firstprivate(k)
+			build_tree_sah(kids[k], 0);
+		}
+#pragma omp taskwait
+		for (unsigned k = 0; k < 2; ++k) {
+			unsigned const base((unsigned)tnodes.size());
+			kids[k][0].next_node_id = (unsigned)kids[k].size();
+			for (tree_node &n : kids[k]) {n.next_node_id += base; tnodes.push_back(n);}
+		}
+	}
+	else {
+		for (unsigned k = 0; k < 2; ++k) { // Note: this loop will invalidate references into tnodes
+			unsigned const kid((unsigned)tnodes.size());
+			tnodes.push_back(tree_node(ranges[k][0], ranges[k][1]));
+			build_tree_sah(tnodes, kid);
+			tnodes[kid].next_node_id = (unsigned)tnodes.size();
+		}
+	}
+}
 
+
+template<typename T> void cobj_tree_simple_type_t<T>::build_tree_top_int(bool use_sah) {
+
+	cobj_tree_base::clear();
 	nodes.reserve(get_conservative_num_nodes(objects.size()));
 	nodes.push_back(tree_node(0, (unsigned)objects.size()));
 	assert(nodes.size() == 1);
 	max_depth = max_leaf_count = num_leaf_nodes = 0;
-	if (!objects.empty()) {build_tree(0, 0, 0);}
+
+	if (use_sah && !objects.empty()) {
+#pragma omp parallel if (objects.size() >= 4*SAH_TASK_MIN_OBJS)
+#pragma omp single
+		build_tree_sah(nodes, 0);
+	}
+	else if (!objects.empty()) {build_tree(0, 0, 0);}
 	nodes[0].next_node_id = (unsigned)nodes.size();
+	if (use_sah) {calc_tree_stats();}
 	for (unsigned i = 0; i < 3; ++i) {vector<T>().swap(temp_bins[i]);}
+}
+
+template<typename T> void cobj_tree_simple_type_t<T>::build_tree_top(bool verbose) {
+
+	build_tree_top_int(cobj_tree_sah_build);
 
 	if (verbose) {
 		cout << "objects: " << objects.size() << ", cap: " << objects.capacity() << ", nodes: " << nodes.size() << ", cap: " << nodes.capacity()
 			 << ", depth: " << max_depth << ", max_leaf: " << max_leaf_count << ", leaf_nodes: " << num_leaf_nodes << endl;
 	}
+	if (verbose && cobj_tree_build_stats && !objects.empty()) { // compare with the other build method, then restore this tree
+		float const nodes_per_line(calc_avg_nodes_visited(NUM_STATS_LINES));
+		vector<T> const objects_copy(objects);
+		vector<tree_node> nodes_copy(nodes);
+		build_tree_top_int(!cobj_tree_sah_build);
+		float const other_nodes_per_line(calc_avg_nodes_visited(NUM_STATS_LINES));
+		float const mid_val(cobj_tree_sah_build ? other_nodes_per_line : nodes_per_line), sah_val(cobj_tree_sah_build ? nodes_per_line : other_nodes_per_line);
+		cout << "avg nodes visited per line: midpoint split: " << mid_val << ", SAH: " << sah_val << endl;
+		objects = objects_copy;
+		nodes.swap(nodes_copy);
+		calc_tree_stats();
+	}
 }
 
 // explicit instantiations
 struct colored_cube_t;
 template class cobj_tree_simple_type_t<sphere_with_id_t>;
 template class cobj_tree_simple_type_t<colored_cube_t>;
+template class cobj_tree_simple_type_t<cube_with_ix_t>;
 
 
 // *** cobj_tree_tquads_t ***
@@ -375,6 +536,9 @@ void cobj_bvh_tree::clear() {
 
 	cobj_tree_base::clear();
 	cixs.resize(0);
+	build_cids.clear();
+	build_sah_cost = 0.0; // disables refit until the next build_or_refit() call
+	soa_nodes.clear();
 }
 
 
@@ -398,6 +562,7 @@ void cobj_bvh_tree::add_cobjs(bool verbose) {
 void cobj_bvh_tree::build_tree_from_cixs(bool do_mt_build) {
 
 	max_depth = max_leaf_count = num_leaf_nodes = 0;
+	built_mt  = do_mt_build; // MT builds may leave unused nodes, which can't be refit
 	nodes.resize(get_conservative_num_nodes(cixs.size()) + 64*do_mt_build); // add 8 extra nodes for each of 8 top level splits
 	unsigned const root(0);
 	nodes[root] = tree_node(0, (unsigned)cixs.size());
@@ -411,6 +576,56 @@ void cobj_bvh_tree::build_tree_from_cixs(bool do_mt_build) {
 		nodes.resize(ptd.get_next_node_ix());
 	}
 	nodes[root].next_node_id = (unsigned)nodes.size();
+	if (cobj_tree_soa_nodes) {build_soa_nodes();} else {soa_nodes.clear();}
+}
+
+
+// rebuilds the tree from cids, or refits the existing tree if cids are the same as the last build and the surface area heuristic cost
+// of the refit tree is no more than max_sah_cost_ratio times the cost after the last rebuild; max_sah_cost_ratio=0 always rebuilds
+void cobj_bvh_tree::build_or_refit(vector<unsigned> const &cids, float max_sah_cost_ratio) {
+
+	bool const profile(is_timing_profiler_enabled());
+
+	if (max_sah_cost_ratio > 0.0 && build_sah_cost > 0.0 && !built_mt && cids == build_cids) {
+		highres_timer_t timer("Cobj BVH Refit", profile);
+		refit();
+		if (calc_sah_cost() <= max_sah_cost_ratio*build_sah_cost) return; // refit tree is good enough
+	}
+	clear();
+	if (cids.empty()) return;
+	highres_timer_t timer("Cobj BVH Rebuild", profile);
+	add_cobj_ids(cids);
+	build_tree_from_cixs(0);
+	build_cids     = cids;
+	build_sah_cost = calc_sah_cost();
+}
+
+// updates node bboxes bottom-up for cobjs that have moved, without changing the tree structure
+void cobj_bvh_tree::refit() {
+
+	assert(!built_mt);
+
+	for (unsigned nix = (unsigned)nodes.size(); nix-- > 0;) { // children come after their parent, so iterate in reverse
+		tree_node &n(nodes[nix]);
+		if (n.start < n.end) {calc_node_bbox(n); continue;} // leaf
+
+		for (unsigned kid = nix+1; kid < n.next_node_id; kid = nodes[kid].next_node_id) { // branch: union of children
+			assert(nodes[kid].next_node_id > kid);
+			if (kid == nix+1) {n.copy_from(nodes[kid]);} else {n.union_with_cube(nodes[kid]);}
+		}
+	}
+	if (!soa_nodes.empty()) {build_soa_nodes();}
+}
+
+// expected cost of a random line query relative to a single root bbox test: node tests plus cobj tests, weighted by the probability of hitting each node
+float cobj_bvh_tree::calc_sah_cost() const {
+
+	if (nodes.empty()) return 0.0;
+	float const root_area(nodes[0].get_area());
+	if (root_area <= 0.0) return 0.0;
+	float cost(0.0);
+	for (auto n = nodes.begin(); n != nodes.end(); ++n) {cost += n->get_area()*(1.0 + (n->end - n->start));}
+	return cost/root_area;
 }
 
 
@@ -433,14 +648,8 @@ bool cobj_bvh_tree::check_coll_line(point const &p1, point const &p2, point &cpo
 			// Note: we probably don't need to return cnorm and cpos in inexact mode, but it shouldn't be too expensive to do so
 			if ((int)cixs[i] == ignore_cobj) continue;
 			coll_obj const &c(get_cobj(i));
-			if (!obj_ok(c))                  continue;
-			if (skip_non_drawn  && !c.cp.might_be_drawn())                    continue;
-			if (skip_movable    && c.is_movable())                            continue;
-			if (test_alpha == 1 && c.is_semi_trans())                         continue; // semi-transparent, can see through
-			if (test_alpha == 2 && c.cp.color.alpha <= max_alpha)             continue; // lower alpha than an earlier object
-			if (test_alpha == 3 && c.cp.color.alpha < MIN_SHADOW_ALPHA)       continue; // less than min alpha
-			if (skip_init_colls && c.contains_pt(p1) && c.contains_point(p1)) continue;
-			if (!c.line_int_exact(p1, p2, t, cnorm, tmin, tmax))              continue;
+			if (!line_cobj_ok(c, p1, test_alpha, max_alpha, skip_non_drawn, skip_init_colls, skip_movable)) continue;
+			if (!c.line_int_exact(p1, p2, t, cnorm, tmin, tmax)) continue;
 			cindex = cixs[i];
 			cpos   = p1 + (p2 - p1)*t;
 			//if (c.type == COLL_POLYGON && dot_product((p2 - p1), c.norm) < 0.0) {} // back-facing polygon test
@@ -456,6 +665,204 @@ bool cobj_bvh_tree::check_coll_line(point const &p1, point const &p2, point &cpo
 }
 
 
+// *** batched line queries ***
+
+
+line_packet_t::line_packet_t(unsigned num_, point const *const p1, point const *const p2) : num(num_) {
+
+	assert(num > 0 && num <= LINE_PACKET_SIZE);
+
+	for (unsigned i = 0; i < LINE_PACKET_SIZE; ++i) {
+		if (i < num) {
+			vector3d d(p2[i] - p1[i]);
+			d.invert();
+			UNROLL_3X(org[i_][i] = p1[i][i_]; dinv[i_][i] = d[i_];)
+			tmax[i] = 1.0;
+		}
+		else { // unused
+			UNROLL_3X(org[i_][i] = 0.0; dinv[i_][i] = 1.0;)
+			disable(i);
+		}
+	}
+}
+
+// performance critical; returns a bitmask of the lines in the packet that intersect the bbox {lo, hi};
+// same as get_line_clip(), but uses min/max rather than templates to handle the sign of each line's direction
+inline unsigned get_packet_line_clip(line_packet_t const &pk, float const lo[3], float const hi[3]) {
+#ifdef __AVX__ // 8-wide
+	__m256 tmin(_mm256_setzero_ps()), tmax(_mm256_loadu_ps(pk.tmax));
+
+	for (unsigned d = 0; d < 3; ++d) {
+		__m256 const org(_mm256_loadu_ps(pk.org[d])), dinv(_mm256_loadu_ps(pk.dinv[d]));
+		__m256 const t1(_mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(lo[d]), org), dinv)), t2(_mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(hi[d]), org), dinv));
+		tmin = _mm256_max_ps(tmin, _mm256_min_ps(t1, t2));
+		tmax = _mm256_min_ps(tmax, _mm256_max_ps(t1, t2));
+	}
+	return _mm256_movemask_ps(_mm256_cmp_ps(tmin, tmax, _CMP_LT_OQ));
+#else // 4-wide SSE
+	unsigned mask(0);
+
+	for (unsigned n = 0; n < LINE_PACKET_SIZE; n += 4) {
+		__m128 tmin(_mm_setzero_ps()), tmax(_mm_loadu_ps(pk.tmax + n));
+
+		for (unsigned d = 0; d < 3; ++d) {
+			__m128 const org(_mm_loadu_ps(pk.org[d] + n)), dinv(_mm_loadu_ps(pk.dinv[d] + n));
+			__m128 const t1(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(lo[d]), org), dinv)), t2(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(hi[d]), org), dinv));
+			tmin = _mm_max_ps(tmin, _mm_min_ps(t1, t2));
+			tmax = _mm_min_ps(tmax, _mm_max_ps(t1, t2));
+		}
+		mask |= (_mm_movemask_ps(_mm_cmplt_ps(tmin, tmax)) << n);
+	}
+	return mask;
+#endif
+}
+
+void cobj_bvh_tree::soa_nodes_t::clear() {
+
+	for (unsigned d = 0; d < 3; ++d) {lo[d].clear(); hi[d].clear();}
+	start.clear();
+	end.clear();
+	next_node_id.clear();
+}
+
+void cobj_bvh_tree::build_soa_nodes() {
+
+	unsigned const num_nodes((unsigned)nodes.size());
+	for (unsigned d = 0; d < 3; ++d) {soa_nodes.lo[d].resize(num_nodes); soa_nodes.hi[d].resize(num_nodes);}
+	soa_nodes.start.resize(num_nodes);
+	soa_nodes.end.resize(num_nodes);
+	soa_nodes.next_node_id.resize(num_nodes);
+
+	for (unsigned nix = 0; nix < num_nodes; ++nix) {
+		tree_node const &n(nodes[nix]);
+		UNROLL_3X(soa_nodes.lo[i_][nix] = n.d[i_][0]; soa_nodes.hi[i_][nix] = n.d[i_][1];)
+		soa_nodes.start[nix] = n.start;
+		soa_nodes.end  [nix] = n.end;
+		soa_nodes.next_node_id[nix] = n.next_node_id;
+	}
+}
+
+// same as check_coll_line(), but traverses the tree once for a packet of lines; pk is modified; returns a bitmask of the lines that hit a cobj
+template<bool USE_SOA> unsigned cobj_bvh_tree::check_coll_line_packet_int(line_packet_t &pk, point const *const p1, point const *const p2, point *cpos, vector3d *cnorm,
+	int *cindex, int ignore_cobj, bool exact, int test_alpha, bool skip_non_drawn, bool skip_init_colls, bool skip_movable) const
+{
+	unsigned const num_nodes((unsigned)nodes.size()), all_mask((1U << pk.num) - 1);
+	unsigned hit_mask(0), done_mask(0);
+	float max_alpha[LINE_PACKET_SIZE] = {}, lo[3], hi[3];
+
+	for (unsigned nix = 0; nix < num_nodes;) {
+		unsigned start(0), end(0), next_node_id(0);
+
+		if (USE_SOA) {
+			UNROLL_3X(lo[i_] = soa_nodes.lo[i_][nix]; hi[i_] = soa_nodes.hi[i_][nix];)
+			start = soa_nodes.start[nix]; end = soa_nodes.end[nix]; next_node_id = soa_nodes.next_node_id[nix];
+		}
+		else {
+			tree_node const &n(nodes[nix]);
+			UNROLL_3X(lo[i_] = n.d[i_][0]; hi[i_] = n.d[i_][1];)
+			start = n.start; end = n.end; next_node_id = n.next_node_id;
+		}
+		unsigned const mask(get_packet_line_clip(pk, lo, hi));
+
+		if (!mask) { // failed the bbox test for all lines
+			assert(next_node_id > nix);
+			nix = next_node_id;
+			continue;
+		}
+		++nix;
+
+		for (unsigned i = start; i < end; ++i) { // check leaves
+			if ((int)cixs[i] == ignore_cobj) continue;
+			coll_obj const &c(get_cobj(i));
+
+			for (unsigned l = 0; l < pk.num; ++l) {
+				unsigned const bit(1U << l);
+				if (!(mask & bit) || (done_mask & bit)) continue;
+				if (!line_cobj_ok(c, p1[l], test_alpha, max_alpha[l], skip_non_drawn, skip_init_colls, skip_movable)) continue;
+				float t(0.0);
+				vector3d norm;
+				if (!c.line_int_exact(p1[l], p2[l], t, norm, 0.0, pk.tmax[l])) continue;
+				cindex[l] = cixs[i];
+				cpos  [l] = p1[l] + (p2[l] - p1[l])*t;
+				cnorm [l] = norm;
+				hit_mask |= bit;
+				if (!exact && test_alpha != 2) {done_mask |= bit; pk.disable(l); continue;} // first hit
+				max_alpha[l] = c.cp.color.alpha; // we need all intersections to find the max alpha
+				pk.tmax[l] = t; // clip the line to the hit pos
+			} // for l
+		} // for i
+		if (done_mask == all_mask) break; // all lines are done
+	} // for nix
+	return hit_mask;
+}
+
+// batched version of check_coll_line() for up to LINE_PACKET_SIZE lines; returns a bitmask of the lines that hit a cobj
+unsigned cobj_bvh_tree::check_coll_line_packet(unsigned num, point const *const p1, point const *const p2, point *cpos, vector3d *cnorm, int *cindex,
+	int ignore_cobj, bool exact, int test_alpha, bool skip_non_drawn, bool skip_init_colls, bool skip_movable) const
+{
+	if (nodes.empty() || num == 0) return 0;
+	line_packet_t pk(num, p1, p2);
+	if (!soa_nodes.empty()) {return check_coll_line_packet_int<1>(pk, p1, p2, cpos, cnorm, cindex, ignore_cobj, exact, test_alpha, skip_non_drawn, skip_init_colls, skip_movable);}
+	return check_coll_line_packet_int<0>(pk, p1, p2, cpos, cnorm, cindex, ignore_cobj, exact, test_alpha, skip_non_drawn, skip_init_colls, skip_movable);
+}
+
+inline unsigned count_bits(unsigned mask) {
+	unsigned count(0);
+	for (; mask; mask &= (mask - 1)) {++count;}
+	return count;
+}
+
+// compares lines/sec for the scalar, packet, and packet + SoA nodes line query paths
+void cobj_bvh_tree::run_line_query_benchmark(unsigned num_lines, bool exact) {
+
+	if (nodes.empty()) return;
+	num_lines = LINE_PACKET_SIZE*max(1U, num_lines/LINE_PACKET_SIZE); // round to a whole number of packets
+	rand_gen_t rgen; // fixed seed so that results are repeatable
+	cube_t const &bcube(nodes[0]);
+	float const line_len(0.5*bcube.get_size().mag());
+	vector<point> p1(num_lines), p2(num_lines), cpos(num_lines);
+	vector<vector3d> cnorm(num_lines);
+	vector<int> cindex(num_lines);
+
+	for (unsigned i = 0; i < num_lines; i += LINE_PACKET_SIZE) { // lines in a packet share an origin and have similar directions, as for light rays
+		point const origin(rgen.gen_rand_cube_point(bcube));
+		vector3d const dir(rgen.signed_rand_vector_norm());
+
+		for (unsigned j = i; j < i+LINE_PACKET_SIZE; ++j) {
+			p1[j] = origin;
+			p2[j] = origin + line_len*(dir + rgen.signed_rand_vector(0.05)).get_norm();
+		}
+	}
+	bool const had_soa_nodes(!soa_nodes.empty());
+	if (!had_soa_nodes) {build_soa_nodes();}
+	char const *const mode_names[3] = {"scalar", "packet", "packet+SoA"};
+	unsigned num_hits[3] = {};
+	cout << "Cobj line query benchmark (" << (exact ? "closest" : "any") << " hit): " << num_lines << " lines, " << cixs.size() << " cobjs, " << nodes.size() << " nodes" << endl;
+
+	for (unsigned mode = 0; mode < 3; ++mode) {
+		for (int &cix : cindex) {cix = -1;}
+		auto const start(high_resolution_clock::now());
+
+		if (mode == 0) {
+			for (unsigned i = 0; i < num_lines; ++i) {num_hits[mode] += check_coll_line(p1[i], p2[i], cpos[i], cnorm[i], cindex[i], -1, exact, 0, 0, 0, 0);}
+		}
+		else {
+			for (unsigned i = 0; i < num_lines; i += LINE_PACKET_SIZE) {
+				line_packet_t pk(LINE_PACKET_SIZE, &p1[i], &p2[i]);
+				unsigned const hit_mask((mode == 2) ?
+					check_coll_line_packet_int<1>(pk, &p1[i], &p2[i], &cpos[i], &cnorm[i], &cindex[i], -1, exact, 0, 0, 0, 0) :
+					check_coll_line_packet_int<0>(pk, &p1[i], &p2[i], &cpos[i], &cnorm[i], &cindex[i], -1, exact, 0, 0, 0, 0));
+				num_hits[mode] += count_bits(hit_mask);
+			}
+		}
+		float const time_ms(1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - start).count());
+		cout << "  " << mode_names[mode] << ": " << time_ms << "ms, " << (1000.0f*num_lines/max(time_ms, 0.001f)) << " lines/s, hits: " << num_hits[mode] << endl;
+	} // for mode
+	if (num_hits[1] != num_hits[0] || num_hits[2] != num_hits[0]) {cout << "Warning: packet line query hits differ from scalar hits" << endl;}
+	if (!had_soa_nodes) {soa_nodes.clear();}
+}
+
+
 bool cobj_bvh_tree::check_point_contained(point const &p, int &cindex) const {
 
 	unsigned const num_nodes((unsigned)nodes.size());
@@ -743,7 +1150,6 @@ cobj_bvh_tree &get_tree(bool dynamic) {
 
 void build_static_moving_cobj_tree() {
 
-	cobj_tree_static_moving.clear();
 	vector<unsigned> moving_cids(falling_cobjs);
 		
 	for (auto i = moving_cobjs.begin(); i != moving_cobjs.end(); ++i) {
@@ -752,10 +1158,7 @@ void build_static_moving_cobj_tree() {
 	for (platform_cont::const_iterator i = platforms.begin(); i != platforms.end(); ++i) {
 		copy(i->cobjs.begin(), i->cobjs.end(), back_inserter(moving_cids));
 	}
-	if (!moving_cids.empty()) {
-		cobj_tree_static_moving.add_cobj_ids(moving_cids);
-		cobj_tree_static_moving.build_tree_from_cixs(0);
-	}
+	cobj_tree_static_moving.build_or_refit(moving_cids, cobj_tree_refit_thresh); // refit if the same cobjs are moving as last frame
 }
 
 void build_cobj_tree(bool dynamic, bool verbose) {
@@ -797,6 +1200,31 @@ bool check_coll_line_tree(point const &p1, point const &p2, int &cindex, int ign
 	return 0;
 }
 
+// batched version of check_coll_line_tree() for static cobjs using line packets; sets cindex[i] to the first cobj hit by line i, or -1; doesn't check voxels
+void check_coll_line_batch_tree(unsigned num, point const *const p1, point const *const p2, int *cindex, int ignore_cobj, int test_alpha, bool skip_non_drawn) {
+
+	point cpos[LINE_PACKET_SIZE]; // unused
+	vector3d cnorm[LINE_PACKET_SIZE]; // unused
+	int cindex2[LINE_PACKET_SIZE];
+	for (unsigned i = 0; i < num; ++i) {cindex[i] = -1;}
+
+	for (unsigned s = 0; s < num; s += LINE_PACKET_SIZE) {
+		unsigned const n(min(LINE_PACKET_SIZE, (num - s)));
+		unsigned const hit_mask(get_tree(0).check_coll_line_packet(n, (p1 + s), (p2 + s), cpos, cnorm, (cindex + s), ignore_cobj, 0, test_alpha, skip_non_drawn, 0, 0));
+		if (hit_mask == ((1U << n) - 1) || cobj_tree_static_moving.is_empty()) continue; // all lines hit
+		unsigned const hit_mask2(cobj_tree_static_moving.check_coll_line_packet(n, (p1 + s), (p2 + s), cpos, cnorm, cindex2, ignore_cobj, 0, test_alpha, skip_non_drawn, 0, 0));
+
+		for (unsigned i = 0; i < n; ++i) {
+			if (!(hit_mask & (1U << i)) && (hit_mask2 & (1U << i))) {cindex[s + i] = cindex2[i];}
+		}
+	}
+}
+
+void run_cobj_tree_line_query_benchmark(unsigned num_lines) {
+	get_tree(0).run_line_query_benchmark(num_lines, 0); // any hit, as for shadow rays
+	get_tree(0).run_line_query_benchmark(num_lines, 1); // closest hit, as for lighting rays
+}
+
 // used in destroy_cobj for cobj destroy/modification and connected/anchoring tests
 void get_intersecting_cobjs_tree(cube_t const &cube, vector<unsigned> &cobjs, int ignore_cobj, float toler,
 	bool dynamic, bool check_ccounter, int id_for_cobj_int)
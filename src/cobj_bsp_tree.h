@@ -5,6 +5,16 @@
 
 #include "physics_objects.h"
 
+unsigned const LINE_PACKET_SIZE = 8; // max number of lines in a batched line query; must be a multiple of 4
+
+
+struct line_packet_t { // SoA line data for batched line queries
+	float org[3][LINE_PACKET_SIZE], dinv[3][LINE_PACKET_SIZE], tmax[LINE_PACKET_SIZE];
+	unsigned num;
+	line_packet_t(unsigned num_, point const *const p1, point const *const p2);
+	void disable(unsigned i) {tmax[i] = -1.0;} // line no longer intersects anything
+};
+
 
 class cobj_tree_base {
 
@@ -28,6 +38,7 @@ protected:
 	}
 	bool check_for_leaf(unsigned num, unsigned skip_dims);
 	unsigned get_conservative_num_nodes(unsigned num) const {return (3*num/2 + 8);}
+	void calc_tree_stats();
 
 	struct node_ix_mgr {
 		point const p1, p2;
@@ -44,6 +55,7 @@ public:
 	bool is_empty() const {return nodes.empty();}
 	void clear() {nodes.resize(0);}
 	bool get_root_bcube(cube_t &bc) const;
+	float calc_avg_nodes_visited(unsigned num_lines) const;
 };
 
 
@@ -54,6 +66,8 @@ protected:
 
 	virtual void calc_node_bbox(tree_node &n) const = 0;
 	void build_tree(unsigned nix, unsigned skip_dims, unsigned depth);
+	void build_tree_sah(vector<tree_node> &tnodes, unsigned nix);
+	void build_tree_top_int(bool use_sah);
 
 public:
 	virtual ~cobj_tree_simple_type_t() {}
@@ -107,8 +121,9 @@ public:
 class cobj_bvh_tree : public cobj_tree_base {
 
 	coll_obj_group const *cobjs;
-	vector<unsigned> cixs;
-	bool is_static, is_dynamic, occluders_only, cubes_only, inc_voxel_cobjs;
+	vector<unsigned> cixs, build_cids; // build_cids are the input cobj IDs of the last build_or_refit() call
+	float build_sah_cost;
+	bool is_static, is_dynamic, occluders_only, cubes_only, inc_voxel_cobjs, built_mt;
 
 	struct per_thread_data {
 		vector<unsigned> temp_bins[3];
@@ -125,27 +140,55 @@ class cobj_bvh_tree : public cobj_tree_base {
 	void add_cobj(unsigned ix) {if (obj_ok((*cobjs)[ix])) {cixs.push_back(ix);}}
 	coll_obj const &get_cobj(unsigned ix) const {return (*cobjs)[cixs[ix]];}
 	bool create_cixs();
+
+	struct soa_nodes_t { // optional structure-of-arrays copy of the nodes, used for batched line queries
+		vector<float> lo[3], hi[3];
+		vector<unsigned> start, end, next_node_id;
+		bool empty() const {return next_node_id.empty();}
+		void clear();
+	};
+	soa_nodes_t soa_nodes;
+
 	void calc_node_bbox(tree_node &n) const;
 	void build_tree_top_level_omp();
 	void build_tree(unsigned nix, unsigned skip_dims, unsigned depth, per_thread_data &ptd);
+	template<bool USE_SOA> unsigned check_coll_line_packet_int(line_packet_t &pk, point const *const p1, point const *const p2, point *cpos, vector3d *cnorm,
+		int *cindex, int ignore_cobj, bool exact, int test_alpha, bool skip_non_drawn, bool skip_init_colls, bool skip_movable) const;
 
 	bool obj_ok(coll_obj const &c) const {
 		return (((is_static && c.status == COLL_STATIC) || (is_dynamic && c.status == COLL_DYNAMIC) || (!is_static && !is_dynamic)) &&
 			(!occluders_only || c.is_occluder()) && !(c.cp.flags & COBJ_NO_COLL) && (!cubes_only || c.type == COLL_CUBE) &&
 			(inc_voxel_cobjs || c.cp.cobj_type != COBJ_TYPE_VOX_TERRAIN));
 	}
+	bool line_cobj_ok(coll_obj const &c, point const &p1, int test_alpha, float max_alpha, bool skip_non_drawn, bool skip_init_colls, bool skip_movable) const {
+		if (!obj_ok(c))                  return 0;
+		if (skip_non_drawn  && !c.cp.might_be_drawn())                    return 0;
+		if (skip_movable    && c.is_movable())                            return 0;
+		if (test_alpha == 1 && c.is_semi_trans())                         return 0; // semi-transparent, can see through
+		if (test_alpha == 2 && c.cp.color.alpha <= max_alpha)             return 0; // lower alpha than an earlier object
+		if (test_alpha == 3 && c.cp.color.alpha < MIN_SHADOW_ALPHA)       return 0; // less than min alpha
+		if (skip_init_colls && c.contains_pt(p1) && c.contains_point(p1)) return 0;
+		return 1;
+	}
 
 public:
 	cobj_bvh_tree(coll_obj_group const *cobjs_, bool s, bool d, bool o, bool c, bool v)
-		: cobjs(cobjs_), is_static(s), is_dynamic(d), occluders_only(o), cubes_only(c), inc_voxel_cobjs(v) {assert(cobjs);}
+		: cobjs(cobjs_), build_sah_cost(0.0), is_static(s), is_dynamic(d), occluders_only(o), cubes_only(c), inc_voxel_cobjs(v), built_mt(0) {assert(cobjs);}
 
 	unsigned get_num_objs() const {return cixs.size();}
 	void clear();
 	void add_cobj_ids(vector<unsigned> const &cids) {assert(cixs.empty() && !cids.empty()); cixs = cids;}
 	void add_cobjs(bool verbose);
 	void build_tree_from_cixs(bool do_mt_build);
+	void build_or_refit(vector<unsigned> const &cids, float max_sah_cost_ratio);
+	void refit();
+	float calc_sah_cost() const;
 	bool check_coll_line(point const &p1, point const &p2, point &cpos, vector3d &cnorm, int &cindex, int ignore_cobj,
 		bool exact, int test_alpha, bool skip_non_drawn, bool skip_init_colls, bool skip_movable) const;
+	unsigned check_coll_line_packet(unsigned num, point const *const p1, point const *const p2, point *cpos, vector3d *cnorm, int *cindex, int ignore_cobj,
+		bool exact, int test_alpha, bool skip_non_drawn, bool skip_init_colls, bool skip_movable) const;
+	void build_soa_nodes();
+	void run_line_query_benchmark(unsigned num_lines, bool exact);
 	bool check_point_contained(point const &p, int &cindex) const;
 	void get_intersecting_cobjs(cube_t const &cube, vector<unsigned> &cobjs, int ignore_cobj, float toler, bool check_ccounter, int id_for_cobj_int) const;
 	bool is_cobj_contained(point const &viewer, point const *const pts, unsigned npts, int ignore_cobj, int &cobj) const;
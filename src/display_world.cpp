@@ -7,6 +7,8 @@
 #include "timetest.h"
 #include "physics_objects.h"
 #include "model3d.h"
+#include "profiler.h"
+#include "telemetry.h"
 #include <fstream>
 
 
@@ -334,6 +336,8 @@ void final_draw(float framerate) {
 
 void swap_buffers_and_redraw() {
 	glutSwapBuffers();
+	trace_profiler_end_frame();
+	sample_telemetry();
 	if (animate) {post_window_redisplay();} // before glutSwapBuffers()?
 }
 
@@ -775,6 +779,7 @@ void begin_loading_screen() {
 
 void display() {
 
+	trace_zone_t const zone("Display");
 	check_gl_error(0);
 	static unsigned counter(0);
 	//if (counter <= 120) {cout << "frame " << counter << " time " << GET_TIME_MS() << "ms" << endl;} // TESTING: 26s for config_heightmap with people+cars
@@ -1220,6 +1225,7 @@ void run_tt_gameplay() {
 
 
 void draw_tiled_terrain_and_transparent_geom(float terrain_zmin, unsigned tt_reflection_tid, bool draw_water, bool camera_above_clouds) {
+	trace_zone_t const zone("Draw Tiled Terrain");
 	draw_tiled_terrain(0);
 	render_tt_models(0, 1); // transparent pass
 	//if (underwater ) {draw_local_precipitation();}
@@ -1242,6 +1248,7 @@ void display_inf_terrain() { // infinite terrain mode (Note: uses light params f
 	static int init_xx(1);
 	RESET_TIME;
 	//timer_t timer("Display Inf Terrain"); // 6.9 no update / 10.6 1-thread / 8.0 2-threads / 7.6 3-threads
+	trace_zone_t const zone("Display Inf Terrain");
 
 	if (init_x || init_xx) {
 		init_xx  = 0;
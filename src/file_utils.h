@@ -21,6 +21,7 @@ inline bool read_double(FILE *fp, double   &val) {return (fscanf(fp, "%lf",  &va
 inline bool read_str   (FILE *fp, char     *val) {return (fscanf(fp, "%255s", val) == 1);}
 
 inline bool check_file_exists(std::string const &fn) {return std::ifstream(fn).good();}
+inline uint64_t get_file_size(std::string const &fn) {std::ifstream in(fn, std::ios::binary | std::ios::ate); return (in.good() ? (uint64_t)in.tellg() : 0);}
 
 inline unsigned read_binary_uint(FILE *fp) {
 	unsigned v(0);
@@ -281,6 +281,8 @@ void end_tiled_terrain_lightning();
 void draw_tiled_terrain_clouds(bool reflection_pass);
 void draw_tiled_terrain_decid_tree_shadows();
 void clear_tiled_terrain(bool no_regen_buildings=0);
+void flush_tiled_terrain_cache();
+void print_tiled_terrain_cache_stats();
 void reset_tiled_terrain_state();
 void clear_tiled_terrain_shaders();
 float get_tiled_terrain_water_level();
@@ -462,6 +464,8 @@ bool check_coll_line_exact_tree(point const &p1, point const &p2, point &cpos, v
 	bool dynamic=0, int test_alpha=0, bool skip_non_drawn=0, bool include_voxels=1, bool skip_init_colls=0, bool skip_movable=0, bool no_stat_moving=0);
 bool check_coll_line_tree(point const &p1, point const &p2, int &cindex, int ignore_cobj, bool dynamic=0, int test_alpha=0,
 	bool skip_non_drawn=0, bool include_voxels=1, bool skip_init_colls=0, bool skip_movable=0);
+void check_coll_line_batch_tree(unsigned num, point const *const p1, point const *const p2, int *cindex, int ignore_cobj, int test_alpha=0, bool skip_non_drawn=0);
+void run_cobj_tree_line_query_benchmark(unsigned num_lines);
 bool cobj_contained_tree(point const &viewer, point const *const pts, unsigned npts, int ignore_cobj, int &cobj);
 void get_coll_line_cobjs_tree(point const &pos1, point const &pos2, int ignore_cobj,
 	vector<int> *cobjs, cobj_query_callback *cqc, bool dynamic, bool occlude, bool do_expand);
@@ -614,6 +618,8 @@ unsigned get_loaded_textures_gpu_mem();
 int texture_lookup(std::string const &name);
 int get_texture_by_name(std::string const &name, bool is_normal_map=0, bool invert_y=0, int wrap_mir=1, float aniso=0.0,
 	bool allow_compress=1, int use_mipmaps=1, unsigned ncolors=3, bool is_alpha_mask=0);
+void set_texture_load_disabled_for_thread(bool disabled);
+bool texture_load_was_skipped();
 unsigned load_cube_map_texture(std::string const &name);
 bool select_texture(int id, unsigned tu_id=0);
 void update_player_bbb_texture(float extra_blood, bool recreate);
@@ -636,6 +642,7 @@ colorRGBA texture_color(int tid);
 unsigned get_texture_size(int tid, bool dim);
 void get_lum_alpha(colorRGBA const &color, int tid, float &luminance, float &alpha);
 bool check_texture_file_exists(std::string const &filename);
+void print_texture_decode_cache_stats();
 std::string get_file_extension(std::string const &filename, unsigned level=0, bool make_lower=0);
 void gen_building_window_texture(float width_frac, float height_frac);
 unsigned get_noise_tex_3d(unsigned tsize, unsigned ncomp, unsigned bytes_per_pixel=1);
@@ -1036,6 +1043,7 @@ int create_buildings_tile(int x, int y, bool allow_flatten);
 bool remove_buildings_tile(int x, int y);
 void free_building_indir_texture();
 void end_building_rt_job();
+void print_building_indir_cache_stats();
 
 // function prototypes - csg
 void expand_cubes_by_xy(vect_cube_t &cubes, float val);
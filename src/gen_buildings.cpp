@@ -12,7 +12,9 @@
 #include "tree_3dw.h" // for tree_placer_t
 #include "profiler.h"
 #include "shadow_map.h" // for get_empty_smap_tid
+#include "cobj_bsp_tree.h" // for building_bvh_t
 #include "lightmap.h" // for light_source
+#include <atomic>
 
 using std::string;
 
@@ -29,7 +31,7 @@ building_params_t global_building_params;
 building_t const *player_building(nullptr);
 
 extern bool start_in_inf_terrain, draw_building_interiors, flashlight_on, enable_use_temp_vbo, toggle_room_light;
-extern bool teleport_to_screenshot, enable_dlight_bcubes, can_do_building_action;
+extern bool teleport_to_screenshot, enable_dlight_bcubes, can_do_building_action, headless_mode;
 extern unsigned room_mirror_ref_tid;
 extern int rand_gen_index, display_mode, window_width, window_height, camera_surf_collide, animate2, building_action_key, player_in_elevator;
 extern float CAMERA_RADIUS, city_dlight_pcf_offset_scale, fticks, FAR_CLIP;
@@ -43,6 +45,8 @@ extern shader_t reflection_shader;
 void get_all_model_bcubes(vector<cube_t> &bcubes); // from model3d.h
 cube_t get_building_indir_light_bounds(); // from building_lighting.cpp
 void register_player_not_in_building();
+void setup_for_parallel_room_details_gen();
+void finish_all_room_geom_bkg_gen();
 void parse_universe_name_str_tables();
 void try_join_house_ext_basements(vect_building_t &buildings);
 void add_sign_text_verts_both_sides(string const &text, cube_t const &sign, bool dim, bool dir, vect_vnctcc_t &verts);
@@ -127,13 +131,19 @@ void building_geom_t::do_xy_rotate_normal_inv(point &n) const {::do_xy_rotate_no
 
 
 class building_texture_mgr_t {
-	int window_tid=-1, hdoor_tid=-1, odoor_tid=-1, bdoor_tid=-1, bdoor2_tid=-1, gdoor_tid=-1, ac_unit_tid1=-1, ac_unit_tid2=-1, bath_wind_tid=-1, helipad_tex=-1,
-		solarp_tex=-1, concrete_tex=-1, met_plate_tex=-1, mplate_nm_tex=-1, met_roof_tex=-1;
-
-	int ensure_tid(int &tid, const char *name, bool is_normal_map=0) {
-		if (tid < 0) {tid = get_texture_by_name(name, is_normal_map);}
-		if (tid < 0) {tid = (is_normal_map ? FLAT_NMAP_TEX : WHITE_TEX);} // failed to load texture - use a simple white texture/flat normal map
-		return tid;
+	int window_tid=-1; // only set on the main thread
+	// atomic because these may be looked up by the background room geometry thread and parallel room detail generation workers; racing threads write the same value
+	std::atomic<int> hdoor_tid{-1}, odoor_tid{-1}, bdoor_tid{-1}, bdoor2_tid{-1}, gdoor_tid{-1}, ac_unit_tid1{-1}, ac_unit_tid2{-1}, bath_wind_tid{-1}, helipad_tex{-1},
+		solarp_tex{-1}, concrete_tex{-1}, met_plate_tex{-1}, mplate_nm_tex{-1}, met_roof_tex{-1};
+
+	int ensure_tid(std::atomic<int> &tid, const char *name, bool is_normal_map=0) {
+		int ret(tid);
+		if (ret >= 0) return ret; // already loaded
+		ret = get_texture_by_name(name, is_normal_map);
+		if (ret < 0 && texture_load_was_skipped()) return (is_normal_map ? FLAT_NMAP_TEX : WHITE_TEX); // worker thread; don't cache, since the main thread will load it
+		if (ret < 0) {ret = (is_normal_map ? FLAT_NMAP_TEX : WHITE_TEX);} // failed to load texture - use a simple white texture/flat normal map
+		tid = ret;
+		return ret;
 	}
 public:
 	int get_window_tid   () const {return window_tid;}
@@ -2147,6 +2157,72 @@ void building_t::write_basement_entrance_depth_pass(shader_t &s) const {
 }
 
 
+// packed BVH of building bcubes using the same node layout as the cobj trees; an alternative to the uniform grid for building queries
+class building_bvh_t : public cobj_tree_simple_type_t<cube_with_ix_t> {
+	virtual void calc_node_bbox(tree_node &n) const {
+		assert(n.start < n.end);
+		for (unsigned i = n.start; i < n.end; ++i) {n.assign_or_union_with_cube(objects[i]);} // bcube union
+	}
+public:
+	void build(vect_building_t const &buildings, bool verbose=0) {
+		clear();
+		objects.reserve(buildings.size());
+
+		for (auto b = buildings.begin(); b != buildings.end(); ++b) {
+			if (!b->bcube.is_all_zeros()) {objects.emplace_back(b->bcube, (b - buildings.begin()));}
+		}
+		build_tree_top(verbose);
+	}
+	// calls func(obj) for each bcube intersecting c; func returns true to end the query early, in which case we return true
+	template<typename F> bool query_cube(cube_t const &c, bool xy_only, F const &func) const {
+		unsigned const num_nodes((unsigned)nodes.size());
+
+		for (unsigned nix = 0; nix < num_nodes;) {
+			tree_node const &n(nodes[nix]);
+			if (!(xy_only ? c.intersects_xy(n) : c.intersects(n))) {nix = n.next_node_id; continue;} // skip this subtree
+			++nix;
+
+			for (unsigned i = n.start; i < n.end; ++i) { // check leaves
+				cube_with_ix_t const &obj(objects[i]);
+				if ((xy_only ? c.intersects_xy(obj) : c.intersects(obj)) && func(obj)) return 1;
+			}
+		}
+		return 0;
+	}
+	// calls func(obj) for each leaf bcube in a node intersecting the line; func returns the new line end as a fraction of (p2 - p1), or a negative value to end the query
+	template<typename F> void query_line(point const &p1, point const &p2, F const &func) const {
+		if (nodes.empty()) return;
+		node_ix_mgr nixm(nodes, p1, p2);
+		unsigned const num_nodes((unsigned)nodes.size());
+		float tmax(1.0);
+
+		for (unsigned nix = 0; nix < num_nodes;) {
+			tree_node const &n(nodes[nix]);
+			if (!nixm.check_node(nix)) continue; // Note: modifies nix
+
+			for (unsigned i = n.start; i < n.end; ++i) { // check leaves
+				float const t(func(objects[i]));
+				if (t < 0.0) return; // done
+				if (t > 0.0 && t < tmax) {tmax = t; nixm.dinv = (p2 - p1)*t; nixm.dinv.invert();} // clip the line to the closest hit so far
+			}
+		}
+	}
+	// calls func(obj) for each leaf bcube in a node visible in pdu, where pdu is in camera space and our cubes are in building space
+	template<typename F> void query_frustum(pos_dir_up const &pdu, vector3d const &xlate, F const &func) const {
+		unsigned const num_nodes((unsigned)nodes.size());
+
+		for (unsigned nix = 0; nix < num_nodes;) {
+			tree_node const &n(nodes[nix]);
+			cube_t const c(n + xlate);
+			if (!pdu.sphere_and_cube_visible_test(c.get_cube_center(), c.get_bsphere_radius(), c)) {nix = n.next_node_id; continue;} // VFC, skip this subtree
+			++nix;
+			for (unsigned i = n.start; i < n.end; ++i) {func(objects[i]);} // check leaves
+		}
+	}
+	unsigned get_num_nodes() const {return nodes.size();}
+	unsigned get_mem_usage   () const {return (nodes.capacity()*sizeof(tree_node) + objects.capacity()*sizeof(cube_with_ix_t));}
+};
+
 class building_creator_t {
 
 	unsigned grid_sz, gpu_mem_usage;
@@ -2175,6 +2251,9 @@ class building_creator_t {
 		}
 	};
 	vector<grid_elem_t> grid, grid_by_tile;
+	building_bvh_t bvh; // used in place of the grid for building queries when enabled
+
+	bool use_bvh() const {return (global_building_params.use_building_bvh && !bvh.is_empty());}
 
 	grid_elem_t &get_grid_elem(unsigned gx, unsigned gy) {
 		assert(gx < grid_sz && gy < grid_sz && !grid.empty());
@@ -2325,9 +2404,11 @@ public:
 	bool has_interior_to_draw() const {return (has_interior_geom && !building_draw_interior.empty());}
 
 	void clear() {
+		finish_all_room_geom_bkg_gen(); // may reference our buildings
 		buildings.clear();
 		grid.clear();
 		grid_by_tile.clear();
+		bvh.clear();
 		bix_by_plot.clear();
 		clear_vbos();
 		buildings_bcube = cube_t();
@@ -2551,8 +2632,11 @@ public:
 				++num_gen;
 				if (!use_city_plots) {center.z = get_exact_zval(center.x+xlate.x, center.y+xlate.y);} // only calculate when needed
 				float const z_sea_level(center.z - def_water_level);
-				if (z_sea_level < 0.0) break; // skip underwater buildings, failed placement
-				if (z_sea_level < mat.min_alt || z_sea_level > mat.max_alt) break; // skip bad altitude buildings, failed placement
+
+				if (z_sea_level < 0.0 || z_sea_level < mat.min_alt || z_sea_level > mat.max_alt) { // skip underwater and bad altitude buildings, failed placement
+					if (use_city_plots) {bix_by_plot[city_block_ix].pop_back();} // remove the index added by check_valid_building_placement()
+					break;
+				}
 				float const hmin(use_city_plots ? pos_range.z1() : 0.0), hmax(use_city_plots ? pos_range.z2() : 1.0);
 				assert(hmin <= hmax);
 				float const height_range(mat.sz_range.dz());
@@ -2643,15 +2727,35 @@ public:
 			bool const use_mt(!is_tile || gen_interiors); // only single threaded for tiles with no interiors, which is a fast case anyway
 			// house extended basement logic isn't thread safe because two houses being generated on different threads could have overlapping basement rooms;
 			// however, office buildings don't have extended basements, so it should be okay to process them in parallel to houses; this is just a bit slower
-#pragma omp parallel for schedule(static) num_threads(2) if (use_mt)
-			for (int is_house=0; is_house < 2; ++is_house) {
+			auto gen_building_geom([&](unsigned i) {
+				building_t &b(buildings[i]);
+				unsigned const rs_ix(city_prob.get(i).same_geom_per_mat[b.is_house] ? b.mat_ix : i); // same material, maybe from same block/city; could also use city_ix
+				b.gen_geometry(rs_ix, 1337*rs_ix+rseed); // seeded per building, so the result doesn't depend on thread assignment
+			});
+			if (use_mt && global_building_params.parallel_interior_gen) { // houses in series on one thread, office buildings spread across the other threads
+				vector<unsigned> office_ixs;
+
 				for (unsigned i = 0; i < buildings.size(); ++i) {
-					building_t &b(buildings[i]);
-					if (b.is_house != bool(is_house)) continue; // wrong pass
-					unsigned const rs_ix(city_prob.get(i).same_geom_per_mat[b.is_house] ? b.mat_ix : i); // same material, maybe from same block/city; could also use city_ix
-					b.gen_geometry(rs_ix, 1337*rs_ix+rseed);
+					if (!buildings[i].is_house) {office_ixs.push_back(i);}
+				}
+#pragma omp parallel
+				{
+#pragma omp single nowait
+					for (unsigned i = 0; i < buildings.size(); ++i) {
+						if (buildings[i].is_house) {gen_building_geom(i);}
+					}
+#pragma omp for schedule(dynamic,4) nowait
+					for (int i = 0; i < (int)office_ixs.size(); ++i) {gen_building_geom(office_ixs[i]);}
 				}
-			} // for is_house
+			}
+			else {
+#pragma omp parallel for schedule(static) num_threads(2) if (use_mt)
+				for (int is_house=0; is_house < 2; ++is_house) {
+					for (unsigned i = 0; i < buildings.size(); ++i) {
+						if (buildings[i].is_house == bool(is_house)) {gen_building_geom(i);}
+					}
+				} // for is_house
+			}
 			if (city_only && gen_interiors && global_building_params.max_ext_basement_room_depth > 0) {try_join_house_ext_basements(buildings);}
 		} // close the scope
 		if (0 && non_city_only) { // perform room graph analysis
@@ -2679,6 +2783,7 @@ public:
 			buildings_bcube.assign_or_union_with_cube(b->bcube);
 			has_interior_geom |= b->has_interior();
 		} // for b
+		if (global_building_params.use_building_bvh) {bvh.build(buildings);} // driveways and porches are only added to the grid
 		if (!is_tile && (!city_only || maybe_residential)) {place_building_trees(rgen);}
 
 		if (!is_tile) {
@@ -2743,6 +2848,75 @@ public:
 			b.add_flags(flags);
 		}
 	}
+	// generates room objects for each building in bixs, which must be unique; each building is seeded independently, so the results are identical to serial generation
+	void gen_room_details_parallel(vector<unsigned> const &bixs) {
+		if (bixs.empty()) return;
+		//highres_timer_t timer("Gen Room Details Parallel");
+		setup_for_parallel_room_details_gen(); // must be done on the main thread
+		vector<unsigned char> needs_texture(bixs.size(), 0);
+#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < (int)bixs.size(); ++i) {
+			set_texture_load_disabled_for_thread(1); // textures can only be loaded on the main thread
+			get_building(bixs[i]).gen_room_details_if_needed(bixs[i]);
+			needs_texture[i] = texture_load_was_skipped();
+			set_texture_load_disabled_for_thread(0);
+		}
+		for (unsigned i = 0; i < bixs.size(); ++i) { // discard and regenerate buildings that needed a texture that wasn't loaded yet
+			if (!needs_texture[i]) continue;
+			building_t &b(get_building(bixs[i]));
+			b.clear_room_geom();
+			b.gen_room_details_if_needed(bixs[i]);
+		}
+	}
+	void gen_all_room_details(bool parallel) { // normally generated lazily as the player approaches; used for headless benchmarks
+		if (parallel) {
+			vector<unsigned> bixs;
+
+			for (unsigned i = 0; i < buildings.size(); ++i) {
+				if (buildings[i].interior && !buildings[i].has_room_geom()) {bixs.push_back(i);}
+			}
+			gen_room_details_parallel(bixs);
+		}
+		else {
+			for (unsigned i = 0; i < buildings.size(); ++i) {buildings[i].gen_room_details_if_needed(i);}
+		}
+	}
+	void clear_all_room_geom() {
+		for (building_t &b : buildings) {b.clear_room_geom();}
+		for (grid_elem_t &g : grid_by_tile) {g.has_room_geom = 0;}
+	}
+	uint64_t get_room_objs_hash() const { // order dependent, since building_ix is part of the seed
+		uint64_t hash(0);
+		for (building_t const &b : buildings) {hash = 31*hash + b.get_room_objs_hash();}
+		return hash;
+	}
+	void update_stats(building_stats_t &s) const {
+		for (building_t const &b : buildings) {b.update_stats(s);}
+	}
+	building_t const *get_indir_lighting_bench_building(unsigned &bix, point &target, unsigned &max_lights) const { // building with the most lights on one floor
+		building_t const *ret(nullptr);
+
+		for (unsigned i = 0; i < buildings.size(); ++i) {
+			point cand_target;
+			unsigned const num_lights(buildings[i].get_indir_lighting_bench_target(cand_target));
+			if (num_lights <= max_lights) continue;
+			max_lights = num_lights;
+			target     = cand_target;
+			bix        = i;
+			ret        = &buildings[i];
+		}
+		return ret;
+	}
+	building_t *get_nav_path_bench_building(unsigned &max_rooms) { // office building with the most rooms
+		building_t *ret(nullptr);
+
+		for (building_t &b : buildings) {
+			if (b.is_house || !b.interior || b.is_rotated() || b.interior->rooms.size() <= max_rooms) continue;
+			max_rooms = b.interior->rooms.size();
+			ret       = &b;
+		}
+		return ret;
+	}
 	void update_ai_state(float delta_dir) { // called once per frame
 		if (!global_building_params.building_people_enabled()) return;
 		point const camera_bs(get_camera_building_space());
@@ -2984,6 +3158,7 @@ public:
 		defer_ped_draw_vars_t defer_ped_draw_vars;
 		vector<building_t *> buildings_with_cars;
 		static brg_batch_draw_t bbd; // allocated memory is reused across building interiors
+		static vector<unsigned> gen_room_geom_bixs; // buildings to generate room geom for in parallel
 		bool const defer_people_draw_for_player_building(global_building_params.people_min_alpha > 0.0);
 
 		// draw building interiors with standard shader and no shadow maps; must be drawn first before windows depth pass
@@ -3061,7 +3236,20 @@ public:
 					if (is_first_tile && !reflection_pass) {oc.set_camera(camera_pdu);} // setup occlusion culling on the first visible tile
 					bbd.next_tile(g->bcube);
 					is_first_tile = 0;
-					
+
+					if (global_building_params.parallel_interior_gen && !reflection_pass) { // generate room geom for all visible buildings in this tile in parallel
+						gen_room_geom_bixs.clear();
+
+						for (auto bi = g->bc_ixs.begin(); bi != g->bc_ixs.end(); ++bi) {
+							building_t const &b((*i)->get_building(bi->ix));
+							if (!b.interior || b.has_room_geom()) continue; // no interior or already generated
+							if (!global_building_params.enable_rotated_room_geom && b.is_rotated()) continue;
+							if (p2p_dist_sq(camera_xlated, b.bcube.closest_pt(camera_xlated)) > rgeom_draw_dist_sq) continue; // too far away
+							if (!b.bcube.contains_pt_xy(camera_xlated) && !camera_pdu.cube_visible(b.bcube + xlate)) continue; // VFC
+							gen_room_geom_bixs.push_back(bi->ix);
+						}
+						if (gen_room_geom_bixs.size() > 1) {(*i)->gen_room_details_parallel(gen_room_geom_bixs);} // a single building will be generated below
+					}
 					for (auto bi = g->bc_ixs.begin(); bi != g->bc_ixs.end(); ++bi) {
 						building_t &b((*i)->get_building(bi->ix));
 						if (!b.interior) continue; // no interior, skip
@@ -3552,6 +3740,7 @@ public:
 		if (!is_tile) {cout << "Building V: " << num_everts << ", T: " << num_etris << ", interior V: " << num_iverts << ", T: " << num_itris << ", mem: " << gpu_mem_usage << endl;}
 	}
 	void create_vbos(bool is_tile) {
+		if (headless_mode) return; // no GL context
 		building_texture_mgr.check_windows_texture();
 		tid_mapper.init();
 		timer_t timer("Create Building VBOs", !is_tile);
@@ -3614,16 +3803,27 @@ public:
 			unsigned ixr[2][2];
 			get_grid_range(bcube, ixr);
 			float const dist(p2p_dist(pos, p_last));
-
+			bool const bvh_query(use_bvh());
+
+			if (bvh_query) { // check buildings with the BVH, then driveways with the grid below
+				// Note: assumes buildings are separated so that only one sphere collision can occur
+				auto check_building([&](cube_with_ix_t const &b) {
+					building_t const &building(get_building(b.ix));
+					if (building.check_sphere_coll(pos, p_last, xlate, radius, xy_only, cnorm, check_interior)) return 1;
+					saw_player_building |= (check_interior && &building == player_building);
+					return 0;
+				});
+				if (bvh.query_cube(bcube, 1, check_building)) return 1; // xy_only=1
+			}
 			for (unsigned y = ixr[0][1]; y <= ixr[1][1]; ++y) {
 				for (unsigned x = ixr[0][0]; x <= ixr[1][0]; ++x) {
 					grid_elem_t const &ge(get_grid_elem(x, y));
-					if (ge.empty()) continue; // skip empty grid
+					if (ge.empty() || (bvh_query && ge.road_segs.empty())) continue; // skip empty grid
 					if (!(xy_only ? sphere_cube_intersect_xy(pos, (radius + dist), (ge.bcube + xlate)) :
 						sphere_cube_intersect(pos, (radius + dist), (ge.bcube + xlate)))) continue; // Note: makes little difference
 
 					// Note: assumes buildings are separated so that only one sphere collision can occur
-					for (auto b = ge.bc_ixs.begin(); b != ge.bc_ixs.end(); ++b) {
+					for (auto b = ge.bc_ixs.begin(); b != ge.bc_ixs.end() && !bvh_query; ++b) {
 						if (!b->intersects_xy(bcube)) continue;
 						building_t const &building(get_building(b->ix));
 						if (building.check_sphere_coll(pos, p_last, xlate, radius, xy_only, cnorm, check_interior)) return 1;
@@ -3737,9 +3937,22 @@ public:
 			return 0; // no coll
 		}
 		cube_t bcube(p1, p2);
+		unsigned coll(BLDG_COLL_NONE);
+
+		if (use_bvh()) {
+			auto check_building([&](cube_with_ix_t const &b) {
+				if (!b.intersects(bcube)) return 1.0f; // no change to the line
+				float t_new(t);
+				unsigned const ret(get_building(b.ix).check_line_coll(p1, p2, t_new, 0, ret_any_pt, no_coll_pt));
+				if (!ret || t_new > t) return 1.0f;
+				t = t_new; hit_bix = b.ix; coll = ret; // closer hit pos, update state
+				return (ret_any_pt ? -1.0f : t); // stop at the first hit, or clip the line to the hit pos
+			});
+			bvh.query_line(p1, p2, check_building);
+			return coll;
+		}
 		unsigned ixr[2][2];
 		get_grid_range(bcube, ixr);
-		unsigned coll(BLDG_COLL_NONE);
 		point end_pos(p2);
 
 		// for now, just do a slow iteration over every grid element within the line's bbox in XY
@@ -3832,13 +4045,13 @@ public:
 		return grid[get_grid_ix(b.bcube.get_cube_center())].bcube;
 	}
 
-	bool check_ped_coll(point const &pos, float radius, unsigned plot_id, unsigned &building_id) const { // Note: not thread safe due to static points
+	bool check_ped_coll(point const &pos, float radius, unsigned plot_id, unsigned &building_id) const { // Note: called from parallel ped updates
 		if (empty()) return 0;
 		assert(plot_id < bix_by_plot.size());
 		vector<unsigned> const &bixes(bix_by_plot[plot_id]); // should be populated in gen()
 		if (bixes.empty()) return 0;
 		cube_t bcube; bcube.set_from_sphere(pos, radius);
-		static vector<point> points; // reused across calls
+		static thread_local vector<point> points; // reused across calls
 
 		// Note: assumes buildings are separated so that only one ped collision can occur
 		for (auto b = bixes.begin(); b != bixes.end(); ++b) {
@@ -3908,21 +4121,82 @@ public:
 
 	void get_occluders(pos_dir_up const &pdu, building_occlusion_state_t &state) const {
 		state.init(pdu.pos, get_camera_coord_space_xlate());
-		
+
+		auto add_occluder([&](cube_with_ix_t const &b) {
+			if ((int)b.ix == state.exclude_bix) return; // excluded
+			cube_t const c(b + state.xlate); // check far clipping plane first because that's more likely to reject buildings
+			// if player's inside this building, skip occlusion so that objects are visible through windows
+			if (state.skip_cont_camera && !(player_in_basement || player_in_attic) && c.contains_pt(pdu.pos) && get_building(b.ix).has_windows()) return;
+			if (dist_less_than(pdu.pos, c.closest_pt(pdu.pos), pdu.far_) && pdu.cube_visible(c)) {state.building_ids.push_back(b);}
+		});
+		if (use_bvh()) {
+			bvh.query_frustum(pdu, state.xlate, add_occluder);
+			return;
+		}
 		for (auto g = grid.begin(); g != grid.end(); ++g) {
 			if (g->bc_ixs.empty()) continue;
 			point const pos(g->bcube.get_cube_center() + state.xlate);
 			if (!pdu.sphere_and_cube_visible_test(pos, g->bcube.get_bsphere_radius(), (g->bcube + state.xlate))) continue; // VFC
-			
-			for (auto b = g->bc_ixs.begin(); b != g->bc_ixs.end(); ++b) {
-				if ((int)b->ix == state.exclude_bix) continue; // excluded
-				cube_t const c(*b + state.xlate); // check far clipping plane first because that's more likely to reject buildings
-				// if player's inside this building, skip occlusion so that objects are visible through windows
-				if (state.skip_cont_camera && !(player_in_basement || player_in_attic) && c.contains_pt(pdu.pos) && get_building(b->ix).has_windows()) continue;
-				if (dist_less_than(pdu.pos, c.closest_pt(pdu.pos), pdu.far_) && pdu.cube_visible(c)) {state.building_ids.push_back(*b);}
-			}
+			for (auto b = g->bc_ixs.begin(); b != g->bc_ixs.end(); ++b) {add_occluder(*b);}
 		}
 	}
+	// runs the same random sphere collision, line intersection, and occluder queries using both the grid and the BVH and accumulates timing into res;
+	// builds the BVH if it wasn't built in gen() because use_building_bvh is disabled
+	void run_query_benchmark(unsigned num_queries, building_query_bench_t &res) {
+		if (empty()) return;
+		if (bvh.is_empty()) {bvh.build(buildings, 1);} // verbose=1; prints tree stats, and compares the build methods if cobj_tree_build_stats is set
+		rand_gen_t rgen; // fixed seed so that results are repeatable
+		vector3d const xlate(get_camera_coord_space_xlate());
+		float const radius(CAMERA_RADIUS), query_dist(0.1*max(range_sz.x, range_sz.y));
+		vector<point> starts, ends;
+		vector<pos_dir_up> frustums;
+		vector<unsigned> bids;
+		building_occlusion_state_t state;
+
+		for (unsigned i = 0; i < num_queries; ++i) { // queries are in building space
+			starts.push_back(rgen.gen_rand_cube_point(buildings_bcube));
+			ends  .push_back(starts.back() + rgen.signed_rand_vector(query_dist));
+			vector3d const dir(rgen.signed_rand_vector_spherical_xy_norm());
+			frustums.emplace_back((starts.back() + xlate), dir, plus_z, 0.0, 0.001*query_dist, query_dist, 0.0, 1); // auto perspective angle, no_zoom=1
+		}
+		bool const prev_use_bvh(global_building_params.use_building_bvh);
+
+		for (unsigned use_bvh = 0; use_bvh < 2; ++use_bvh) {
+			global_building_params.use_building_bvh = use_bvh;
+			auto const t_start(high_resolution_clock::now());
+
+			for (point const &p : starts) {
+				point pos(p + xlate); // convert to camera space
+				res.sphere_hits[use_bvh] += check_sphere_coll(pos, pos, radius);
+			}
+			auto const t_sphere(high_resolution_clock::now());
+
+			for (unsigned i = 0; i < num_queries; ++i) {
+				float t(1.0);
+				unsigned hit_bix(0);
+				res.line_hits[use_bvh] += (check_line_coll(starts[i], ends[i], t, hit_bix, 0, 0) != BLDG_COLL_NONE);
+			}
+			auto const t_line(high_resolution_clock::now());
+
+			for (pos_dir_up const &pdu : frustums) {
+				get_occluders(pdu, state);
+				bids.clear();
+				for (cube_with_ix_t const &b : state.building_ids) {bids.push_back(b.ix);}
+				sort(bids.begin(), bids.end());
+				bids.erase(unique(bids.begin(), bids.end()), bids.end()); // the grid can return a building once per grid element it overlaps
+				res.num_occluders[use_bvh] += bids.size();
+			}
+			auto const t_occluder(high_resolution_clock::now());
+			res.sphere_ms  [use_bvh] += 1000.0f*duration_cast<duration<float>>(t_sphere   - t_start ).count();
+			res.line_ms    [use_bvh] += 1000.0f*duration_cast<duration<float>>(t_line     - t_sphere).count();
+			res.occluder_ms[use_bvh] += 1000.0f*duration_cast<duration<float>>(t_occluder - t_line  ).count();
+		} // for use_bvh
+		global_building_params.use_building_bvh = prev_use_bvh;
+		res.num_buildings += buildings.size();
+		res.num_queries   += num_queries;
+		res.bvh_nodes     += bvh.get_num_nodes();
+		res.bvh_mem       += bvh.get_mem_usage();
+	}
 	bool check_pts_occluded(point const *const pts, unsigned npts, building_occlusion_state_t const &state) const { // pts are in building space
 		point const pos_bs(state.pos - state.xlate);
 
@@ -4251,9 +4525,40 @@ bool get_buildings_line_hit_color(point const &p1, point const &p2, colorRGBA &c
 	return building_creator.get_building_hit_color(p1x, p2x, color);
 }
 bool have_city_buildings() {return !building_creator_city.empty();}
+
+void gen_all_building_room_details(bool parallel) {
+	building_creator_city.gen_all_room_details(parallel);
+	building_creator     .gen_all_room_details(parallel);
+}
+void clear_all_building_room_geom() {
+	building_creator_city.clear_all_room_geom();
+	building_creator     .clear_all_room_geom();
+}
+uint64_t get_all_building_room_objs_hash() {return (building_creator_city.get_room_objs_hash() ^ (building_creator.get_room_objs_hash() << 1));}
+void time_building_queries(unsigned num_queries, building_query_bench_t &res) {
+	building_creator_city.run_query_benchmark(num_queries, res);
+	building_creator     .run_query_benchmark(num_queries, res);
+}
+void get_all_building_stats(building_stats_t &s) {
+	building_creator_city.update_stats(s);
+	building_creator     .update_stats(s);
+}
+building_t const *get_indir_lighting_bench_building(unsigned &bix, point &target, unsigned &num_lights) {
+	num_lights = 0;
+	building_t const *const city_b(building_creator_city.get_indir_lighting_bench_building(bix, target, num_lights));
+	building_t const *const sec_b (building_creator     .get_indir_lighting_bench_building(bix, target, num_lights));
+	return (sec_b ? sec_b : city_b); // secondary building only returned if it has more lights
+}
+building_t *get_nav_path_bench_building(unsigned &num_rooms) {
+	num_rooms = 0;
+	building_t *const city_b(building_creator_city.get_nav_path_bench_building(num_rooms));
+	building_t *const sec_b (building_creator     .get_nav_path_bench_building(num_rooms));
+	return (sec_b ? sec_b : city_b); // secondary building only returned if it has more rooms
+}
 bool have_secondary_buildings() {return (global_building_params.add_secondary_buildings && global_building_params.num_place > 0);}
 bool have_buildings() {return (!building_creator.empty() || !building_creator_city.empty() || !building_tiles.empty());} // for postproc effects
 bool no_grass_under_buildings() {return (world_mode == WMODE_INF_TERRAIN && !(building_creator.empty() && building_tiles.empty()) && global_building_params.flatten_mesh);}
+unsigned get_num_buildings_total() {return (building_creator.get_num_buildings() + building_creator_city.get_num_buildings() + building_tiles.get_tot_num_buildings());}
 unsigned get_buildings_gpu_mem_usage() {return (building_creator.get_gpu_mem_usage() + building_creator_city.get_gpu_mem_usage() + building_tiles.get_gpu_mem_usage());}
 void add_city_building_signs(cube_t const &city_bcube, vector<sign_t> &signs) {building_creator_city.add_building_signs(city_bcube, signs);}
 void add_city_building_flags(cube_t const &city_bcube, vector<city_flag_t> &flags) {building_creator_city.add_building_flags(city_bcube, flags);}
@@ -314,14 +314,18 @@ public:
 
 				for (int x = 0; x <= MESH_X_SIZE; ++x) {
 					if (is_mesh_disabled(x, y)) continue;
-					point const start_pt(get_xval(x), get_yval(y), mesh_height[min(y, MESH_Y_SIZE-1)][min(x, MESH_X_SIZE-1)]);
+					point start_pts[16], end_pts[16];
+					int cindex[16];
+					start_pts[0].assign(get_xval(x), get_yval(y), mesh_height[min(y, MESH_Y_SIZE-1)][min(x, MESH_X_SIZE-1)]);
 					unsigned char &val(occ_map[y*om_stride + x]);
 
 					for (unsigned n = 0; n < SAMPLES_PER_TILE; ++n) {
-						point const end_pt(start_pt + Z_SCENE_SIZE*vector3d(0.5*occ_rgen.signed_rand_float(), 0.5*occ_rgen.signed_rand_float(), 1.0));
-						int cindex(-1);
-						if (check_coll_line(start_pt, end_pt, cindex, -1, 1, 0, 0)) {++val;} // ignore alpha value (even for leaves, to incrase their influence)
+						start_pts[n] = start_pts[0];
+						end_pts  [n] = start_pts[0] + Z_SCENE_SIZE*vector3d(0.5*occ_rgen.signed_rand_float(), 0.5*occ_rgen.signed_rand_float(), 1.0);
 					}
+					// rays from the same point are tested against static cobjs together; ignore alpha value (even for leaves, to incrase their influence)
+					check_coll_line_batch_tree(SAMPLES_PER_TILE, start_pts, end_pts, cindex, -1, 0);
+					for (unsigned n = 0; n < SAMPLES_PER_TILE; ++n) {val += (cindex[n] >= 0);}
 				}
 			}
 			//PRINT_TIME("Grass Occlusion");
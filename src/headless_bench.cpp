@@ -0,0 +1,822 @@
+// 3D World - Headless City and Building Generation Benchmark
+// by Frank Gennari
+// 10/16/26
+#include "function_registry.h"
+#include "buildings.h" // for building_stats_t
+#include "model3d.h"
+#include "mesh.h" // for mesh_xy_grid_cache_t
+#include "horizon_map.h"
+#include "file_utils.h" // for get_file_size()
+#include "profiler.h"
+#include <fstream>
+#include <omp.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h> // for GetProcessMemoryInfo()
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h> // for getrusage()
+#endif
+
+using std::string;
+
+extern bool model3d_lazy_materials;
+extern string texture_decode_cache_dir;
+extern int world_mode, mesh_gen_mode;
+extern unsigned NUM_THREADS, LOCAL_RAYS, indir_light_batch_size;
+extern string building_indir_cache_dir;
+extern building_params_t global_building_params;
+
+void reset_planet_defaults();
+bool load_tiled_terrain_heightmap();
+void gen_all_building_room_details(bool parallel);
+void clear_all_building_room_geom();
+uint64_t get_all_building_room_objs_hash();
+void get_all_building_stats(building_stats_t &s);
+void time_building_queries(unsigned num_queries, building_query_bench_t &res);
+bool parse_obj_file_only(string const &fn, bool parallel, uint64_t &hash);
+building_t const *get_indir_lighting_bench_building(unsigned &bix, point &target, unsigned &num_lights);
+void get_building_indir_cache_stats(unsigned &hits, unsigned &misses, double &saved_ms);
+void set_city_num_cars(unsigned num_cars);
+unsigned get_city_num_cars();
+float run_car_sim_bench_frames(unsigned num_frames, unsigned num_threads);
+void get_car_sort_stats(unsigned &incr, unsigned &full);
+void set_city_num_peds(unsigned num_peds);
+unsigned get_city_num_peds();
+float run_ped_sim_bench_frames(unsigned num_frames, unsigned num_threads, bool restore_state, uint64_t &state_hash);
+building_t *get_nav_path_bench_building(unsigned &num_rooms);
+void get_building_nav_path_stats(uint64_t &queries, uint64_t &cache_hits, uint64_t &tables_built, uint64_t &invalidations);
+void reset_building_nav_path_stats();
+void get_building_flow_field_stats(unsigned &grid_builds, unsigned &room_builds, unsigned &player_builds);
+
+
+uint64_t get_peak_process_mem_bytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+	return pmc.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+	return 1024ULL*usage.ru_maxrss; // ru_maxrss is in KB on linux
+#endif
+}
+
+class bench_json_t { // writes a JSON object; the top level object has one value per line, and nested objects are written on one line
+	std::ostream &out;
+	bool first=1, multiline;
+
+	std::ostream &key(char const *const k) {
+		out << (first ? "{" : ",") << (multiline ? "\n  " : (first ? "" : " ")) << "\"" << k << "\": ";
+		first = 0;
+		return out;
+	}
+public:
+	bench_json_t(std::ostream &out_, bool multiline_=0) : out(out_), multiline(multiline_) {}
+	template<typename T> bench_json_t &add(char const *const k, T const &val) {key(k) << val; return *this;}
+	bench_json_t &add(char const *const k, bool val) {key(k) << (val ? "true" : "false"); return *this;}
+	bench_json_t &add(char const *const k, char const *const val) {key(k) << "\"" << val << "\""; return *this;}
+	bench_json_t &add(char const *const k, string const &val) {return add(k, val.c_str());}
+	bench_json_t &add_hex(char const *const k, uint64_t val) {key(k) << "\"" << std::hex << val << std::dec << "\""; return *this;}
+	std::ostream &add_raw(char const *const k) {return key(k);} // caller writes the value
+
+	template<typename F> bench_json_t &add_object(char const *const k, F const &add_vals) { // add_vals(bench_json_t &obj)
+		key(k);
+		bench_json_t obj(out);
+		add_vals(obj);
+		obj.end();
+		return *this;
+	}
+	template<typename F> bench_json_t &add_array(char const *const k, unsigned num, F const &add_vals) { // array of objects; add_vals(bench_json_t &obj, unsigned ix)
+		key(k) << "[";
+
+		for (unsigned i = 0; i < num; ++i) {
+			out << (i ? ", " : "");
+			bench_json_t obj(out);
+			add_vals(obj, i);
+			obj.end();
+		}
+		out << "]";
+		return *this;
+	}
+	void end() {out << (first ? "{" : "") << (multiline ? "\n}" : "}");}
+};
+
+class bench_output_t { // JSON results file for one benchmark; stdout is shared with log messages, so results are always written to a file
+	string name, fn;
+	std::ofstream out;
+public:
+	bench_json_t json;
+
+	bench_output_t(char const *const name_, char const *const out_fn, char const *const def_fn) : name(name_), fn(out_fn ? out_fn : def_fn), json(out, 1) {}
+	std::ostream &get_stream() {return out;}
+
+	bool open() {
+		out.open(fn);
+		if (out.good()) return 1;
+		std::cerr << "Error: Failed to open " << name << " benchmark output file " << fn << " for write" << endl;
+		return 0;
+	}
+	int finish(int ret) { // returns ret, the process exit code
+		json.end();
+		out << endl;
+		cout << "Wrote " << name << " benchmark results to " << fn << endl;
+		return ret;
+	}
+};
+
+// creates the terrain mesh and sine table used by tiled terrain height queries; cities and building interiors are only generated in tiled terrain mode
+void init_bench_terrain() {
+	world_mode = WMODE_INF_TERRAIN;
+	reset_planet_defaults();
+	alloc_matrices();
+	init_terrain_mesh();
+	gen_mesh(0, 0, 0);
+}
+// generates the heightmap, cities, buildings, and city details, overriding the config file car and pedestrian counts if nonzero; room objects are optional
+// because they're normally generated lazily as the player approaches each building
+void gen_bench_city(bool room_details, unsigned num_cars=0, unsigned num_peds=0) {
+	init_bench_terrain();
+	load_tiled_terrain_heightmap();
+	gen_buildings();
+	if (num_cars > 0) {set_city_num_cars(num_cars);}
+	if (num_peds > 0) {set_city_num_peds(num_peds);}
+	gen_city_details(); // parking lots, city objects, cars, and pedestrians
+	if (room_details) {gen_all_building_room_details(global_building_params.parallel_interior_gen);}
+}
+
+class headless_stage_timer_t { // like highres_timer_t, but records to a list of stages rather than the profiler
+	vector<pair<string, float>> stages;
+	high_resolution_clock::time_point start;
+public:
+	void begin() {start = high_resolution_clock::now();}
+	float end(char const *const name) {
+		float const ms(1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - start).count());
+		stages.emplace_back(name, ms);
+		cout << "Headless stage " << name << ": " << ms << "ms" << endl;
+		return ms;
+	}
+	float get_total() const {
+		float total(0.0);
+		for (auto const &s : stages) {total += s.second;}
+		return total;
+	}
+	void write_json(bench_json_t &obj) const {
+		for (auto const &s : stages) {obj.add(s.first.c_str(), s.second);}
+		obj.add("total", get_total());
+	}
+};
+
+// runs terrain heightmap, city road/plot, building placement, and building interior generation without a window or GL context,
+// then writes per-stage timing, object counts, and peak memory as JSON to out_fn; returns the process exit code
+int run_headless_benchmark(char const *out_fn) {
+
+	cout << "Running headless generation benchmark" << endl;
+	enable_timing_profiler_no_print(); // accumulate all named timers so that they can be included in the output
+	init_bench_terrain(); // not timed
+	headless_stage_timer_t stages;
+
+	// heightmap load or generation; city roads and plots are generated as a heightmap postprocess step
+	stages.begin();
+	load_tiled_terrain_heightmap();
+	float const hmap_and_cities_ms(stages.end("heightmap_and_cities"));
+
+	if (!using_tiled_terrain_hmap_tex()) {
+		std::cerr << "Warning: No tiled terrain heightmap was specified with mh_filename_tiled_terrain or tiled_terrain_gen_heightmap_sz; cities will not be generated" << endl;
+	}
+	float const cities_ms(get_timing_profiler_total("Gen Cities"));
+	stages.begin();
+	gen_buildings(); // includes building floorplans and room assignment
+	stages.end("building_placement");
+	stages.begin();
+	gen_city_details(); // parking lots, city objects, cars, and pedestrians
+	stages.end("city_details");
+	bool const parallel_rgen(global_building_params.parallel_interior_gen);
+	stages.begin();
+	gen_all_building_room_details(parallel_rgen); // room objects; normally generated lazily as the player approaches each building
+	stages.end("room_objects");
+	building_stats_t s;
+	get_all_building_stats(s); // must be called before room geom is cleared below
+	uint64_t const rgen_hash(get_all_building_room_objs_hash());
+	float serial_rgen_ms(0.0);
+	bool deterministic(1);
+
+	if (parallel_rgen) { // check that parallel room object generation matches serial generation
+		clear_all_building_room_geom();
+		{
+			highres_timer_t timer("Serial Room Details");
+			gen_all_building_room_details(0); // serial
+		}
+		serial_rgen_ms = get_timing_profiler_total("Serial Room Details");
+		deterministic  = (get_all_building_room_objs_hash() == rgen_hash);
+		if (!deterministic) {std::cerr << "Error: Parallel room object generation differs from serial generation" << endl;}
+	}
+	bench_output_t res("headless", out_fn, "headless_bench.json");
+	if (!res.open()) return 1;
+	res.json.add("threads", omp_get_max_threads()).add("building_rand_seed", global_building_params.buildings_rand_seed);
+	res.json.add_object("stages_ms", [&](bench_json_t &o) {stages.write_json(o);});
+	res.json.add_object("substages_ms", [&](bench_json_t &o) {o.add("heightmap", (hmap_and_cities_ms - cities_ms)).add("roads_and_plots", cities_ms);});
+	res.json.add_object("counts", [&](bench_json_t &o) {
+		o.add("buildings", s.nbuildings).add("parts", s.nparts).add("details", s.ndetails).add("roof_tquads", s.ntquads).add("doors", s.ndoors).add("interiors", s.ninterior)
+			.add("rooms", s.nrooms).add("ceilings", s.nceils).add("floors", s.nfloors).add("walls", s.nwalls).add("room_geoms", s.nrgeom).add("room_objects", s.nobjs);
+	});
+	res.json.add_object("room_objects", [&](bench_json_t &o) {
+		o.add("parallel", parallel_rgen).add_hex("hash", rgen_hash).add("serial_ms", serial_rgen_ms).add("deterministic", deterministic);
+	});
+	res.json.add("peak_mem_bytes", get_peak_process_mem_bytes());
+	timing_profiler_write_json(res.json.add_raw("timers"));
+	return res.finish(deterministic ? 0 : 1);
+}
+
+
+// generates buildings as in run_headless_benchmark(), then runs num_queries (100K if zero) random sphere collision, line intersection, and occluder queries
+// using both the building grid and the building BVH, and reports the time of each query type
+int run_building_query_benchmark(char const *out_fn, unsigned num_queries) {
+
+	cout << "Running building query benchmark" << endl;
+	gen_bench_city(0); // room_details=0
+	if (num_queries == 0) {num_queries = 100000;}
+	building_query_bench_t qb;
+	time_building_queries(num_queries, qb);
+
+	if (qb.num_buildings == 0) {
+		std::cerr << "Error: No buildings found for building query benchmark" << endl;
+		return 1;
+	}
+	if (!qb.results_match()) {std::cerr << "Warning: Building grid and BVH query results differ" << endl;} // may differ for spheres that overlap multiple buildings
+	bench_output_t res("building query", out_fn, "building_query_bench.json");
+	if (!res.open()) return 1;
+	res.json.add("buildings", qb.num_buildings).add("queries", qb.num_queries).add("bvh_nodes", qb.bvh_nodes).add("bvh_mem_bytes", qb.bvh_mem).add("results_match", qb.results_match());
+
+	for (unsigned use_bvh = 0; use_bvh < 2; ++use_bvh) {
+		cout << "Building queries with the " << (use_bvh ? "BVH" : "grid") << ": sphere " << qb.sphere_ms[use_bvh] << "ms, line " << qb.line_ms[use_bvh]
+			 << "ms, occluder " << qb.occluder_ms[use_bvh] << "ms" << endl;
+		res.json.add_object((use_bvh ? "bvh" : "grid"), [&](bench_json_t &q) {
+			q.add("sphere_ms", qb.sphere_ms[use_bvh]).add("line_ms", qb.line_ms[use_bvh]).add("occluder_ms", qb.occluder_ms[use_bvh])
+				.add("sphere_hits", qb.sphere_hits[use_bvh]).add("line_hits", qb.line_hits[use_bvh]).add("occluders", qb.num_occluders[use_bvh]);
+		});
+	}
+	return res.finish(0);
+}
+
+
+float time_model3d_read(model3d &model, string const &fn, unsigned num_iters, float *materialize_ms=nullptr) { // returns min time in ms over num_iters
+	float min_ms(0.0), min_mat_ms(0.0);
+
+	for (unsigned n = 0; n < num_iters; ++n) {
+		auto const start(high_resolution_clock::now());
+		if (!model.read_from_disk(fn)) return -1.0;
+		auto const loaded(high_resolution_clock::now());
+		model.ensure_all_geom_loaded(); // same work as drawing every material once
+		float const ms    (1000.0f*duration_cast<duration<float>>(loaded - start).count());
+		float const mat_ms(1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - loaded).count());
+		if (n == 0 || ms < min_ms) {min_ms = ms; min_mat_ms = mat_ms;}
+	}
+	if (materialize_ms) {*materialize_ms = min_mat_ms;}
+	return min_ms;
+}
+
+float time_obj_file_parse(string const &fn, bool parallel, unsigned num_iters, uint64_t &hash) { // returns min time in ms over num_iters
+	float min_ms(0.0);
+
+	for (unsigned n = 0; n < num_iters; ++n) {
+		auto const start(high_resolution_clock::now());
+		if (!parse_obj_file_only(fn, parallel, hash)) return -1.0;
+		float const ms(1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - start).count());
+		if (n == 0 || ms < min_ms) {min_ms = ms;}
+	}
+	return min_ms;
+}
+
+// compares load times of the legacy and v2 model3d formats, with and without lazy material geometry loading;
+// each input file (in either format) is converted to temporary files in both formats next to the original;
+// for OBJ files, compares the parse throughput of the serial and parallel readers and checks that their results match
+int run_model3d_load_benchmark(char const *out_fn, int num_fns, char const *const *fns) {
+
+	unsigned const NUM_ITERS = 3;
+	vector<string> files(fns, fns+num_fns);
+	if (files.empty()) {files = {"../sponza2/sponza.model3d", "model_data/fish/fishOBJ.model3d", "../sponza/sponza.obj"};}
+	bench_output_t res("model3d load", out_fn, "model3d_bench.json");
+	if (!res.open()) return 1;
+	std::ostream &out(res.get_stream());
+	bool const prev_lazy(model3d_lazy_materials);
+	unsigned num_written(0);
+	res.json.add("iterations", NUM_ITERS).add_raw("models") << "["; // one model per line
+
+	for (string const &fn : files) {
+		if (get_file_extension(fn, 0, 1) == "obj") {
+			uint64_t serial_hash(0), parallel_hash(0);
+			float const serial_ms(time_obj_file_parse(fn, 0, NUM_ITERS, serial_hash)), parallel_ms(time_obj_file_parse(fn, 1, NUM_ITERS, parallel_hash));
+			if (serial_ms < 0.0 || parallel_ms < 0.0) {std::cerr << "Error: Failed to read object file " << fn << "; skipping" << endl; continue;}
+			bool const match(serial_hash == parallel_hash);
+			if (!match) {std::cerr << "Error: Serial and parallel object file parsers differ for " << fn << endl;}
+			float const mb(get_file_size(fn)/float(1 << 20)), serial_mbps(1000.0f*mb/max(serial_ms, 0.001f)), parallel_mbps(1000.0f*mb/max(parallel_ms, 0.001f));
+			cout << "Object file parse " << fn << ": serial " << serial_mbps << " MB/s, parallel " << parallel_mbps << " MB/s" << endl;
+			out << (num_written++ ? "," : "") << "\n    ";
+			bench_json_t(out).add("file", fn).add("mb", mb).add("threads", omp_get_max_threads()).add("serial_parse_ms", serial_ms).add("parallel_parse_ms", parallel_ms)
+				.add("serial_mb_per_s", serial_mbps).add("parallel_mb_per_s", parallel_mbps).add("results_match", match).end();
+			continue;
+		}
+		texture_manager tmgr; // textures aren't loaded
+		model3d model(fn, tmgr);
+		
+		if (!model.read_from_disk(fn)) {
+			std::cerr << "Error: Failed to read model3d file " << fn << "; skipping" << endl;
+			continue;
+		}
+		model.compute_area_per_tri();
+		string const v1_fn(fn + ".v1.tmp"), v2_fn(fn + ".v2.tmp");
+		if (!model.write_to_disk(v1_fn, 1) || !model.write_to_disk(v2_fn, 0)) {std::cerr << "Error: Failed to write temporary model3d files for " << fn << endl; continue;}
+		model3d_stats_t stats;
+		model.get_stats(stats);
+		float v2_lazy_mat_ms(0.0);
+		model3d_lazy_materials = 0;
+		float const v1_ms(time_model3d_read(model, v1_fn, NUM_ITERS)), v2_eager_ms(time_model3d_read(model, v2_fn, NUM_ITERS));
+		model3d_lazy_materials = 1;
+		float const v2_lazy_ms(time_model3d_read(model, v2_fn, NUM_ITERS, &v2_lazy_mat_ms));
+		uint64_t const v1_bytes(get_file_size(v1_fn)), v2_bytes(get_file_size(v2_fn));
+		std::remove(v1_fn.c_str());
+		std::remove(v2_fn.c_str());
+		cout << "Model3d load " << fn << ": v1 " << v1_ms << "ms, v2 " << v2_eager_ms << "ms, v2 lazy " << v2_lazy_ms << "ms + " << v2_lazy_mat_ms << "ms on first draw" << endl;
+		out << (num_written++ ? "," : "") << "\n    ";
+		bench_json_t(out).add("file", fn).add("materials", stats.mats).add("verts", stats.verts).add("tris", stats.tris).add("quads", stats.quads).add("v1_bytes", v1_bytes)
+			.add("v2_bytes", v2_bytes).add("v1_load_ms", v1_ms).add("v2_load_ms", v2_eager_ms).add("v2_lazy_load_ms", v2_lazy_ms).add("v2_lazy_first_draw_ms", v2_lazy_mat_ms).end();
+	} // for fn
+	out << "\n  ]";
+	model3d_lazy_materials = prev_lazy;
+	return res.finish((num_written == files.size()) ? 0 : 1);
+}
+
+
+// loads all textures with the same parallel path used for model textures; returns the time in ms and a hash of the loaded texels
+float time_texture_load(vector<string> const &files, uint64_t &hash) {
+
+	texture_manager tmgr;
+	vector<unsigned> tids;
+	auto const start(high_resolution_clock::now());
+	
+	for (string const &fn : files) {
+		tids.push_back(tmgr.create_texture(fn, 0, 0)); // is_alpha_mask=0, verbose=0
+		tmgr.add_work_item(tids.back(), 0); // is_nm=0
+	}
+	tmgr.load_work_items_mt();
+	float const ms(1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - start).count());
+	fnv1a_hash_t texels_hash;
+
+	for (unsigned tid : tids) {
+		texture_t const &t(tmgr.get_texture(tid));
+		if (t.is_allocated()) {texels_hash.add_bytes(t.get_data(), t.num_bytes());} // else deferred load
+	}
+	hash = texels_hash.hash;
+	tmgr.free_client_mem();
+	return ms;
+}
+
+// compares texture load times with the decoded texture cache disabled, cold (decode + write), and warm (read only)
+int run_texture_load_benchmark(char const *out_fn, int num_fns, char const *const *fns) {
+
+	vector<string> files(fns, fns+num_fns);
+	if (files.empty()) {files = {"lichen.jpg", "grass_new.jpg", "hedges.jpg", "final1024.jpg", "wood.jpg", "bricks_tan.png", "shingles.jpg", "starburst.png", "sky.jpg", "marble2.jpg"};}
+	bench_output_t res("texture load", out_fn, "texture_bench.json");
+	if (!res.open()) return 1;
+	for (string const &fn : files) {
+		if (!check_texture_file_exists(fn)) {std::cerr << "Error: Texture file " << fn << " not found" << endl; return 1;}
+	}
+	string const prev_cache_dir(texture_decode_cache_dir);
+	string const cache_dir(prev_cache_dir.empty() ? "texture_cache" : prev_cache_dir);
+	uint64_t decode_hash(0), cold_hash(0), warm_hash(0);
+	texture_decode_cache_dir.clear();
+	float const decode_ms(time_texture_load(files, decode_hash));
+	texture_decode_cache_dir = cache_dir;
+	
+	for (string const &fn : files) { // remove any existing cache files so that the cold pass has to decode
+		texture_manager tmgr;
+		string const cache_fn(tmgr.get_texture(tmgr.create_texture(fn, 0, 0)).get_decode_cache_fn(-1, 0, 0, 0)); // same args as ensure_texture_loaded()
+		if (!cache_fn.empty()) {std::remove(cache_fn.c_str());}
+	}
+	float const cold_ms(time_texture_load(files, cold_hash)), warm_ms(time_texture_load(files, warm_hash));
+	texture_decode_cache_dir = prev_cache_dir;
+	bool const match(cold_hash == decode_hash && warm_hash == decode_hash);
+	if (!match) {std::cerr << "Error: Cached textures differ from decoded textures" << endl;}
+	cout << "Texture load of " << files.size() << " files: no cache " << decode_ms << "ms, cold " << cold_ms << "ms, warm " << warm_ms << "ms" << endl;
+	res.json.add("threads", omp_get_max_threads()).add("num_textures", files.size()).add("cache_dir", cache_dir).add("no_cache_ms", decode_ms)
+		.add("cold_ms", cold_ms).add("warm_ms", warm_ms).add("results_match", match);
+	return res.finish(match ? 0 : 1);
+}
+
+// times per-point scalar evaluation vs. bulk SIMD evaluation of tile heights; returns the samples per second of each
+void time_mesh_height_gen(unsigned num_tiles, unsigned tile_sz, double &scalar_sps, double &simd_sps, float &max_abs_err, float &max_rel_err) {
+
+	unsigned const num_iters(3);
+	vector<float> ref_vals(tile_sz*tile_sz), simd_vals(tile_sz*tile_sz);
+	float scalar_ms(0.0), simd_ms(0.0), max_abs_val(0.0);
+	max_abs_err = 0.0;
+
+	for (unsigned t = 0; t < num_tiles; ++t) {
+		mesh_xy_grid_cache_t height_gen; // setup as in tiled terrain tile_t::create_zvals()
+		height_gen.build_arrays(float(t*(tile_sz-1))*DX_VAL, float(t%4)*float(tile_sz-1)*DY_VAL, DX_VAL, DY_VAL, tile_sz, tile_sz);
+		height_gen.enable_glaciate();
+		float best_scalar_ms(0.0), best_simd_ms(0.0);
+
+		for (unsigned n = 0; n < num_iters; ++n) {
+			auto const start(high_resolution_clock::now());
+#pragma omp parallel for schedule(static,1)
+			for (int y = 0; y < (int)tile_sz; ++y) {
+				for (unsigned x = 0; x < tile_sz; ++x) {ref_vals[y*tile_sz + x] = height_gen.eval_index(x, y);}
+			}
+			auto const mid(high_resolution_clock::now());
+			height_gen.eval_all(simd_vals.data());
+			float const sc_ms(1000.0f*duration_cast<duration<float>>(mid - start).count()), si_ms(1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - mid).count());
+			best_scalar_ms = ((n == 0) ? sc_ms : min(best_scalar_ms, sc_ms));
+			best_simd_ms   = ((n == 0) ? si_ms : min(best_simd_ms,   si_ms));
+		}
+		scalar_ms += best_scalar_ms;
+		simd_ms   += best_simd_ms;
+
+		for (unsigned i = 0; i < ref_vals.size(); ++i) {
+			max_eq(max_abs_err, fabs(simd_vals[i] - ref_vals[i]));
+			max_eq(max_abs_val, fabs(ref_vals[i]));
+		}
+	}
+	double const num_samples(double(num_tiles)*tile_sz*tile_sz);
+	scalar_sps  = 1000.0*num_samples/max(scalar_ms, 1.0E-6f);
+	simd_sps    = 1000.0*num_samples/max(simd_ms,   1.0E-6f);
+	max_rel_err = ((max_abs_val > 0.0) ? max_abs_err/max_abs_val : 0.0);
+}
+
+// compares scalar vs. SIMD CPU heightmap generation for the sine, simplex, and perlin mesh gen modes; perlin has no SIMD version;
+// the SSE path is always checked, and the AVX2 path is also checked if the CPU supports it
+int run_mesh_gen_benchmark(char const *out_fn) {
+
+	cout << "Running mesh height generation benchmark" << endl;
+	init_bench_terrain();
+	bench_output_t res("mesh gen", out_fn, "mesh_gen_bench.json");
+	if (!res.open()) return 1;
+	unsigned const num_tiles(16), tile_sz(257);
+	float const tolerance(1.0E-4); // max error relative to the max height
+	int const modes[3] = {MGEN_SINE, MGEN_SIMPLEX, MGEN_PERLIN};
+	char const *const mode_names[3] = {"sine", "simplex", "perlin"};
+	char const *const path_names[2] = {"sse", "avx2"};
+	unsigned const num_paths(mesh_xy_grid_cache_t::cpu_has_avx2() ? 2 : 1);
+	int const prev_mode(mesh_gen_mode);
+	bool const prev_allow_avx2(mesh_xy_grid_cache_t::allow_avx2);
+	bool all_match(1);
+	res.json.add("threads", omp_get_max_threads()).add("cpu_has_avx2", mesh_xy_grid_cache_t::cpu_has_avx2()).add("tiles", num_tiles).add("tile_size", tile_sz);
+	res.json.add_object("modes", [&](bench_json_t &o) {
+		for (unsigned m = 0; m < 3; ++m) {
+			mesh_gen_mode = modes[m];
+			o.add_object(mode_names[m], [&](bench_json_t &r) {
+				for (unsigned p = 0; p < num_paths; ++p) {
+					mesh_xy_grid_cache_t::allow_avx2 = (p == 1);
+					double scalar_sps(0.0), simd_sps(0.0);
+					float max_abs_err(0.0), max_rel_err(0.0);
+					time_mesh_height_gen(num_tiles, tile_sz, scalar_sps, simd_sps, max_abs_err, max_rel_err);
+					bool const match(max_rel_err <= tolerance);
+					all_match &= match;
+					if (!match) {std::cerr << "Error: " << path_names[p] << " " << mode_names[m] << " mesh heights differ from scalar heights by " << max_abs_err << endl;}
+					cout << "Mesh gen " << mode_names[m] << ": scalar " << scalar_sps << " samples/s, " << path_names[p] << " " << simd_sps << " samples/s, speedup " << simd_sps/scalar_sps << endl;
+					r.add_object(path_names[p], [&](bench_json_t &q) {
+						q.add("simd_width", mesh_xy_grid_cache_t::get_simd_width()).add("scalar_samples_per_sec", scalar_sps).add("simd_samples_per_sec", simd_sps)
+							.add("speedup", simd_sps/scalar_sps).add("max_abs_err", max_abs_err).add("max_rel_err", max_rel_err).add("within_tolerance", match);
+					});
+				} // for p
+			});
+		}
+	});
+	mesh_gen_mode = prev_mode;
+	mesh_xy_grid_cache_t::allow_avx2 = prev_allow_avx2;
+	res.json.add("tolerance", tolerance);
+	return res.finish(all_match ? 0 : 1);
+}
+
+
+// compares the time to compute tiled terrain mesh shadows for a full day of sun positions using ray marching (the default)
+// vs. shadows derived from precomputed per-tile horizon maps; also reports how often the two methods agree
+int run_horizon_shadow_benchmark(char const *out_fn) {
+
+	cout << "Running horizon map shadow benchmark" << endl;
+	init_bench_terrain();
+	bench_output_t res("horizon shadow", out_fn, "horizon_shadow_bench.json");
+	if (!res.open()) return 1;
+	unsigned const tile_sz(MESH_X_SIZE), grid_tiles(4), grid_sz(grid_tiles*tile_sz + 2), num_tiles(grid_tiles*grid_tiles), num_steps(96);
+	float const min_agreement(0.9);
+	vector<float> heights(grid_sz*grid_sz);
+	mesh_xy_grid_cache_t height_gen; // setup as in tiled terrain tile_t::create_zvals()
+	height_gen.build_arrays(get_xval(0), get_yval(0), DX_VAL, DY_VAL, grid_sz, grid_sz);
+	height_gen.enable_glaciate();
+	height_gen.eval_all(heights.data());
+	vector<horizon_map_t> horizon_maps(num_tiles);
+	vector<unsigned char> march_smask(heights.size()), tile_smask(tile_sz*tile_sz);
+	vector<float> ctx_heights;
+	auto const pre_start(high_resolution_clock::now());
+
+	for (unsigned t = 0; t < num_tiles; ++t) { // each tile's horizon map includes occluders up to one tile away, which is the context used by tile_t
+		unsigned const x0((t%grid_tiles)*tile_sz), y0((t/grid_tiles)*tile_sz);
+		unsigned const cx1((x0 > tile_sz) ? x0-tile_sz : 0), cy1((y0 > tile_sz) ? y0-tile_sz : 0), cx2(min(grid_sz, x0+2*tile_sz)), cy2(min(grid_sz, y0+2*tile_sz));
+		ctx_heights.clear();
+
+		for (unsigned y = cy1; y < cy2; ++y) {
+			for (unsigned x = cx1; x < cx2; ++x) {ctx_heights.push_back(heights[y*grid_sz + x]);}
+		}
+		horizon_maps[t].calc(ctx_heights.data(), (cx2 - cx1), (cy2 - cy1), (x0 - cx1), (y0 - cy1), tile_sz, tile_sz, DX_VAL, DY_VAL);
+	}
+	float const precompute_ms(1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - pre_start).count());
+	float march_ms(0.0), horizon_ms(0.0);
+	uint64_t num_agree(0), num_shadowed(0);
+
+	for (unsigned s = 0; s < num_steps; ++s) { // sweep the sun from sunrise to sunset
+		float const angle(PI*(s + 0.5f)/num_steps);
+		point const lpos(1.0E4*vector3d(cosf(angle), 0.3f, sinf(angle)).get_norm());
+		auto const start(high_resolution_clock::now());
+		calc_mesh_shadows(LIGHT_SUN, lpos, heights.data(), march_smask.data(), grid_sz, grid_sz);
+		auto const mid(high_resolution_clock::now());
+		march_ms += 1000.0f*duration_cast<duration<float>>(mid - start).count();
+
+		for (unsigned t = 0; t < num_tiles; ++t) {
+			auto const tile_start(high_resolution_clock::now());
+			horizon_maps[t].calc_shadows(LIGHT_SUN, lpos, tile_smask.data());
+			horizon_ms += 1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - tile_start).count();
+			unsigned const x0((t%grid_tiles)*tile_sz), y0((t/grid_tiles)*tile_sz);
+
+			for (unsigned y = 0; y < tile_sz; ++y) {
+				for (unsigned x = 0; x < tile_sz; ++x) {
+					bool const march_sh((march_smask[(y + y0)*grid_sz + (x + x0)] & MESH_SHADOW) != 0), horizon_sh((tile_smask[y*tile_sz + x] & MESH_SHADOW) != 0);
+					num_agree    += (march_sh == horizon_sh);
+					num_shadowed += march_sh;
+				}
+			}
+		} // for t
+	} // for s
+	double const num_samples(double(num_steps)*num_tiles*tile_sz*tile_sz);
+	float const agreement(num_agree/num_samples), shadowed(num_shadowed/num_samples);
+	bool const match(agreement >= min_agreement);
+	if (!match) {std::cerr << "Error: Horizon map shadows agree with ray marched shadows for only " << 100.0*agreement << "% of texels" << endl;}
+	cout << "Sun sweep of " << num_steps << " steps over " << num_tiles << " tiles: ray march " << march_ms << "ms, horizon map " << horizon_ms << "ms + "
+		 << precompute_ms << "ms precompute, speedup " << march_ms/max(horizon_ms, 1.0E-6f) << ", agreement " << 100.0*agreement << "%" << endl;
+	res.json.add("threads", omp_get_max_threads()).add("tiles", num_tiles).add("tile_size", tile_sz).add("sun_steps", num_steps).add("horizon_dirs", NUM_HORIZON_DIRS)
+		.add("ray_march_ms", march_ms).add("horizon_precompute_ms", precompute_ms).add("horizon_sweep_ms", horizon_ms).add("sweep_speedup", march_ms/max(horizon_ms, 1.0E-6f))
+		.add("speedup_with_precompute", march_ms/max((horizon_ms + precompute_ms), 1.0E-6f)).add("shadowed_fraction", shadowed).add("agreement", agreement)
+		.add("min_agreement", min_agreement);
+	return res.finish(match ? 0 : 1);
+}
+
+// generates buildings as in run_headless_benchmark(), then times building indirect lighting convergence for the building with the most lights on one floor,
+// comparing the default of one light at a time split across threads with batches of lights processed concurrently with per-thread lighting accumulation;
+// if building_indir_light_cache_dir is set, also times converging twice more with the disk cache, where the second run should be a cache hit
+int run_indir_lighting_benchmark(char const *out_fn) {
+
+	cout << "Running building indirect lighting benchmark" << endl;
+	gen_bench_city(1); // room_details=1
+	unsigned bix(0), floor_lights(0);
+	point target;
+	building_t const *const b(get_indir_lighting_bench_building(bix, target, floor_lights));
+
+	if (b == nullptr) {
+		std::cerr << "Error: No buildings with lights found for indirect lighting benchmark" << endl;
+		return 1;
+	}
+	bench_output_t res("indirect lighting", out_fn, "indir_lighting_bench.json");
+	if (!res.open()) return 1;
+	unsigned const batch_sizes[2] = {1, ((indir_light_batch_size > 1) ? indir_light_batch_size : max(2U, NUM_THREADS-1))};
+	unsigned num_lights[2] = {0};
+	float converge_ms[2] = {0.0};
+	string const cache_dir(building_indir_cache_dir);
+	building_indir_cache_dir.clear(); // disable the cache for timing ray casting
+
+	for (unsigned n = 0; n < 2; ++n) {
+		converge_ms[n] = b->run_indir_lighting_to_convergence(bix, target, batch_sizes[n], num_lights[n]);
+		cout << "Indirect lighting batch size " << batch_sizes[n] << ": " << num_lights[n] << " lights converged in " << converge_ms[n] << "ms, "
+			 << 1000.0f*num_lights[n]/max(converge_ms[n], 1.0E-6f) << " lights/sec" << endl;
+	}
+	building_indir_cache_dir = cache_dir;
+	unsigned cache_lights[2] = {0}, hits(0), misses(0);
+	float cache_ms[2] = {0.0};
+	double saved_ms(0.0);
+
+	if (!cache_dir.empty()) { // first run writes the cache entry unless it already exists from a previous run
+		for (unsigned n = 0; n < 2; ++n) {cache_ms[n] = b->run_indir_lighting_to_convergence(bix, target, batch_sizes[1], cache_lights[n]);}
+		get_building_indir_cache_stats(hits, misses, saved_ms);
+		cout << "Indirect lighting cache: " << cache_ms[0] << "ms first run, " << cache_ms[1] << "ms second run, " << hits << " hits, " << misses << " misses" << endl;
+	}
+	bool const match(num_lights[0] == num_lights[1] && (cache_dir.empty() || (cache_lights[0] == num_lights[0] && cache_lights[1] == num_lights[0])));
+	if (!match) {std::cerr << "Error: Batched or cached indirect lighting added a different number of lights than " << num_lights[0] << endl;}
+	res.json.add("threads", NUM_THREADS).add("building_parts", b->parts.size()).add("floor_lights", floor_lights).add("rays_per_light", LOCAL_RAYS);
+	res.json.add_array("modes", 2, [&](bench_json_t &o, unsigned n) {
+		o.add("batch_size", batch_sizes[n]).add("lights", num_lights[n]).add("time_to_converge_ms", converge_ms[n]).add("lights_per_sec", 1000.0f*num_lights[n]/max(converge_ms[n], 1.0E-6f));
+	});
+	res.json.add("speedup", converge_ms[0]/max(converge_ms[1], 1.0E-6f));
+
+	if (!cache_dir.empty()) {
+		res.json.add_object("cache", [&](bench_json_t &o) {
+			o.add("first_run_ms", cache_ms[0]).add("second_run_ms", cache_ms[1]).add("hits", hits).add("misses", misses)
+				.add("hit_rate", ((hits + misses) ? float(hits)/(hits + misses) : 0.0f)).add("ray_cast_ms_saved", saved_ms);
+		});
+	}
+	res.json.add("lights_match", match);
+	return res.finish(match ? 0 : 1);
+}
+
+// generates cities with num_cars cars (or the config file value if zero), then steps the car simulation for num_frames frames with 1, 2, 4, ... threads up to the max;
+// reports ms per frame and speedup for each thread count, and how often the incremental car sort had to fall back to a full sort
+int run_car_sim_benchmark(char const *out_fn, unsigned num_cars, unsigned num_frames) {
+
+	cout << "Running car simulation benchmark" << endl;
+	gen_bench_city(0, num_cars); // room_details=0
+	if (num_frames == 0) {num_frames = 500;}
+	unsigned const actual_cars(get_city_num_cars());
+
+	if (actual_cars == 0) {
+		std::cerr << "Error: No cars were placed for car simulation benchmark; cities and num_cars must be enabled in the config file" << endl;
+		return 1;
+	}
+	bench_output_t res("car simulation", out_fn, "car_sim_bench.json");
+	if (!res.open()) return 1;
+	run_car_sim_bench_frames(max(1U, num_frames/4), 1); // warm up and let traffic spread out from the initial placement
+	unsigned incr_sorts0(0), full_sorts0(0), incr_sorts(0), full_sorts(0);
+	get_car_sort_stats(incr_sorts0, full_sorts0);
+	unsigned const max_threads(omp_get_max_threads());
+	vector<pair<unsigned, float>> results; // {threads, ms per frame}
+	// Note: the simulation continues from where the previous thread count left off rather than restarting, so traffic differs slightly between runs
+	for (unsigned t = 1; ; t *= 2) {
+		unsigned const num_threads(min(t, max_threads));
+		float const ms(run_car_sim_bench_frames(num_frames, num_threads));
+		results.emplace_back(num_threads, ms);
+		cout << "Car simulation of " << actual_cars << " cars with " << num_threads << " threads: " << ms << " ms/frame, speedup " << results.front().second/max(ms, 1.0E-6f) << endl;
+		if (num_threads == max_threads) break;
+	}
+	get_car_sort_stats(incr_sorts, full_sorts);
+	incr_sorts -= incr_sorts0;
+	full_sorts -= full_sorts0;
+	res.json.add("max_threads", max_threads).add("cars", actual_cars).add("frames", num_frames);
+	res.json.add_array("runs", results.size(), [&](bench_json_t &o, unsigned n) {
+		o.add("threads", results[n].first).add("ms_per_frame", results[n].second).add("speedup", results.front().second/max(results[n].second, 1.0E-6f));
+	});
+	res.json.add_object("sorts", [&](bench_json_t &o) {o.add("incremental", incr_sorts).add("full", full_sorts);});
+	return res.finish(0);
+}
+
+// generates cities with num_peds pedestrians (100K if zero), then steps all pedestrians for num_frames frames with 1, 2, 4, ... threads up to the max;
+// each thread count starts from the same state, and the final pedestrian states are compared to check that the update doesn't depend on the thread count
+int run_ped_sim_benchmark(char const *out_fn, unsigned num_peds, unsigned num_frames) {
+
+	cout << "Running pedestrian simulation benchmark" << endl;
+	gen_bench_city(0, 0, ((num_peds > 0) ? num_peds : 100000)); // room_details=0, num_cars=0 (use config file value)
+	if (num_frames == 0) {num_frames = 100;}
+	unsigned const actual_peds(get_city_num_peds());
+
+	if (actual_peds == 0) {
+		std::cerr << "Error: No pedestrians were placed for pedestrian simulation benchmark; cities must be enabled in the config file" << endl;
+		return 1;
+	}
+	bench_output_t res("pedestrian simulation", out_fn, "ped_sim_bench.json");
+	if (!res.open()) return 1;
+	uint64_t hash(0);
+	run_ped_sim_bench_frames(max(1U, num_frames/4), 1, 0, hash); // warm up, choose initial destinations, and let peds spread out; restore_state=0
+	unsigned const max_threads(omp_get_max_threads());
+	vector<pair<unsigned, float>> results; // {threads, ms per frame}
+	vector<uint64_t> hashes;
+
+	for (unsigned t = 1; ; t *= 2) {
+		unsigned const num_threads(min(t, max_threads));
+		float const ms(run_ped_sim_bench_frames(num_frames, num_threads, 1, hash)); // restore_state=1
+		results.emplace_back(num_threads, ms);
+		hashes.push_back(hash);
+		cout << "Pedestrian simulation of " << actual_peds << " peds with " << num_threads << " threads: " << ms << " ms/frame, speedup " << results.front().second/max(ms, 1.0E-6f) << endl;
+		if (num_threads == max_threads) break;
+	}
+	bool deterministic(1);
+	for (uint64_t h : hashes) {deterministic &= (h == hashes.front());}
+	if (!deterministic) {std::cerr << "Error: Pedestrian simulation results depend on the number of threads" << endl;}
+	res.json.add("max_threads", max_threads).add("peds", actual_peds).add("frames", num_frames);
+	res.json.add_array("runs", results.size(), [&](bench_json_t &o, unsigned n) {
+		o.add("threads", results[n].first).add("ms_per_frame", results[n].second).add("speedup", results.front().second/max(results[n].second, 1.0E-6f)).add_hex("hash", hashes[n]);
+	});
+	res.json.add("deterministic", deterministic);
+	return res.finish(deterministic ? 0 : 1);
+}
+
+// generates buildings as in run_headless_benchmark(), then finds paths for num_people people (200 if zero) who repeatedly walk to rooms chosen by
+// choose_dest_room() in the office building with the most rooms, for num_queries queries (20K if zero); compares A* for each query with the cached next-hop tables,
+// with a door toggled every 100 queries, and reports queries per second and the cache hit ratio
+int run_building_path_benchmark(char const *out_fn, unsigned num_people, unsigned num_queries) {
+
+	cout << "Running building path finding benchmark" << endl;
+	gen_bench_city(1); // room_details=1
+	if (num_people  == 0) {num_people  = 200;}
+	if (num_queries == 0) {num_queries = 20000;}
+	unsigned num_rooms(0);
+	building_t *const b(get_nav_path_bench_building(num_rooms));
+
+	if (b == nullptr) {
+		std::cerr << "Error: No office buildings with interiors found for building path finding benchmark" << endl;
+		return 1;
+	}
+	bench_output_t res("building path finding", out_fn, "building_path_bench.json");
+	if (!res.open()) return 1;
+	unsigned const door_toggle_period(100);
+	bool const prev_path_cache(global_building_params.ai_path_cache);
+	char const *const mode_names[2] = {"a_star", "cache"};
+	unsigned num_found[2] = {0};
+	float ms[2] = {0.0};
+	uint64_t queries[2] = {0}, hits(0), tables(0), invalidations(0);
+
+	for (unsigned n = 0; n < 2; ++n) {
+		global_building_params.ai_path_cache = (n == 1);
+		reset_building_nav_path_stats();
+		ms[n] = b->run_nav_path_benchmark(num_people, num_queries, door_toggle_period, num_found[n]);
+		get_building_nav_path_stats(queries[n], hits, tables, invalidations);
+		cout << "Building path finding with " << mode_names[n] << ": " << num_queries << " routes, " << queries[n] << " path queries, " << num_found[n]
+			 << " found in " << ms[n] << "ms, " << 1000.0f*queries[n]/max(ms[n], 1.0E-6f) << " queries/sec" << endl;
+	}
+	global_building_params.ai_path_cache = prev_path_cache;
+	float const hit_ratio((hits + tables) ? float(hits)/(hits + tables) : 0.0f);
+	cout << "Building path cache: " << hits << " hits, " << tables << " tables built, " << invalidations << " invalidations, hit ratio " << hit_ratio << endl;
+	res.json.add("rooms", num_rooms).add("people", num_people).add("routes", num_queries).add("door_toggle_period", door_toggle_period);
+	res.json.add_array("modes", 2, [&](bench_json_t &o, unsigned n) {
+		o.add("mode", mode_names[n]).add("queries", queries[n]).add("routes_found", num_found[n]).add("time_ms", ms[n]).add("queries_per_sec", 1000.0f*queries[n]/max(ms[n], 1.0E-6f));
+	});
+	res.json.add("speedup", ms[0]/max(ms[1], 1.0E-6f));
+	res.json.add_object("cache", [&](bench_json_t &o) {o.add("hits", hits).add("tables_built", tables).add("invalidations", invalidations).add("hit_ratio", hit_ratio);});
+	return res.finish(0);
+}
+
+// generates buildings as in run_headless_benchmark(), then simulates num_pursuers people (1000 if zero) chasing a moving player on the floor with the most rooms
+// of the office building with the most rooms for num_frames frames (100 if zero); compares finding a path for each person with the shared flow field,
+// and reports ms per frame, time per pursuer, and how often each part of the flow field was rebuilt
+int run_pursuit_benchmark(char const *out_fn, unsigned num_pursuers, unsigned num_frames) {
+
+	cout << "Running building pursuit benchmark" << endl;
+	gen_bench_city(1); // room_details=1
+	if (num_pursuers == 0) {num_pursuers = 1000;}
+	if (num_frames   == 0) {num_frames   = 100;}
+	unsigned num_rooms(0);
+	building_t *const b(get_nav_path_bench_building(num_rooms));
+
+	if (b == nullptr) {
+		std::cerr << "Error: No office buildings with interiors found for building pursuit benchmark" << endl;
+		return 1;
+	}
+	bench_output_t res("building pursuit", out_fn, "pursuit_bench.json");
+	if (!res.open()) return 1;
+	char const *const mode_names[2] = {"per_person_paths", "flow_field"};
+	unsigned num_paths[2] = {0}, num_contacts[2] = {0}, grid_builds(0), room_builds(0), player_builds(0);
+	float ms[2] = {0.0};
+
+	for (unsigned n = 0; n < 2; ++n) {
+		ms[n] = b->run_pursuit_benchmark(num_pursuers, num_frames, (n == 1), num_paths[n], num_contacts[n]);
+		cout << "Building pursuit with " << mode_names[n] << ": " << num_pursuers << " pursuers, " << ms[n]/num_frames << " ms/frame, "
+			 << 1000.0f*ms[n]/(num_frames*num_pursuers) << " us/pursuer, " << num_paths[n] << " paths, " << num_contacts[n] << " contacts" << endl;
+	}
+	get_building_flow_field_stats(grid_builds, room_builds, player_builds);
+	cout << "Flow field rebuilds: " << grid_builds << " grid, " << room_builds << " room distance, " << player_builds << " player distance" << endl;
+	res.json.add("rooms", num_rooms).add("pursuers", num_pursuers).add("frames", num_frames);
+	res.json.add_array("modes", 2, [&](bench_json_t &o, unsigned n) {
+		o.add("mode", mode_names[n]).add("ms_per_frame", ms[n]/num_frames).add("us_per_pursuer", 1000.0f*ms[n]/(num_frames*num_pursuers))
+			.add("paths", num_paths[n]).add("contacts", num_contacts[n]);
+	});
+	res.json.add("speedup", ms[0]/max(ms[1], 1.0E-6f));
+	res.json.add_object("flow_field_rebuilds", [&](bench_json_t &o) {o.add("grid", grid_builds).add("room_dist", room_builds).add("player_dist", player_builds);});
+	return res.finish(0);
+}
+
+struct bench_args_t { // command line arguments after the benchmark name
+	char const *out_fn; // nullptr selects the default output file
+	int num_args;
+	char const *const *args;
+	unsigned get_uint(int ix) const {return ((ix < num_args) ? atoi(args[ix]) : 0);} // zero selects the default
+};
+struct command_line_bench_t {
+	char const *name;
+	int (*run)(bench_args_t const &args); // returns the process exit code
+};
+// usage: 3dworld <name> [<output.json> [<args> ...]], where the additional args are listed for each benchmark
+command_line_bench_t const command_line_benches[] = {
+	{"-headless",             [](bench_args_t const &a) {return run_headless_benchmark      (a.out_fn);}},
+	{"-model3d_bench",        [](bench_args_t const &a) {return run_model3d_load_benchmark  (a.out_fn, a.num_args, a.args);}}, // [<file.model3d|file.obj> ...]
+	{"-texture_bench",        [](bench_args_t const &a) {return run_texture_load_benchmark  (a.out_fn, a.num_args, a.args);}}, // [<image file> ...]
+	{"-mesh_gen_bench",       [](bench_args_t const &a) {return run_mesh_gen_benchmark      (a.out_fn);}},
+	{"-horizon_shadow_bench", [](bench_args_t const &a) {return run_horizon_shadow_benchmark(a.out_fn);}},
+	{"-indir_lighting_bench", [](bench_args_t const &a) {return run_indir_lighting_benchmark(a.out_fn);}},
+	{"-car_sim_bench",        [](bench_args_t const &a) {return run_car_sim_benchmark       (a.out_fn, a.get_uint(0), a.get_uint(1));}}, // [<num_cars> [<num_frames>]]
+	{"-ped_sim_bench",        [](bench_args_t const &a) {return run_ped_sim_benchmark       (a.out_fn, a.get_uint(0), a.get_uint(1));}}, // [<num_peds> [<num_frames>]]
+	{"-building_path_bench",  [](bench_args_t const &a) {return run_building_path_benchmark (a.out_fn, a.get_uint(0), a.get_uint(1));}}, // [<num_people> [<num_queries>]]
+	{"-pursuit_bench",        [](bench_args_t const &a) {return run_pursuit_benchmark       (a.out_fn, a.get_uint(0), a.get_uint(1));}}, // [<num_pursuers> [<num_frames>]]
+	{"-building_query_bench", [](bench_args_t const &a) {return run_building_query_benchmark(a.out_fn, a.get_uint(0));}}, // [<num_queries>]
+};
+
+command_line_bench_t const *find_command_line_benchmark(int argc, char const *const *argv) {
+	if (argc < 2) return nullptr;
+
+	for (command_line_bench_t const &b : command_line_benches) {
+		if (strcmp(argv[1], b.name) == 0) return &b;
+	}
+	return nullptr;
+}
+bool is_command_line_benchmark(int argc, char const *const *argv) {return (find_command_line_benchmark(argc, argv) != nullptr);}
+
+int run_command_line_benchmark(int argc, char const *const *argv) { // runs the benchmark named by argv[1] without a window or GL context
+	command_line_bench_t const *const b(find_command_line_benchmark(argc, argv));
+	assert(b != nullptr);
+	return b->run(bench_args_t{((argc >= 3) ? argv[2] : nullptr), max(argc-3, 0), argv+3});
+}
@@ -0,0 +1,129 @@
+// 3D World - Terrain Horizon Maps for Fast Mesh Shadows
+// by Frank Gennari
+// 10/16/26
+#include "horizon_map.h"
+
+float const ANGLE_QUANT_SCALE = 255.0/PI_TWO; // maps [0, PI/2] to [0, 255]
+
+extern bool combined_gu;
+extern float zmin;
+
+
+// Computes the horizon angles for one direction by sweeping parallel digital lines across the context against the direction (cx, cy);
+// the upper convex hull of the heights already visited along each line gives the horizon of the next point in amortized constant time
+void calc_horizon_dir(float const *heights, unsigned ctx_xsize, unsigned ctx_ysize, unsigned x0, unsigned y0, unsigned xsize, unsigned ysize,
+	float dx, float dy, float cx, float cy, unsigned dir, unsigned char *angles)
+{
+	bool const x_major(fabs(cx) >= fabs(cy));
+	int const len(x_major ? ctx_xsize : ctx_ysize), width(x_major ? ctx_ysize : ctx_xsize); // along and across the lines
+	float const slope(x_major ? cy/cx : cx/cy); // minor axis texels per major axis texel
+	float const step_len(x_major ? sqrt(dx*dx + slope*slope*dy*dy) : sqrt(dy*dy + slope*slope*dx*dx)); // distance between line samples
+	bool const pos_dir((x_major ? cx : cy) > 0.0f);
+	int const span(int(ceil(fabs(slope)*(len - 1))) + 1);
+	vector<pair<float, float>> hull; // {distance, height}, sorted from far to near
+	hull.reserve(len);
+
+	for (int k = -span; k < width + span; ++k) { // iterate over lines, indexed by the minor axis position at major axis position 0
+		hull.clear();
+
+		for (int i = 0; i < len; ++i) { // visit points in the opposite direction of the horizon direction
+			int const major(pos_dir ? (len - 1 - i) : i), minor(int(floor(k + major*slope + 0.5f)));
+			if (minor < 0 || minor >= width) continue; // not on this line
+			int const x(x_major ? major : minor), y(x_major ? minor : major);
+			float const s((pos_dir ? major : -major)*step_len), h(heights[y*ctx_xsize + x]); // s increases along the horizon direction
+
+			while (hull.size() >= 2) { // remove points that are below the line from this point to the next point on the hull
+				pair<float, float> const &p1(hull.back()), &p2(hull[hull.size()-2]);
+				if ((p1.second - h)*(p2.first - s) > (p2.second - h)*(p1.first - s)) break; // p1 is above
+				hull.pop_back();
+			}
+			int const rx(x - x0), ry(y - y0); // position in the output region
+
+			if (rx >= 0 && ry >= 0 && rx < (int)xsize && ry < (int)ysize) {
+				float const max_tan(hull.empty() ? 0.0f : max(0.0f, (hull.back().second - h)/(hull.back().first - s)));
+				angles[NUM_HORIZON_DIRS*(ry*xsize + rx) + dir] = (unsigned char)min(255.0f, (ANGLE_QUANT_SCALE*atanf(max_tan) + 0.5f));
+			}
+			hull.emplace_back(s, h);
+		} // for i
+	} // for k
+}
+
+void horizon_map_t::calc(float const *heights, unsigned ctx_xsize, unsigned ctx_ysize, unsigned x0, unsigned y0, unsigned xsize_, unsigned ysize_, float dx, float dy) {
+
+	//timer_t timer("Calc Horizon Map");
+	assert(heights != nullptr);
+	assert(x0 + xsize_ <= ctx_xsize && y0 + ysize_ <= ctx_ysize);
+	xsize = xsize_;
+	ysize = ysize_;
+	angles.resize(NUM_HORIZON_DIRS*xsize*ysize);
+
+#pragma omp parallel for schedule(dynamic,1)
+	for (int d = 0; d < (int)NUM_HORIZON_DIRS; ++d) { // each direction writes a different angle of each texel
+		float const az(TWO_PI*d/NUM_HORIZON_DIRS);
+		float cx(cosf(az)), cy(sinf(az));
+		if (fabs(cx) < 1.0E-6) {cx = 0.0;} // exactly axis aligned
+		if (fabs(cy) < 1.0E-6) {cy = 0.0;}
+		calc_horizon_dir(heights, ctx_xsize, ctx_ysize, x0, y0, xsize, ysize, dx, dy, cx, cy, d, &angles.front());
+	}
+	calc_max_angles();
+}
+
+void horizon_map_t::calc_max_angles() {
+
+	bxsize = (xsize + HORIZON_BLOCK_SZ - 1)/HORIZON_BLOCK_SZ;
+	bysize = (ysize + HORIZON_BLOCK_SZ - 1)/HORIZON_BLOCK_SZ;
+	block_max.clear();
+	block_max.resize(NUM_HORIZON_DIRS*bxsize*bysize, 0);
+	for (unsigned d = 0; d < NUM_HORIZON_DIRS; ++d) {map_max[d] = 0;}
+
+	for (unsigned y = 0; y < ysize; ++y) {
+		for (unsigned x = 0; x < xsize; ++x) {
+			unsigned char const *const ta(&angles[NUM_HORIZON_DIRS*(y*xsize + x)]);
+			unsigned char *const bm(&block_max[NUM_HORIZON_DIRS*((y/HORIZON_BLOCK_SZ)*bxsize + (x/HORIZON_BLOCK_SZ))]);
+			for (unsigned d = 0; d < NUM_HORIZON_DIRS; ++d) {bm[d] = max(bm[d], ta[d]);}
+		}
+	}
+	for (unsigned i = 0; i < bxsize*bysize; ++i) {
+		for (unsigned d = 0; d < NUM_HORIZON_DIRS; ++d) {map_max[d] = max(map_max[d], block_max[NUM_HORIZON_DIRS*i + d]);}
+	}
+}
+
+
+void horizon_map_t::calc_shadows(unsigned l, point const &lpos, unsigned char *smask) const {
+
+	assert(smask != nullptr);
+	assert(!angles.empty());
+	unsigned const num_texels(xsize*ysize);
+	// same special cases as calc_mesh_shadows()
+	bool const no_shadow(l == LIGHT_MOON && combined_gu), all_shadowed(!no_shadow && lpos.z < zmin);
+	unsigned char const val(all_shadowed ? MESH_SHADOW : 0);
+	for (unsigned i = 0; i < num_texels; ++i) {smask[i] = val;}
+	if (no_shadow || all_shadowed || (lpos.x == 0.0 && lpos.y == 0.0)) return;
+	// the light is a directional light, so its elevation and azimuth are the same for every texel
+	vector3d const ldir(lpos.get_norm());
+	float const elev(ANGLE_QUANT_SCALE*atan2(ldir.z, sqrt(ldir.x*ldir.x + ldir.y*ldir.y)));
+	float az(atan2(ldir.y, ldir.x));
+	if (az < 0.0) {az += TWO_PI;}
+	float const fdir(az*NUM_HORIZON_DIRS/TWO_PI);
+	unsigned const d0(unsigned(fdir) % NUM_HORIZON_DIRS), d1((d0 + 1) % NUM_HORIZON_DIRS);
+	float const w1(fdir - floor(fdir)), w0(1.0f - w1);
+	// the interpolated horizon is never above the max of the two directions, so skip the map or blocks that are entirely lit
+	if (elev >= max(map_max[d0], map_max[d1])) return;
+
+	for (unsigned by = 0; by < bysize; ++by) {
+		for (unsigned bx = 0; bx < bxsize; ++bx) {
+			unsigned char const *const bm(&block_max[NUM_HORIZON_DIRS*(by*bxsize + bx)]);
+			if (elev >= max(bm[d0], bm[d1])) continue;
+			unsigned const x1(bx*HORIZON_BLOCK_SZ), y1(by*HORIZON_BLOCK_SZ), x2(min(xsize, x1+HORIZON_BLOCK_SZ)), y2(min(ysize, y1+HORIZON_BLOCK_SZ));
+
+			for (unsigned y = y1; y < y2; ++y) {
+				for (unsigned x = x1; x < x2; ++x) { // interpolate the horizon between the two closest directions
+					unsigned const i(y*xsize + x);
+					unsigned char const *const ta(&angles[NUM_HORIZON_DIRS*i]);
+					if (elev < w0*ta[d0] + w1*ta[d1]) {smask[i] |= MESH_SHADOW;}
+				}
+			}
+		} // for bx
+	} // for by
+}
+
@@ -0,0 +1,31 @@
+// 3D World - Terrain Horizon Maps for Fast Mesh Shadows
+// by Frank Gennari
+// 10/16/26
+#pragma once
+
+#include "3DWorld.h"
+
+unsigned const NUM_HORIZON_DIRS  = 16; // azimuth directions
+unsigned const HORIZON_BLOCK_SZ  = 8;  // size of texel blocks used to skip fully lit regions
+
+
+// stores the max elevation angle of the surrounding terrain for each texel in each of NUM_HORIZON_DIRS directions;
+// mesh shadows for any directional light position can then be computed in constant time per texel,
+// and the max angle of each block of texels and of the entire map allow lit regions to be skipped
+class horizon_map_t {
+
+	vector<unsigned char> angles, block_max; // quantized elevation angles in [0, PI/2], NUM_HORIZON_DIRS per texel/block
+	unsigned char map_max[NUM_HORIZON_DIRS] = {0};
+	unsigned xsize=0, ysize=0, bxsize=0, bysize=0;
+
+	void calc_max_angles();
+public:
+	bool empty() const {return angles.empty();}
+	void clear() {angles.clear(); block_max.clear(); xsize = ysize = bxsize = bysize = 0;}
+	size_t get_mem() const {return (angles.size() + block_max.size());}
+	// heights is a ctx_xsize x ctx_ysize grid of heights that contains the xsize x ysize region starting at (x0, y0) plus its surroundings;
+	// occluders outside of the context are ignored
+	void calc(float const *heights, unsigned ctx_xsize, unsigned ctx_ysize, unsigned x0, unsigned y0, unsigned xsize_, unsigned ysize_, float dx, float dy);
+	void calc_shadows(unsigned l, point const &lpos, unsigned char *smask) const; // sets MESH_SHADOW for shadowed texels; smask is xsize x ysize
+};
+
@@ -3,8 +3,12 @@
 // 10/14/13
 #include "targa.h"
 #include "textures.h"
+#include "mapped_file.h" // for get_file_mod_time_and_size()
 //#include "profiler.h"
 #include <fstream> // for filebuf
+#include <sstream>
+#include <atomic>
+#include <thread>
 
 using namespace std;
 
@@ -38,6 +42,11 @@ void wrap_png_error(png_structp, png_const_charp) {cerr << "Error reading PNG im
 
 
 string const texture_dir("textures");
+string texture_decode_cache_dir; // set in config file; empty = disabled
+
+unsigned const TEX_CACHE_MAGIC   = 0x54444543; // "CEDT"
+unsigned const TEX_CACHE_VERSION = 1; // increment when the decoders or post-load processing change
+std::atomic<unsigned> tex_cache_hits(0), tex_cache_misses(0);
 
 string append_texture_dir(string const &filename) {return (texture_dir + "/" + filename);}
 
@@ -102,6 +111,100 @@ bool check_texture_file_exists(string const &filename) {
 	checked_fclose(fp);
 	return 1;
 }
+string get_texture_file_path(string const &filename, uint64_t &mtime, uint64_t &size) { // same search order as open_texture_file(); returns "" if not found
+	string const tex_fn(append_texture_dir(filename));
+	if (get_file_mod_time_and_size(tex_fn,   mtime, size)) return tex_fn;
+	if (get_file_mod_time_and_size(filename, mtime, size)) return filename;
+	return "";
+}
+
+void print_texture_decode_cache_stats() {
+	if (texture_decode_cache_dir.empty()) return;
+	cout << "Texture decode cache: " << tex_cache_hits << " hits, " << tex_cache_misses << " misses" << endl;
+	tex_cache_hits = tex_cache_misses = 0;
+}
+
+
+// ************ decoded texture cache ************
+
+struct tex_cache_header_t { // all unsigned so that there's no padding
+	unsigned magic=TEX_CACHE_MAGIC, version=TEX_CACHE_VERSION, width=0, height=0, ncolors=0, format=0, is_16_bit_gray=0, num_bytes=0;
+};
+
+// the cache filename includes a hash of everything that affects the decoded texels: the source file path, modification time, and size, plus the load flags;
+// returns an empty string if caching is disabled or this texture can't be cached
+string texture_t::get_decode_cache_fn(int index, bool allow_diff_width_height, bool allow_two_byte_grayscale, bool ignore_word_alignment) const {
+
+	if (texture_decode_cache_dir.empty() || type > 0 || format == IMG_FMT_DDS) return ""; // generated or compressed texture
+	string const ext(get_file_extension(name, 0, 1));
+	if (ext == "dds" || ext == "hdr") return ""; // DDS is already GPU ready, and HDR is unsupported
+	uint64_t mtime(0), size(0);
+	string const path(get_texture_file_path(name, mtime, size));
+	if (path.empty()) return ""; // not found; let the loader report the error
+	int const vals[] = {index, width, height, ncolors, format, allow_diff_width_height, allow_two_byte_grayscale, ignore_word_alignment,
+		invert_y, invert_alpha, no_avg_color_alpha_fill, (int)TEX_CACHE_VERSION};
+	fnv1a_hash_t hash;
+	auto add_bytes([&hash](void const *data, size_t sz) {hash.add_bytes(data, sz);});
+	add_bytes(path.data(), path.size());
+	add_bytes(&mtime, sizeof(mtime));
+	add_bytes(&size,  sizeof(size));
+	add_bytes(vals,   sizeof(vals));
+	char hex[17] = {};
+	snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash.hash);
+	return (texture_decode_cache_dir + "/" + get_base_filename(name) + "." + hex + ".tcache");
+}
+
+bool texture_t::read_from_decode_cache(string const &cache_fn) {
+
+	FILE *fp(fopen(cache_fn.c_str(), "rb"));
+	if (fp == nullptr) return 0; // not cached
+	tex_cache_header_t header;
+	tex_cache_header_t const expected;
+	bool success(fread(&header, sizeof(header), 1, fp) == 1 && header.magic == expected.magic && header.version == expected.version &&
+		header.width > 0 && header.height > 0 && header.ncolors > 0 && header.num_bytes == header.width*header.height*header.ncolors);
+
+	if (success) {
+		width   = header.width;
+		height  = header.height;
+		ncolors = header.ncolors;
+		format  = (char)header.format;
+		is_16_bit_gray = (header.is_16_bit_gray != 0);
+		alloc();
+		success = (fread(data, header.num_bytes, 1, fp) == 1);
+		if (!success) {free_client_mem();}
+	}
+	checked_fclose(fp);
+	if (!success) {cerr << "Warning: Ignoring invalid texture cache file " << cache_fn << endl;}
+	return success;
+}
+
+void texture_t::write_to_decode_cache(string const &cache_fn) const {
+
+	if (!is_allocated() || !create_dir_if_missing(texture_decode_cache_dir)) return;
+	tex_cache_header_t header;
+	header.width   = width;
+	header.height  = height;
+	header.ncolors = ncolors;
+	header.format  = format;
+	header.is_16_bit_gray = is_16_bit_gray;
+	header.num_bytes      = num_bytes();
+	// write to a temp file first so that other threads/processes never see a partial cache file
+	std::ostringstream tmp_fn;
+	tmp_fn << cache_fn << "." << std::this_thread::get_id() << ".tmp";
+	FILE *fp(fopen(tmp_fn.str().c_str(), "wb"));
+	if (fp == nullptr) {cerr << "Warning: Failed to open texture cache file " << tmp_fn.str() << " for write" << endl; return;}
+	bool const success(fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(data, header.num_bytes, 1, fp) == 1);
+	checked_fclose(fp);
+	if (success && std::rename(tmp_fn.str().c_str(), cache_fn.c_str()) == 0) return;
+	std::remove(tmp_fn.str().c_str()); // failed to write, or another process already wrote the same cache file
+}
+
+uint64_t texture_t::get_load_cost() const { // used to schedule the most expensive textures first
+	if (type > 0) return 0; // generated
+	uint64_t mtime(0), size(0);
+	get_texture_file_path(name, mtime, size);
+	return size;
+}
 
 void texture_t::load(int index, bool allow_diff_width_height, bool allow_two_byte_grayscale, bool ignore_word_alignment) {
 
@@ -112,6 +215,12 @@ void texture_t::load(int index, bool allow_diff_width_height, bool allow_two_byt
 		memset(data, 0, num_bytes()); // zero the values to make sure we don't accidentally use it uninitialized before the texture is generated
 	}
 	else {
+		string const cache_fn(get_decode_cache_fn(index, allow_diff_width_height, allow_two_byte_grayscale, ignore_word_alignment));
+
+		if (!cache_fn.empty()) {
+			if (read_from_decode_cache(cache_fn)) {++tex_cache_hits; return;} // texels are already fully processed
+			++tex_cache_misses;
+		}
 		if (format == IMG_FMT_AUTO) { // auto
 			string const ext(get_file_extension(name, 0, 1));
 		
@@ -185,6 +294,7 @@ void texture_t::load(int index, bool allow_diff_width_height, bool allow_two_byt
 				for (unsigned i = 0; i < npixels; ++i) {data[4*i+3] = (255 - data[4*i+3]);}
 			}
 		}
+		if (!cache_fn.empty()) {write_to_decode_cache(cache_fn);}
 	} // end non-generated texture case
 #if 0
 	if (name.size() > 4 && name.front() != '@') {
@@ -20,7 +20,7 @@ float const FLASHLIGHT_RAD   = 4.0;
 colorRGBA const flashlight_colors[2] = {colorRGBA(1.0, 0.8, 0.5, 1.0), colorRGBA(0.8, 0.8, 1.0, 1.0)}; // incandescent, LED
 
 
-bool using_lightmap(0), lm_alloc(0), has_dl_sources(0), has_spotlights(0), has_line_lights(0), use_dense_voxels(0), has_indir_lighting(0);
+bool using_lightmap(0), lm_alloc(0), has_dl_sources(0), has_spotlights(0), has_line_lights(0), use_dense_voxels(0), has_indir_lighting(0), lmap_sparse_z(0);
 bool dl_smap_enabled(0), flashlight_on(0), enable_dlight_bcubes(0);
 unsigned dl_tid(0), elem_tid(0), gb_tid(0), dl_bc_tid(0), DL_GRID_BS(0), flashlight_color_id(0);
 float DZ_VAL2(0.0), DZ_VAL_INV2(0.0);
@@ -206,16 +206,41 @@ void lmcell::set_outside_colors() {
 
 
 inline bool is_inside_lmap(int x, int y, int z) {return (z >= 0 && z < MESH_SIZE[2] && !point_outside_mesh(x, y));}
-bool lmap_manager_t::is_valid_cell(int x, int y, int z) const {return (is_inside_lmap(x, y, z) && vlmap[y][x] != NULL);}
+
+bool lmap_manager_t::is_valid_cell(int x, int y, int z) const {
+	if (!is_inside_lmap(x, y, z) || vlmap[y][x] == NULL) return 0;
+	if (col_zr.empty()) return 1; // full column
+	unsigned const ix(2*(y*lm_xsize + x));
+	return (unsigned(z) >= col_zr[ix] && unsigned(z) < col_zr[ix+1]);
+}
+void lmap_manager_t::get_column_zrange(int x, int y, unsigned &z1, unsigned &z2) const {
+	if (col_zr.empty()) {z1 = 0; z2 = lm_zsize; return;}
+	unsigned const ix(2*(y*lm_xsize + x));
+	z1 = col_zr[ix]; z2 = col_zr[ix+1];
+}
+lmcell const *lmap_manager_t::get_lmcell_clamp_z(int x, int y, int z) const {
+	if (!is_inside_lmap(x, y, z) || vlmap[y][x] == NULL) return NULL;
+	if (col_zr.empty()) return &vlmap[y][x][z]; // full column
+	unsigned const ix(2*(y*lm_xsize + x));
+	if (unsigned(z) < col_zr[ix]) return NULL; // under the mesh
+	return &vlmap[y][x][min(unsigned(z), (col_zr[ix+1] - 1U)) - col_zr[ix]]; // columns with a z range are never empty
+}
 
 // Note: only intended to work in ground mode where sizes are MESH_X_SIZE and MESH_Y_SIZE
 lmcell *lmap_manager_t::get_lmcell_round_down(point const &p) { // round down
 	int const x(get_xpos_round_down(p.x)), y(get_ypos_round_down(p.y)), z(get_zpos(p.z));
-	return (is_valid_cell(x, y, z) ? &vlmap[y][x][z] : NULL);
+	return (is_valid_cell(x, y, z) ? &get_lmcell(x, y, z) : NULL);
 }
 lmcell *lmap_manager_t::get_lmcell(point const &p) { // round to center
 	int const x(get_xpos(p.x)), y(get_ypos(p.y)), z(get_zpos(p.z));
-	return (is_valid_cell(x, y, z) ? &vlmap[y][x][z] : NULL);
+	return (is_valid_cell(x, y, z) ? &get_lmcell(x, y, z) : NULL);
+}
+
+void lmap_manager_t::free_mem() {
+	clear_cells();
+	vldata_alloc.shrink_to_fit();
+	col_zr.clear();
+	matrix_delete_2d(vlmap);
 }
 
 void lmap_manager_t::reset_all(lmcell const &init_lmcell) {
@@ -227,6 +252,7 @@ template<typename T> void lmap_manager_t::alloc(unsigned nbins, unsigned xsize,
 	lm_xsize = xsize; lm_ysize = ysize; lm_zsize = zsize;
 	if (vlmap == NULL) {matrix_gen_2d(vlmap, lm_xsize, lm_ysize);} // create column headers once
 	vldata_alloc.resize(max(nbins, 1U), init_lmcell); // make size at least 1, even if there are no bins, so we can test on emptiness
+	col_zr.clear(); // full columns
 	unsigned cur_v(0);
 
 	// initialize light volume
@@ -246,12 +272,41 @@ template<typename T> void lmap_manager_t::alloc(unsigned nbins, unsigned xsize,
 
 template void lmap_manager_t::alloc(unsigned nbins, unsigned xsize, unsigned ysize, unsigned zsize, unsigned char **nonempty_bins, lmcell const &init_lmcell); // explicit instantiation
 
+// only the cells in [z1, z2) of each column are stored, which skips the cells under the mesh that are never lit or reached by smoke,
+// and the cells above the column's contents that are lit about the same as its top cell; columns stay contiguous, so get_column() users can iterate over a column's z range in bulk
+void lmap_manager_t::alloc_z_ranges(unsigned xsize, unsigned ysize, unsigned zsize, vector<unsigned short> const &zranges, lmcell const &init_lmcell) {
+
+	assert(zranges.size() == 2*xsize*ysize);
+	unsigned nbins(0);
+
+	for (unsigned i = 0; i < zranges.size(); i += 2) {
+		assert(zranges[i] <= zranges[i+1] && zranges[i+1] <= zsize);
+		nbins += (zranges[i+1] - zranges[i]);
+	}
+	lm_xsize = xsize; lm_ysize = ysize; lm_zsize = zsize;
+	if (vlmap == NULL) {matrix_gen_2d(vlmap, lm_xsize, lm_ysize);} // create column headers once
+	vldata_alloc.resize(max(nbins, 1U), init_lmcell); // make size at least 1, even if there are no bins, so we can test on emptiness
+	col_zr = zranges;
+	unsigned cur_v(0);
+
+	for (unsigned i = 0; i < lm_ysize; ++i) {
+		for (unsigned j = 0; j < lm_xsize; ++j) {
+			unsigned const ix(2*(i*lm_xsize + j)), z1(col_zr[ix]), z2(col_zr[ix+1]);
+			if (z1 == z2) {vlmap[i][j] = NULL; continue;} // empty column
+			vlmap[i][j] = &vldata_alloc[cur_v]; // indexed by z - z1
+			cur_v      += (z2 - z1);
+		}
+	}
+	assert(cur_v == nbins);
+}
+
 
 void lmap_manager_t::init_from(lmap_manager_t const &src) {
 
 	//assert(!is_allocated());
 	//clear_cells(); // probably unnecessary
-	alloc(src.vldata_alloc.size(), src.lm_xsize, src.lm_ysize, src.lm_zsize, src.vlmap, lmcell());
+	if (src.has_z_ranges()) {alloc_z_ranges(src.lm_xsize, src.lm_ysize, src.lm_zsize, src.col_zr, lmcell());}
+	else {alloc(src.vldata_alloc.size(), src.lm_xsize, src.lm_ysize, src.lm_zsize, src.vlmap, lmcell());}
 	copy_data(src);
 }
 
@@ -261,7 +316,7 @@ void lmap_manager_t::copy_data(lmap_manager_t const &src, float blend_weight) {
 
 	assert(vlmap && src.vlmap);
 	assert(src.lm_xsize == lm_xsize && src.lm_ysize == lm_ysize && src.lm_zsize == lm_zsize);
-	assert(src.vldata_alloc.size() == vldata_alloc.size());
+	assert(src.vldata_alloc.size() == vldata_alloc.size() && src.col_zr == col_zr);
 	assert(blend_weight >= 0.0);
 	if (blend_weight == 0.0) return; // keep existing dest
 
@@ -273,15 +328,91 @@ void lmap_manager_t::copy_data(lmap_manager_t const &src, float blend_weight) {
 		for (unsigned j = 0; j < lm_xsize; ++j) {
 			if (!vlmap[i][j]) {assert(!src.vlmap[i][j]); continue;}
 			assert(src.vlmap[i][j]);
+			unsigned z1(0), z2(0);
+			get_column_zrange(j, i, z1, z2);
 			
-			for (unsigned z = 0; z < lm_zsize; ++z) {
-				vlmap[i][j][z].mix_lighting_with(src.vlmap[i][j][z], blend_weight);
+			for (unsigned z = z1; z < z2; ++z) {
+				vlmap[i][j][z-z1].mix_lighting_with(src.vlmap[i][j][z-z1], blend_weight);
 			}
 		}
 	}
 }
 
 
+void lmap_local_accum_t::add(unsigned cell_ix, colorRGBA const &cw) {
+
+	unsigned const bix(cell_ix/BLOCK_SZ);
+	if (bix >= block_ixs.size()) {block_ixs.resize(bix+1, -1);}
+	int &ix(block_ixs[bix]);
+
+	if (ix < 0) { // first write to this block
+		ix = used_blocks.size();
+		used_blocks.push_back(bix);
+		blocks.resize(blocks.size() + BLOCK_SZ);
+	}
+	float *const color(blocks[ix*BLOCK_SZ + (cell_ix - bix*BLOCK_SZ)].lc);
+	ADD_LIGHT_CONTRIB(cw, color);
+}
+
+void lmap_local_accum_t::clear() {
+	for (unsigned bix : used_blocks) {block_ixs[bix] = -1;}
+	used_blocks.clear();
+	blocks.clear(); // keep the capacity for reuse
+}
+
+void lmap_local_accum_t::merge_into(vector<lmap_local_accum_t> &accums, lmap_manager_t &lmgr) {
+
+	unsigned num_blocks(0);
+	for (lmap_local_accum_t const &a : accums) {max_eq(num_blocks, (unsigned)a.block_ixs.size());}
+
+#pragma omp parallel for schedule(dynamic,16)
+	for (int b = 0; b < (int)num_blocks; ++b) { // each block of cells is written by a single thread
+		unsigned const start(b*BLOCK_SZ), end(min((b+1)*BLOCK_SZ, (unsigned)lmgr.size()));
+
+		for (lmap_local_accum_t const &a : accums) { // add in a consistent order
+			if ((unsigned)b >= a.block_ixs.size() || a.block_ixs[b] < 0) continue;
+			lmcell_local const *const src(&a.blocks[a.block_ixs[b]*BLOCK_SZ]);
+			for (unsigned i = start; i < end; ++i) {ADD_LIGHT_CONTRIB(src[i - start].lc, lmgr.get_cell(i).lc);}
+		}
+	}
+	for (lmap_local_accum_t &a : accums) {a.clear();}
+	lmgr.was_updated = 1;
+}
+
+
+void lmap_ltype_accum_t::init(lmap_manager_t const &lmgr, int ltype_) {
+	assert(ltype_ < LIGHTING_DYNAMIC); // not dynamic
+	ltype = ltype_;
+	dsz   = lmcell::get_dsz(ltype);
+	data.clear(); // zero all values, but keep the capacity for the next pass
+	data.resize(dsz*lmgr.size(), 0.0);
+}
+
+
+// like copy_data(), but only for the lighting type of src
+float lmap_manager_t::blend_ltype_from(lmap_ltype_accum_t const &src, float blend_weight) {
+
+	assert(src.size() == vldata_alloc.size());
+	int const ltype(src.get_ltype());
+	unsigned const num(src.get_dsz());
+	float const omw(1.0 - blend_weight);
+	double tot_change(0.0), tot_color(0.0);
+
+#pragma omp parallel for schedule(static,4096) reduction(+:tot_change, tot_color)
+	for (int i = 0; i < (int)vldata_alloc.size(); ++i) {
+		float *color(vldata_alloc[i].get_offset(ltype));
+		float const *const src_color(src.get_cell(i));
+
+		for (unsigned j = 0; j < num; ++j) {
+			float const val(blend_weight*src_color[j] + omw*color[j]);
+			if (j < 3) {tot_change += fabs(val - color[j]); tot_color += fabs(val);} // exclude weight
+			color[j] = val;
+		}
+	}
+	return ((tot_color > 0.0) ? float(tot_change/tot_color) : 0.0f);
+}
+
+
 // *this = val*lmc + (1.0 - val)*(*this)
 void lmcell::mix_lighting_with(lmcell const &lmc, float val) {
 
@@ -528,6 +659,7 @@ void clear_lightmap() {
 
 	if (!lmap_manager.is_allocated()) return;
 	kill_current_raytrace_threads(); // kill raytrace threads and wait for them to finish since they are using the current lightmap
+	cancel_progressive_lighting();
 	lmap_manager.clear_cells();
 	using_lightmap = 0;
 	lm_alloc       = 0;
@@ -565,15 +697,17 @@ void calc_flow_profile(r_profile flow_prof[3], int i, int j, bool proc_cobjs, fl
 		sort(cobj_z.begin(), cobj_z.end(), std::greater<pair<float, unsigned> >()); // max to min z
 	}
 	unsigned const ncv2((unsigned)cobj_z.size());
+	unsigned z1(0), z2(0);
+	lmap_manager.get_column_zrange(j, i, z1, z2);
 
-	for (int v = MESH_SIZE[2]-1; v >= 0; --v) { // top to bottom
+	for (int v = z2-1; v >= (int)z1; --v) { // top to bottom
 		float zb(czmin0 + v*zstep), zt(zb + zstep); // cell Z bounds
 		
 		if (zt < mesh_height[i][j]) { // under mesh
-			UNROLL_3X(vldata[v].pflow[i_] = 0;) // all zeros
+			UNROLL_3X(vldata[v-z1].pflow[i_] = 0;) // all zeros
 		}
 		else if (!proc_cobjs /*|| ncv2 == 0*/) { // ignore cobjs or no cobjs
-			UNROLL_3X(vldata[v].pflow[i_] = 255;) // all ones
+			UNROLL_3X(vldata[v-z1].pflow[i_] = 255;) // all ones
 		}
 		else { // above mesh case
 			float const bb[3][2]  = {{bbz[0][0], bbz[0][1]}, {bbz[1][0], bbz[1][1]}, {zb, zt}};
@@ -599,7 +733,7 @@ void calc_flow_profile(r_profile flow_prof[3], int i, int j, bool proc_cobjs, fl
 			for (unsigned e = 0; e < 3; ++e) {
 				float const fv(flow_prof[e].den_inv());
 				assert(fv > -TOLER);
-				vldata[v].pflow[e] = (unsigned char)(255.5*CLIP_TO_01(fv));
+				vldata[v-z1].pflow[e] = (unsigned char)(255.5*CLIP_TO_01(fv));
 			}
 		} // if above mesh
 	} // for v
@@ -615,6 +749,92 @@ unsigned get_grid_ysize() {return max((MESH_Y_SIZE >> DL_GRID_BS), 1);}
 unsigned get_ldynamic_ix(unsigned x, unsigned y) {return (y >> DL_GRID_BS)*get_grid_xsize() + (x >> DL_GRID_BS);}
 
 
+// returns the number of cells in the {z1, z2} range to allocate for each column: from just below the mesh and lowest cobj to just above the highest cobj, mesh, or light;
+// cells under the mesh are never lit or reached by smoke, and cells above the top of a column are lit about the same as its top cell, so lookups there are clamped to it
+unsigned calc_lmap_column_zranges(unsigned char **need_lmcell, unsigned zsize, vector<unsigned short> &zranges) {
+
+	zranges.clear();
+	zranges.resize(2*XY_MULT_SIZE, 0);
+	vector<unsigned short> light_z2(XY_MULT_SIZE, 0); // top of static light source bounds per column
+
+	for (unsigned i = 0; i < light_sources_a.size(); ++i) {
+		cube_t bcube; // unused
+		int bnds[3][2];
+		light_sources_a[i].get_bounds(bcube, bnds, SQRT_CTHRESH);
+		unsigned const z2(min(zsize, (unsigned)max(0, bnds[2][1]+1)));
+
+		for (int y = bnds[1][0]; y <= bnds[1][1]; ++y) {
+			for (int x = bnds[0][0]; x <= bnds[0][1]; ++x) {max_eq(light_z2[y*MESH_X_SIZE + x], (unsigned short)z2);}
+		}
+	}
+	unsigned nbins(0);
+
+	for (int i = 0; i < MESH_Y_SIZE; ++i) {
+		for (int j = 0; j < MESH_X_SIZE; ++j) {
+			if (!need_lmcell[i][j]) continue;
+			unsigned z1(0);
+			float ztop(v_collision_matrix[i][j].zmax); // -FAR_DISTANCE if there are no cobjs
+
+			if (!is_mesh_disabled(j, i)) { // skip cells entirely under the mesh and below any cobjs, with one cell of padding for texture filtering
+				int const i2(min(i+1, MESH_Y_SIZE-1)), j2(min(j+1, MESH_X_SIZE-1));
+				float const mh(min(min(mesh_height[i][j], mesh_height[i][j2]), min(mesh_height[i2][j], mesh_height[i2][j2])));
+				z1 = min((unsigned)max(0, (get_zpos(min(mh, v_collision_matrix[i][j].zmin)) - 1)), zsize-1);
+				max_eq(ztop, max(max(mesh_height[i][j], mesh_height[i][j2]), max(mesh_height[i2][j], mesh_height[i2][j2])));
+			}
+			unsigned const ix(2*(i*MESH_X_SIZE + j));
+			unsigned z2((ztop > czmin) ? min(zsize, unsigned(get_zpos(ztop) + 2)) : 0); // one cell of padding above for texture filtering
+			z2 = max(max(z2, (unsigned)light_z2[ix/2]), (z1 + 1)); // include light sources; must be nonempty
+			zranges[ix] = z1; zranges[ix+1] = z2;
+			nbins += (z2 - z1);
+		}
+	}
+	return nbins;
+}
+
+// measures the memory use and random lookup throughput of column z range sparse, column sparse, and dense storage of the lmap in one run;
+// the layouts not in use are allocated temporarily; lookups above the top of a column are clamped to its top cell as in get_indir_light()
+void print_lmap_storage_stats(unsigned char **need_lmcell, unsigned nonempty) {
+
+	unsigned const NUM_LOOKUPS = (1 << 20);
+	size_t const MAX_TEMP_CELLS = (1 << 24); // skip temporary layouts larger than this (~870MB)
+	unsigned const zsize(MESH_SIZE[2]);
+	cube_t const bcube(get_scene_bounds_bcube());
+	rand_gen_t rgen;
+	vector<point> pts(NUM_LOOKUPS);
+	for (point &p : pts) {p = rgen.gen_rand_cube_point(bcube);}
+	lmap_manager_t temp_lmaps[3]; // {column z range, column, dense}
+	lmap_manager_t const *lmaps[3] = {};
+	char const *const names[3] = {"column z range sparse", "column sparse", "dense"};
+	vector<unsigned short> zranges;
+	unsigned const zr_nbins(create_voxel_landscape ? 0 : calc_lmap_column_zranges(need_lmcell, zsize, zranges)); // not used with voxel terrain
+	size_t const num_cells[3] = {zr_nbins, size_t(nonempty)*zsize, size_t(XY_MULT_SIZE)*zsize};
+
+	for (unsigned n = 0; n < 3; ++n) {
+		if ((n == 0) ? lmap_manager.has_z_ranges() : (n == 1 && !lmap_manager.has_z_ranges())) {lmaps[n] = &lmap_manager; continue;} // current layout
+		if (num_cells[n] == 0 || num_cells[n] > MAX_TEMP_CELLS) continue; // skip
+		if      (n == 0) {temp_lmaps[n].alloc_z_ranges(MESH_X_SIZE, MESH_Y_SIZE, zsize, zranges, lmcell());}
+		else if (n == 1) {temp_lmaps[n].alloc(num_cells[n], MESH_X_SIZE, MESH_Y_SIZE, zsize, need_lmcell, lmcell());}
+		else             {temp_lmaps[n].alloc(num_cells[n], MESH_X_SIZE, MESH_Y_SIZE, zsize, (unsigned char **)nullptr, lmcell());}
+		lmaps[n] = &temp_lmaps[n];
+	}
+	cout << "Lightmap storage (" << names[lmap_manager.has_z_ranges() ? 0 : 1] << " in use):" << endl;
+
+	for (unsigned n = 0; n < 3; ++n) {
+		if (lmaps[n] == nullptr) {cout << "  " << names[n] << ": " << num_cells[n] << " cells, not measured" << endl; continue;}
+		unsigned num_valid(0);
+		auto const start_time(high_resolution_clock::now());
+
+		for (point const &p : pts) {
+			int const x(get_xpos_round_down(p.x)), y(get_ypos_round_down(p.y)), z(get_zpos(p.z));
+			num_valid += (lmaps[n]->get_lmcell_clamp_z(x, y, z) != nullptr);
+		}
+		float const secs(duration_cast<duration<float>>(high_resolution_clock::now() - start_time).count());
+		cout << "  " << names[n] << ": " << lmaps[n]->size() << " cells, " << lmaps[n]->get_mem_usage()/float(1024*1024) << "MB, "
+			 << NUM_LOOKUPS/max(secs, 1.0E-6f)/1.0E6 << "M lookups/s, " << 100.0*num_valid/NUM_LOOKUPS << "% found" << endl;
+	}
+	for (unsigned n = 0; n < 3; ++n) {temp_lmaps[n].free_mem();}
+}
+
 void build_lightmap(bool verbose) {
 
 	if (lm_alloc) return; // what about recreating the lightmap if the scene has changed?
@@ -687,9 +907,11 @@ void build_lightmap(bool verbose) {
 		cout << "* Warning: Scene height extends beyond the specified z range. Clamping zsize of " << zsize << " to " << MESH_Z_SIZE << "." << endl;
 		zsize = MESH_Z_SIZE;
 	}
-	unsigned const nbins(nonempty*zsize);
+	unsigned nbins(nonempty*zsize);
 	MESH_SIZE[2] = zsize; // override MESH_SIZE[2]
 	float const zstep(czspan/zsize);
+	vector<unsigned short> zranges;
+	if (lmap_sparse_z && !create_voxel_landscape) {nbins = calc_lmap_column_zranges(need_lmcell, zsize, zranges);} // voxel terrain has caves under the mesh
 	if (verbose) {cout << "Lightmap zsize= " << zsize << ", nonempty= " << nonempty << ", bins= " << nbins << ", czmin= " << czmin0 << ", czmax= " << czmax << endl;}
 	assert(zstep > 0.0);
 	bool raytrace_lights[NUM_LIGHTING_TYPES] = {0};
@@ -701,8 +923,10 @@ void build_lightmap(bool verbose) {
 		init_lmcell.sv = init_lmcell.gv = DEF_SKY_GLOBAL_LT;
 		UNROLL_3X(init_lmcell.sc[i_] = init_lmcell.gc[i_] = 1.0;)
 	}
-	lmap_manager.alloc(nbins, MESH_X_SIZE, MESH_Y_SIZE, zsize, need_lmcell, init_lmcell);
+	if (zranges.empty()) {lmap_manager.alloc(nbins, MESH_X_SIZE, MESH_Y_SIZE, zsize, need_lmcell, init_lmcell);}
+	else {lmap_manager.alloc_z_ranges(MESH_X_SIZE, MESH_Y_SIZE, zsize, zranges, init_lmcell);}
 	assert(lmap_manager.is_allocated());
+	if (verbose && nbins > 0) {print_lmap_storage_stats(need_lmcell, nonempty);}
 	using_lightmap = (nonempty > 0);
 	lm_alloc       = 1;
 
@@ -739,6 +963,7 @@ void build_lightmap(bool verbose) {
 
 					for (int z = bnds[2][0]; z <= bnds[2][1]; ++z) {
 						assert(unsigned(z) < zsize);
+						if (!lmap_manager.is_valid_cell(x, y, z)) continue; // under the mesh
 						point const p(xv, yv, get_zval(z));
 						point lpos(lposc); // will be updated for line lights
 						float cscale(ls.get_intensity_at(p, lpos));
@@ -819,6 +1044,7 @@ void update_indir_light_tex_range(lmap_manager_t const &lmap, vector<unsigned ch
 {
 	bool const apply_sqrt(lighting_exponent > 0.49 && lighting_exponent < 0.51), apply_exp(!apply_sqrt && lighting_exponent != 1.0);
 	assert(lmap.is_allocated());
+	assert(!lmap.has_z_ranges()); // not supported in this flow
 
 #pragma omp parallel for schedule(static) if (mt)
 	for (int y = y1; y < (int)y2; ++y) {
@@ -1344,8 +1570,10 @@ void get_indir_light(colorRGBA &a, point const &p) { // used for particle clouds
 	if (!point_outside_mesh(x, y) && p.z > czmin0) { // inside the mesh range and above the lowest cobj
 		float val(get_voxel_terrain_ao_lighting_val(p));
 		
-		if (using_lightmap && p.z < czmax && lmap_manager.get_column(x, y) != NULL) { // not above all collision objects and not empty cell
-			lmap_manager.get_lmcell(x, y, z).get_final_color(cscale, 0.5, val);
+		lmcell const *const lmc((using_lightmap && p.z < czmax) ? lmap_manager.get_lmcell_clamp_z(x, y, z) : nullptr);
+
+		if (lmc != nullptr) { // not above all collision objects and not empty cell
+			lmc->get_final_color(cscale, 0.5, val);
 		}
 		else if (val < 1.0) {
 			cscale *= val;
@@ -44,11 +44,14 @@ struct lmcell { // size = 52
 };
 
 
+class lmap_ltype_accum_t;
+
 class lmap_manager_t {
 
 	vector<lmcell> vldata_alloc;
+	vector<unsigned short> col_zr; // optional {z1, z2} range of allocated cells per column; empty if every allocated column spans the full z range
 	unsigned lm_xsize, lm_ysize, lm_zsize;
-	lmcell ***vlmap; // y, x, z (size is determined by {MESH_Y_SIZE, MESH_X_SIZE, MESH_Z_SIZE}
+	lmcell ***vlmap; // y, x, z (size is determined by {MESH_Y_SIZE, MESH_X_SIZE, MESH_Z_SIZE}; columns with a z range point to their first cell, at z1
 
 	lmap_manager_t(lmap_manager_t const &) = delete; // forbidden
 	void operator=(lmap_manager_t const &) = delete; // forbidden
@@ -56,8 +59,9 @@ class lmap_manager_t {
 public:
 	bool was_updated;
 	cube_t update_bcube;
+	lmap_ltype_accum_t *pass_accum; // if set, ray tracing of its lighting type adds to it rather than to the cells; used for background progressive lighting passes
 
-	lmap_manager_t() : lm_xsize(0), lm_ysize(0), lm_zsize(0), vlmap(NULL), was_updated(0) {update_bcube.set_to_zeros();}
+	lmap_manager_t() : lm_xsize(0), lm_ysize(0), lm_zsize(0), vlmap(NULL), was_updated(0), pass_accum(nullptr) {update_bcube.set_to_zeros();}
 	void clear_cells() {vldata_alloc.clear();} // vlmap matrix headers are not cleared
 	bool is_allocated() const {return (vlmap != NULL && !vldata_alloc.empty());}
 	size_t size() const {return vldata_alloc.size();}
@@ -65,15 +69,29 @@ public:
 	bool write_data_to_file(char const *const fn, int ltype) const;
 	void clear_lighting_values(int ltype);
 	bool is_valid_cell(int x, int y, int z) const;
-	lmcell const *get_column(int x, int y) const {return vlmap[y][x];} // Note: no bounds checking
-	lmcell *get_column(int x, int y) {return vlmap[y][x];} // Note: no bounds checking
-	lmcell &get_lmcell(int x, int y, int z) {return get_column(x, y)[z];} // Note: no bounds checking
+	bool has_z_ranges() const {return !col_zr.empty();}
+	size_t get_mem_usage() const {return (vldata_alloc.capacity()*sizeof(lmcell) + col_zr.capacity()*sizeof(unsigned short) + size_t(lm_xsize)*lm_ysize*sizeof(lmcell *));}
+	void free_mem(); // frees the cells and column headers
+	void get_column_zrange(int x, int y, unsigned &z1, unsigned &z2) const; // valid z values of an allocated column are [z1, z2)
+	unsigned get_column_z1(int x, int y) const {return (col_zr.empty() ? 0 : col_zr[2*(y*lm_xsize + x)]);} // z value of the first cell of a column
+	lmcell const *get_column(int x, int y) const {return vlmap[y][x];} // Note: no bounds checking; first cell is at get_column_z1()
+	lmcell *get_column(int x, int y) {return vlmap[y][x];} // Note: no bounds checking; first cell is at get_column_z1()
+	lmcell const &get_lmcell(int x, int y, int z) const {return vlmap[y][x][z - get_column_z1(x, y)];} // Note: no bounds checking
+	lmcell       &get_lmcell(int x, int y, int z)       {return vlmap[y][x][z - get_column_z1(x, y)];} // Note: no bounds checking
+	lmcell const *get_lmcell_if_valid(int x, int y, int z) const {return (is_valid_cell(x, y, z) ? &get_lmcell(x, y, z) : nullptr);}
+	lmcell       *get_lmcell_if_valid(int x, int y, int z)       {return (is_valid_cell(x, y, z) ? &get_lmcell(x, y, z) : nullptr);}
+	lmcell const *get_lmcell_clamp_z(int x, int y, int z) const; // for reading lighting; cells above the top of a column with a z range return the top cell
 	lmcell *get_lmcell_round_down(point const &p);
 	lmcell *get_lmcell(point const &p);
 	void reset_all(lmcell const &init_lmcell=lmcell());
 	template<typename T> void alloc(unsigned nbins, unsigned xsize, unsigned ysize, unsigned zsize, T **nonempty_bins, lmcell const &init_lmcell);
+	void alloc_z_ranges(unsigned xsize, unsigned ysize, unsigned zsize, vector<unsigned short> const &zranges, lmcell const &init_lmcell); // z1 == z2 is an empty column
 	void init_from(lmap_manager_t const &src);
 	void copy_data(lmap_manager_t const &src, float blend_weight=1.0);
+	float blend_ltype_from(lmap_ltype_accum_t const &src, float blend_weight); // returns the relative change in total color
+	unsigned get_cell_ix(lmcell const *lmc) const {return (lmc - vldata_alloc.data());} // lmc must be a cell of this lmap
+	lmcell const &get_cell(unsigned ix) const {return vldata_alloc[ix];}
+	lmcell       &get_cell(unsigned ix)       {return vldata_alloc[ix];}
 };
 
 
@@ -83,6 +101,43 @@ struct lmcell_local { // size = 12 (must be packed)
 	bool is_near_zero(float toler) const {return (lc[0] < toler && lc[1] < toler && lc[2] < toler);}
 };
 
+
+// sparse accumulation of local lighting for the cells of an lmap_manager_t, used to avoid write races when casting rays for multiple lights in parallel;
+// storage is allocated in blocks of consecutive cells as they're first written
+class lmap_local_accum_t {
+
+	static unsigned const BLOCK_SZ = 1024; // in cells
+	vector<int> block_ixs; // index into blocks; -1 = not allocated
+	vector<lmcell_local> blocks;
+	vector<unsigned> used_blocks;
+public:
+	void add(unsigned cell_ix, colorRGBA const &cw);
+	void clear();
+	bool empty() const {return used_blocks.empty();}
+	size_t get_mem() const {return (block_ixs.capacity()*sizeof(int) + blocks.capacity()*sizeof(lmcell_local));}
+	static void merge_into(vector<lmap_local_accum_t> &accums, lmap_manager_t &lmgr); // adds and clears accums
+};
+
+
+// accumulation of a single lighting type for every cell of an lmap_manager_t, used for progressive lighting passes so that only the channels of that type
+// are allocated and blended rather than copying the entire lmap each pass; written by multiple threads without locking, like the lmap itself
+class lmap_ltype_accum_t {
+
+	vector<float> data; // get_dsz(ltype) values per cell
+	int ltype=-1;
+	unsigned dsz=0;
+public:
+	void init(lmap_manager_t const &lmgr, int ltype_);
+	void free_mem() {data.clear(); data.shrink_to_fit(); ltype = -1;}
+	int get_ltype() const {return ltype;}
+	unsigned get_dsz() const {return dsz;}
+	size_t size() const {return (dsz ? data.size()/dsz : 0);} // in cells
+	size_t get_mem() const {return data.capacity()*sizeof(float);}
+	float       *get_cell(unsigned cell_ix)       {return &data[cell_ix*dsz];}
+	float const *get_cell(unsigned cell_ix) const {return &data[cell_ix*dsz];}
+};
+
+
 class light_volume_local : public light_grid_base {
 
 	bool changed, compressed;
@@ -330,8 +385,10 @@ public:
 
 // from ray_trace.cpp
 void check_for_lighting_finished();
+void cancel_progressive_lighting();
 void compute_ray_trace_lighting(unsigned ltype, bool verbose);
-unsigned add_path_to_lmcs(lmap_manager_t *lmgr, cube_t *bcube, point p1, point const &p2, float weight, colorRGBA const &color, int ltype, bool first_pt);
+unsigned add_path_to_lmcs(lmap_manager_t *lmgr, cube_t *bcube, point p1, point const &p2, float weight, colorRGBA const &color, int ltype, bool first_pt,
+	lmap_local_accum_t *accum=nullptr);
 // from lightmap.cpp
 void update_indir_light_tex_range(lmap_manager_t const &lmap, vector<unsigned char> &tex_data,
 	unsigned xsize, unsigned y1, unsigned y2, unsigned zsize, float lighting_exponent=1.0, bool local_only=0, bool mt=0);
@@ -0,0 +1,114 @@
+// 3D World - Read-Only Memory Mapped File Wrapper
+// by Frank Gennari
+// 10/16/26
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <cerrno>
+#endif
+
+
+bool mapped_file_t::open(std::string const &fn) {
+
+	close();
+#ifdef _WIN32
+	HANDLE const fh(CreateFileA(fn.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL));
+	if (fh == INVALID_HANDLE_VALUE) return 0;
+	file_handle = fh;
+	LARGE_INTEGER fsize;
+	if (!GetFileSizeEx(fh, &fsize) || fsize.QuadPart == 0) {close(); return 0;}
+	HANDLE const mh(CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL));
+	if (mh == NULL) {close(); return 0;}
+	map_handle = mh;
+	void const *const ptr(MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0));
+	if (ptr == nullptr) {close(); return 0;}
+	size_ = (size_t)fsize.QuadPart;
+#else
+	fd = ::open(fn.c_str(), O_RDONLY);
+	if (fd < 0) return 0;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {close(); return 0;}
+	void *const ptr(mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+	if (ptr == MAP_FAILED) {close(); return 0;}
+	size_ = (size_t)st.st_size;
+	posix_madvise(ptr, size_, POSIX_MADV_WILLNEED); // hint only; ignore errors
+#endif
+	data_ = (char const *)ptr;
+	return 1;
+}
+
+void mapped_file_t::close() {
+#ifdef _WIN32
+	if (data_       != nullptr) {UnmapViewOfFile(data_);}
+	if (map_handle  != nullptr) {CloseHandle(map_handle);}
+	if (file_handle != nullptr) {CloseHandle(file_handle);}
+	map_handle = file_handle = nullptr;
+#else
+	if (data_ != nullptr) {munmap((void *)data_, size_);}
+	if (fd >= 0) {::close(fd);}
+	fd = -1;
+#endif
+	data_ = nullptr;
+	size_ = 0;
+}
+
+
+bool get_file_mod_time_and_size(std::string const &fn, uint64_t &mtime, uint64_t &size) {
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	if (!GetFileAttributesExA(fn.c_str(), GetFileExInfoStandard, &attr) || (attr.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) return 0;
+	mtime = ((uint64_t(attr.ftLastWriteTime.dwHighDateTime) << 32) | attr.ftLastWriteTime.dwLowDateTime);
+	size  = ((uint64_t(attr.nFileSizeHigh) << 32) | attr.nFileSizeLow);
+#else
+	struct stat st;
+	if (stat(fn.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return 0;
+	mtime = (uint64_t)st.st_mtime;
+	size  = (uint64_t)st.st_size;
+#endif
+	return 1;
+}
+
+bool create_dir_if_missing(std::string const &dir) {
+
+	for (size_t pos = 1; pos <= dir.size(); ++pos) { // create each directory along the path; skip the leading slash of an absolute path
+		if (pos < dir.size() && dir[pos] != '/' && dir[pos] != '\\') continue;
+		std::string const sub_dir(dir, 0, pos);
+		if (sub_dir.back() == ':') continue; // drive letter
+#ifdef _WIN32
+		if (!CreateDirectoryA(sub_dir.c_str(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS) return 0;
+#else
+		if (mkdir(sub_dir.c_str(), 0755) != 0 && errno != EEXIST) return 0;
+#endif
+	}
+	return 1;
+}
+
+uint64_t get_dir_files_size(std::string const &dir, std::string const &suffix) {
+
+	uint64_t total(0);
+	auto add_file([&](std::string const &name) {
+		if (name.size() < suffix.size() || name.compare(name.size()-suffix.size(), suffix.size(), suffix) != 0) return;
+		uint64_t mtime(0), size(0);
+		if (get_file_mod_time_and_size((dir + "/" + name), mtime, size)) {total += size;}
+	});
+#ifdef _WIN32
+	WIN32_FIND_DATAA fd;
+	HANDLE const h(FindFirstFileA((dir + "/*").c_str(), &fd));
+	if (h == INVALID_HANDLE_VALUE) return 0;
+	do {add_file(fd.cFileName);} while (FindNextFileA(h, &fd));
+	FindClose(h);
+#else
+	DIR *const d(opendir(dir.c_str()));
+	if (d == nullptr) return 0;
+	for (struct dirent *e = readdir(d); e != nullptr; e = readdir(d)) {add_file(e->d_name);}
+	closedir(d);
+#endif
+	return total;
+}
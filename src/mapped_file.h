@@ -0,0 +1,59 @@
+// 3D World - Read-Only Memory Mapped File Wrapper
+// by Frank Gennari
+// 10/16/26
+#pragma once
+
+#include <string>
+#include <istream>
+#include <streambuf>
+#include <cstddef>
+#include <cstdint>
+
+
+class mapped_file_t { // read-only, not copyable
+
+	char const *data_=nullptr;
+	size_t size_=0;
+#ifdef _WIN32
+	void *file_handle=nullptr, *map_handle=nullptr;
+#else
+	int fd=-1;
+#endif
+public:
+	mapped_file_t() {}
+	mapped_file_t(mapped_file_t const &) = delete;
+	mapped_file_t &operator=(mapped_file_t const &) = delete;
+	~mapped_file_t() {close();}
+	bool open(std::string const &fn);
+	void close();
+	bool is_open() const {return (data_ != nullptr);}
+	char const *data() const {return data_;}
+	size_t size() const {return size_;}
+};
+
+
+// istream that reads directly from a range of memory (such as a mapped file) without copying it into a stream buffer
+class mem_istream_t : public std::istream {
+
+	struct mem_buf_t : public std::streambuf {
+		mem_buf_t(char const *data, size_t size) {char *const d(const_cast<char *>(data)); setg(d, d, d+size);} // read only
+	protected:
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+			char *const pos((dir == std::ios_base::beg) ? eback() : ((dir == std::ios_base::end) ? egptr() : gptr()));
+			if (pos + off < eback() || pos + off > egptr()) return pos_type(off_type(-1));
+			setg(eback(), pos+off, egptr());
+			return pos_type(gptr() - eback());
+		}
+		pos_type seekpos(pos_type sp, std::ios_base::openmode which) override {return seekoff(off_type(sp), std::ios_base::beg, which);}
+	};
+	mem_buf_t buf;
+public:
+	mem_istream_t(char const *data, size_t size) : std::istream(nullptr), buf(data, size) {rdbuf(&buf);}
+};
+
+
+// file system queries used by the various on-disk caches
+bool get_file_mod_time_and_size(std::string const &fn, uint64_t &mtime, uint64_t &size); // returns 0 if the file doesn't exist
+bool create_dir_if_missing(std::string const &dir); // creates parent directories as needed
+uint64_t get_dir_files_size(std::string const &dir, std::string const &suffix); // total size of files in dir (not recursive) whose names end in suffix
+
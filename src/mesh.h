@@ -34,6 +34,7 @@ class mesh_xy_grid_cache_t {
 
 	void run_gpu_simplex();
 	void cache_gpu_simplex_vals();
+	float apply_glaciate_terms(float zval, unsigned x, unsigned y) const;
 
 public:
 	mesh_xy_grid_cache_t() : cur_nx(0), cur_ny(0), yterms_start(0), tid(0), mx0(0.0), my0(0.0), mdx(0.0), mdy(0.0), sine_offset(0.0),
@@ -42,6 +43,11 @@ public:
 	bool build_arrays(float x0, float y0, float dx, float dy, unsigned nx, unsigned ny, bool cache_values=0, bool force_sine_mode=0, bool no_wait=0);
 	void enable_glaciate();
 	float eval_index(unsigned x, unsigned y, int min_start_sin=0, bool use_cache=1) const;
+	void eval_all(float *vals, int min_start_sin=0, bool use_cache=1) const;
+	static bool allow_avx2; // may be cleared to force the SSE path of eval_all(), for testing
+	static bool cpu_has_avx2();
+	static bool use_avx2();
+	static unsigned get_simd_width(); // of eval_all()
 	void clear_context();
 	void free_cshader();
 };
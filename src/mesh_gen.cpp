@@ -10,6 +10,7 @@
 #include "shaders.h"
 #include "gl_ext_arb.h"
 #include <glm/gtc/noise.hpp>
+#include <immintrin.h> // SSE/AVX
 
 
 int      const NUM_FREQ_COMP      = 9;
@@ -549,6 +550,22 @@ void compute_scale() {
 	start_eval_sin = N_RAND_SIN2*max(0, min(NUM_FREQ_COMP-MIN_FREQS, (iscale+mesh_freq_filter)));
 }
 
+// hash of all parameters that affect generated mesh heights and texture weights; used to validate cached terrain tiles
+uint64_t get_mesh_gen_params_hash() {
+
+	int const ivals[] = {mesh_gen_mode, mesh_gen_shape, start_eval_sin, GLACIATE, mesh_seed, mesh_rgen_index, MESH_X_SIZE, MESH_Y_SIZE};
+	float const fvals[] = {mesh_scale, mesh_scale_z, mesh_height_scale, MESH_HEIGHT, zmin, zmax, zmax_est, custom_glaciate_exp, DX_VAL, DY_VAL};
+	fnv1a_hash_t hash;
+	auto add_bytes([&hash](void const *data, size_t sz) {hash.add_bytes(data, sz);});
+	add_bytes(ivals, sizeof(ivals));
+	add_bytes(fvals, sizeof(fvals));
+	add_bytes(sinTable, sizeof(sinTable)); // includes the random seed and frequency/magnitude parameters
+	add_bytes(&hmap_params, sizeof(hmap_params));
+	add_bytes(sthresh, sizeof(sthresh));
+	add_bytes(lttex_dirt, sizeof(lttex_dirt));
+	return hash.hash;
+}
+
 float get_hmap_scale(int mode) {
 	float const scale((mode == MGEN_SIMPLEX || mode == MGEN_SIMPLEX_GPU || mode == MGEN_DWARP_GPU) ? 16.0 : 32.0); // simplex vs. perlin
 	return scale*MESH_HEIGHT*mesh_height_scale*mesh_scale_z_inv;
@@ -629,12 +646,7 @@ bool mesh_xy_grid_cache_t::build_arrays(float x0, float y0, float dx, float dy,
 	if (cache_values) {
 		cached_vals.resize(cur_nx*cur_ny);
 		
-#pragma omp parallel for schedule(static,1)
-		for (int y = 0; y < (int)cur_ny; ++y) {
-			for (unsigned x = 0; x < cur_nx; ++x) {
-				cached_vals[y*cur_nx + x] = eval_index(x, y, 0, 0); // Note: no glaciate, min_start_sin=0, use_cache=0
-			}
-		}
+		eval_all(cached_vals.data(), 0, 0); // Note: no glaciate, min_start_sin=0, use_cache=0
 	}
 	return 1; // results are available
 }
@@ -782,6 +794,11 @@ float mesh_xy_grid_cache_t::eval_index(unsigned x, unsigned y, int min_start_sin
 		}
 		apply_noise_shape_final(zval, gen_shape);
 	}
+	return apply_glaciate_terms(zval, x, y);
+}
+
+float mesh_xy_grid_cache_t::apply_glaciate_terms(float zval, unsigned x, unsigned y) const {
+
 	if (do_glaciate) {
 		apply_glaciate(zval);
 		
@@ -795,6 +812,226 @@ float mesh_xy_grid_cache_t::eval_index(unsigned x, unsigned y, int min_start_sin
 }
 
 
+// minimal SIMD float vector wrappers for bulk mesh height evaluation: 8-wide with AVX2 if the CPU supports it, otherwise 4-wide with SSE;
+// the AVX2 versions are compiled for that target individually so that the rest of the build doesn't require AVX2;
+// FMA is intentionally not used so that results match the scalar code
+#ifdef __GNUC__
+#define SIMD_INLINE inline __attribute__((always_inline))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#pragma GCC diagnostic ignored "-Wpsabi" // the templates taking AVX args are always inlined into TARGET_AVX2 functions
+#else // MSVC allows AVX intrinsics without any compiler options
+#define SIMD_INLINE __forceinline
+#define TARGET_AVX2
+#endif
+
+struct vf_sse_t {
+	typedef __m128 vfloat;
+	static unsigned const WIDTH = 4;
+	static vfloat set1(float v) {return _mm_set1_ps(v);}
+	static vfloat lanes() {return _mm_setr_ps(0.0, 1.0, 2.0, 3.0);}
+	static vfloat load(float const *p) {return _mm_loadu_ps(p);}
+	static void   store(float *p, vfloat v) {_mm_storeu_ps(p, v);}
+	static vfloat add(vfloat a, vfloat b) {return _mm_add_ps(a, b);}
+	static vfloat sub(vfloat a, vfloat b) {return _mm_sub_ps(a, b);}
+	static vfloat mul(vfloat a, vfloat b) {return _mm_mul_ps(a, b);}
+	static vfloat div(vfloat a, vfloat b) {return _mm_div_ps(a, b);}
+	static vfloat max(vfloat a, vfloat b) {return _mm_max_ps(a, b);}
+#ifdef __SSE4_1__
+	static vfloat floor(vfloat v) {return _mm_floor_ps(v);}
+#else // SSE2: truncate, then subtract one where truncation rounded up (negative non-integers); valid for |v| < 2^31
+	static vfloat floor(vfloat v) {vfloat const t(_mm_cvtepi32_ps(_mm_cvttps_epi32(v))); return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, v), _mm_set1_ps(1.0f)));}
+#endif
+	static vfloat abs(vfloat v) {return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);}
+	static vfloat select_gt(vfloat a, vfloat b, vfloat t, vfloat f) {vfloat const m(_mm_cmpgt_ps(a, b)); return _mm_or_ps(_mm_and_ps(m, t), _mm_andnot_ps(m, f));} // (a > b) ? t : f
+};
+struct vf_avx2_t {
+	typedef __m256 vfloat;
+	static unsigned const WIDTH = 8;
+	TARGET_AVX2 static vfloat set1(float v) {return _mm256_set1_ps(v);}
+	TARGET_AVX2 static vfloat lanes() {return _mm256_setr_ps(0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0);}
+	TARGET_AVX2 static vfloat load(float const *p) {return _mm256_loadu_ps(p);}
+	TARGET_AVX2 static void   store(float *p, vfloat v) {_mm256_storeu_ps(p, v);}
+	TARGET_AVX2 static vfloat add(vfloat a, vfloat b) {return _mm256_add_ps(a, b);}
+	TARGET_AVX2 static vfloat sub(vfloat a, vfloat b) {return _mm256_sub_ps(a, b);}
+	TARGET_AVX2 static vfloat mul(vfloat a, vfloat b) {return _mm256_mul_ps(a, b);}
+	TARGET_AVX2 static vfloat div(vfloat a, vfloat b) {return _mm256_div_ps(a, b);}
+	TARGET_AVX2 static vfloat max(vfloat a, vfloat b) {return _mm256_max_ps(a, b);}
+	TARGET_AVX2 static vfloat floor(vfloat v) {return _mm256_floor_ps(v);}
+	TARGET_AVX2 static vfloat abs(vfloat v) {return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);}
+	TARGET_AVX2 static vfloat select_gt(vfloat a, vfloat b, vfloat t, vfloat f) {return _mm256_blendv_ps(f, t, _mm256_cmp_ps(a, b, _CMP_GT_OQ));} // (a > b) ? t : f
+};
+unsigned const VF_MAX_WIDTH = vf_avx2_t::WIDTH; // row buffers are padded to a multiple of this
+
+bool mesh_xy_grid_cache_t::allow_avx2(1);
+
+/*static*/ bool mesh_xy_grid_cache_t::cpu_has_avx2() {
+#if defined(__AVX2__)
+	return 1; // enabled for the whole build
+#elif defined(__GNUC__)
+	static bool const has_avx2(__builtin_cpu_supports("avx2"));
+	return has_avx2;
+#else
+	return 0;
+#endif
+}
+/*static*/ bool mesh_xy_grid_cache_t::use_avx2() {return (allow_avx2 && cpu_has_avx2());}
+/*static*/ unsigned mesh_xy_grid_cache_t::get_simd_width() {return (use_avx2() ? vf_avx2_t::WIDTH : vf_sse_t::WIDTH);}
+
+template<typename V> SIMD_INLINE typename V::vfloat vf_permute(typename V::vfloat x) { // mod289(((x*34)+1)*x)
+	typename V::vfloat const v(V::mul(V::add(V::mul(x, V::set1(34.0f)), V::set1(1.0f)), x));
+	return V::sub(v, V::mul(V::floor(V::mul(v, V::set1(1.0f/289.0f))), V::set1(289.0f)));
+}
+
+template<typename V> SIMD_INLINE typename V::vfloat simplex_corner(typename V::vfloat p, typename V::vfloat x, typename V::vfloat y) { // returns m*g for one corner
+	typedef typename V::vfloat vfloat;
+	vfloat m(V::max(V::sub(V::set1(0.5f), V::add(V::mul(x, x), V::mul(y, y))), V::set1(0.0f)));
+	m = V::mul(m, m);
+	m = V::mul(m, m);
+	vfloat const p_scaled(V::mul(p, V::set1(0.024390243902439f))); // 1/41
+	vfloat const gx(V::sub(V::mul(V::set1(2.0f), V::sub(p_scaled, V::floor(p_scaled))), V::set1(1.0f))); // 2*fract(p/41) - 1
+	vfloat const h(V::sub(V::abs(gx), V::set1(0.5f))), a0(V::sub(gx, V::floor(V::add(gx, V::set1(0.5f)))));
+	m = V::mul(m, V::sub(V::set1(1.79284291400159f), V::mul(V::set1(0.85373472095314f), V::add(V::mul(a0, a0), V::mul(h, h)))));
+	return V::mul(m, V::add(V::mul(a0, x), V::mul(h, y)));
+}
+
+template<typename V> SIMD_INLINE typename V::vfloat simplex_noise_simd(typename V::vfloat vx, typename V::vfloat vy) { // SIMD version of glm::simplex(vec2) with the same sequence of operations
+
+	typedef typename V::vfloat vfloat;
+	vfloat const C0(V::set1(0.211324865405187f)), C1(V::set1(0.366025403784439f)), C2(V::set1(-0.577350269189626f));
+	vfloat const one(V::set1(1.0f)), zero(V::set1(0.0f)), m289(V::set1(289.0f));
+	vfloat const d(V::add(V::mul(vx, C1), V::mul(vy, C1)));
+	vfloat ix(V::floor(V::add(vx, d))), iy(V::floor(V::add(vy, d)));
+	vfloat const di(V::add(V::mul(ix, C0), V::mul(iy, C0)));
+	vfloat const x0x(V::add(V::sub(vx, ix), di)), x0y(V::add(V::sub(vy, iy), di));
+	vfloat const i1x(V::select_gt(x0x, x0y, one, zero)), i1y(V::sub(one, i1x)); // lower or upper triangle
+	vfloat const x1x(V::sub(V::add(x0x, C0), i1x)), x1y(V::sub(V::add(x0y, C0), i1y)), x2x(V::add(x0x, C2)), x2y(V::add(x0y, C2));
+	ix = V::sub(ix, V::mul(m289, V::floor(V::div(ix, m289))));
+	iy = V::sub(iy, V::mul(m289, V::floor(V::div(iy, m289))));
+	vfloat const p0(vf_permute<V>(V::add(vf_permute<V>(iy), ix)));
+	vfloat const p1(vf_permute<V>(V::add(V::add(vf_permute<V>(V::add(iy, i1y)), ix), i1x)));
+	vfloat const p2(vf_permute<V>(V::add(V::add(vf_permute<V>(V::add(iy, one)), ix), one)));
+	vfloat const sum(V::add(V::add(simplex_corner<V>(p0, x0x, x0y), simplex_corner<V>(p1, x1x, x1y)), simplex_corner<V>(p2, x2x, x2y)));
+	return V::mul(V::set1(130.0f), sum);
+}
+
+// writes the sum of the sine terms for each x of one row to out; xterms is transposed so that adjacent x values are contiguous, with rows of nx_pad values
+template<typename V> SIMD_INLINE void sine_row_sums(float const *xterms, float const *yterms, int start_ix, int end_ix, unsigned nx_pad, float *out) {
+	for (unsigned x = 0; x < nx_pad; x += V::WIDTH) {
+		typename V::vfloat zval(V::set1(0.0f));
+		float const *xptr(xterms + x);
+		// performance critical; summed in the same order as eval_index()
+		for (int i = start_ix; i < end_ix; ++i, xptr += nx_pad) {zval = V::add(zval, V::mul(V::load(xptr), V::set1(yterms[i])));}
+		V::store(out + x, zval);
+	}
+}
+void sine_row_sums_sse(float const *xterms, float const *yterms, int start_ix, int end_ix, unsigned nx_pad, float *out) {
+	sine_row_sums<vf_sse_t>(xterms, yterms, start_ix, end_ix, nx_pad, out);
+}
+TARGET_AVX2 void sine_row_sums_avx2(float const *xterms, float const *yterms, int start_ix, int end_ix, unsigned nx_pad, float *out) {
+	sine_row_sums<vf_avx2_t>(xterms, yterms, start_ix, end_ix, nx_pad, out);
+}
+
+struct simplex_row_params_t { // see gen_noise() and get_noise_zval()
+	float xy_scale, mx0, mdx, rx0, ry0, lacunarity, gain;
+	unsigned end_octave;
+	int gen_shape;
+};
+// writes the unscaled simplex noise sum for each x of one row at yval (in index space) to out, which must be padded to a multiple of V::WIDTH
+template<typename V> SIMD_INLINE void simplex_row_sums(simplex_row_params_t const &p, float yval, unsigned nx, float *out) {
+	typedef typename V::vfloat vfloat;
+	vfloat const yv(V::set1(p.xy_scale*yval));
+
+	for (unsigned x = 0; x < nx; x += V::WIDTH) {
+		vfloat const xi(V::add(V::set1(float(x)), V::lanes()));
+		vfloat const xv(V::mul(V::set1(p.xy_scale), V::mul(V::add(V::mul(xi, V::set1(p.mdx)), V::set1(p.mx0)), V::set1(DX_VAL_INV))));
+		vfloat zval(V::set1(0.0f));
+		float mag(1.0), freq(1.0), rx(p.rx0), ry(p.ry0);
+
+		for (unsigned i = 0; i < p.end_octave; ++i) {
+			vfloat noise(simplex_noise_simd<V>(V::add(V::mul(V::set1(freq), xv), V::set1(rx)), V::add(V::mul(V::set1(freq), yv), V::set1(ry))));
+			if      (p.gen_shape == 1) {noise = V::sub(V::abs(noise), V::set1(0.40f));} // billowy
+			else if (p.gen_shape == 2) {noise = V::sub(V::set1(0.45f), V::abs(noise));} // ridged
+			zval  = V::add(zval, V::mul(V::set1(mag), noise));
+			mag  *= p.gain;
+			freq *= p.lacunarity;
+			rx   *= 1.5;
+			ry   *= 1.5;
+		}
+		V::store(out + x, zval);
+	} // for x
+}
+void simplex_row_sums_sse(simplex_row_params_t const &p, float yval, unsigned nx, float *out) {simplex_row_sums<vf_sse_t>(p, yval, nx, out);}
+TARGET_AVX2 void simplex_row_sums_avx2(simplex_row_params_t const &p, float yval, unsigned nx, float *out) {simplex_row_sums<vf_avx2_t>(p, yval, nx, out);}
+
+// fills vals with all cur_nx*cur_ny values in row-major order; same results as calling eval_index() for each point,
+// but sine and simplex modes are evaluated 4 or 8 points at a time
+void mesh_xy_grid_cache_t::eval_all(float *vals, int min_start_sin, bool use_cache) const {
+
+	assert(vals != nullptr);
+	bool const use_cached_vals((use_cache || gen_mode >= MGEN_SIMPLEX_GPU) && !cached_vals.empty());
+
+	if (use_cached_vals || (gen_mode != MGEN_SINE && gen_mode != MGEN_SIMPLEX)) { // no SIMD version
+#pragma omp parallel for schedule(static,1)
+		for (int y = 0; y < (int)cur_ny; ++y) {
+			for (unsigned x = 0; x < cur_nx; ++x) {vals[y*cur_nx + x] = eval_index(x, y, min_start_sin, use_cache);}
+		}
+		return;
+	}
+	bool const avx2(use_avx2());
+	unsigned const nx_pad(VF_MAX_WIDTH*((cur_nx + VF_MAX_WIDTH - 1)/VF_MAX_WIDTH));
+
+	if (gen_mode == MGEN_SINE) {
+		int const start_ix(max(start_eval_sin, min_start_sin));
+		vector<float> xterms((F_TABLE_SIZE - start_ix)*nx_pad, 0.0); // transposed so that adjacent x values are contiguous, zero padded
+
+		for (int k = start_ix; k < F_TABLE_SIZE; ++k) {
+			for (unsigned x = 0; x < cur_nx; ++x) {xterms[(k - start_ix)*nx_pad + x] = xyterms[x*F_TABLE_SIZE + k];}
+		}
+#pragma omp parallel for schedule(static,1)
+		for (int y = 0; y < (int)cur_ny; ++y) {
+			float const *const yptr(xyterms.data() + yterms_start + y*F_TABLE_SIZE);
+			float *const row(vals + y*cur_nx);
+			static thread_local vector<float> sums;
+			sums.resize(nx_pad);
+			if (avx2) {sine_row_sums_avx2(xterms.data(), yptr, start_ix, F_TABLE_SIZE, nx_pad, sums.data());}
+			else      {sine_row_sums_sse (xterms.data(), yptr, start_ix, F_TABLE_SIZE, nx_pad, sums.data());}
+
+			for (unsigned x = 0; x < cur_nx; ++x) {
+				apply_noise_shape_final(sums[x], gen_shape);
+				row[x] = apply_glaciate_terms(sums[x], x, y);
+			}
+		} // for y
+		return;
+	}
+	// simplex noise; see gen_noise() and get_noise_zval()
+	float const zscale(get_hmap_scale(gen_mode));
+	simplex_row_params_t params;
+	params.xy_scale   = MESH_SCALE_FACTOR*mesh_scale;
+	params.mx0        = mx0;
+	params.mdx        = mdx;
+	params.lacunarity = 1.92;
+	params.gain       = 0.5;
+	params.end_octave = NUM_FREQ_COMP - start_eval_sin/N_RAND_SIN2;
+	params.gen_shape  = gen_shape;
+	gen_rx_ry(params.rx0, params.ry0);
+
+#pragma omp parallel for schedule(static,1)
+	for (int y = 0; y < (int)cur_ny; ++y) {
+		float *const row(vals + y*cur_nx);
+		float const yval((y*mdy + my0)*DY_VAL_INV);
+		static thread_local vector<float> sums;
+		sums.resize(nx_pad);
+		if (avx2) {simplex_row_sums_avx2(params, yval, cur_nx, sums.data());}
+		else      {simplex_row_sums_sse (params, yval, cur_nx, sums.data());}
+
+		for (unsigned x = 0; x < cur_nx; ++x) {
+			postproc_noise_zval(sums[x]);
+			row[x] = apply_glaciate_terms(sums[x]*zscale, x, y);
+		}
+	} // for y
+}
+
+
 // Note: called directly in tiled mesh and voxel code as a random number generator (not for mesh height);
 // we always use sine tables here because get_noise_zval() is too slow
 float eval_mesh_sin_terms(float xv, float yv) {
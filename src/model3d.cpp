@@ -24,11 +24,14 @@ bool const SHOW_MODEL_BCUBE_CENTER  = 0;
 bool const ENABLE_ANIMATION_SHADOWS = 1;
 bool const USE_ANIM_MODEL_TANGENTS  = 1;
 unsigned const MAGIC_NUMBER  = 42987143; // arbitrary file signature
+unsigned const MAGIC_NUMBER_V2 = 42987144; // versioned format with a material table and per-material geometry offsets
+unsigned const MODEL3D_FILE_VERSION = 2;
 unsigned const BLOCK_SIZE    = 32768; // in vertex indices
 unsigned const BONE_IDS_LOC     = 4;
 unsigned const BONE_WEIGHTS_LOC = 5;
 
 bool model_calc_tan_vect(1); // slower and more memory but sometimes better quality/smoother transitions
+bool model3d_lazy_materials(1); // for v2 model3d files, read material geometry on first draw rather than at load time
 
 extern bool group_back_face_cull, enable_model3d_tex_comp, disable_shader_effects, texture_alpha_in_red_comp, use_model3d_tex_mipmaps, enable_model3d_bump_maps;
 extern bool two_sided_lighting, have_indir_smoke_tex, use_core_context, model3d_wn_normal, invert_model_nmap_bscale, use_z_prepass, all_model3d_ref_update;
@@ -151,9 +154,17 @@ void texture_manager::add_work_item(int tid, bool is_nm) {
 void texture_manager::load_work_items_mt() {
 	if (to_load.empty()) return; // nothing to do
 	sort_and_unique(to_load);
-#pragma omp parallel for schedule(dynamic)
-	for (int i = 0; i < (int)to_load.size(); ++i) {ensure_texture_loaded(to_load[i].tid, to_load[i].is_nm);}
+	vector<pair<uint64_t, unsigned>> load_order; // {cost, index}
+	for (unsigned i = 0; i < to_load.size(); ++i) {load_order.emplace_back(get_texture(to_load[i].tid).get_load_cost(), i);}
+	// start the largest textures first so that threads don't sit idle waiting for one big decode at the end
+	sort(load_order.begin(), load_order.end(), [](pair<uint64_t, unsigned> const &a, pair<uint64_t, unsigned> const &b) {return (a.first > b.first);});
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < (int)load_order.size(); ++i) {
+		tex_work_item_t const &wi(to_load[load_order[i].second]);
+		ensure_texture_loaded(wi.tid, wi.is_nm);
+	}
 	to_load.clear();
+	print_texture_decode_cache_stats();
 }
 
 texture_t &get_builtin_texture(int tid) {
@@ -1240,6 +1251,7 @@ template<typename T> void update_score(vntc_vect_block_t<T> const &v, float &sco
 void material_t::compute_area_per_tri() {
 
 	if (avg_area_per_tri > 0) return; // already computed
+	ensure_geom_loaded();
 	unsigned tris(0);
 	tot_tri_area = 0;
 	geom.calc_area(tot_tri_area, tris);
@@ -1249,6 +1261,7 @@ void material_t::compute_area_per_tri() {
 }
 
 void material_t::simplify_indices(float reduce_target) {
+	ensure_geom_loaded();
 	geom.simplify_indices(reduce_target);
 	geom_tan.simplify_indices(reduce_target);
 }
@@ -1301,6 +1314,7 @@ void material_t::check_for_tc_invert_y(texture_manager &tmgr) {
 	texture_t &texture(tmgr.get_texture(tid));
 
 	if (texture.is_inverted_y_type() && !texture.invert_y) { // compressed DDS texture, need to invert tex coord in Y
+		ensure_geom_loaded();
 		geom.invert_tcy();
 		geom_tan.invert_tcy();
 		texture.invert_y ^= 1; // already inverted, don't try to invert again (FIXME: doesn't work if used in multiple materials)
@@ -1319,6 +1333,7 @@ void material_t::render(shader_t &shader, texture_manager const &tmgr, int defau
 {
 	if (empty() || skip || alpha == 0.0) return; // empty or transparent
 	if (is_shadow_pass && alpha < MIN_SHADOW_ALPHA) return;
+	if (!ensure_geom_loaded()) return;
 
 	if (draw_order_score == 0) {
 		unsigned num_nonempty(0);
@@ -1450,18 +1465,55 @@ bool material_t::add_poly(polygon_t const &poly, vntc_map_t vmap[2], vntct_map_t
 }
 
 
-bool material_t::write(ostream &out) const {
+bool material_t::write_header(ostream &out) const {
 	out.write((char const *)this, sizeof(material_params_t));
 	write_vector(out, name);
 	write_vector(out, filename);
-	return (geom.write(out) && geom_tan.write(out));
+	return out.good();
 }
 
-bool material_t::read(istream &in) {
+bool material_t::read_header(istream &in) {
 	in.read((char *)this, sizeof(material_params_t));
 	read_vector(in, name);
 	read_vector(in, filename);
-	return (geom.read(in) && geom_tan.read(in));
+	return in.good();
+}
+
+bool material_t::write(ostream &out) const {
+	ensure_geom_loaded();
+	return (write_header(out) && geom.write(out) && geom_tan.write(out));
+}
+
+bool material_t::read(istream &in) {
+	lazy_geom.clear();
+	return (read_header(in) && geom.read(in) && geom_tan.read(in));
+}
+
+bool material_t::ensure_geom_loaded() const { // const because geometry is logically part of the material, even if it hasn't been read yet
+
+	if (!lazy_geom.pending()) return 1; // already loaded
+	material_t &m(const_cast<material_t &>(*this));
+	assert(lazy_geom.offset + lazy_geom.size <= lazy_geom.file->size());
+	mem_istream_t in((lazy_geom.file->data() + lazy_geom.offset), lazy_geom.size);
+	bool const ret(m.geom.read(in) && m.geom_tan.read(in) && in.good());
+	lazy_geom.clear(); // unmaps the file if this was the last material to be loaded
+	if (!ret) {cerr << "Error reading geometry for model3d material " << name << endl;}
+	return ret;
+}
+
+void material_t::get_stats(model3d_stats_t &stats) const {
+
+	if (lazy_geom.pending()) {
+		stats.verts  += lazy_geom.stats.verts;
+		stats.quads  += lazy_geom.stats.quads;
+		stats.tris   += lazy_geom.stats.tris;
+		stats.blocks += lazy_geom.stats.blocks;
+	}
+	else {
+		geom.get_stats(stats);
+		geom_tan.get_stats(stats);
+	}
+	++stats.mats;
 }
 
 bool material_t::write_to_obj_file(ostream &out, unsigned &cur_vert_ix) const {
@@ -1578,6 +1630,7 @@ void model3d::get_transformed_bcubes(vector<cube_t> &bcubes) const {
 void model3d::get_polygons(vector<coll_tquad> &polygons, bool quads_only, bool apply_transforms, unsigned lod_level) const {
 
 	unsigned const start_pix(polygons.size());
+	ensure_all_geom_loaded();
 
 	if (start_pix == 0) { // Note: we count quads as 1.5 polygons because some of them may be split into triangles
 		model3d_stats_t stats;
@@ -1678,6 +1731,7 @@ void model3d::get_cubes(vector<cube_t> &cubes, model3d_xform_t const &xf) const
 	RESET_TIME;
 	float const spacing(xf.voxel_spacing);
 	assert(spacing > 0.0);
+	ensure_all_geom_loaded();
 
 	// calculate scene voxel bounds
 	int bounds[2][2] = {}, num_xy[2] = {}; // {x,y}x{lo,hi}
@@ -1906,7 +1960,7 @@ void model3d::bind_all_used_tids() {
 		tmgr.ensure_tid_bound(m->get_render_texture()); // only one tid for now
 		
 		if (m->use_bump_map()) {
-			if (model_calc_tan_vect && !m->geom.empty()) {
+			if (model_calc_tan_vect && m->has_geom_no_tan()) {
 				cerr << "Error loading model3d material " << m->name << ": Geometry is missing tangent vectors, so bump map cannot be enabled." << endl;
 				m->bump_tid = -1; // disable bump map
 			}
@@ -2511,11 +2565,7 @@ void model3d::get_stats(model3d_stats_t &stats) const {
 	stats.transforms += transforms.size();
 	unbound_geom.get_stats(stats);
 	
-	for (deque<material_t>::const_iterator m = materials.begin(); m != materials.end(); ++m) {
-		m->geom.get_stats(stats);
-		m->geom_tan.get_stats(stats);
-		++stats.mats;
-	}
+	for (deque<material_t>::const_iterator m = materials.begin(); m != materials.end(); ++m) {m->get_stats(stats);}
 }
 
 void model3d::show_stats() const {
@@ -2534,8 +2584,29 @@ void model3d::show_stats() const {
 }
 
 
-bool model3d::write_to_disk(string const &fn) const { // as model3d file; Note: transforms not written
+void model3d::ensure_all_geom_loaded() const {
+	for (auto m = materials.begin(); m != materials.end(); ++m) {m->ensure_geom_loaded();}
+}
+
+unsigned model3d::num_lazy_materials() const {
+	unsigned num(0);
+	for (auto m = materials.begin(); m != materials.end(); ++m) {num += m->lazy_geom.pending();}
+	return num;
+}
+
 
+struct model3d_mat_info_t { // per-material entry in the v2 material table; written as POD
+	uint64_t geom_offset=0, geom_size=0; // from the start of the file
+	model3d_stats_t stats;
+	float avg_area_per_tri=0.0, tot_tri_area=0.0; // precomputed for LOD so that geometry isn't needed until the first draw
+	unsigned char has_geom=0, has_geom_tan=0, pad[2]={};
+};
+
+// v2 format: magic, version, bcube, unbound geom, material table (params, names, geometry offsets, and stats), then per-material geometry blocks;
+// the file is read through a memory mapping, and each material's geometry is read from the mapping on first use
+bool model3d::write_to_disk(string const &fn, bool legacy_format) const { // as model3d file; Note: transforms not written
+
+	ensure_all_geom_loaded(); // must be done before opening fn for write, in case we're overwriting the mapped file this model was read from
 	ofstream out(fn, ios::out | ios::binary);
 	
 	if (!out.good()) {
@@ -2543,16 +2614,56 @@ bool model3d::write_to_disk(string const &fn) const { // as model3d file; Note:
 		return 0;
 	}
 	cout << "Writing model3d file " << fn << endl;
-	write_uint(out, MAGIC_NUMBER);
+
+	if (legacy_format) {
+		write_uint(out, MAGIC_NUMBER);
+		out.write((char const *)&bcube, sizeof(cube_t));
+		if (!unbound_geom.write(out)) return 0;
+		write_uint(out, (unsigned)materials.size());
+	
+		for (deque<material_t>::const_iterator m = materials.begin(); m != materials.end(); ++m) {
+			if (!m->write(out)) {
+				cerr << "Error writing material " << m->name << endl;
+				return 0;
+			}
+		}
+		return out.good();
+	}
+	write_uint(out, MAGIC_NUMBER_V2);
+	write_uint(out, MODEL3D_FILE_VERSION);
 	out.write((char const *)&bcube, sizeof(cube_t));
 	if (!unbound_geom.write(out)) return 0;
 	write_uint(out, (unsigned)materials.size());
-	
-	for (deque<material_t>::const_iterator m = materials.begin(); m != materials.end(); ++m) {
-		if (!m->write(out)) {
-			cerr << "Error writing material " << m->name << endl;
+	vector<model3d_mat_info_t> infos(materials.size());
+	vector<streampos> info_pos(materials.size());
+
+	for (unsigned i = 0; i < materials.size(); ++i) { // write the material table with placeholder geometry offsets
+		if (!materials[i].write_header(out)) {
+			cerr << "Error writing material " << materials[i].name << endl;
 			return 0;
 		}
+		info_pos[i] = out.tellp();
+		out.write((char const *)&infos[i], sizeof(model3d_mat_info_t));
+	}
+	for (unsigned i = 0; i < materials.size(); ++i) { // write geometry blocks
+		material_t const &m(materials[i]);
+		model3d_mat_info_t &info(infos[i]);
+		info.geom_offset      = (uint64_t)out.tellp();
+		info.avg_area_per_tri = m.avg_area_per_tri; // may be zero if not yet computed
+		info.tot_tri_area     = m.tot_tri_area;
+		info.has_geom         = !m.geom    .empty();
+		info.has_geom_tan     = !m.geom_tan.empty();
+		m.get_stats(info.stats);
+		
+		if (!m.geom.write(out) || !m.geom_tan.write(out)) {
+			cerr << "Error writing material " << m.name << endl;
+			return 0;
+		}
+		info.geom_size = (uint64_t)out.tellp() - info.geom_offset;
+	}
+	for (unsigned i = 0; i < materials.size(); ++i) { // go back and fill in the material table
+		out.seekp(info_pos[i]);
+		out.write((char const *)&infos[i], sizeof(model3d_mat_info_t));
 	}
 	return out.good();
 }
@@ -2560,31 +2671,56 @@ bool model3d::write_to_disk(string const &fn) const { // as model3d file; Note:
 
 bool model3d::read_from_disk(string const &fn) { // as model3d file; Note: transforms not read
 
-	ifstream in(fn, ios::in | ios::binary);
+	auto file(std::make_shared<mapped_file_t>());
 	
-	if (!in.good()) {
+	if (!file->open(fn)) {
 		cerr << "Error opening model3d file for read: " << fn << endl;
 		return 0;
 	}
 	clear(); // ???
+	mem_istream_t in(file->data(), file->size()); // reads directly from the mapped file
 	unsigned const magic_number_comp(read_uint(in));
+	bool const is_v2(magic_number_comp == MAGIC_NUMBER_V2);
 
-	if (magic_number_comp != MAGIC_NUMBER) {
+	if (magic_number_comp != MAGIC_NUMBER && !is_v2) {
 		cerr << "Error reading model3d file " << fn << ": Invalid file format (magic number check failed)." << endl;
 		return 0;
 	}
-	cout << "Reading model3d file " << fn << endl;
+	unsigned const version(is_v2 ? read_uint(in) : 1);
+
+	if (version > MODEL3D_FILE_VERSION) {
+		cerr << "Error reading model3d file " << fn << ": Unsupported file version " << version << " (max supported is " << MODEL3D_FILE_VERSION << ")." << endl;
+		return 0;
+	}
+	cout << "Reading model3d file " << fn << " version " << version << endl;
 	from_model3d_file = 1;
 	in.read((char *)&bcube, sizeof(cube_t));
 	if (!unbound_geom.read(in)) return 0;
 	materials.resize(read_uint(in));
 	
 	for (deque<material_t>::iterator m = materials.begin(); m != materials.end(); ++m) {
-		if (!m->read(in)) {
+		if (!(is_v2 ? m->read_header(in) : m->read(in))) {
 			cerr << "Error reading material" << endl;
 			return 0;
 		}
 		mat_map[m->name] = (m - materials.begin());
+		if (!is_v2) continue;
+		model3d_mat_info_t info;
+		in.read((char *)&info, sizeof(model3d_mat_info_t));
+
+		if (!in.good() || info.geom_offset + info.geom_size > file->size()) {
+			cerr << "Error reading model3d file " << fn << ": Invalid geometry offset for material " << m->name << endl;
+			return 0;
+		}
+		m->avg_area_per_tri       = info.avg_area_per_tri;
+		m->tot_tri_area           = info.tot_tri_area;
+		m->lazy_geom.file         = file;
+		m->lazy_geom.offset       = info.geom_offset;
+		m->lazy_geom.size         = info.geom_size;
+		m->lazy_geom.has_geom     = info.has_geom;
+		m->lazy_geom.has_geom_tan = info.has_geom_tan;
+		m->lazy_geom.stats        = info.stats;
+		if (!model3d_lazy_materials && !m->ensure_geom_loaded()) return 0; // read now
 	}
 	//simplify_indices(0.1); // TESTING
 	//if (fn == "model_data/fish/fishOBJ.model3d") {write_as_obj_file(fn + ".obj");} // TESTING
@@ -2604,6 +2740,7 @@ bool model3d::write_as_obj_file(string const &fn) {
 	out << "# Created by 3DWorld, by Frank Gennari 2022" << endl;
 	out << "mtllib " << mtllib_fn << endl;
 	unsigned cur_vert_ix(0);
+	ensure_all_geom_loaded();
 	if (!unbound_geom.write_to_obj_file(out, cur_vert_ix)) return 0; // no usemtl
 
 	for (deque<material_t>::const_iterator m = materials.begin(); m != materials.end(); ++m) {
@@ -8,8 +8,10 @@
 #include "cobj_bsp_tree.h" // for cobj_tree_tquads_t
 #include "shadow_map.h" // for smap_data_t and rotation_t
 #include "gl_ext_arb.h"
+#include "mapped_file.h"
 
 #include <unordered_map>
+#include <memory>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
@@ -485,6 +487,18 @@ struct material_params_t { // Warning: changing this struct will invalidate the
 }; // must be padded
 
 
+struct lazy_geom_ref_t { // material geometry in a mapped model3d file that hasn't been read yet
+
+	std::shared_ptr<mapped_file_t> file; // keeps the file mapped until all of its materials have been read
+	size_t offset=0, size=0;
+	bool has_geom=0, has_geom_tan=0;
+	model3d_stats_t stats; // stats of the unread geometry, for show_stats()
+
+	bool pending() const {return (file != nullptr);}
+	void clear() {file.reset();}
+};
+
+
 struct material_t : public material_params_t {
 
 	bool might_have_alpha_comp, tcs_checked;
@@ -495,11 +509,15 @@ struct material_t : public material_params_t {
 
 	geometry_t<vert_norm_tc> geom;
 	geometry_t<vert_norm_tc_tan> geom_tan;
+	mutable lazy_geom_ref_t lazy_geom; // set when reading model3d v2 files; geometry is read on first use
 
 	material_t(string const &name_=string(), string const &fn=string())
 		: might_have_alpha_comp(0), tcs_checked(0), a_tid(-1), d_tid(-1), s_tid(-1), ns_tid(-1), alpha_tid(-1), bump_tid(-1), refl_tid(-1),
 		draw_order_score(0.0), avg_area_per_tri(0.0), tot_tri_area(0.0), metalness(-1.0), name(name_), filename(fn) {}
-	bool empty() const {return (geom.empty() && geom_tan.empty());}
+	bool empty() const {return (lazy_geom.pending() ? !(lazy_geom.has_geom || lazy_geom.has_geom_tan) : (geom.empty() && geom_tan.empty()));}
+	bool has_geom_no_tan() const {return (lazy_geom.pending() ? lazy_geom.has_geom : !geom.empty());}
+	bool ensure_geom_loaded() const;
+	void get_stats(model3d_stats_t &stats) const;
 	mesh_bone_data_t &get_bone_data_for_last_added_tri_mesh();
 	unsigned add_triangles(vector<vert_norm_tc> const &verts, vector<unsigned> const &indices, bool add_new_block); // Note: no quads or tangents
 	bool add_poly(polygon_t const &poly, vntc_map_t vmap[2], vntct_map_t vmap_tan[2], unsigned obj_id=0);
@@ -524,6 +542,8 @@ struct material_t : public material_params_t {
 	colorRGBA get_avg_color(texture_manager const &tmgr, int default_tid=-1) const;
 	bool write(ostream &out) const;
 	bool read(istream &in);
+	bool write_header(ostream &out) const;
+	bool read_header (istream &in);
 	bool write_to_obj_file(ostream &out, unsigned &cur_vert_ix) const;
 	void write_mtllib_entry(ostream &out, texture_manager const &tmgr) const;
 };
@@ -670,7 +690,9 @@ public:
 	void get_stats(model3d_stats_t &stats) const;
 	void show_stats() const;
 	void get_all_mat_lib_fns(set<std::string> &mat_lib_fns) const;
-	bool write_to_disk (string const &fn) const;
+	void ensure_all_geom_loaded() const;
+	unsigned num_lazy_materials() const;
+	bool write_to_disk (string const &fn, bool legacy_format=0) const;
 	bool read_from_disk(string const &fn);
 	bool write_as_obj_file(string const &fn);
 	static void proc_model_normals(vector<counted_normal> &cn, int recalc_normals, float nmag_thresh=0.7);
@@ -751,4 +773,5 @@ bool load_model_file(string const &filename, model3ds &models, geom_xform_t cons
 	colorRGBA const &def_c, int reflective, float metalness, int recalc_normals, int group_cobjs_level, bool write_file, bool verbose);
 bool read_model_file(string const &filename, vector<coll_tquad> *ppts, geom_xform_t const &xf, int def_tid, colorRGBA const &def_c,
 	int reflective, float metalness, bool load_model_file, int recalc_normals, int group_cobjs_level, bool write_file, bool verbose);
+bool convert_model3d_file(string const &in_fn, string const &out_fn);
 
@@ -10,12 +10,17 @@
 #include <algorithm> // for transform()
 #include <cctype> // for tolower()
 #include "fast_atof.h"
+#include "file_utils.h" // for get_file_size()
+#include <omp.h>
 
 
 extern bool use_obj_file_bump_grayscale, model_calc_tan_vect, enable_model_animations;
 extern float model_auto_tc_scale, model_mat_lod_thresh;
 extern model3ds all_models;
 
+bool obj_file_parallel_parse(1); // use the multithreaded parser for OBJ files larger than OBJ_PARALLEL_MIN_SIZE
+size_t const OBJ_PARALLEL_MIN_SIZE = (1 << 20); // 1MB
+
 // hack to avoid slow multithreaded locking in getc()/ungetc() in MSVC++
 #ifndef _getc_nolock
 #define _getc_nolock   getc
@@ -493,27 +498,102 @@ public:
 		return 1;
 	}
 
-	bool read(geom_xform_t const &xf, int recalc_normals, bool verbose) {
-		if (!open_file(1)) return 0; // binary mode is faster
-		cout << "Reading object file " << filename << endl;
-		RESET_TIME;
+	// parse state, shared by the serial and parallel readers
+	int cur_mat_id=-1, recalc_normals=0;
+	unsigned smoothing_group=0, prev_smoothing_group=0, num_faces=0, num_objects=0, num_groups=0, obj_group_id=0, approx_line=0;
+	bool is_textured=0, had_npts_error=0;
+	vector<point> v; // vertices
+	vector<vector3d> n; // normals
+	// weighted_normal can also be used, but doesn't work well; see face_weight_avg mode selected by recalc_normals==2
+	vector<counted_normal> vn; // vertex normals
+	vector<point2d<float> > tc; // texture coords
+	vector<colorRGB> colors; // vertex colors
+	deque<poly_data_block> pblocks;
+	set<string> loaded_mat_libs;
+	vector<vntc_ix_t> face_pts; // temporary
+
+	void add_face() { // from face_pts
 		unsigned const block_size = (1 << 18); // 256K
-		int cur_mat_id(-1);
-		unsigned smoothing_group(0), prev_smoothing_group(0), num_faces(0), num_objects(0), num_groups(0), obj_group_id(0);
-		vector<point> v; // vertices
-		vector<vector3d> n; // normals
-		// weighted_normal can also be used, but doesn't work well; see face_weight_avg mode selected by recalc_normals==2
-		vector<counted_normal> vn; // vertex normals
-		vector<point2d<float> > tc; // texture coords
-		vector<colorRGB> colors; // vertex colors
-		deque<poly_data_block> pblocks;
-		set<string> loaded_mat_libs;
+		unsigned const npts(face_pts.size());
+		model.mark_mat_as_used(cur_mat_id);
+
+		if (npts < 3) {
+			if (!had_npts_error) {cerr << "Error near line " << approx_line << ": face has only " << npts << " vertices." << endl; had_npts_error = 1;}
+			return; // skip it
+		}
+		if (pblocks.empty() || pblocks.back().pts.size() >= block_size || smoothing_group != prev_smoothing_group) { // create a new block
+			if (!pblocks.empty()) {
+				remove_excess_cap(pblocks.back().polys);
+				remove_excess_cap(pblocks.back().pts);
+			}
+			pblocks.push_back(poly_data_block());
+			prev_smoothing_group = smoothing_group;
+		}
+		poly_data_block &pb(pblocks.back());
+		pb.polys.push_back(poly_header_t(cur_mat_id, obj_group_id));
+		pb.polys.back().npts = npts;
+		unsigned const pix((unsigned)pb.pts.size());
+		vector_add_to(face_pts, pb.pts);
+		vector3d &normal(pb.polys.back().n);
+
+		for (unsigned i = pix; i < pix+npts-2; ++i) { // find a nonzero normal
+			normal = cross_product((v[pb.pts[i+1].vix] - v[pb.pts[i].vix]), (v[pb.pts[i+2].vix] - v[pb.pts[i].vix])); // backwards?
+			// if we disable this normalize() we will weight normal contributions by polygon area,
+			// but we have to change the code below and it causes problems with vertex uniquing
+			normal.normalize();
+			if (normal != zero_vector) break; // got a good normal
+		}
+		if (recalc_normals) {
+			bool const face_weight_avg(recalc_normals == 2 && (npts == 3 || npts == 4)); // only works for quads and triangles
+			float face_area(0.0);
+
+			if (face_weight_avg) {
+				point face_pts[4];
+				for (unsigned i = 0; i < npts; ++i) {face_pts[i] = v[pb.pts[i+pix].vix];}
+				face_area = polygon_area(face_pts, npts);
+			}
+			for (unsigned i = pix; i < pix+npts; ++i) {
+				unsigned const vix(pb.pts[i].vix);
+				assert((unsigned)vix < vn.size());
+				bool const using_texgen(is_textured && model_auto_tc_scale > 0.0 && pb.pts[i].tix == 0);
+
+				if (vn[vix].is_valid() && (using_texgen || dot_product(normal, vn[vix].get_norm()) < 0.25)) { // normals in disagreement (or using texgen)
+					vn[vix] = zero_vector; // zero it out so that it becomes invalid later
+				}
+				else if (face_weight_avg) {vn[vix].add_normal(face_area*normal);} // face weighted average
+				else {vn[vix].add_normal(normal);} // unweighted average of normals
+			}
+		}
+	}
+	bool set_material(string const &material_name) { // usemtl
+		if (material_name.empty()) {
+			if (!had_empty_mat_error) {cerr << "Error reading material from object file " << filename << " near line " << approx_line << endl;}
+			had_empty_mat_error = 1;
+			return 0;
+		}
+		cur_mat_id = model.find_material(material_name);
+
+		if (cur_mat_id >= 0) { // material was valid
+			int const tid(model.get_material(cur_mat_id).d_tid);
+			is_textured = (tid >= 0 && model.tmgr.get_tex_avg_color(tid) != WHITE); // no texture, or all white texture
+		}
+		return 1;
+	}
+	bool add_mat_lib(string const &mat_lib) { // mtllib
+		if (mat_lib.empty()) {
+			cerr << "Error reading material library from object file " << filename << " near line " << approx_line << endl;
+			return 0;
+		}
+		if (!try_load_mat_lib(mat_lib, loaded_mat_libs, approx_line)) {
+			//return 0; // nonfatal
+		}
+		return 1;
+	}
+
+	bool parse_serial(geom_xform_t const &xf) {
+		if (!open_file(1)) return 0; // binary mode is faster
 		char s[MAX_CHARS];
-		string material_name, mat_lib, group_name, object_name;
-		tc.push_back(point2d<float>(0.0, 0.0)); // default tex coords
-		n.push_back(zero_vector); // default normal
-		unsigned approx_line(0);
-		bool is_textured(0), had_npts_error(0);
+		string str;
 
 		while (read_string(s, MAX_CHARS)) {
 			++approx_line;
@@ -526,21 +606,8 @@ public:
 				read_to_newline(fp); // ignore
 			}
 			else if (strcmp(s, "f") == 0) { // face
-				model.mark_mat_as_used(cur_mat_id);
-
-				if (pblocks.empty() || pblocks.back().pts.size() >= block_size || smoothing_group != prev_smoothing_group) { // create a new block
-					if (!pblocks.empty()) {
-						remove_excess_cap(pblocks.back().polys);
-						remove_excess_cap(pblocks.back().pts);
-					}
-					pblocks.push_back(poly_data_block());
-					prev_smoothing_group = smoothing_group;
-				}
-				poly_data_block &pb(pblocks.back());
-				pb.polys.push_back(poly_header_t(cur_mat_id, obj_group_id));
-				unsigned &npts(pb.polys.back().npts);
-				unsigned const pix((unsigned)pb.pts.size()), pts_start(pb.pts.size());
 				int vix(0), tix(0), nix(0);
+				face_pts.clear();
 
 				while (read_int(vix)) { // read vertex index
 					normalize_index(vix, (unsigned)v.size());
@@ -563,50 +630,14 @@ public:
 						else {unget_last_char(c2);}
 					}
 					else {unget_last_char(c);}
-					pb.pts.push_back(vntc_ix);
-					++npts;
+					face_pts.push_back(vntc_ix);
 				} // end while vertex
-				if (npts < 3) {
-					if (!had_npts_error) {cerr << "Error near line " << approx_line << ": face has only " << npts << " vertices." << endl; had_npts_error = 1;}
-					pb.pts.resize(pts_start);
-					pb.polys.pop_back(); // remove pts and polygon
-					continue; // skip it
-				}
-				vector3d &normal(pb.polys.back().n);
-				
-				for (unsigned i = pix; i < pix+npts-2; ++i) { // find a nonzero normal
-					normal = cross_product((v[pb.pts[i+1].vix] - v[pb.pts[i].vix]), (v[pb.pts[i+2].vix] - v[pb.pts[i].vix])); // backwards?
-					// if we disable this normalize() we will weight normal contributions by polygon area,
-					// but we have to change the code below and it causes problems with vertex uniquing
-					normal.normalize();
-					if (normal != zero_vector) break; // got a good normal
-				}
-				if (recalc_normals) {
-					bool const face_weight_avg(recalc_normals == 2 && (npts == 3 || npts == 4)); // only works for quads and triangles
-					float face_area(0.0);
-
-					if (face_weight_avg) {
-						point face_pts[4];
-						for (unsigned i = 0; i < npts; ++i) {face_pts[i] = v[pb.pts[i+pix].vix];}
-						face_area = polygon_area(face_pts, npts);
-					}
-					for (unsigned i = pix; i < pix+npts; ++i) {
-						unsigned const vix(pb.pts[i].vix);
-						assert((unsigned)vix < vn.size());
-						bool const using_texgen(is_textured && model_auto_tc_scale > 0.0 && pb.pts[i].tix == 0);
-
-						if (vn[vix].is_valid() && (using_texgen || dot_product(normal, vn[vix].get_norm()) < 0.25)) { // normals in disagreement (or using texgen)
-							vn[vix] = zero_vector; // zero it out so that it becomes invalid later
-						}
-						else if (face_weight_avg) {vn[vix].add_normal(face_area*normal);} // face weighted average
-						else {vn[vix].add_normal(normal);} // unweighted average of normals
-					}
-				}
+				add_face();
 			}
 			else if (strcmp(s, "v") == 0) { // vertex
 				v.push_back(point());
 				if (recalc_normals) {vn.push_back(counted_normal());} // vertex normal
-			
+
 				if (!read_point(v.back())) {
 					cerr << "Error reading vertex from object file " << filename << " near line " << approx_line << endl;
 					return 0;
@@ -623,7 +654,7 @@ public:
 			}
 			else if (strcmp(s, "vt") == 0) { // tex coord
 				point tc3d;
-			
+
 				if (!read_point(tc3d, 2)) {
 					cerr << "Error reading texture coord from object file " << filename << " near line " << approx_line << endl;
 					return 0;
@@ -632,7 +663,7 @@ public:
 			}
 			else if (strcmp(s, "vn") == 0) { // normal
 				vector3d normal;
-			
+
 				if (!read_point(normal)) {
 					cerr << "Error reading normal from object file " << filename << " near line " << approx_line << endl;
 					return 0;
@@ -646,12 +677,12 @@ public:
 				read_to_newline(fp); // ignore
 			}
 			else if (strcmp(s, "o") == 0) { // object definition
-				read_str_to_newline(fp, object_name); // can be empty?
+				read_str_to_newline(fp, str); // object name; can be empty?
 				++num_objects;
 				++obj_group_id;
 			}
 			else if (strcmp(s, "g") == 0) { // group
-				read_str_to_newline(fp, group_name); // can be empty
+				read_str_to_newline(fp, str); // group name; can be empty
 				++num_groups;
 				++obj_group_id;
 			}
@@ -665,30 +696,12 @@ public:
 				}
 			}
 			else if (strcmp(s, "usemtl") == 0) { // use material
-				read_str_to_newline(fp, material_name);
-
-				if (material_name.empty()) {
-					if (!had_empty_mat_error) {cerr << "Error reading material from object file " << filename << " near line " << approx_line << endl;}
-					had_empty_mat_error = 1;
-					return 0;
-				}
-				cur_mat_id = model.find_material(material_name);
-				
-				if (cur_mat_id >= 0) { // material was valid
-					int const tid(model.get_material(cur_mat_id).d_tid);
-					is_textured = (tid >= 0 && model.tmgr.get_tex_avg_color(tid) != WHITE); // no texture, or all white texture
-				}
+				read_str_to_newline(fp, str);
+				if (!set_material(str)) return 0;
 			}
 			else if (strcmp(s, "mtllib") == 0) { // material library
-				read_str_to_newline(fp, mat_lib);
-
-				if (mat_lib.empty()) {
-					cerr << "Error reading material library from object file " << filename << " near line " << approx_line << endl;
-					return 0;
-				}
-				if (!try_load_mat_lib(mat_lib, loaded_mat_libs, approx_line)) {
-					//return 0; // nonfatal
-				}
+				read_str_to_newline(fp, str);
+				if (!add_mat_lib(str)) return 0;
 			}
 			else {
 				cerr << "Error: Undefined entry '" << s << "' in object file " << filename << " near line " << approx_line << endl;
@@ -696,11 +709,303 @@ public:
 				//return 0;
 			}
 		} // while
+		return 1;
+	}
+
+	// parallel reader: the file is mapped and split into line-aligned chunks, and each chunk's vertices and face indices are parsed on a separate thread;
+	// the chunks are then merged and their faces and material/group/smoothing commands are replayed in file order, so the result matches the serial reader
+	enum {OBJ_CMD_USEMTL=0, OBJ_CMD_MTLLIB, OBJ_CMD_OBJECT, OBJ_CMD_GROUP, OBJ_CMD_SMOOTH, OBJ_CMD_BAD_FACE, OBJ_CMD_WARN, OBJ_CMD_ERROR};
+
+	struct obj_cmd_t { // anything other than a vertex or face that must be applied in file order
+		unsigned char type;
+		unsigned face_ix, line, val; // face_ix = number of faces in the chunk before this command
+		string str;
+		obj_cmd_t(unsigned char t, unsigned fix, unsigned line_, unsigned val_=0, string const &str_=string()) : type(t), face_ix(fix), line(line_), val(val_), str(str_) {}
+	};
+	struct obj_face_vert_t { // raw indices, 1-based; relative (negative) indices have been converted to be relative to the start of the chunk
+		int vix=0, tix=0, nix=0;
+		unsigned char flags=0; // bits: 0=has tix, 1=has nix, 2/3/4=vix/tix/nix relative to chunk
+	};
+	struct obj_chunk_t {
+		char const *begin=nullptr, *end=nullptr, *file_end=nullptr;
+		unsigned num_lines=0;
+		vector<point> v;
+		vector<pair<unsigned, colorRGB> > colors; // {chunk vertex index, color}
+		vector<point2d<float> > tc;
+		vector<vector3d> n;
+		vector<unsigned> face_npts;
+		vector<obj_face_vert_t> face_verts;
+		vector<obj_cmd_t> cmds;
+
+		static bool is_ws(char c) {return (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f');} // excludes newline
+		static void skip_ws(char const *&p, char const *eol) {while (p < eol && is_ws(*p)) {++p;}}
+
+		bool parse_float(char const *&p, char const *eol, float &val) const { // same rules as object_file_reader::read_float()
+			skip_ws(p, eol);
+			if (p == eol) return 0;
+			char const c(*p);
+			if (!fast_isdigit(c) && c != '.' && c != '-') return 0; // not a fp number
+			char const *tend(p);
+			while (tend < eol && !is_ws(*tend)) {++tend;}
+
+			if (tend == file_end) { // can't read past the end of the mapped file, so copy to a null terminated buffer
+				char buf[MAX_CHARS] = {0};
+				memcpy(buf, p, min(size_t(tend - p), size_t(MAX_CHARS-1)));
+				val = Assimp::fast_atof(buf);
+			}
+			else {val = Assimp::fast_atof(p);} // stops at the whitespace after the number
+			p = tend;
+			return 1;
+		}
+		static bool parse_int(char const *&p, char const *eol, int &val) { // same rules as base_file_reader::read_int()
+			skip_ws(p, eol);
+			bool const is_neg(p < eol && *p == '-');
+			char const *q(p + is_neg);
+			if (q == eol || !fast_isdigit(*q)) return 0;
+			for (val = 0; q < eol && fast_isdigit(*q); ++q) {val = 10*val + int(*q - '0');}
+			if (is_neg) {val = -val;}
+			p = q;
+			return 1;
+		}
+		static string get_rest_of_line(char const *p, char const *eol) { // same rules as read_str_to_newline()
+			skip_ws(p, eol);
+			string str(p, eol);
+			while (!str.empty() && fast_isspace(str.back())) {str.pop_back();}
+			return str;
+		}
+		void add_error(unsigned line, string const &msg) {cmds.emplace_back(OBJ_CMD_ERROR, (unsigned)face_npts.size(), line, 0, msg);}
+
+		void parse(geom_xform_t const &xf, int recalc_normals) {
+			for (char const *p = begin; p < end; ) {
+				char const *eol(p);
+				while (eol < end && *eol != '\n') {++eol;}
+				char const *const next_line(eol + (eol < end));
+				unsigned const line(num_lines++);
+				skip_ws(p, eol);
+				char const *const tok(p);
+				while (p < eol && !is_ws(*p)) {++p;}
+				unsigned const tlen(p - tok);
+				unsigned const fix((unsigned)face_npts.size());
+
+				if (tlen == 0 || tok[0] == '#') {} // empty line or comment
+				else if (tlen == 1 && tok[0] == 'f') { // face
+					unsigned npts(0);
+					obj_face_vert_t fv;
+
+					while (parse_int(p, eol, fv.vix)) { // read vertex index
+						fv.flags = 0;
+						if (fv.vix < 0) {fv.vix += (int)v.size() + 1; fv.flags |= 4;}
+
+						if (p < eol && *p == '/') {
+							++p;
+							if (parse_int(p, eol, fv.tix)) { // read text coord index
+								fv.flags |= 1;
+								if (fv.tix < 0) {fv.tix += (int)tc.size() + 1; fv.flags |= 8;}
+							}
+							if (p < eol && *p == '/') {
+								++p;
+								if (parse_int(p, eol, fv.nix)) { // read normal index
+									fv.flags |= 2;
+									if (fv.nix < 0) {fv.nix += (int)n.size() + 1; fv.flags |= 16;}
+								}
+							}
+						}
+						face_verts.push_back(fv);
+						++npts;
+					} // end while vertex
+					if (npts >= 3) {face_npts.push_back(npts);}
+					else { // remove pts and record the error
+						face_verts.resize(face_verts.size() - npts);
+						cmds.emplace_back(OBJ_CMD_BAD_FACE, fix, line, npts);
+					}
+				}
+				else if (tlen == 1 && tok[0] == 'v') { // vertex
+					point pos;
+					float vals[4] = {};
+					unsigned nv(0);
+					while (nv < 4 && parse_float(p, eol, vals[nv])) {++nv;}
+					if (nv < 3) {add_error(line, "Error reading vertex from object file"); return;}
+					UNROLL_3X(pos[i_] = vals[i_];)
+
+					if (nv == 4) { // vertex color
+						colorRGB color(vals[3], 0.0, 0.0);
+						if (!parse_float(p, eol, color.G) || !parse_float(p, eol, color.B)) {add_error(line, "Error reading vertex color from object file"); return;}
+						colors.emplace_back((unsigned)v.size(), color);
+					}
+					xf.xform_pos(pos);
+					v.push_back(pos);
+				}
+				else if (tlen == 2 && tok[0] == 'v' && tok[1] == 't') { // tex coord
+					point2d<float> t;
+					if (!parse_float(p, eol, t.x) || !parse_float(p, eol, t.y)) {add_error(line, "Error reading texture coord from object file"); return;}
+					tc.push_back(t); // discard the optional third component
+				}
+				else if (tlen == 2 && tok[0] == 'v' && tok[1] == 'n') { // normal
+					vector3d normal;
+					for (unsigned d = 0; d < 3; ++d) {if (!parse_float(p, eol, normal[d])) {add_error(line, "Error reading normal from object file"); return;}}
+					if (!recalc_normals) {xf.xform_pos_rm(normal); n.push_back(normal);}
+				}
+				else if (tlen == 1 && tok[0] == 'l') {} // line; ignore
+				else if (tlen == 1 && tok[0] == 'o') {cmds.emplace_back(OBJ_CMD_OBJECT, fix, line);} // object definition
+				else if (tlen == 1 && tok[0] == 'g') {cmds.emplace_back(OBJ_CMD_GROUP,  fix, line);} // group
+				else if (tlen == 1 && tok[0] == 's') { // smoothing/shading (off/on or 0/1)
+					int sg(0);
+					if (parse_int(p, eol, sg) && sg >= 0) {cmds.emplace_back(OBJ_CMD_SMOOTH, fix, line, sg);}
+					else if (get_rest_of_line(p, eol) == "off") {cmds.emplace_back(OBJ_CMD_SMOOTH, fix, line, 0);}
+					else {add_error(line, "Error reading smoothing group from object file"); return;}
+				}
+				else if (tlen == 6 && strncmp(tok, "usemtl", 6) == 0) {cmds.emplace_back(OBJ_CMD_USEMTL, fix, line, 0, get_rest_of_line(p, eol));} // use material
+				else if (tlen == 6 && strncmp(tok, "mtllib", 6) == 0) {cmds.emplace_back(OBJ_CMD_MTLLIB, fix, line, 0, get_rest_of_line(p, eol));} // material library
+				else {cmds.emplace_back(OBJ_CMD_WARN, fix, line, 0, string(tok, tlen));} // undefined entry
+				p = next_line;
+			} // for p
+		}
+	};
+
+	static int get_chunk_index(obj_face_vert_t const &fv, unsigned rel_flag, int ix, unsigned base) {
+		return ((fv.flags & rel_flag) ? (ix + (int)base) : ix); // relative index becomes an absolute 1-based index
+	}
+
+	bool parse_parallel(geom_xform_t const &xf) {
+		auto file(std::make_shared<mapped_file_t>());
+
+		if (!file->open(filename)) {
+			cerr << "Error: Could not open object file " << filename << endl;
+			return 0;
+		}
+		char const *const data(file->data()), *const data_end(data + file->size());
+		unsigned const chunk_size(1 << 20); // 1MB
+		unsigned const num_chunks(max(1U, min((unsigned)(file->size()/chunk_size), 8U*(unsigned)omp_get_max_threads())));
+		vector<obj_chunk_t> chunks(num_chunks);
+
+		for (unsigned i = 0; i < num_chunks; ++i) { // split into line-aligned chunks
+			obj_chunk_t &c(chunks[i]);
+			c.begin    = ((i == 0) ? data : chunks[i-1].end);
+			c.end      = ((i+1 == num_chunks) ? data_end : max(c.begin, data + (file->size()*(i+1))/num_chunks));
+			c.file_end = data_end;
+			while (c.end < data_end && c.end[-1] != '\n') {++c.end;} // end after a newline
+		}
+#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < (int)num_chunks; ++i) {chunks[i].parse(xf, recalc_normals);}
+		// merge vertex data in file order
+		unsigned nv(v.size()), nn(n.size()), ntc(tc.size());
+		vector<unsigned> v_base(num_chunks), n_base(num_chunks), tc_base(num_chunks);
+		bool has_colors(0);
+
+		for (unsigned i = 0; i < num_chunks; ++i) {
+			v_base[i] = nv; n_base[i] = nn - 1; tc_base[i] = ntc - 1; // normal and tc indices don't include n[0] and tc[0]
+			nv  += chunks[i].v .size();
+			nn  += chunks[i].n .size();
+			ntc += chunks[i].tc.size();
+			has_colors |= !chunks[i].colors.empty();
+		}
+		v .reserve(nv);
+		n .reserve(nn);
+		tc.reserve(ntc);
+		for (obj_chunk_t const &c : chunks) {vector_add_to(c.v, v); vector_add_to(c.n, n); vector_add_to(c.tc, tc);}
+		if (recalc_normals) {vn.resize(v.size());}
+
+		if (has_colors) { // all vertices get a color, with white for those that don't specify one
+			colors.resize(v.size(), WHITE);
+
+			for (unsigned i = 0; i < num_chunks; ++i) {
+				for (auto const &c : chunks[i].colors) {colors[v_base[i] + c.first] = c.second;}
+			}
+		}
+		// replay faces and commands in file order
+		unsigned line_base(0);
+
+		for (unsigned i = 0; i < num_chunks; ++i) {
+			obj_chunk_t &c(chunks[i]);
+			unsigned fvix(0), cix(0);
+
+			for (unsigned f = 0; f <= c.face_npts.size(); ++f) {
+				for (; cix < c.cmds.size() && c.cmds[cix].face_ix == f; ++cix) { // apply commands that come before this face
+					obj_cmd_t const &cmd(c.cmds[cix]);
+					approx_line = line_base + cmd.line + 1;
+
+					switch (cmd.type) {
+					case OBJ_CMD_USEMTL: if (!set_material(cmd.str)) return 0; break;
+					case OBJ_CMD_MTLLIB: if (!add_mat_lib (cmd.str)) return 0; break;
+					case OBJ_CMD_OBJECT: ++num_objects; ++obj_group_id; break;
+					case OBJ_CMD_GROUP : ++num_groups;  ++obj_group_id; break;
+					case OBJ_CMD_SMOOTH: smoothing_group = cmd.val; break;
+					case OBJ_CMD_BAD_FACE: face_pts.resize(min(cmd.val, 2U)); add_face(); break; // reports the error
+					case OBJ_CMD_WARN:
+						cerr << "Error: Undefined entry '" << cmd.str << "' in object file " << filename << " near line " << approx_line << endl;
+						break;
+					case OBJ_CMD_ERROR:
+						cerr << cmd.str << " " << filename << " near line " << approx_line << endl;
+						return 0;
+					default: assert(0);
+					}
+				} // for cix
+				if (f == c.face_npts.size()) break; // no more faces
+				face_pts.resize(c.face_npts[f]);
+
+				for (vntc_ix_t &vntc_ix : face_pts) {
+					obj_face_vert_t const &fv(c.face_verts[fvix++]);
+					int vix(get_chunk_index(fv, 4, fv.vix, v_base[i]));
+					normalize_index(vix, (unsigned)v.size());
+					vntc_ix = vntc_ix_t(vix, 0, 0);
+					int tix(get_chunk_index(fv, 8, fv.tix, tc_base[i]));
+
+					if (fv.flags & 1) {
+						normalize_index(tix, (unsigned)tc.size()-1); // account for tc[0]
+						vntc_ix.tix = tix+1; // account for tc[0]
+					}
+					int nix(get_chunk_index(fv, 16, fv.nix, n_base[i]));
+
+					if ((fv.flags & 2) && !recalc_normals) {
+						normalize_index(nix, (unsigned)n.size()-1); // account for n[0]
+						vntc_ix.nix = nix+1; // account for n[0]
+					}
+				} // for vntc_ix
+				add_face();
+			} // for f
+			line_base += c.num_lines;
+			c = obj_chunk_t(); // free memory
+		} // for i
+		approx_line = line_base;
+		return 1;
+	}
+
+public:
+	bool parse(geom_xform_t const &xf, int recalc_normals_, bool parallel) { // parse only; doesn't build the model
+		recalc_normals = recalc_normals_;
+		tc.push_back(point2d<float>(0.0, 0.0)); // default tex coords
+		n.push_back(zero_vector); // default normal
+		return (parallel ? parse_parallel(xf) : parse_serial(xf));
+	}
+	uint64_t get_parse_hash() const { // for checking that the serial and parallel readers agree
+		fnv1a_hash_t hash(v.size() + (uint64_t(n.size()) << 20) + (uint64_t(tc.size()) << 40));
+		auto add_bytes([&hash](void const *data, size_t sz) {hash.add_bytes(data, sz);});
+		if (!v     .empty()) {add_bytes(v     .data(), v     .size()*sizeof(point));}
+		if (!n     .empty()) {add_bytes(n     .data(), n     .size()*sizeof(vector3d));}
+		if (!tc    .empty()) {add_bytes(tc    .data(), tc    .size()*sizeof(point2d<float>));}
+		if (!colors.empty()) {add_bytes(colors.data(), colors.size()*sizeof(colorRGB));}
+
+		for (poly_data_block const &pb : pblocks) {
+			for (poly_header_t const &ph : pb.polys) {add_bytes(&ph.npts, sizeof(unsigned)); add_bytes(&ph.obj_id, sizeof(unsigned)); add_bytes(&ph.mat_id, sizeof(int)); add_bytes(&ph.n, sizeof(vector3d));}
+			if (!pb.pts.empty()) {add_bytes(pb.pts.data(), pb.pts.size()*sizeof(vntc_ix_t));}
+		}
+		for (counted_normal const &cn : vn) {add_bytes(&cn, sizeof(counted_normal));}
+		return hash.hash;
+	}
+
+	bool read(geom_xform_t const &xf, int recalc_normals_, bool verbose) {
+		size_t const file_size(get_file_size(filename));
+		bool const parallel(obj_file_parallel_parse && file_size >= OBJ_PARALLEL_MIN_SIZE);
+		cout << "Reading object file " << filename << (parallel ? " with parallel parser" : "") << endl;
+		RESET_TIME;
+		if (!parse(xf, recalc_normals_, parallel)) return 0;
 		remove_excess_cap(v);
 		remove_excess_cap(n);
 		remove_excess_cap(tc);
 		remove_excess_cap(vn);
 		remove_excess_cap(colors);
+		float const parse_secs(0.001*(GET_TIME_MS() - timer1));
+		cout << "Object file parse: " << (file_size >> 20) << " MB at " << ((parse_secs > 0.0) ? file_size/(parse_secs*(1<<20)) : 0.0) << " MB/s" << endl;
 		PRINT_TIME("Object File Load");
 		model.load_all_used_tids(); // need to load the textures here to get the colors
 		size_t const num_blocks(pblocks.size());
@@ -715,7 +1020,7 @@ public:
 
 			for (vector<poly_header_t>::const_iterator j = pd.polys.begin(); j != pd.polys.end(); ++j) {
 				poly.resize(j->npts);
-				
+
 				for (unsigned p = 0; p < j->npts; ++p) {
 					vntc_ix_t const &V(pd.pts[pix+p]);
 					vector3d normal;
@@ -749,7 +1054,7 @@ public:
 		}
 		model.finalize(); // optimize vertices, remove excess capacity, compute bounding cube, subdivide, generate LOD blocks
 		PRINT_TIME("Model3d Build");
-		
+
 		if (verbose) {
 			size_t const nn(recalc_normals ? vn.size() : n.size());
 			cout << "verts: " << v.size() << ", normals: " << nn << ", tcs: " << tc.size() << ", colors: " << colors.size() << ", faces: " << num_faces
@@ -773,6 +1078,7 @@ bool write_model3d_file(string const &base_fn, model3d &cur_model) {
 	string out_fn(base_fn.begin(), base_fn.end()-4); // strip off the '.obj'
 	out_fn += ".model3d";
 	if (model_calc_tan_vect) {cur_model.calc_tangent_vectors();} // tangent vectors are needed for writing
+	cur_model.compute_area_per_tri(); // stored in the file so that LOD can be done before material geometry is loaded
 				
 	if (!cur_model.write_to_disk(out_fn)) {
 		cerr << "Error writing model3d file " << out_fn << endl;
@@ -783,6 +1089,29 @@ bool write_model3d_file(string const &base_fn, model3d &cur_model) {
 }
 
 
+// parses an OBJ file without building the model or loading textures; used for comparing the serial and parallel parsers
+bool parse_obj_file_only(string const &fn, bool parallel, uint64_t &hash) {
+
+	texture_manager tmgr;
+	model3d model(fn, tmgr);
+	object_file_reader_model reader(fn, model);
+	if (!reader.parse(geom_xform_t(), 0, parallel)) return 0; // recalc_normals=0
+	hash = reader.get_parse_hash();
+	return 1;
+}
+
+
+// converts a model3d file in any supported version to the current version; in_fn and out_fn may be the same
+bool convert_model3d_file(string const &in_fn, string const &out_fn) {
+
+	texture_manager tmgr; // textures aren't needed
+	model3d model(in_fn, tmgr);
+	if (!model.read_from_disk(in_fn)) return 0;
+	model.compute_area_per_tri();
+	return model.write_to_disk(out_fn);
+}
+
+
 bool read_3ds_file_model(string const &filename, model3d &model, geom_xform_t const &xf, int use_vertex_normals, bool verbose);
 bool read_3ds_file_pts(string const &filename, vector<coll_tquad> *ppts, geom_xform_t const &xf, colorRGBA const &def_c, bool verbose);
 bool read_assimp_model(string const &filename, model3d &model, geom_xform_t const &xf, string const &anim_name, int recalc_normals, bool verbose);
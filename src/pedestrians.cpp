@@ -4,6 +4,7 @@
 #include "city.h"
 #include "shaders.h"
 #include <fstream>
+#include <omp.h>
 
 float const CROSS_SPEED_MULT = 1.8; // extra speed multiplier when crossing the road
 float const CROSS_WAIT_TIME  = 60.0; // in seconds
@@ -195,11 +196,6 @@ bool pedestrian_t::is_valid_pos(vect_cube_t const &colliders, bool &ped_at_dest,
 	return 1;
 }
 
-void register_ped_coll(pedestrian_t &p1, pedestrian_t &p2, unsigned pid1, unsigned pid2) {
-	p1.collided = p1.ped_coll = 1; p1.colliding_ped = pid2;
-	p2.collided = p2.ped_coll = 1; p2.colliding_ped = pid1;
-}
-
 bool check_for_ped_future_coll(point const &p1, point const &p2, vector3d const &v1, vector3d const &v2, float r1, float r2) {
 	// determine if these two peds will collide within LOOKAHEAD_TICKS time
 	point const p1b(p1 + LOOKAHEAD_TICKS*v1), p2b(p2 + LOOKAHEAD_TICKS*v2);
@@ -213,66 +209,51 @@ bool check_for_ped_future_coll(point const &p1, point const &p2, vector3d const
 #endif
 }
 
-bool pedestrian_t::check_ped_ped_coll_range(vector<pedestrian_t> &peds, unsigned pid, unsigned ped_start, unsigned target_plot, float prox_radius, vector3d &force) {
+// other peds are read from their start of frame state and only this ped is modified, so peds can be updated in any order and in parallel;
+// each ped of a colliding pair detects the collision itself, including collisions with stopped peds
+bool pedestrian_t::check_ped_ped_coll_range(ped_manager_t const &ped_mgr, unsigned pid, unsigned target_plot, float prox_radius, vector3d &force) {
 	float const prox_radius_sq(prox_radius*prox_radius);
 
-	for (auto i = peds.begin()+ped_start; i != peds.end(); ++i) { // check every ped until we exit target_plot
-		if (i->plot != target_plot) break; // moved to a new plot, no collision, done; since plots are globally unique across cities, we don't need to check cities
-		float const dist_sq(p2p_dist_xy_sq(pos, i->pos));
-		if (dist_sq > prox_radius_sq) continue; // proximity test
-		if (i->destroyed) continue; // dead
-		float const r1(get_coll_radius()), r2(i->get_coll_radius()), r_sum(r1 + r2);
-		if (dist_sq < r_sum*r_sum) {register_ped_coll(*this, *i, pid, (i - peds.begin())); return 1;} // collision
-		if (speed < TOLERANCE) continue;
-		point const p1_xy(pos.x, pos.y, 0.0), p2_xy(i->pos.x, i->pos.y, 0.0); // z=0.0
-		vector3d const delta_v(vel - i->vel), delta_p(p1_xy - p2_xy);
+	return ped_mgr.get_ped_grid().iterate_near(target_plot, pos, prox_radius, [&](unsigned ix) { // peds in grid cells near us in target_plot
+		if (ix == pid) return 0; // skip self
+		ped_snapshot_t const &p(ped_mgr.get_prev_ped(ix));
+		float const dist_sq(p2p_dist_xy_sq(pos, p.pos));
+		if (dist_sq > prox_radius_sq) return 0; // proximity test
+		float const r1(get_coll_radius()), r2(p.coll_radius), r_sum(r1 + r2);
+		if (dist_sq < r_sum*r_sum) {collided = ped_coll = 1; colliding_ped = ix; return 1;} // collision
+		if (speed < TOLERANCE) return 0;
+		point const p1_xy(pos.x, pos.y, 0.0), p2_xy(p.pos.x, p.pos.y, 0.0); // z=0.0
+		vector3d const delta_v(vel - p.vel), delta_p(p1_xy - p2_xy);
 		float const dp(-dot_product_xy(delta_v, delta_p));
-		if (dp <= 0.0) continue; // diverging, no avoidance needed
-		if (!check_for_ped_future_coll(p1_xy, p2_xy, vel, i->vel, r1, r2)) continue;
+		if (dp <= 0.0) return 0; // diverging, no avoidance needed
+		if (!check_for_ped_future_coll(p1_xy, p2_xy, vel, p.vel, r1, r2)) return 0;
 		float const dv_mag(delta_v.mag());
-		if (dv_mag < TOLERANCE) continue;
+		if (dv_mag < TOLERANCE) return 0;
 		float const dist(sqrt(dist_sq)), fmag(dist/(dist - 0.9*r_sum));
 		vector3d const rejection(delta_p - (dp/(dv_mag*dv_mag))*delta_v); // component of velocity perpendicular to delta_p (avoid dir)
 		float const rmag(rejection.mag()), rel_vel(max(dv_mag/speed, 0.5f)); // higher when peds are converging
-		if (rmag < TOLERANCE) continue;
+		if (rmag < TOLERANCE) return 0;
 		float const force_mult(dp/(dv_mag*dist)); // stronger with head-on collisions
 		force += rejection*(rel_vel*force_mult*fmag/rmag);
 		//cout << TXT(r_sum) << TXT(dist) << TXT(fmag) << ", dv: " << delta_v.str() << ", dp: " << delta_p.str() << ", rej: " << rejection.str() << ", force: " << force.str() << endl;
-	} // for i
-	return 0;
+		return 0;
+	});
 }
 
-bool pedestrian_t::check_ped_ped_coll(ped_manager_t const &ped_mgr, vector<pedestrian_t> &peds, unsigned pid, float delta_dir) {
-	assert(pid < peds.size());
+bool pedestrian_t::check_ped_ped_coll(ped_manager_t const &ped_mgr, unsigned pid, float delta_dir) {
 	float const lookahead_dist(LOOKAHEAD_TICKS*speed); // how far we can travel in 2s
 	float const prox_radius(1.2*radius + lookahead_dist); // assume other ped has a similar radius
 	vector3d force(zero_vector);
-	if (check_ped_ped_coll_range(peds, pid, pid+1, plot, prox_radius, force)) return 1;
+	if (check_ped_ped_coll_range(ped_mgr, pid, plot, prox_radius, force)) return 1;
 
 	if (in_the_road && next_plot != plot) {
 		// need to check for coll between two peds crossing the street from different sides, since they won't be in the same plot while in the street
-		unsigned const ped_ix(ped_mgr.get_first_ped_at_plot(next_plot));
-		assert(ped_ix <= peds.size()); // could be at the end
-		if (check_ped_ped_coll_range(peds, pid, ped_ix, next_plot, prox_radius, force)) return 1;
+		if (check_ped_ped_coll_range(ped_mgr, pid, next_plot, prox_radius, force)) return 1;
 	}
 	if (force != zero_vector) {set_velocity((0.1*delta_dir)*force + ((1.0 - delta_dir)/speed)*vel);} // apply ped repulsive force
 	return 0;
 }
 
-bool pedestrian_t::check_ped_ped_coll_stopped(vector<pedestrian_t> &peds, unsigned pid) {
-	assert(pid < peds.size());
-
-	// Note: shouldn't have to check peds in the next plot, assuming that if we're stopped, they likely are as well, and won't be walking toward us
-	for (auto i = peds.begin()+pid+1; i != peds.end(); ++i) { // check every ped until we exit target_plot
-		if (i->plot != plot) break; // moved to a new plot, no collision, done; since plots are globally unique across cities, we don't need to check cities
-		if (!dist_xy_less_than(pos, i->pos, (get_coll_radius() + i->get_coll_radius()))) continue; // no collision
-		if (i->destroyed) continue; // dead
-		i->collided = i->ped_coll = 1; i->colliding_ped = pid;
-		return 1; // Note: could omit this return and continue processing peds
-	} // for i
-	return 0;
-}
-
 point rand_xy_pt_on_cube_edge(cube_t const &c, float radius, rand_gen_t &rgen) {
 	bool const dim(rgen.rand_bool()), dir(rgen.rand_bool());
 	point pt;
@@ -606,7 +587,7 @@ void pedestrian_t::get_avoid_cubes(ped_manager_t const &ped_mgr, vect_cube_t con
 		else {avoid_entire_plot = 1;} // not our destination plot, we can't walk through any residential properties
 
 		if (!in_the_road) { // include collider bcubes for cars parked in house driveways
-			static vect_cube_t car_bcubes; // reused across calls
+			static thread_local vect_cube_t car_bcubes; // reused across calls; per-thread since peds are updated in parallel
 			car_bcubes.clear();
 			ped_mgr.get_parked_car_bcubes_for_plot(plot_bcube, city, car_bcubes);
 
@@ -709,13 +690,14 @@ void pedestrian_t::move(ped_manager_t const &ped_mgr, cube_t const &plot_bcube,
 }
 
 void pedestrian_t::run_path_finding(ped_manager_t &ped_mgr, cube_t const &plot_bcube, cube_t const &next_plot_bcube, vect_cube_t const &colliders, vector3d &dest_pos) {
-	vect_cube_t &avoid(ped_mgr.path_finder.get_avoid_vector());
+	path_finder_t &path_finder(ped_mgr.get_path_finder());
+	vect_cube_t &avoid(path_finder.get_avoid_vector());
 	get_avoid_cubes(ped_mgr, colliders, plot_bcube, next_plot_bcube, dest_pos, avoid);
 	target_pos = all_zeros;
 	cube_t union_plot_bcube(plot_bcube);
 	union_plot_bcube.union_with_cube(next_plot_bcube); // this is the area the ped is constrained to (both plots + road in between)
 	// run path finding between pos and dest_pos using avoid cubes
-	if (ped_mgr.path_finder.run(pos, dest_pos, union_plot_bcube, 0.1*radius, dest_pos)) {target_pos = dest_pos;}
+	if (path_finder.run(pos, dest_pos, union_plot_bcube, 0.1*radius, dest_pos)) {target_pos = dest_pos;}
 }
 
 void pedestrian_t::get_plot_bcubes_inc_sidewalks(ped_manager_t const &ped_mgr, cube_t &plot_bcube, cube_t &next_plot_bcube) const {
@@ -728,17 +710,22 @@ void pedestrian_t::get_plot_bcubes_inc_sidewalks(ped_manager_t const &ped_mgr, c
 	next_plot_bcube.expand_by_xy(sidewalk_width);
 }
 
-void pedestrian_t::next_frame(ped_manager_t &ped_mgr, vector<pedestrian_t> &peds, unsigned pid, rand_gen_t &rgen, float delta_dir) {
-	if (destroyed)    return; // destroyed
-	if (speed == 0.0) return; // not moving, no update needed
+// navigation with destination; this modifies shared state (the ped manager rgen and crosswalks), so it's run serially before the parallel next_frame() calls
+void pedestrian_t::update_dest(ped_manager_t &ped_mgr) {
+	if (destroyed || speed == 0.0) return;
 
-	// navigation with destination
 	if (at_dest) {
 		register_at_dest();
 		ped_mgr.choose_new_ped_plot_pos(*this);
 	}
 	else if (!has_dest_bldg && !has_dest_car) {ped_mgr.choose_dest_building_or_parked_car(*this);}
 	if (at_crosswalk) {ped_mgr.mark_crosswalk_in_use(*this);}
+}
+
+// Note: only modifies this ped, and reads other peds from their start of frame state
+void pedestrian_t::next_frame(ped_manager_t &ped_mgr, unsigned pid, rand_gen_t &rgen, float delta_dir) {
+	if (destroyed)    return; // destroyed
+	if (speed == 0.0) return; // not moving, no update needed
 	cube_t plot_bcube, next_plot_bcube;
 	get_plot_bcubes_inc_sidewalks(ped_mgr, plot_bcube, next_plot_bcube);
 	// movement logic
@@ -750,8 +737,7 @@ void pedestrian_t::next_frame(ped_manager_t &ped_mgr, vector<pedestrian_t> &peds
 			target_pos = all_zeros;
 			go(); // back up or turn so that we don't walk forward into the street? move() should attempt to rotate in place
 		}
-		else {
-			check_ped_ped_coll_stopped(peds, pid); // still need to check for other peds colliding with us; this doesn't always work
+		else { // other peds check for collisions with us
 			collided = ped_coll = 0;
 			return;
 		}
@@ -766,7 +752,7 @@ void pedestrian_t::next_frame(ped_manager_t &ped_mgr, vector<pedestrian_t> &peds
 	else if (!check_inside_plot(ped_mgr, prev_pos, plot_bcube, next_plot_bcube)) {collided = outside_plot = 1;} // outside the plot, treat as a collision with the plot bounds
 	else if (!is_valid_pos(colliders, at_dest, &ped_mgr))           {collided = 1;} // collided with a static collider
 	else if (check_road_coll(ped_mgr, plot_bcube, next_plot_bcube)) {collided = 1;} // collided with something in the road (stoplight, streetlight, etc.)
-	else if (check_ped_ped_coll(ped_mgr, peds, pid, delta_dir))     {collided = 1;} // collided with another pedestrian
+	else if (check_ped_ped_coll(ped_mgr, pid, delta_dir))           {collided = 1;} // collided with another pedestrian
 	else { // no collisions
 		//cout << TXT(pid) << TXT(plot) << TXT(dest_plot) << TXT(next_plot) << TXT(at_dest) << TXT(delta_dir) << TXT((unsigned)stuck_count) << TXT(collided) << endl;
 		int debug_state(0); // unused
@@ -811,8 +797,7 @@ void pedestrian_t::next_frame(ped_manager_t &ped_mgr, vector<pedestrian_t> &peds
 			else {pos += rgen.signed_rand_vector_spherical_xy()*(0.1*radius); } // shift randomly by 10% radius to get unstuck
 		}
 		if (ped_coll) {
-			assert(colliding_ped < peds.size());
-			pedestrian_t const &other(peds[colliding_ped]);
+			ped_snapshot_t const &other(ped_mgr.get_prev_ped(colliding_ped));
 			vector3d const coll_dir(other.pos - pos);
 			new_dir = cross_product(vel, plus_z); // right angle turn - using the tangent causes peds to get stuck together
 			if (dot_product_xy(new_dir, coll_dir) > 0.0) {new_dir.negate();} // orient away from the other ped's position
@@ -1089,18 +1074,93 @@ void ped_manager_t::register_ped_new_plot(pedestrian_t const &ped) {
 	if (!need_to_sort_city.empty()) {need_to_sort_city[ped.city] = 1;}
 	need_to_sort_peds = 1;
 }
-void ped_manager_t::move_ped_to_next_plot(pedestrian_t &ped) {
+void ped_manager_t::move_ped_to_next_plot(pedestrian_t &ped) { // Note: called in parallel; plot changes are registered at the end of next_frame()
 	if (ped.next_plot == ped.plot) return; // already there (error?)
 	ped.plot = ped.next_plot; // assumes plot is adjacent; doesn't actually do any moving, only registers the move
-	register_ped_new_plot(ped);
 }
 
-void ped_manager_t::next_frame() {
+void ped_grid_t::build(vector<ped_snapshot_t> const &peds, vector<pair<unsigned, unsigned>> const &ranges, unsigned num_plots, float cell_sz) {
+	unsigned const MAX_CELLS_PER_DIM = 64; // limit memory for large plots
+	assert(cell_sz > 0.0);
+	plots.clear();
+	plots.resize(num_plots);
+	int const num_ranges(ranges.size());
+
+#pragma omp parallel for schedule(dynamic)
+	for (int r = 0; r < num_ranges; ++r) { // calculate the bounds of peds in each plot; ranges contain disjoint plots
+		for (unsigned i = ranges[r].first; i < ranges[r].second; ++i) {
+			ped_snapshot_t const &p(peds[i]);
+			if (p.destroyed) continue;
+			assert(p.plot < num_plots);
+			plot_grid_t &pg(plots[p.plot]);
+			if (pg.nx == 0) {pg.x0 = pg.x1 = p.pos.x; pg.y0 = pg.y1 = p.pos.y; pg.nx = 1;} // first ped
+			else {min_eq(pg.x0, p.pos.x); max_eq(pg.x1, p.pos.x); min_eq(pg.y0, p.pos.y); max_eq(pg.y1, p.pos.y);}
+		}
+	}
+	unsigned num_cells(0);
+
+	for (plot_grid_t &pg : plots) {
+		if (pg.nx == 0) continue; // no peds
+		float const dx(pg.x1 - pg.x0), dy(pg.y1 - pg.y0);
+		pg.nx = max(1U, min(MAX_CELLS_PER_DIM, unsigned(ceil(dx/cell_sz))));
+		pg.ny = max(1U, min(MAX_CELLS_PER_DIM, unsigned(ceil(dy/cell_sz))));
+		pg.inv_dx = ((dx > 0.0) ? pg.nx/dx : 0.0);
+		pg.inv_dy = ((dy > 0.0) ? pg.ny/dy : 0.0);
+		pg.cell_start = num_cells;
+		num_cells += pg.nx*pg.ny;
+	}
+	cell_start.clear();
+	cell_start.resize(num_cells+1, 0);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int r = 0; r < num_ranges; ++r) { // count peds per cell
+		for (unsigned i = ranges[r].first; i < ranges[r].second; ++i) {
+			if (!peds[i].destroyed) {++cell_start[get_cell(plots[peds[i].plot], peds[i].pos)+1];}
+		}
+	}
+	for (unsigned c = 0; c < num_cells; ++c) {cell_start[c+1] += cell_start[c];}
+	ped_ixs.resize(cell_start.back());
+	cell_pos.assign(cell_start.begin(), cell_start.end()-1);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int r = 0; r < num_ranges; ++r) { // add peds to cells in index order
+		for (unsigned i = ranges[r].first; i < ranges[r].second; ++i) {
+			if (!peds[i].destroyed) {ped_ixs[cell_pos[get_cell(plots[peds[i].plot], peds[i].pos)]++] = i;}
+		}
+	}
+}
+
+path_finder_t &ped_manager_t::get_path_finder() {
+	unsigned const tid(omp_get_thread_num());
+	assert(tid < path_finders.size());
+	return path_finders[tid];
+}
+
+void ped_manager_t::build_ped_grid() {
+	//timer_t timer("Build Ped Grid");
+	prev_peds.resize(peds.size());
+	unsigned num_plots(by_plot.size());
+	float max_prox_radius(0.0);
+
+	for (auto const &r : active_ped_ranges) {
+		for (unsigned i = r.first; i < r.second; ++i) {
+			pedestrian_t const &ped(peds[i]);
+			ped_snapshot_t &p(prev_peds[i]);
+			p.pos = ped.pos; p.vel = ped.vel; p.coll_radius = ped.get_coll_radius(); p.plot = ped.plot; p.destroyed = ped.destroyed;
+			max_eq(num_plots, ped.plot+1);
+			max_eq(max_prox_radius, (1.2f*ped.radius + LOOKAHEAD_TICKS*ped.speed)); // same as check_ped_ped_coll()
+		}
+	}
+	// use a cell size of the max ped-ped collision query radius so that most queries touch at most 3x3 cells
+	ped_grid.build(prev_peds, active_ped_ranges, num_plots, max(max_prox_radius, get_ped_radius()));
+}
+
+void ped_manager_t::next_frame(bool bench_mode) {
 	if (!animate2) return; // nothing to do (only applies to moving peds)
 	float const delta_dir(1.2*(1.0 - pow(0.7f, fticks))); // controls pedestrian turning rate
 	// Note: peds and peds_b can be processed in parallel, but that doesn't seem to make a significant difference in framerate
 	// update people in buildings first, so that it can overlap with car sort and spend less time in the modify_car_data critical section
-	update_building_ai_state(delta_dir);
+	if (!bench_mode) {update_building_ai_state(delta_dir);}
 
 	if (!peds.empty()) {
 		//timer_t timer("Ped Update"); // ~4.2ms for 10K peds; 1ms for sparse per-city update
@@ -1117,20 +1177,78 @@ void ped_manager_t::next_frame() {
 		if (first_frame) { // choose initial ped destinations (must be after building setup, etc.)
 			for (auto i = peds.begin(); i != peds.end(); ++i) {choose_dest_building_or_parked_car(*i);}
 		}
+		active_ped_ranges.clear();
+		active_plots.clear();
+
 		for (unsigned city = 0; city+1 < by_city.size(); ++city) {
-			if (!get_expanded_city_bcube_for_peds(city).closest_dist_less_than(camera_bs, enable_ai_dist)) continue; // too far from the player
+			if (!bench_mode && !get_expanded_city_bcube_for_peds(city).closest_dist_less_than(camera_bs, enable_ai_dist)) continue; // too far from the player
 			unsigned const ped_start(by_city[city].ped_ix), ped_end(by_city[city+1].ped_ix);
 			assert(ped_start <= ped_end && ped_end <= peds.size());
-				
-			for (auto i = peds.begin()+ped_start; i != peds.begin()+ped_end; ++i) {
-				i->next_frame(*this, peds, (i - peds.begin()), rgen, delta_dir);
-			}
+			if (ped_start == ped_end) continue; // no peds
+			active_ped_ranges.emplace_back(ped_start, ped_end);
+			for (unsigned plot = by_city[city].plot_ix; plot < by_city[city+1].plot_ix; ++plot) {active_plots.push_back(plot);}
 		} // for city
+		for (auto const &r : active_ped_ranges) { // serial destination update
+			for (unsigned i = r.first; i < r.second; ++i) {peds[i].update_dest(*this);}
+		}
+		build_ped_grid(); // after update_dest(), which may respawn peds
+		// update peds in parallel across plots; each ped only modifies itself and reads other peds from prev_peds,
+		// and uses its own random number generator, so the results don't depend on the number of threads
+		int const num_threads(city_params.ped_sim_threads ? city_params.ped_sim_threads : omp_get_max_threads()), num_plots(active_plots.size());
+		path_finders.resize(max(1, num_threads));
+		// Note: when called from the pedestrian thread of the parallel draw section, nested parallel regions are disabled and this loop runs serially
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads) if (num_threads > 1)
+		for (int p = 0; p < num_plots; ++p) {
+			unsigned const plot(active_plots[p]);
+			assert(plot+1 < by_plot.size());
+
+			for (unsigned i = by_plot[plot]; i < by_plot[plot+1]; ++i) {
+				rand_gen_t ped_rgen;
+				ped_rgen.set_state((i + 1), (sim_frame_ix + 1));
+				ped_rgen.rand_mix();
+				peds[i].next_frame(*this, i, ped_rgen, delta_dir);
+			}
+		} // for p
+		for (auto const &r : active_ped_ranges) { // serial registration of peds that moved to a new plot
+			for (unsigned i = r.first; i < r.second; ++i) {
+				if (peds[i].plot != prev_peds[i].plot) {register_ped_new_plot(peds[i]);}
+			}
+		}
+		++sim_frame_ix;
 		if (need_to_sort_peds) {sort_by_city_and_plot();}
 		first_frame = 0;
 	}
 }
 
+void ped_manager_t::save_sim_state() {
+	saved_state.peds  = peds;
+	saved_state.by_city = by_city;
+	saved_state.by_plot = by_plot;
+	saved_state.need_to_sort_city = need_to_sort_city;
+	saved_state.rgen  = rgen;
+	saved_state.sim_frame_ix = sim_frame_ix;
+	saved_state.need_to_sort_peds = need_to_sort_peds;
+}
+void ped_manager_t::restore_sim_state() {
+	peds    = saved_state.peds;
+	by_city = saved_state.by_city;
+	by_plot = saved_state.by_plot;
+	need_to_sort_city = saved_state.need_to_sort_city;
+	rgen    = saved_state.rgen;
+	sim_frame_ix = saved_state.sim_frame_ix;
+	need_to_sort_peds = saved_state.need_to_sort_peds;
+}
+uint64_t ped_manager_t::get_sim_state_hash() const { // FNV-1a hash of ped positions, velocities, and plots
+	fnv1a_hash_t hash;
+
+	for (pedestrian_t const &ped : peds) {
+		hash.add(ped.pos);
+		hash.add(ped.vel);
+		hash.add(ped.plot);
+	}
+	return hash.hash;
+}
+
 pedestrian_t const *ped_manager_t::get_ped_at(point const &p1, point const &p2) const { // Note: p1/p2 in local TT space
 	for (unsigned city = 0; city+1 < by_city.size(); ++city) {
 		if (!get_expanded_city_bcube_for_peds(city).line_intersects(p1, p2)) continue; // skip
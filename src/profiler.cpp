@@ -4,6 +4,14 @@
 
 #include "3DWorld.h"
 #include "profiler.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <unordered_set>
+#include <unordered_map>
 
 using std::string;
 
@@ -47,6 +55,19 @@ public:
 					<< i->second.tmax << "\t" << float(i->second.time)/float(i->second.count) << endl;
 		}
 	}
+	void write_json(std::ostream &out, bool &first) const { // writes "name": {...} entries; times are in ms
+		for (auto i = entries.begin(); i != entries.end(); ++i) {
+			out << (first ? "" : ",\n") << "    \"" << i->first << "\": {\"count\": " << i->second.count
+				<< ", \"total_ms\": " << i->second.time << ", \"max_ms\": " << i->second.tmax << "}";
+			first = 0;
+		}
+	}
+	bool get_total(string const &name, float &total) const {
+		auto it(entries.find(name));
+		if (it == entries.end()) return 0;
+		total = float(it->second.time);
+		return 1;
+	}
 };
 
 timing_profiler<int> global_profiler;
@@ -55,17 +76,203 @@ timing_profiler<float> global_highres_profiler;
 void toggle_timing_profiler() {global_profiler.enabled ^= 1; global_highres_profiler.enabled ^= 1;}
 void register_timing_value(const char *str, int delta_time, bool no_loading_screen) {global_profiler.register_time(str, delta_time, no_loading_screen);}
 
+void enable_timing_profiler_no_print() {global_profiler.enabled = global_highres_profiler.enabled = 1;}
+bool is_timing_profiler_enabled() {return global_highres_profiler.enabled;}
+
+void timing_profiler_write_json(std::ostream &out) {
+	bool first(1);
+	out << "{\n";
+	global_profiler.write_json(out, first);
+	global_highres_profiler.write_json(out, first);
+	out << "\n  }";
+}
+float get_timing_profiler_total(string const &name) { // returns 0.0 if not found
+	float total(0.0);
+	if (!global_highres_profiler.get_total(name, total)) {global_profiler.get_total(name, total);}
+	return total;
+}
+
 void timing_profiler_stats() {
 	global_profiler.stats();
 	global_profiler.clear();
 	global_highres_profiler.stats();
 	global_highres_profiler.clear();
+	trace_profiler_summary();
 }
 
 void highres_timer_t::end() {
+	zone.end();
 	if (!enabled || name.empty()) return;
 	float const elapsed(duration_cast<duration<float>>(clock.now() - timer1).count());
 	global_highres_profiler.register_time(name.c_str(), 1000.0f*elapsed, no_loading_screen); // print in ms
 	name.clear(); // make sure we don't double count this
 }
 
+
+// trace profiler
+unsigned const TRACE_BUF_SIZE       = 1<<16; // events per thread; must be a power of 2
+unsigned const TRACE_MAX_DEPTH      = 64;
+unsigned const TRACE_SUMMARY_FRAMES = 120;
+unsigned const TRACE_SUMMARY_ZONES  = 10;
+
+bool trace_profiler_enabled(0);
+
+struct trace_event_t {
+	char const *name;
+	uint64_t start_ns, dur_ns;
+};
+
+// ring buffer of completed zones written only by its owning thread; readers see events up to num_written
+struct trace_thread_buf_t {
+	trace_event_t events[TRACE_BUF_SIZE];
+	std::atomic<uint64_t> num_written;
+	uint64_t frame_read_pos=0; // only used by trace_profiler_end_frame()
+	unsigned depth=0, index=0;
+	bool is_main=0;
+	char const *open_names[TRACE_MAX_DEPTH] = {};
+	uint64_t open_starts[TRACE_MAX_DEPTH] = {};
+
+	trace_thread_buf_t(unsigned index_, bool is_main_) : num_written(0), index(index_), is_main(is_main_) {}
+	uint64_t get_first_valid(uint64_t pos, uint64_t end) const {return max(pos, ((end > TRACE_BUF_SIZE) ? end - TRACE_BUF_SIZE : 0));} // older events were overwritten
+};
+
+class trace_profiler_t {
+	std::mutex mutex; // only used when a thread first records a zone and for string names
+	vector<std::unique_ptr<trace_thread_buf_t>> bufs;
+	std::unordered_set<string> names; // storage for non-literal zone names
+	std::thread::id main_thread;
+	high_resolution_clock::time_point start_time;
+	std::deque<map<string, float>> frame_zone_ms; // total ms of each zone for recent frames
+public:
+	void enable() {
+		start_time  = high_resolution_clock::now();
+		main_thread = std::this_thread::get_id();
+		trace_profiler_enabled = 1;
+	}
+	uint64_t get_time_ns() const {return duration_cast<nanoseconds>(high_resolution_clock::now() - start_time).count();}
+
+	trace_thread_buf_t *register_thread() {
+		std::lock_guard<std::mutex> lock(mutex);
+		bufs.emplace_back(new trace_thread_buf_t(bufs.size(), (std::this_thread::get_id() == main_thread)));
+		return bufs.back().get();
+	}
+	char const *intern_name(string const &name) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return names.insert(name).first->c_str(); // pointers to elements of unordered_set remain valid after rehashing
+	}
+	void end_frame() {
+		map<string, float> zone_ms;
+		std::lock_guard<std::mutex> lock(mutex); // protects bufs
+
+		for (auto const &b : bufs) {
+			uint64_t const end(b->num_written.load(std::memory_order_acquire));
+
+			for (uint64_t i = b->get_first_valid(b->frame_read_pos, end); i < end; ++i) {
+				trace_event_t const &e(b->events[i & (TRACE_BUF_SIZE-1)]);
+				zone_ms[e.name] += 1.0E-6f*e.dur_ns;
+			}
+			b->frame_read_pos = end;
+		}
+		frame_zone_ms.push_back(zone_ms);
+		if (frame_zone_ms.size() > TRACE_SUMMARY_FRAMES) {frame_zone_ms.pop_front();}
+	}
+	void summary() const {
+		if (frame_zone_ms.empty()) return;
+		map<string, pair<float, float>> zones; // {max, total}
+
+		for (auto const &f : frame_zone_ms) {
+			for (auto const &z : f) {
+				pair<float, float> &v(zones[z.first]);
+				v.first   = max(v.first, z.second);
+				v.second += z.second;
+			}
+		}
+		vector<pair<float, string>> by_max;
+		for (auto const &z : zones) {by_max.emplace_back(z.second.first, z.first);}
+		sort(by_max.begin(), by_max.end(), std::greater<pair<float, string>>());
+		cout << "Slowest zones over the last " << frame_zone_ms.size() << " frames (name max_ms avg_ms):" << endl;
+
+		for (unsigned i = 0; i < min((unsigned)by_max.size(), TRACE_SUMMARY_ZONES); ++i) {
+			cout << by_max[i].second << ": " << by_max[i].first << "\t" << zones.find(by_max[i].second)->second.second/frame_zone_ms.size() << endl;
+		}
+	}
+	bool write_json(string const &fn) { // should be called when worker threads are idle, otherwise some events may be overwritten as they're read
+		std::ofstream out(fn);
+
+		if (!out.good()) {
+			std::cerr << "Error: Failed to open trace profiler output file " << fn << " for write" << endl;
+			return 0;
+		}
+		auto write_str([&](char const *str) {
+			out << '"';
+			for (char const *c = str; *c; ++c) {
+				if (*c == '"' || *c == '\\') {out << '\\';}
+				out << *c;
+			}
+			out << '"';
+		});
+		std::lock_guard<std::mutex> lock(mutex);
+		uint64_t num_events(0), num_dropped(0);
+		out << std::fixed << std::setprecision(3); // microseconds with ns resolution
+		out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+		for (auto const &b : bufs) {
+			out << (b->index ? ",\n" : "\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << b->index
+				<< ", \"args\": {\"name\": \"" << (b->is_main ? "Main" : "Worker") << " " << b->index << "\"}}";
+			uint64_t const end(b->num_written.load(std::memory_order_acquire)), first(b->get_first_valid(0, end));
+			num_dropped += first;
+
+			for (uint64_t i = first; i < end; ++i, ++num_events) { // complete events; nesting is implied by the time ranges of events on the same thread
+				trace_event_t const &e(b->events[i & (TRACE_BUF_SIZE-1)]);
+				out << ",\n{\"name\": ";
+				write_str(e.name);
+				out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << b->index << ", \"ts\": " << 0.001*e.start_ns << ", \"dur\": " << 0.001*e.dur_ns << "}";
+			}
+		}
+		out << "\n]}" << endl;
+		cout << "Wrote " << num_events << " trace events for " << bufs.size() << " threads to " << fn;
+		if (num_dropped > 0) {cout << " (" << num_dropped << " older events were overwritten)";}
+		cout << endl;
+		return out.good();
+	}
+};
+
+trace_profiler_t trace_profiler;
+thread_local trace_thread_buf_t *trace_thread_buf(nullptr);
+
+void trace_zone_begin(char const *name) {
+	if (trace_thread_buf == nullptr) {trace_thread_buf = trace_profiler.register_thread();}
+	trace_thread_buf_t &b(*trace_thread_buf);
+
+	if (b.depth < TRACE_MAX_DEPTH) {
+		b.open_names [b.depth] = name;
+		b.open_starts[b.depth] = trace_profiler.get_time_ns();
+	}
+	++b.depth; // zones deeper than TRACE_MAX_DEPTH are counted but not recorded
+}
+void trace_zone_begin(string const &name) {
+	thread_local std::unordered_map<string, char const *> thread_names; // per-thread cache of interned names, so that only the first use of a name takes the lock
+	char const *&interned(thread_names[name]);
+	if (interned == nullptr) {interned = trace_profiler.intern_name(name);}
+	trace_zone_begin(interned);
+}
+
+void trace_zone_end() {
+	if (trace_thread_buf == nullptr) return; // zone started before tracing was enabled
+	trace_thread_buf_t &b(*trace_thread_buf);
+	if (b.depth == 0) return; // unmatched
+	--b.depth;
+	if (b.depth >= TRACE_MAX_DEPTH) return;
+	uint64_t const pos(b.num_written.load(std::memory_order_relaxed)), start(b.open_starts[b.depth]);
+	trace_event_t &e(b.events[pos & (TRACE_BUF_SIZE-1)]);
+	e.name     = b.open_names[b.depth];
+	e.start_ns = start;
+	e.dur_ns   = trace_profiler.get_time_ns() - start;
+	b.num_written.store(pos+1, std::memory_order_release); // publish the event to readers
+}
+
+void enable_trace_profiler() {trace_profiler.enable();}
+void trace_profiler_end_frame() {if (trace_profiler_enabled) {trace_profiler.end_frame();}}
+void trace_profiler_summary() {if (trace_profiler_enabled) {trace_profiler.summary();}}
+bool trace_profiler_write_json(string const &fn) {return trace_profiler.write_json(fn);}
+
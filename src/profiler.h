@@ -5,18 +5,47 @@
 
 #include <string>
 #include <chrono>
+#include <iosfwd>
 
 using namespace std::chrono;
 
+extern bool trace_profiler_enabled; // when disabled, trace zones cost a single branch
+
+// trace zones are recorded into per-thread ring buffers; name must remain valid until the trace is written (string literals are fine)
+void trace_zone_begin(char const *name);
+void trace_zone_begin(std::string const &name); // copies the name into a table of names that's never freed; the lock is only taken the first time a thread uses a name
+void trace_zone_end();
+
+class trace_zone_t { // scoped, nestable trace zone with the same interface as highres_timer_t
+	bool active;
+public:
+	trace_zone_t(char const *const name,  bool enabled=1, bool nls=0) : active(enabled && trace_profiler_enabled) {if (active) {trace_zone_begin(name);}}
+	trace_zone_t(std::string const &name, bool enabled=1, bool nls=0) : active(enabled && trace_profiler_enabled) {if (active) {trace_zone_begin(name);}}
+	~trace_zone_t() {end();}
+	void end() {if (active) {trace_zone_end(); active = 0;}}
+};
+
 class highres_timer_t { // should this share a base class with timer_t?
 	std::string name;
 	bool enabled, no_loading_screen;
 	high_resolution_clock::time_point timer1;
 	high_resolution_clock clock;
+	trace_zone_t zone; // also shows up in traces
 public:
-	highres_timer_t(char const *const name_,  bool enabled_=1, bool nls=0) : name(name_), enabled(enabled_), no_loading_screen(nls), timer1(clock.now()) {}
-	highres_timer_t(std::string const &name_, bool enabled_=1, bool nls=0) : name(name_), enabled(enabled_), no_loading_screen(nls), timer1(clock.now()) {}
+	highres_timer_t(char const *const name_,  bool enabled_=1, bool nls=0) : name(name_), enabled(enabled_), no_loading_screen(nls), timer1(clock.now()), zone(name_, enabled_) {}
+	highres_timer_t(std::string const &name_, bool enabled_=1, bool nls=0) : name(name_), enabled(enabled_), no_loading_screen(nls), timer1(clock.now()), zone(name_, enabled_) {}
 	~highres_timer_t() {end();}
 	void end();
 };
 
+
+void enable_timing_profiler_no_print();
+bool is_timing_profiler_enabled();
+void timing_profiler_write_json(std::ostream &out);
+float get_timing_profiler_total(std::string const &name);
+
+void enable_trace_profiler();
+void trace_profiler_end_frame(); // accumulates zone times for the rolling summary of the slowest zones
+void trace_profiler_summary();
+bool trace_profiler_write_json(std::string const &fn); // Chrome trace event format, which can be viewed in Perfetto or chrome://tracing
+
@@ -6,6 +6,7 @@
 #include "mesh.h"
 #include "model3d.h"
 #include "binary_file_io.h"
+#include "profiler.h"
 #include <atomic>
 #include <thread>
 
@@ -22,6 +23,9 @@ bool keep_beams(0); // debugging mode
 bool kill_raytrace(0);
 bool no_stat_moving(0); // generally not thread safe for dynamic lighting update, since BVH is rebuilt per-frame; also, wrong to cache lighting for moving cobjs
 unsigned NPTS(50000), NRAYS(40000), LOCAL_RAYS(1000000), GLOBAL_RAYS(1000000), DYNAMIC_RAYS(1000000), NUM_THREADS(1), MAX_RAY_BOUNCES(20);
+unsigned progressive_lighting_passes(0); // max number of passes for sky, global, and local lighting; 0 or 1 = trace all rays in one blocking pass
+float progressive_lighting_tol(0.005); // stop refining when a pass changes total lighting by less than this fraction
+bool compact_lighting_files(0); // write lighting files with shared exponent colors and 16-bit weights
 std::atomic<unsigned long long> tot_rays(0), num_hits(0), cells_touched(0);
 unsigned const NUM_RAY_SPLITS [NUM_LIGHTING_TYPES] = {1, 1, 1, 1, 1}; // sky, global, local, cobj_accum, dynamic
 unsigned const INIT_RAY_SPLITS[NUM_LIGHTING_TYPES] = {1, 4, 1, 1, 1}; // sky, global, local, cobj_accum, dynamic
@@ -215,7 +219,9 @@ light_volume_local &get_local_light_volume(int ltype) {
 
 
 // Note: weight can be negative
-unsigned add_path_to_lmcs(lmap_manager_t *lmgr, cube_t *bcube, point p1, point const &p2, float weight, colorRGBA const &color, int ltype, bool first_pt) {
+unsigned add_path_to_lmcs(lmap_manager_t *lmgr, cube_t *bcube, point p1, point const &p2, float weight, colorRGBA const &color, int ltype, bool first_pt,
+	lmap_local_accum_t *accum)
+{
 
 	bool const dynamic(is_ltype_dynamic(ltype));
 	if (first_pt && dynamic) return 0; // since dynamic lights already have a direct lighting component, we skip the first ray here to avoid double counting it
@@ -238,12 +244,15 @@ unsigned add_path_to_lmcs(lmap_manager_t *lmgr, cube_t *bcube, point p1, point c
 	}
 	else { // use the lmgr
 		assert(lmgr != nullptr && lmgr->is_allocated());
+		assert(accum == nullptr || ltype == LIGHTING_LOCAL); // accumulation is only supported for local lighting
+		lmap_ltype_accum_t *const pass_accum((lmgr->pass_accum && lmgr->pass_accum->get_ltype() == ltype) ? lmgr->pass_accum : nullptr);
 
 		for (unsigned s = 0; s < nsteps; ++s) {
 			lmcell *lmc(lmgr->get_lmcell_round_down(p1));
 		
-			if (lmc != NULL) { // could use a mutex here, but it seems too slow
-				float *color(lmc->get_offset(ltype));
+			if (lmc != NULL && accum != nullptr) {accum->add(lmgr->get_cell_ix(lmc), cw);} // added to lmgr later
+			else if (lmc != NULL) { // could use a mutex here, but it seems too slow
+				float *color(pass_accum ? pass_accum->get_cell(lmgr->get_cell_ix(lmc)) : lmc->get_offset(ltype)); // pass_accum is blended into lmgr later
 				ADD_LIGHT_CONTRIB(cw, color);
 				if (ltype != LIGHTING_LOCAL) {color[3] += weight;}
 			}
@@ -253,7 +262,7 @@ unsigned add_path_to_lmcs(lmap_manager_t *lmgr, cube_t *bcube, point p1, point c
 			bcube->assign_or_union_with_pt(p1);
 			bcube->union_with_pt(p2);
 		}
-		lmgr->was_updated = 1;
+		if (!pass_accum) {lmgr->was_updated = 1;}
 	}
 	return nsteps;
 }
@@ -499,12 +508,15 @@ struct rt_data {
 	unsigned ix, num, job_id, checksum;
 	int rseed, ltype;
 	bool is_thread, verbose, randomized, is_running;
+	float ray_scale; // fraction of rays to trace, with ray weights scaled to match
 	cube_t update_bcube;
 	lmap_manager_t *lmgr;
 	cobj_ray_accum_map_t accum_map;
 
-	rt_data(unsigned i=0, unsigned n=0, int s=1, bool t=0, bool v=0, bool r=0, int lt=0, unsigned jid=0)
-		: ix(i), num(n), job_id(jid), checksum(0), rseed(s), ltype(lt), is_thread(t), verbose(v), randomized(r), is_running(0), lmgr(nullptr) {update_bcube.set_to_zeros();}
+	rt_data(unsigned i=0, unsigned n=0, int s=1, bool t=0, bool v=0, bool r=0, int lt=0, unsigned jid=0, float rs=1.0)
+		: ix(i), num(n), job_id(jid), checksum(0), rseed(s), ltype(lt), is_thread(t), verbose(v), randomized(r), is_running(0), ray_scale(rs), lmgr(nullptr)
+	{update_bcube.set_to_zeros();}
+	unsigned scale_rays(unsigned num_rays) const {return ((ray_scale == 1.0f || num_rays == 0) ? num_rays : max(1U, unsigned(ray_scale*num_rays + 0.5f)));}
 
 	void pre_run(rand_gen_t &rgen) {
 		assert(lmgr);
@@ -553,10 +565,82 @@ public:
 
 thread_manager_t<rt_data> thread_manager;
 lmap_manager_t thread_temp_lmap;
+lmap_ltype_accum_t progressive_pass_accum;
 
 bool indir_lighting_updated() {return (global_lighting_update && (lmap_manager.was_updated || thread_temp_lmap.was_updated));} // only for global updates
 
 
+// progressive lighting traces a small fraction of the rays for each lighting type in a blocking first pass so that lighting is usable quickly,
+// then refines it with passes of doubling ray counts in the background, averaging each pass into the lmap weighted by its number of rays
+class progressive_lighting_t {
+	struct ltype_state_t {
+		unsigned pass=0;
+		float rays_done=0.0; // fraction of the full ray count blended so far
+		high_resolution_clock::time_point start_time;
+	};
+	ltype_state_t state[NUM_LIGHTING_TYPES];
+	deque<unsigned> queue; // lighting types to refine in order; front is current
+	bool job_running=0;
+
+	static float get_pass_ray_scale(unsigned pass) {return float(1U << pass)/((1U << progressive_lighting_passes) - 1);} // all passes add up to the full ray count
+	static float get_elapsed_ms(ltype_state_t const &s) {return 1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - s.start_time).count();}
+public:
+	static bool enabled() {return (progressive_lighting_passes > 1 && progressive_lighting_passes <= 16);}
+	float start(unsigned ltype) { // returns the ray scale for the first pass
+		assert(ltype < NUM_LIGHTING_TYPES);
+		cancel(ltype);
+		state[ltype].start_time = high_resolution_clock::now();
+		state[ltype].rays_done  = get_pass_ray_scale(0);
+		return state[ltype].rays_done;
+	}
+	void first_pass_done(unsigned ltype) {
+		ltype_state_t &s(state[ltype]);
+		s.pass = 1;
+		queue.push_back(ltype);
+		unsigned const pass_bytes(lmcell::get_dsz(ltype)*sizeof(float));
+		cout << "Progressive lighting type " << ltype << " first usable after " << get_elapsed_ms(s) << "ms using " << 100.0*s.rays_done << "% of rays; "
+			 << "lmap uses " << sizeof(lmcell) << " bytes per cell, " << lmap_manager.size()*sizeof(lmcell)/(1024*1024) << "MB; refinement passes accumulate into "
+			 << pass_bytes << " bytes per cell, " << lmap_manager.size()*pass_bytes/(1024*1024) << "MB" << endl;
+	}
+	void cancel(unsigned ltype) {
+		for (auto i = queue.begin(); i != queue.end(); ++i) {
+			if (*i != ltype) continue;
+			if (i == queue.begin()) {job_running = 0;} // any job will be killed by the next launch
+			queue.erase(i);
+			break;
+		}
+	}
+	void cancel_all() {queue.clear(); job_running = 0; progressive_pass_accum.free_mem();}
+	void job_killed() {job_running = 0;} // pass will be restarted
+	bool is_job_running() const {return job_running;}
+
+	void pass_done() { // called when the background pass has finished and its threads have been joined
+		assert(job_running && !queue.empty());
+		job_running = 0;
+		unsigned const ltype(queue.front());
+		ltype_state_t &s(state[ltype]);
+		float const pass_rays(get_pass_ray_scale(s.pass)), blend_weight(pass_rays/(s.rays_done + pass_rays));
+		assert(lmap_manager.pass_accum == &progressive_pass_accum);
+		float const change(lmap_manager.blend_ltype_from(progressive_pass_accum, blend_weight));
+		lmap_manager.pass_accum  = nullptr;
+		lmap_manager.was_updated = 1; // publish
+		s.rays_done += pass_rays;
+		++s.pass;
+		bool const converged(change < progressive_lighting_tol);
+		if (!converged && s.pass < progressive_lighting_passes) return; // continue refining
+		cout << "Progressive lighting type " << ltype << (converged ? " converged" : " finished") << " after " << s.pass << " passes and " << get_elapsed_ms(s)
+			 << "ms using " << 100.0*s.rays_done << "% of rays with a last pass change of " << 100.0*change << "%" << endl;
+		queue.pop_front();
+		if (queue.empty()) {progressive_pass_accum.free_mem();} // done with all lighting types
+	}
+	void launch_next_pass();
+};
+
+progressive_lighting_t progressive_lighting;
+
+void cancel_progressive_lighting() {progressive_lighting.cancel_all();} // called when the lightmap is cleared
+
+
 void kill_current_raytrace_threads() {
 
 	if (thread_manager.is_active()) { // can't have two running at once, so kill the existing one
@@ -565,6 +649,8 @@ void kill_current_raytrace_threads() {
 		thread_manager.join_and_clear();
 		assert(!thread_manager.is_active());
 		kill_raytrace = 0;
+		lmap_manager.pass_accum = nullptr; // discard any partial progressive pass
+		progressive_lighting.job_killed();
 	}
 }
 
@@ -581,15 +667,18 @@ void update_lmap_from_temp_copy() {
 
 void check_for_lighting_finished() { // to be called about once per frame
 
-	if (!thread_manager.is_active()) return; // inactive
+	if (!thread_manager.is_active()) {progressive_lighting.launch_next_pass(); return;} // inactive
 	if (thread_manager.any_threads_running()) return; // still running
 	thread_manager.join_and_clear(); // clear() or join_and_clear()?
-	update_lmap_from_temp_copy();
+	if (progressive_lighting.is_job_running()) {progressive_lighting.pass_done();} else {update_lmap_from_temp_copy();}
 }
 
 
 // see https://computing.llnl.gov/tutorials/pthreads/ (for old pthread implementation - now using std::thread)
-void launch_threaded_job(unsigned num_threads, void (*start_func)(rt_data *), bool verbose, bool blocking, bool use_temp_lmap, bool randomized, int ltype, unsigned job_id=0) {
+// pass > 0 is a progressive lighting refinement pass: ray_scale is the fraction of rays to trace, and rays for ltype are added to progressive_pass_accum, starting from zero
+void launch_threaded_job(unsigned num_threads, void (*start_func)(rt_data *), bool verbose, bool blocking, bool use_temp_lmap, bool randomized, int ltype,
+	unsigned job_id=0, float ray_scale=1.0, unsigned pass=0)
+{
 
 	kill_current_raytrace_threads();
 	assert(num_threads > 0 && num_threads < 100);
@@ -598,11 +687,17 @@ void launch_threaded_job(unsigned num_threads, void (*start_func)(rt_data *), bo
 	if (verbose) {cout << "Computing lighting on " << num_threads << " threads." << endl;}
 	thread_manager.create(num_threads);
 	vector<rt_data> &data(thread_manager.data);
+	assert(!(use_temp_lmap && pass > 0));
 	if (use_temp_lmap) {thread_temp_lmap.init_from(lmap_manager);}
+	
+	if (pass > 0) { // only the channels of this lighting type are allocated, and the rest of the lmap is neither copied nor modified until the pass is blended in
+		progressive_pass_accum.init(lmap_manager, ltype);
+		lmap_manager.pass_accum = &progressive_pass_accum;
+	}
 
 	for (unsigned t = 0; t < data.size(); ++t) {
 		// create a custom lmap_manager_t for each thread then merge them together?
-		data[t] = rt_data(t, num_threads, 234323*(t+1), !single_thread, (verbose && t == 0), randomized, ltype, job_id);
+		data[t] = rt_data(t, num_threads, 234323*(t+1) + 7919*pass, !single_thread, (verbose && t == 0), randomized, ltype, job_id, ray_scale);
 		data[t].lmgr = (use_temp_lmap ? &thread_temp_lmap : &lmap_manager);
 	}
 	if (single_thread && blocking) { // threads disabled
@@ -715,22 +810,24 @@ void trace_ray_block_global_light(rt_data *data, point const &pos, colorRGBA con
 	data->pre_run(rgen);
 	unsigned long long cube_start_rays(0);
 
-	if (GLOBAL_RAYS > 0) {
-		float const ray_wt(RAY_WEIGHT*weight*color.alpha/GLOBAL_RAYS);
+	unsigned const global_rays(data->scale_rays(GLOBAL_RAYS));
+
+	if (global_rays > 0) {
+		float const ray_wt(RAY_WEIGHT*weight*color.alpha/global_rays);
 		assert(ray_wt > 0.0);
 		cube_t const bnds(get_scene_bounds());
-		trace_ray_block_global_cube(data->lmgr, bnds, pos, color, ray_wt, max(1U, GLOBAL_RAYS/data->num), LIGHTING_GLOBAL, 0, 1, data->verbose, data->randomized, rgen, &data->accum_map);
+		trace_ray_block_global_cube(data->lmgr, bnds, pos, color, ray_wt, max(1U, global_rays/data->num), LIGHTING_GLOBAL, 0, 1, data->verbose, data->randomized, rgen, &data->accum_map);
 	}
 	for (cube_light_src_vect::const_iterator i = global_cube_lights.begin(); i != global_cube_lights.end(); ++i) {
 		if (data->num == 0 || i->num_rays == 0) continue; // disabled
 		if (data->verbose) {cout << "Cube volume light source " << (i - global_cube_lights.begin()) << " of " << global_cube_lights.size() << endl;}
-		unsigned const num_rays(i->num_rays/data->num);
-		float const cube_weight(RAY_WEIGHT*weight*i->intensity/i->num_rays);
+		unsigned const tot_rays(data->scale_rays(i->num_rays)), num_rays(tot_rays/data->num);
+		float const cube_weight(RAY_WEIGHT*weight*i->intensity/tot_rays);
 		trace_ray_block_global_cube(data->lmgr, i->bounds, pos, color, cube_weight, num_rays, LIGHTING_GLOBAL, i->disabled_edges, 0, data->verbose, data->randomized, rgen, &data->accum_map);
 		cube_start_rays += num_rays;
 	}
 	if (data->verbose) {
-		cout << "start rays: " << GLOBAL_RAYS << ", cube_start_rays: " << cube_start_rays << ", total rays: "
+		cout << "start rays: " << global_rays << ", cube_start_rays: " << cube_start_rays << ", total rays: "
 			 << tot_rays << ", hits: " << num_hits << ", cells touched: " << cells_touched << endl;
 	}
 	data->post_run();
@@ -757,10 +854,11 @@ void trace_ray_block_sky(rt_data *data) {
 	data->pre_run(rgen);
 	float const scene_radius(get_scene_radius()), line_length(2.0*scene_radius);
 	unsigned long long start_rays(0), cube_start_rays(0);
+	unsigned const npts(data->scale_rays(NPTS));
 
-	if (NPTS > 0 && NRAYS > 0) {
-		float const ray_wt(get_sky_light_ray_weight());
-		unsigned const block_npts(max(1U, NPTS/data->num));
+	if (npts > 0 && NRAYS > 0) {
+		float const ray_wt(RAY_WEIGHT/(((float)npts)*NRAYS)); // same as get_sky_light_ray_weight() when not scaled
+		unsigned const block_npts(max(1U, npts/data->num));
 		vector<point> pts(block_npts);
 		vector<vector3d> dirs(NRAYS);
 
@@ -798,8 +896,8 @@ void trace_ray_block_sky(rt_data *data) {
 	for (cube_light_src_vect::const_iterator i = sky_cube_lights.begin(); i != sky_cube_lights.end(); ++i) {
 		if (kill_raytrace) break;
 		if (data->num == 0 || i->num_rays == 0) continue; // disabled
-		unsigned const num_rays(i->num_rays/data->num);
-		float const cube_weight(RAY_WEIGHT*i->intensity/i->num_rays);
+		unsigned const tot_rays(data->scale_rays(i->num_rays)), num_rays(tot_rays/data->num);
+		float const cube_weight(RAY_WEIGHT*i->intensity/tot_rays);
 		if (data->verbose) {cout << "Cube volume light source " << (i - sky_cube_lights.begin()) << " of " << sky_cube_lights.size() << ", progress (of " << 1+num_rays/1000 << "): 0";}
 		cube_start_rays += num_rays;
 
@@ -1010,7 +1108,7 @@ void trace_ray_block_local(rt_data *data) {
 	}
 	for (unsigned i = 0; i < light_sources_a.size(); ++i) {
 		if (data->verbose) {increment_printed_number(i);}
-		unsigned const light_nrays(light_sources_a[i].get_num_rays()), NRAYS(light_nrays ? light_nrays : LOCAL_RAYS), num_rays(max(1U, NRAYS/data->num));
+		unsigned const light_nrays(light_sources_a[i].get_num_rays()), NRAYS(data->scale_rays(light_nrays ? light_nrays : LOCAL_RAYS)), num_rays(max(1U, NRAYS/data->num));
 		ray_trace_local_light_source(data->lmgr, light_sources_a[i], line_length, num_rays, rgen, data->ltype, NRAYS);
 	}
 	if (data->verbose) {cout << endl;}
@@ -1045,6 +1143,16 @@ typedef void (*ray_trace_func)(rt_data *);
 ray_trace_func const rt_funcs[NUM_LIGHTING_TYPES] = {trace_ray_block_sky, trace_ray_block_global, trace_ray_block_local, trace_ray_block_cobj_accum, trace_ray_block_dynamic};
 
 
+void progressive_lighting_t::launch_next_pass() {
+	if (job_running || queue.empty() || !lmap_manager.is_allocated()) return;
+	unsigned const ltype(queue.front());
+	launch_threaded_job(max(1U, NUM_THREADS-1), rt_funcs[ltype], 0, 0, 0, 0, ltype, 0, get_pass_ray_scale(state[ltype].pass), state[ltype].pass); // non-blocking; reserve a thread for rendering
+	job_running = 1; // set after launch, which may kill a previous job
+}
+
+
+bool is_null_lighting_fn(char const *const fn) {return (fn == nullptr || fn[0] == 0 || strcmp(fn, "''") == 0 || strcmp(fn, "\"\"") == 0);}
+
 void compute_ray_trace_lighting(unsigned ltype, bool verbose) {
 
 	bool const dynamic(is_ltype_dynamic(ltype));
@@ -1066,9 +1174,20 @@ void compute_ray_trace_lighting(unsigned ltype, bool verbose) {
 	else {
 		if (c_ltype != LIGHTING_LOCAL && !dynamic) {cout << X_SCENE_SIZE << " " << Y_SCENE_SIZE << " " << Z_SCENE_SIZE << " " << czmin << " " << czmax << endl;}
 		all_models.build_cobj_trees(1);
-		if (enable_platform_lights(ltype)) {pre_rt_bvh_build_hook();}
-		launch_threaded_job(NUM_THREADS, rt_funcs[c_ltype], verbose, 1, 0, 0, ltype);
-		if (enable_platform_lights(ltype)) {post_rt_bvh_build_hook();}
+		// progressive refinement runs in the background, which isn't supported for platform lights, async global lighting updates, or when writing a lighting file
+		bool const progressive(progressive_lighting_t::enabled() && !dynamic && c_ltype != LIGHTING_COBJ_ACCUM && (!write_light_files[c_ltype] || is_null_lighting_fn(fn)) &&
+			!(enable_platform_lights(ltype) && !platforms.empty()) && !(c_ltype == LIGHTING_GLOBAL && global_lighting_update));
+
+		if (progressive) { // trace the first pass now; later passes are started by check_for_lighting_finished()
+			float const ray_scale(progressive_lighting.start(c_ltype));
+			launch_threaded_job(NUM_THREADS, rt_funcs[c_ltype], verbose, 1, 0, 0, ltype, 0, ray_scale);
+			progressive_lighting.first_pass_done(c_ltype);
+		}
+		else {
+			if (enable_platform_lights(ltype)) {pre_rt_bvh_build_hook();}
+			launch_threaded_job(NUM_THREADS, rt_funcs[c_ltype], verbose, 1, 0, 0, ltype);
+			if (enable_platform_lights(ltype)) {post_rt_bvh_build_hook();}
+		}
 	}
 	if (!dynamic && write_light_files[c_ltype]) {
 		if (c_ltype == LIGHTING_COBJ_ACCUM) {
@@ -1131,6 +1250,38 @@ void check_all_platform_cobj_lighting_update() {
 
 // lmap_manager_t
 
+unsigned const COMPACT_LMAP_FLAG = (1U << 31); // set in the data size of compact lighting files
+
+// RGB9E5 shared exponent format: 9-bit mantissas for each color and a 5-bit exponent; negative values are clamped to zero
+uint32_t pack_rgb9e5(float const *const c) {
+	float const max_val(65408.0f); // (511/512)*2^16
+	float rgb[3];
+	UNROLL_3X(rgb[i_] = max(0.0f, min(max_val, c[i_]));)
+	float const max_c(max(rgb[0], max(rgb[1], rgb[2])));
+	if (max_c < 1.0E-9f) return 0;
+	int exp_shared(max(-16, int(floor(log2(max_c)))) + 16); // biased by 15, plus one
+	float denom(exp2f(float(exp_shared - 15 - 9)));
+	if (unsigned(max_c/denom + 0.5f) == 512) {denom *= 2.0f; ++exp_shared;} // mantissa overflow
+	uint32_t ret(uint32_t(exp_shared) << 27);
+	UNROLL_3X(ret |= (min(511U, unsigned(rgb[i_]/denom + 0.5f)) << (9*i_));)
+	return ret;
+}
+void unpack_rgb9e5(uint32_t v, float *const c) {
+	float const scale(exp2f(float(int(v >> 27) - 15 - 9)));
+	UNROLL_3X(c[i_] = scale*((v >> (9*i_)) & 511);)
+}
+uint16_t pack_bfloat16(float v) { // upper 16 bits of a float with rounding; same range as float
+	uint32_t u;
+	memcpy(&u, &v, sizeof(u));
+	u += 0x7FFF + ((u >> 16) & 1);
+	return uint16_t(u >> 16);
+}
+float unpack_bfloat16(uint16_t v) {
+	uint32_t const u(uint32_t(v) << 16);
+	float ret;
+	memcpy(&ret, &u, sizeof(ret));
+	return ret;
+}
 
 bool lmap_manager_t::read_data_from_file(char const *const fn, int ltype) {
 
@@ -1140,6 +1291,8 @@ bool lmap_manager_t::read_data_from_file(char const *const fn, int ltype) {
 	cout << "Reading lighting file from " << fn << endl;
 	unsigned data_size(0);
 	if (!reader.read(&data_size, sizeof(unsigned), 1)) return 0;
+	bool const compact((data_size & COMPACT_LMAP_FLAG) != 0);
+	data_size &= ~COMPACT_LMAP_FLAG;
 
 	if (data_size != vldata_alloc.size()) {
 		cerr << "Error: Lighting file " << fn << " data size of " << data_size
@@ -1147,6 +1300,22 @@ bool lmap_manager_t::read_data_from_file(char const *const fn, int ltype) {
 		return 0;
 	}
 	unsigned const sz = lmcell::get_dsz(ltype);
+
+	if (compact) {
+		vector<uint32_t> colors(data_size);
+		vector<uint16_t> weights((sz == 4) ? data_size : 0);
+
+		if (!reader.read(colors.data(), sizeof(uint32_t), colors.size()) || (!weights.empty() && !reader.read(weights.data(), sizeof(uint16_t), weights.size()))) {
+			cerr << "Error reading data from ligthing file " << fn << endl;
+			return 0;
+		}
+		for (unsigned i = 0; i < data_size; ++i) {
+			float *ptr(vldata_alloc[i].get_offset(ltype));
+			unpack_rgb9e5(colors[i], ptr);
+			if (!weights.empty()) {ptr[3] = unpack_bfloat16(weights[i]);}
+		}
+		return 1;
+	}
 	vector<float> data(data_size*sz);
 	unsigned pos(0);
 
@@ -1165,14 +1334,34 @@ bool lmap_manager_t::read_data_from_file(char const *const fn, int ltype) {
 
 bool lmap_manager_t::write_data_to_file(char const *const fn, int ltype) const {
 
-	if (fn == nullptr || strcmp(fn, "''") == 0 || strcmp(fn, "\"\"") == 0) return 0; // don't write
+	if (is_null_lighting_fn(fn)) return 0; // don't write
 	binary_file_writer writer;
 	if (!writer.open(fn)) return 0;
 	cout << "Writing lighting file to " << fn << endl;
 	unsigned const data_size((unsigned)vldata_alloc.size()); // should be size_t?
-	if (!writer.write(&data_size, sizeof(unsigned), 1)) return 0;
+	assert(!(data_size & COMPACT_LMAP_FLAG));
+	unsigned const data_size_flags(data_size | (compact_lighting_files ? COMPACT_LMAP_FLAG : 0));
+	if (!writer.write(&data_size_flags, sizeof(unsigned), 1)) return 0;
 	unsigned const sz(lmcell::get_dsz(ltype));
 
+	if (compact_lighting_files) { // 4-6 bytes per cell rather than 12-16
+		vector<uint32_t> colors(data_size);
+		vector<uint16_t> weights((sz == 4) ? data_size : 0);
+
+		for (unsigned i = 0; i < data_size; ++i) {
+			float const *const ptr(vldata_alloc[i].get_offset(ltype));
+			colors[i] = pack_rgb9e5(ptr);
+			if (!weights.empty()) {weights[i] = pack_bfloat16(ptr[3]);}
+		}
+		if (!writer.write(colors.data(), sizeof(uint32_t), colors.size()) || (!weights.empty() && !writer.write(weights.data(), sizeof(uint16_t), weights.size()))) {
+			cerr << "Error writing data to ligthing file " << fn << endl;
+			return 0;
+		}
+		cout << "Wrote " << data_size << " cells using " << (sizeof(uint32_t) + (weights.empty() ? 0 : sizeof(uint16_t))) << " bytes per cell vs. "
+			 << sz*sizeof(float) << " uncompacted" << endl;
+		return 1;
+	}
+
 	for (vector<lmcell>::const_iterator i = vldata_alloc.begin(); i != vldata_alloc.end(); ++i) { // const_iterator?
 		if (!writer.write(i->get_offset(ltype), sizeof(float), sz)) {
 			cerr << "Error writing data to ligthing file " << fn << endl;
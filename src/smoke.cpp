@@ -142,10 +142,10 @@ void add_smoke(point const &pos, float val) {
 void diffuse_smoke_xy(int x, int y, int z, lmcell &adj, float rate, int dim, int dir) {
 
 	float delta(0.0); // Note: not using fticks due to instability
-	lmcell *vldata(point_outside_mesh(x, y) ? nullptr : lmap_manager.get_column(x, y));
+	lmcell *const lmc_ptr(lmap_manager.get_lmcell_if_valid(x, y, z));
 
-	if (vldata) {
-		lmcell &lmc(vldata[z]);
+	if (lmc_ptr) {
+		lmcell &lmc(*lmc_ptr);
 		unsigned char const flow(dir ? adj.pflow[dim] : lmc.pflow[dim]);
 		if (flow == 0) return;
 		float const cur_smoke(lmc.smoke);
@@ -160,12 +160,13 @@ void diffuse_smoke_xy(int x, int y, int z, lmcell &adj, float rate, int dim, int
 	adjust_smoke_val(adj.smoke, -delta);
 }
 
-void diffuse_smoke_z(int x, int y, int z, lmcell &adj, lmcell *vldata, float pos_rate, float neg_rate, int dim, int dir) {
+// [z1, z2) is the allocated z range of column vldata
+void diffuse_smoke_z(int x, int y, int z, lmcell &adj, lmcell *vldata, unsigned z1, unsigned z2, float pos_rate, float neg_rate, int dim, int dir) {
 
 	float delta(0.0); // Note: not using fticks due to instability
 
-	if (z >= 0 && z < MESH_SIZE[2]) {
-		lmcell &lmc(vldata[z]);
+	if (z >= (int)z1 && z < (int)z2) {
+		lmcell &lmc(vldata[z-z1]);
 		unsigned char const flow(dir ? adj.pflow[dim] : lmc.pflow[dim]);
 		if (flow == 0) return;
 		float const cur_smoke(lmc.smoke);
@@ -209,10 +210,12 @@ void distribute_smoke() { // called at most once per frame
 			smoke_entry_t &zrange(smoke_grid.get_z_range(x, y));
 			//smoke_entry_t zrange; zrange.zmin = 0; zrange.zmax = MESH_Z_SIZE;
 			if (!zrange.valid()) continue;
+			unsigned z1(0), z2(0);
+			lmap_manager.get_column_zrange(x, y, z1, z2);
 			bool any_z_has_smoke(0);
 			
-			for (int z = zrange.zmin; z < zrange.zmax; ++z) {
-				lmcell &lmc(vldata[z]);
+			for (int z = max((int)zrange.zmin, (int)z1); z < min((int)zrange.zmax, (int)z2); ++z) { // only iterate over the allocated cells
+				lmcell &lmc(vldata[z-z1]);
 				if (lmc.smoke < SMOKE_THRESH) {lmc.smoke = 0.0;}
 				if (lmc.smoke == 0.0) continue;
 				//if (get_zval(z) > v_collision_matrix[y][x].zmax) {lmc.smoke = 0.0; continue;} // open space above - smoke goes up
@@ -232,8 +235,8 @@ void distribute_smoke() { // called at most once per frame
 					diffuse_smoke_xy(x, y-1, z, lmc, xy_rate, 1, 0);
 					diffuse_smoke_xy(x, y+1, z, lmc, xy_rate, 1, 1);
 				}
-				diffuse_smoke_z(x, y, (z - 1), lmc, vldata, SMOKE_DIS_ZD, SMOKE_DIS_ZU, 2, 0);
-				diffuse_smoke_z(x, y, (z + 1), lmc, vldata, SMOKE_DIS_ZU, SMOKE_DIS_ZD, 2, 1);
+				diffuse_smoke_z(x, y, (z - 1), lmc, vldata, z1, z2, SMOKE_DIS_ZD, SMOKE_DIS_ZU, 2, 0);
+				diffuse_smoke_z(x, y, (z + 1), lmc, vldata, z1, z2, SMOKE_DIS_ZU, SMOKE_DIS_ZD, 2, 1);
 				any_z_has_smoke = 1;
 			} // for z
 			if (!any_z_has_smoke) {zrange.clear();} // mark this xy as not having smoke
@@ -248,10 +251,8 @@ float get_smoke_at_pos(point const &pos) {
 
 	if (!DYNAMIC_SMOKE  || !smoke_exists)  return 0.0;
 	if (pos.z <= czmin0 || pos.z >= czmax) return 0.0;
-	int const x(get_xpos(pos.x)), y(get_ypos(pos.y)), z(get_zpos(pos.z));
-	if (point_outside_mesh(x, y) || z < 0 || z >= MESH_SIZE[2]) return 0.0;
-	lmcell const *const vldata(lmap_manager.get_column(x, y));
-	return ((vldata == NULL) ? 0.0 : vldata[z].smoke);
+	lmcell const *const lmc(lmap_manager.get_lmcell_if_valid(get_xpos(pos.x), get_ypos(pos.y), get_zpos(pos.z)));
+	return ((lmc == NULL) ? 0.0 : lmc->smoke);
 }
 
 
@@ -273,6 +274,8 @@ void update_smoke_row(vector<unsigned char> &data, vector<unsigned> const &llvol
 		lmcell const *const vlm(lmap_manager.get_column(x, y));
 		if (vlm == NULL && !update_lighting) continue; // x/y pairs that get into here should also be constant
 		unsigned const off(zsize*(y*MESH_X_SIZE + x));
+		unsigned vz1(0), vz2(0); // allocated z range; cells below this range use default_lmc, and cells above it use the lighting of the top cell
+		if (vlm != NULL) {lmap_manager.get_column_zrange(x, y, vz1, vz2);}
 		bool const check_z_thresh((display_mode & 0x01) && !is_mesh_disabled(x, y));
 		float const mh(mesh_height[y][x]);
 		unsigned llv_ix_s(0), llv_ix_e(0);
@@ -296,9 +299,11 @@ void update_smoke_row(vector<unsigned char> &data, vector<unsigned> const &llvol
 		}
 		for (unsigned z = z_start; z < z_end; ++z) {
 			unsigned const off2(ncomp*(off + z));
-			if (vlm == NULL || vlm[z].smoke == 0.0) {data[off2+3] = 0;}
-			else {data[off2+3] = (unsigned char)(255*CLIP_TO_01(smoke_scale*vlm[z].smoke));} // alpha: smoke
+			lmcell const *const smoke_lmc((z >= vz1 && z < vz2) ? (vlm + (z - vz1)) : nullptr);
+			if (smoke_lmc == NULL || smoke_lmc->smoke == 0.0) {data[off2+3] = 0;}
+			else {data[off2+3] = (unsigned char)(255*CLIP_TO_01(smoke_scale*smoke_lmc->smoke));} // alpha: smoke
 			if (!do_lighting) continue; // lighting not needed
+			lmcell const *const lmc((smoke_lmc == NULL && vlm != NULL && z >= vz2) ? (vlm + (vz2 - vz1 - 1)) : smoke_lmc); // clamp to the top of the column
 				
 			if (check_z_thresh && get_zval(z+1) < mh) { // adjust by one because GPU will interpolate the texel
 				UNROLL_3X(data[off2+i_] = 0;)
@@ -308,10 +313,10 @@ void update_smoke_row(vector<unsigned char> &data, vector<unsigned> const &llvol
 
 				if (create_voxel_landscape) {
 					float const indir_scale(get_voxel_terrain_ao_lighting_val(get_xyz_pos(x, y, z)));
-					if (vlm == NULL) {color = default_color*indir_scale;} else {vlm[z].get_final_color(color, 1.0, 1.0, indir_scale);}
+					if (lmc == NULL) {color = default_color*indir_scale;} else {lmc->get_final_color(color, 1.0, 1.0, indir_scale);}
 				}
 				else {
-					if (vlm == NULL) {color = default_color;} else {vlm[z].get_final_color(color, 1.0, 1.0);}
+					if (lmc == NULL) {color = default_color;} else {lmc->get_final_color(color, 1.0, 1.0);}
 				}
 				for (unsigned i = llv_ix_s; i < llv_ix_e; ++i) {local_light_volumes[llvol_ixs[i]]->add_lighting(color, x, y, z);} // add local light volumes
 				UNROLL_3X(data[off2+i_] = (unsigned char)(255*CLIP_TO_01(color[i_]));) // lmc.pflow[i_]
@@ -0,0 +1,204 @@
+// 3D World - Frame Time and Memory Telemetry
+// by Frank Gennari
+// 10/16/26
+#include "3DWorld.h"
+#include "telemetry.h"
+#include "physics_objects.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <cmath>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h> // for GetProcessMemoryInfo()
+#pragma comment(lib, "psapi.lib")
+#else
+#include <unistd.h>
+#endif
+
+using namespace std::chrono;
+using std::string;
+
+unsigned telemetry_frames(0); // 0 = disabled
+string telemetry_file("telemetry");
+
+extern int frame_counter, num_groups;
+extern obj_group obj_groups[];
+extern coll_obj_group coll_objects;
+
+unsigned get_loaded_textures_cpu_mem();
+unsigned get_loaded_textures_gpu_mem();
+unsigned get_buildings_gpu_mem_usage();
+unsigned get_num_buildings_total();
+unsigned get_city_model_gpu_mem();
+unsigned get_loaded_models_gpu_mem();
+unsigned get_num_tiled_terrain_tiles();
+uint64_t get_tiled_terrain_gpu_mem();
+void get_building_nav_path_stats(uint64_t &queries, uint64_t &cache_hits, uint64_t &tables_built, uint64_t &invalidations);
+
+
+uint64_t get_cur_process_mem_bytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+	return pmc.WorkingSetSize;
+#else
+	std::ifstream in("/proc/self/statm"); // size and resident set size in pages
+	uint64_t size(0), resident(0);
+	if (!(in >> size >> resident)) return 0;
+	return resident*uint64_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+
+class telemetry_registry_t {
+
+	struct value_t {
+		string name;
+		unsigned type;
+		telemetry_func_t func;
+		vector<double> samples; // ring buffer; NaN = not sampled
+		value_t(string const &name_, unsigned type_, telemetry_func_t const &func_) : name(name_), type(type_), func(func_) {}
+	};
+	vector<value_t> values;
+	vector<int> frames;
+	vector<double> times, frame_ms; // time in seconds since the first sample, frame time in ms
+	unsigned num_samples=0; // total, including those that have been overwritten
+	high_resolution_clock::time_point start_time, last_time;
+
+	unsigned get_num_valid() const {return min(num_samples, (unsigned)frames.size());}
+	unsigned get_ix(unsigned n) const {return ((num_samples - get_num_valid() + n) % frames.size());} // n-th oldest valid sample
+public:
+	void register_value(string const &name, unsigned type, telemetry_func_t const &func) {
+		assert(type < NUM_TELEM_TYPES);
+
+		for (value_t &v : values) {
+			if (v.name == name) {v.type = type; v.func = func; return;} // replace
+		}
+		values.emplace_back(name, type, func);
+		values.back().samples.resize(frames.size(), NAN);
+	}
+	void sample() {
+		if (telemetry_frames == 0) return; // disabled
+		auto const cur_time(high_resolution_clock::now());
+
+		if (frames.empty()) { // first sample
+			frames.resize(telemetry_frames);
+			times.resize(telemetry_frames);
+			frame_ms.resize(telemetry_frames);
+			for (value_t &v : values) {v.samples.resize(telemetry_frames, NAN);}
+			start_time = last_time = cur_time;
+		}
+		unsigned const ix(num_samples % frames.size());
+		frames  [ix] = frame_counter;
+		times   [ix] = duration_cast<duration<double>>(cur_time - start_time).count();
+		frame_ms[ix] = 1000.0*duration_cast<duration<double>>(cur_time - last_time).count();
+		for (value_t &v : values) {v.samples[ix] = v.func();}
+		last_time = cur_time;
+		++num_samples;
+	}
+	bool write_csv(string const &fn) const {
+		std::ofstream out(fn);
+
+		if (!out.good()) {
+			std::cerr << "Error: Failed to open telemetry output file " << fn << " for write" << endl;
+			return 0;
+		}
+		out << std::setprecision(12); // exact byte counts
+		out << "frame,time_s,frame_ms";
+		for (value_t const &v : values) {out << "," << v.name;}
+		out << endl;
+
+		for (unsigned n = 0; n < get_num_valid(); ++n) {
+			unsigned const ix(get_ix(n));
+			out << frames[ix] << "," << times[ix] << "," << frame_ms[ix];
+
+			for (value_t const &v : values) {
+				out << ",";
+				if (!std::isnan(v.samples[ix])) {out << v.samples[ix];} // empty if not sampled
+			}
+			out << "\n";
+		}
+		cout << "Wrote " << get_num_valid() << " frames of telemetry to " << fn << endl;
+		return out.good();
+	}
+	bool write_json(string const &fn) const {
+		std::ofstream out(fn);
+
+		if (!out.good()) {
+			std::cerr << "Error: Failed to open telemetry output file " << fn << " for write" << endl;
+			return 0;
+		}
+		unsigned const num_valid(get_num_valid());
+		out << std::setprecision(12); // exact byte counts
+		auto write_series([&](vector<double> const &series) {
+			out << "[";
+
+			for (unsigned n = 0; n < num_valid; ++n) {
+				double const val(series[get_ix(n)]);
+				out << (n ? ", " : "");
+				if (std::isnan(val)) {out << "null";} else {out << val;}
+			}
+			out << "]";
+		});
+		out << "{\n  \"num_frames\": " << num_valid << ",\n  \"frames\": [";
+		for (unsigned n = 0; n < num_valid; ++n) {out << (n ? ", " : "") << frames[get_ix(n)];}
+		out << "],\n  \"time_s\": ";
+		write_series(times);
+		out << ",\n  \"frame_ms\": ";
+		write_series(frame_ms);
+		out << ",\n  \"values\": {";
+
+		for (auto v = values.begin(); v != values.end(); ++v) {
+			out << ((v == values.begin()) ? "\n" : ",\n") << "    \"" << v->name << "\": {\"type\": \"" << ((v->type == TELEM_BYTES) ? "bytes" : "count") << "\", \"samples\": ";
+			write_series(v->samples);
+			out << "}";
+		}
+		out << "\n  }\n}" << endl;
+		cout << "Wrote " << num_valid << " frames of telemetry to " << fn << endl;
+		return out.good();
+	}
+	bool has_samples() const {return (num_samples > 0);}
+};
+
+telemetry_registry_t telemetry_registry;
+
+
+void register_telemetry_value(string const &name, unsigned type, telemetry_func_t const &func) {telemetry_registry.register_value(name, type, func);}
+void sample_telemetry() {telemetry_registry.sample();}
+bool write_telemetry_csv (string const &fn) {return telemetry_registry.write_csv (fn);}
+bool write_telemetry_json(string const &fn) {return telemetry_registry.write_json(fn);}
+
+void dump_telemetry() {
+	if (!telemetry_registry.has_samples()) {cout << "No telemetry to write; set telemetry_frames in the config file to enable" << endl; return;}
+	write_telemetry_csv (telemetry_file + ".csv");
+	write_telemetry_json(telemetry_file + ".json");
+}
+
+void register_default_telemetry() {
+	register_telemetry_value("process_mem",          TELEM_BYTES, []() {return double(get_cur_process_mem_bytes());});
+	register_telemetry_value("texture_cpu_mem",      TELEM_BYTES, []() {return double(get_loaded_textures_cpu_mem());});
+	register_telemetry_value("texture_gpu_mem",      TELEM_BYTES, []() {return double(get_loaded_textures_gpu_mem());});
+	register_telemetry_value("buildings",            TELEM_COUNT, []() {return double(get_num_buildings_total());});
+	register_telemetry_value("building_gpu_mem",     TELEM_BYTES, []() {return double(get_buildings_gpu_mem_usage());});
+	register_telemetry_value("model_gpu_mem",        TELEM_BYTES, []() {return double(get_loaded_models_gpu_mem() + get_city_model_gpu_mem());});
+	register_telemetry_value("terrain_tiles",        TELEM_COUNT, []() {return double(get_num_tiled_terrain_tiles());});
+	register_telemetry_value("terrain_tile_gpu_mem", TELEM_BYTES, []() {return double(get_tiled_terrain_gpu_mem());});
+	register_telemetry_value("cobjs",                TELEM_COUNT, []() {return double(coll_objects.size());});
+	register_telemetry_value("cobj_mem",             TELEM_BYTES, []() {return double(coll_objects.capacity()*sizeof(coll_obj));});
+	register_telemetry_value("building_path_queries",    TELEM_COUNT, []() {uint64_t q(0), h(0), t(0), i(0); get_building_nav_path_stats(q, h, t, i); return double(q);});
+	register_telemetry_value("building_path_cache_hits", TELEM_COUNT, []() {uint64_t q(0), h(0), t(0), i(0); get_building_nav_path_stats(q, h, t, i); return double(h);});
+
+	register_telemetry_value("particles",            TELEM_COUNT, []() { // active dynamic objects across all object groups
+		unsigned num(0);
+
+		for (int g = 0; g < num_groups; ++g) {
+			obj_group const &objg(obj_groups[g]);
+			if (!objg.is_enabled()) continue;
+			for (unsigned i = 0; i < objg.end_id; ++i) {num += (objg.get_obj(i).status != 0);}
+		}
+		return double(num);
+	});
+}
+
@@ -0,0 +1,23 @@
+// 3D World - Frame Time and Memory Telemetry
+// by Frank Gennari
+// 10/16/26
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <functional>
+
+enum {TELEM_COUNT=0, TELEM_BYTES, NUM_TELEM_TYPES};
+
+typedef std::function<double()> telemetry_func_t;
+
+// subsystems register named counters and byte gauges, which are sampled once per frame into a ring buffer of the last telemetry_frames frames;
+// registering an existing name replaces its function; values registered after sampling has started are empty for earlier frames
+void register_telemetry_value(std::string const &name, unsigned type, telemetry_func_t const &func);
+void register_default_telemetry(); // buildings, tiles, models, textures, cobjs, particles, and process memory
+void sample_telemetry(); // called once per frame; does nothing if telemetry is disabled
+bool write_telemetry_csv (std::string const &fn);
+bool write_telemetry_json(std::string const &fn);
+void dump_telemetry(); // writes <telemetry_file>.csv and <telemetry_file>.json
+uint64_t get_cur_process_mem_bytes();
+
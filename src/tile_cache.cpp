@@ -0,0 +1,268 @@
+// 3D World - Tiled Terrain Tile Cache (in-memory LRU + compressed disk files)
+// by Frank Gennari
+// 10/16/26
+#include "tiled_mesh.h"
+#include "binary_file_io.h"
+#include "mapped_file.h"
+#include <iomanip>
+
+string tt_tile_cache_dir; // directory for cached tile files; empty = no disk cache
+float tt_tile_cache_mem_mb(0.0); // max size of the in-memory cache of removed tiles; 0 = no memory cache
+
+unsigned const TILE_CACHE_MAGIC   = 0x54544333; // "3CTT"
+unsigned const TILE_CACHE_VERSION = 1;
+string const tile_cache_suffix(".tcache.gz");
+
+extern bool enable_tiled_mesh_ao;
+extern int invert_mh_image;
+extern unsigned erosion_iters_tt;
+extern float water_plane_z, vegetation, relh_adj_tex, biome_x_offset;
+extern char *mh_filename_tt;
+extern string read_hmap_modmap_fn;
+
+uint64_t get_mesh_gen_params_hash();
+
+
+// *** tile_t::cache_entry_t ***
+
+struct tile_cache_header_t { // written directly to files, so all padding is explicit and zeroed
+	unsigned magic=0, version=0;
+	uint64_t params_hash=0;
+	int x1=0, y1=0;
+	unsigned size=0, pad=0;
+};
+static_assert(sizeof(tile_cache_header_t) == 32, "tile_cache_header_t has implicit padding");
+
+template<typename T> bool write_cache_vector(binary_file_writer &w, vector<T> const &v) {
+	unsigned const sz(v.size());
+	return (w.write(&sz, sizeof(unsigned), 1) && (v.empty() || w.write(v.data(), sizeof(T), v.size())));
+}
+template<typename T> bool read_cache_vector(binary_file_reader &r, vector<T> &v, unsigned max_sz) {
+	unsigned sz(0);
+	if (!r.read(&sz, sizeof(unsigned), 1) || sz > max_sz) return 0; // read error or invalid size
+	v.resize(sz);
+	return (v.empty() || r.read(v.data(), sizeof(T), sz));
+}
+
+size_t tile_t::cache_entry_t::get_mem() const {
+	size_t mem(sizeof(*this) + zvals.size()*sizeof(float) + ao_lighting.size() + mesh_weight_data.size() + grass_blocks.size()*sizeof(grass_block_t));
+
+	for (unsigned l = 0; l < NUM_LIGHT_SRC; ++l) {
+		mem += smask[l].size();
+		for (unsigned d = 0; d < 2; ++d) {mem += sh_out[l][d].size()*sizeof(float);}
+	}
+	return mem;
+}
+
+bool tile_t::cache_entry_t::write(string const &fn, uint64_t params_hash) const {
+
+	binary_file_writer w;
+	if (!w.open(fn)) return 0;
+	tile_cache_header_t header;
+	header.magic       = TILE_CACHE_MAGIC;
+	header.version     = TILE_CACHE_VERSION;
+	header.params_hash = params_hash;
+	header.x1   = x1;
+	header.y1   = y1;
+	header.size = size;
+	int const wvals[4] = {wx1, wy1, wx2, wy2};
+	float const fvals[4] = {mzmin, mzmax, mesh_dz, radius};
+	unsigned char const flags[3] = {has_any_grass, has_tunnel, no_trees};
+	bool ret(w.write(&header, sizeof(header), 1) && w.write(wvals, sizeof(int), 4) && w.write(fvals, sizeof(float), 4) &&
+		w.write(sub_zmin, sizeof(sub_zmin), 1) && w.write(sub_zmax, sizeof(sub_zmax), 1) && w.write(flags, 1, 3) && w.write(light_pos, sizeof(point), NUM_LIGHT_SRC));
+	ret = ret && write_cache_vector(w, zvals) && write_cache_vector(w, ao_lighting) && write_cache_vector(w, mesh_weight_data) && write_cache_vector(w, grass_blocks);
+
+	for (unsigned l = 0; l < NUM_LIGHT_SRC; ++l) {
+		ret = ret && write_cache_vector(w, smask[l]) && write_cache_vector(w, sh_out[l][0]) && write_cache_vector(w, sh_out[l][1]);
+	}
+	return ret;
+}
+
+bool tile_t::cache_entry_t::read(string const &fn, uint64_t params_hash) {
+
+	binary_file_reader r;
+	if (!r.open(fn)) return 0;
+	tile_cache_header_t header;
+	if (!r.read(&header, sizeof(header), 1)) return 0;
+	if (header.magic != TILE_CACHE_MAGIC || header.version != TILE_CACHE_VERSION || header.params_hash != params_hash) return 0; // stale or invalid file
+	x1   = header.x1;
+	y1   = header.y1;
+	size = header.size;
+	int wvals[4] = {0};
+	float fvals[4] = {0};
+	unsigned char flags[3] = {0};
+	if (!r.read(wvals, sizeof(int), 4) || !r.read(fvals, sizeof(float), 4) || !r.read(sub_zmin, sizeof(sub_zmin), 1) || !r.read(sub_zmax, sizeof(sub_zmax), 1) ||
+		!r.read(flags, 1, 3) || !r.read(light_pos, sizeof(point), NUM_LIGHT_SRC)) return 0;
+	wx1 = wvals[0]; wy1 = wvals[1]; wx2 = wvals[2]; wy2 = wvals[3];
+	mzmin = fvals[0]; mzmax = fvals[1]; mesh_dz = fvals[2]; radius = fvals[3];
+	has_any_grass = (flags[0] != 0); has_tunnel = (flags[1] != 0); no_trees = (flags[2] != 0);
+	unsigned const zvsize(size+2), stride(size+1), max_sz(4*zvsize*zvsize); // upper bound on vector sizes
+	if (!read_cache_vector(r, zvals, max_sz) || !read_cache_vector(r, ao_lighting, max_sz) || !read_cache_vector(r, mesh_weight_data, max_sz) ||
+		!read_cache_vector(r, grass_blocks, stride*stride)) return 0;
+
+	for (unsigned l = 0; l < NUM_LIGHT_SRC; ++l) {
+		if (!read_cache_vector(r, smask[l], max_sz) || !read_cache_vector(r, sh_out[l][0], zvsize) || !read_cache_vector(r, sh_out[l][1], zvsize)) return 0;
+	}
+	return 1;
+}
+
+
+// *** tile_cache_t ***
+
+void tile_cache_stats_t::print() const {
+	cout << "Tile cache: " << mem_hits << " memory hits, " << disk_hits << " disk hits, " << misses << " misses, hit rate " << 100.0*get_hit_rate() << "%, "
+		 << num_stored << " stored, " << num_evicted << " evicted, " << disk_writes << " disk writes, " << disk_errors << " disk errors, "
+		 << mem_bytes/1024 << "KB in memory, " << disk_bytes/(1024*1024) << "MB on disk" << endl;
+}
+
+bool tile_cache_t::is_enabled() const {return (!disabled && (tt_tile_cache_mem_mb > 0.0 || !tt_tile_cache_dir.empty()));}
+
+string tile_cache_t::get_fn(tile_xy_pair const &txy) const {
+	std::ostringstream oss;
+	oss << tt_tile_cache_dir << "/tile_" << std::hex << std::setw(16) << std::setfill('0') << params_hash << std::dec << "_" << txy.x << "_" << txy.y << tile_cache_suffix;
+	return oss.str();
+}
+
+bool tile_cache_t::init_disk() {
+	if (disk_init) return disk_ok;
+	disk_init = 1;
+	if (tt_tile_cache_dir.empty()) return 0;
+
+	if (!create_dir_if_missing(tt_tile_cache_dir)) {
+		cerr << "Error: Failed to create tile cache directory " << tt_tile_cache_dir << "; disk tile cache is disabled" << endl;
+		return 0;
+	}
+	stats.disk_bytes = get_dir_files_size(tt_tile_cache_dir, tile_cache_suffix);
+	disk_ok = 1;
+	return 1;
+}
+
+void tile_cache_t::update_params() { // called at most once per frame
+
+	if (params_frame == frame_counter) return;
+	params_frame = frame_counter;
+	fnv1a_hash_t hash(get_mesh_gen_params_hash()); // continue the hash
+	auto add_bytes([&hash](void const *data, size_t sz) {hash.add_bytes(data, sz);});
+	int const ivals[] = {(int)TILE_CACHE_VERSION, invert_mh_image, (int)erosion_iters_tt, enable_tiled_mesh_ao, have_cities(), have_buildings()};
+	float const fvals[] = {water_plane_z, get_water_z_height(), vegetation, relh_adj_tex, biome_x_offset};
+	add_bytes(ivals, sizeof(ivals));
+	add_bytes(fvals, sizeof(fvals));
+
+	for (string const &fn : {string(mh_filename_tt ? mh_filename_tt : ""), read_hmap_modmap_fn}) { // heightmap and modmap files
+		add_bytes(fn.data(), fn.size());
+		if (fn.empty()) continue;
+		auto it(file_stats.find(fn));
+
+		if (it == file_stats.end()) {
+			pair<uint64_t, uint64_t> ts(0, 0);
+			get_file_mod_time_and_size(fn, ts.first, ts.second); // zeros if the file doesn't exist
+			it = file_stats.insert(make_pair(fn, ts)).first;
+		}
+		add_bytes(&it->second, sizeof(it->second));
+	}
+	if (hash.hash == params_hash) return; // no change
+	if (params_hash != 0) {evict_to(0);} // write any entries for the previous params to disk
+	params_hash = hash.hash;
+	on_disk.clear();
+	missed.clear();
+}
+
+void tile_cache_t::write_to_disk(lru_entry_t const &e) {
+
+	if (on_disk.find(e.first) != on_disk.end() || !init_disk()) return; // already written, or no disk cache
+	string const fn(get_fn(e.first));
+	uint64_t mtime(0), prev_size(0), new_size(0);
+	get_file_mod_time_and_size(fn, mtime, prev_size); // file may exist from a previous session
+
+	if (!e.second.write(fn, params_hash)) {
+		++stats.disk_errors;
+		remove(fn.c_str()); // don't leave a partially written file
+		stats.disk_bytes -= min(stats.disk_bytes, prev_size);
+		return;
+	}
+	get_file_mod_time_and_size(fn, mtime, new_size);
+	stats.disk_bytes += new_size;
+	stats.disk_bytes -= min(stats.disk_bytes, prev_size);
+	on_disk.insert(e.first);
+	++stats.disk_writes;
+}
+
+void tile_cache_t::evict_to(size_t max_bytes) {
+
+	while (!lru.empty() && stats.mem_bytes > max_bytes) { // remove least recently used entries
+		lru_entry_t const &e(lru.back());
+		write_to_disk(e);
+		stats.mem_bytes -= min(stats.mem_bytes, e.second.get_mem());
+		lru_map.erase(e.first);
+		lru.pop_back();
+		++stats.num_evicted;
+	}
+	if (lru.empty()) {stats.mem_bytes = 0;}
+}
+
+void tile_cache_t::add(tile_t const &tile) {
+
+	if (!is_enabled()) return;
+	update_params();
+	tile_xy_pair const txy(tile.get_tile_xy_pair());
+	missed.erase(txy);
+	auto it(lru_map.find(txy));
+
+	if (it != lru_map.end()) { // replace the existing entry
+		stats.mem_bytes -= min(stats.mem_bytes, it->second->second.get_mem());
+		lru.erase(it->second);
+		lru_map.erase(it);
+	}
+	lru.emplace_front(txy, tile_t::cache_entry_t());
+	tile.write_cache_entry(lru.front().second);
+	lru_map[txy]     = lru.begin();
+	stats.mem_bytes += lru.front().second.get_mem();
+	++stats.num_stored;
+	evict_to(size_t(1024*1024*tt_tile_cache_mem_mb)); // if there's no memory cache, the entry is written directly to disk
+}
+
+tile_t *tile_cache_t::restore(tile_t const &tile) { // the new tile is only allocated on a hit
+
+	if (!is_enabled()) return nullptr;
+	update_params();
+	tile_xy_pair const txy(tile.get_tile_xy_pair());
+	auto it(lru_map.find(txy));
+	unique_ptr<tile_t> new_tile;
+
+	if (it != lru_map.end()) { // found in memory; move data into the tile and remove the entry
+		auto const lit(it->second);
+		stats.mem_bytes -= min(stats.mem_bytes, lit->second.get_mem());
+		new_tile.reset(new tile_t(tile));
+		if (new_tile->read_cache_entry(lit->second)) {++stats.mem_hits;} else {new_tile.reset();}
+		lru.erase(lit);
+		lru_map.erase(it);
+	}
+	else if (missed.find(txy) != missed.end()) return nullptr; // already looked up, don't count it again
+	else if (init_disk()) {
+		string const fn(get_fn(txy));
+		uint64_t mtime(0), fsize(0);
+
+		if (get_file_mod_time_and_size(fn, mtime, fsize)) { // file exists
+			tile_t::cache_entry_t entry;
+
+			if (entry.read(fn, params_hash)) {
+				new_tile.reset(new tile_t(tile));
+				if (!new_tile->read_cache_entry(entry)) {new_tile.reset();}
+			}
+			if (new_tile) {++stats.disk_hits; on_disk.insert(txy);} else {++stats.disk_errors;}
+		}
+	}
+	if (!new_tile) {missed.insert(txy); ++stats.misses;}
+	return new_tile.release();
+}
+
+void tile_cache_t::flush() {evict_to(0);}
+
+void tile_cache_t::disable() {
+
+	if (disabled) return;
+	flush(); // entries are still valid for the unmodified heightmap
+	disabled = 1;
+	cout << "Tile cache disabled due to heightmap edit" << endl;
+}
+
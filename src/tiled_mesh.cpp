@@ -59,7 +59,7 @@ vector<clear_area_t> tile_smaps_to_clear;
 
 extern bool inf_terrain_scenery, enable_tiled_mesh_ao, underwater, fog_enabled, volume_lighting, combined_gu, enable_depth_clamp, tt_triplanar_tex, use_grass_tess;
 extern bool use_instanced_pine_trees, enable_tt_model_reflect, water_is_lava, tt_fire_button_down, flashlight_on, camera_in_building, player_in_attic, rotate_trees;
-extern unsigned grass_density, max_unique_trees, shadow_map_sz, erosion_iters_tt, num_rnd_grass_blocks, tiled_terrain_gen_heightmap_sz;
+extern unsigned grass_density, max_unique_trees, shadow_map_sz, erosion_iters_tt, num_rnd_grass_blocks, tiled_terrain_gen_heightmap_sz, NUM_THREADS;
 extern unsigned num_birds_per_tile, num_fish_per_tile, num_bflies_per_tile;
 extern int DISABLE_WATER, display_mode, tree_mode, leaf_color_changed, ground_effects_level, animate2, iticks, num_trees, window_width, window_height, player_in_basement;
 extern int invert_mh_image, is_cloudy, camera_surf_collide, show_fog, mesh_gen_mode, mesh_gen_shape, cloud_model, precip_mode, auto_time_adv, draw_model, player_in_elevator;
@@ -78,6 +78,10 @@ extern pt_line_drawer tree_scenery_pld;
 extern tree_placer_t tree_placer;
 
 bool enable_terrain_env(ENABLE_TERRAIN_ENV);
+bool tt_bkg_tile_gen(0); // generate tile zvals and AO lighting on a background thread; CPU height generation modes only
+float tt_tile_prefetch_dist(0.5); // how far ahead of the moving camera to generate tiles, in units of the tile view radius
+float tt_tile_gen_budget_ms(4.0); // per-frame time limit for generating tiles on the main thread when tt_bkg_tile_gen=1
+bool tt_horizon_shadows(0); // compute tile mesh shadows from precomputed horizon maps, which makes sun and moon movement faster
 void set_water_plane_uniforms(shader_t &s);
 void create_pine_tree_instances();
 unsigned get_tree_inst_gpu_mem();
@@ -182,6 +186,7 @@ public:
 		cur_tile = tile;
 		assert(brush.radius <= get_tile_size()); // only allow for a single adjacent tile
 		clear_modified();
+		disable_tile_cache(); // cached tiles no longer match the edited heightmap
 
 		if (brush.is_flatten_brush()) { // use heightmap value at brush center instead of a delta
 			brush.delta = get_clamped_pixel_value(brush.x, brush.y); // Note: original delta is overwritten/unused in this case
@@ -252,10 +257,25 @@ bool read_default_hmap_modmap() {
 	return 1;
 }
 
+bool load_tiled_terrain_heightmap() { // returns 1 if a heightmap file was loaded; cities are generated as a heightmap postprocess step
+
+	if (terrain_hmap_manager.maybe_load(mh_filename_tt, (invert_mh_image != 0))) {
+		read_default_hmap_modmap();
+		return 1;
+	}
+	if (tiled_terrain_gen_heightmap_sz > 0) {
+		terrain_hmap_manager.proc_gen_heightmap(tiled_terrain_gen_heightmap_sz);
+		read_default_hmap_modmap();
+		// since the heightmap values should be the same as single point queries, we don't need to re-calculate the player's zval
+	}
+	return 0;
+}
+
 bool write_default_hmap_modmap() {
 
 	if (write_hmap_modmap_fn.empty()) return 0;
 	if (!terrain_hmap_manager.write_mod(write_hmap_modmap_fn)) return 0;
+	invalidate_tile_cache_file_stats();
 	cout << "Wrote heightmap modmap " << write_hmap_modmap_fn << endl;
 	return 1;
 }
@@ -267,12 +287,12 @@ tile_t::tile_t() : x1(0), y1(0), x2(0), y2(0), wx1(0), wy1(0), wx2(0), wy2(0),
 	last_occluded_frame(0), weight_tid(0), height_tid(0), normal_tid(0), shadow_tid(0), size(0), stride(0), zvsize(0), base_tsize(0), gen_tsize(0), smap_lod_level(0),
 	radius(0), mzmin(0), mzmax(0), mesh_dz(0), ptzmax(0), dtzmax(0), trmax(0), xstart(0), ystart(0), min_normal_z(0.0), deltax(0.0), deltay(0.0),
 	sun_shadows_invalid(1), moon_shadows_invalid(1), recalc_tree_grass_weights(1), mesh_height_invalid(0), in_queue(0), last_occluded(0), has_any_grass(0),
-	is_distant(0), no_trees(0), just_cleared(0), has_tunnel(0), decid_trees(tree_data_manager) {}
+	is_distant(0), no_trees(0), just_cleared(0), has_tunnel(0), weights_from_cache(0), decid_trees(tree_data_manager) {}
 
 tile_t::tile_t(unsigned size_, int x, int y) : last_occluded_frame(0), weight_tid(0), height_tid(0), normal_tid(0), shadow_tid(0),
 	size(size_), stride(size+1), zvsize(stride+1), gen_tsize(0), smap_lod_level(0), mesh_dz(0.0), trmax(0.0), min_normal_z(0.0), deltax(DX_VAL), deltay(DY_VAL),
 	sun_shadows_invalid(1), moon_shadows_invalid(1), recalc_tree_grass_weights(1), mesh_height_invalid(0), in_queue(0), last_occluded(0), has_any_grass(0),
-	is_distant(0), no_trees(0), just_cleared(0), has_tunnel(0), mesh_off(xoff-xoff2, yoff-yoff2), decid_trees(tree_data_manager)
+	is_distant(0), no_trees(0), just_cleared(0), has_tunnel(0), weights_from_cache(0), mesh_off(xoff-xoff2, yoff-yoff2), decid_trees(tree_data_manager)
 {
 	assert(size > 0);
 	x1 = x*size;
@@ -385,6 +405,8 @@ void tile_t::clear() {
 	weight_data.clear();
 	zvals.clear();
 	clear_shadows();
+	horizon_map.clear();
+	horizon_adj_mask = 0;
 	pine_trees.clear_all();
 	decid_trees.clear();
 	scenery.clear();
@@ -459,6 +481,10 @@ bool tile_t::create_zvals(mesh_xy_grid_cache_t &height_gen, bool no_wait) {
 		if (!results_ready) {assert(no_wait); return 0;} // cached heights are not yet ready
 	}
 	float const xy_mult(1.0/float(size)), wpz_max(get_max_sea_level());
+	vector<float> detail_zvals;
+	// evaluate all height gen values at once, which is faster than calling eval_index() per point
+	if (using_hmap) {if (add_detail) {detail_zvals.resize(zvals.size()); height_gen.eval_all(detail_zvals.data());}}
+	else if (ao_zvals.empty()) {height_gen.eval_all(zvals.data());}
 
 #pragma omp parallel for schedule(static,1)
 	for (int y = 0; y < (int)zvsize; ++y) {
@@ -467,11 +493,11 @@ bool tile_t::create_zvals(mesh_xy_grid_cache_t &height_gen, bool no_wait) {
 
 			if (using_hmap) {
 				zval = terrain_hmap_manager.get_clamped_height((x1 + x), (y1 + y));
-				if (add_detail) {zval += HMAP_DETAIL_MAG*height_gen.eval_index(x, y);} // less hard-coded - scale by delta between adjacent zvals?
+				if (add_detail) {zval += HMAP_DETAIL_MAG*detail_zvals[y*zvsize + x];} // less hard-coded - scale by delta between adjacent zvals?
 			}
 			else {
 				if (!ao_zvals.empty()) {zval = ao_zvals[(y + AO_RAY_LEN)*context_sz + (x + AO_RAY_LEN)];} // use AO zvals
-				else                   {zval = height_gen.eval_index(x, y);} // use height gen
+				// else zval was set by height_gen.eval_all() above
 
 				if (USE_PARAMS_HSCALE) {
 					float const xv(float(x)*xy_mult), yv(float(y)*xy_mult);
@@ -513,6 +539,66 @@ bool tile_t::create_zvals(mesh_xy_grid_cache_t &height_gen, bool no_wait) {
 	return 1; // results are ready
 }
 
+void tile_t::write_cache_entry(cache_entry_t &entry) const {
+
+	assert(can_cache());
+	entry.x1 = x1; entry.y1 = y1; entry.wx1 = wx1; entry.wy1 = wy1; entry.wx2 = wx2; entry.wy2 = wy2;
+	entry.size    = size;
+	entry.mzmin   = mzmin;
+	entry.mzmax   = mzmax;
+	entry.mesh_dz = mesh_dz;
+	entry.radius  = radius;
+	memcpy(entry.sub_zmin, sub_zmin, sizeof(sub_zmin));
+	memcpy(entry.sub_zmax, sub_zmax, sizeof(sub_zmax));
+	entry.has_any_grass = has_any_grass;
+	entry.has_tunnel    = has_tunnel;
+	entry.no_trees      = no_trees;
+	entry.zvals         = zvals;
+	entry.ao_lighting   = ao_lighting;
+	entry.mesh_weight_data = mesh_weight_data; // Note: weight_data/tree_map depend on trees and are regenerated
+	if (!mesh_weight_data.empty()) {entry.grass_blocks = grass_blocks;}
+
+	for (unsigned l = 0; l < NUM_LIGHT_SRC; ++l) {
+		if (smask[l].empty() || sh_out[l][0].size() != zvsize || sh_out[l][1].size() != zvsize) continue; // not calculated
+		entry.smask[l] = smask[l];
+		for (unsigned d = 0; d < 2; ++d) {entry.sh_out[l][d] = sh_out[l][d];}
+		entry.light_pos[l] = shadow_light_pos[l];
+	}
+}
+
+bool tile_t::read_cache_entry(cache_entry_t &entry) { // moves data out of entry; tile must be newly created
+
+	if (entry.x1 != x1 || entry.y1 != y1 || entry.size != size || entry.zvals.size() != zvsize*zvsize) return 0; // wrong tile or size
+	if (!entry.ao_lighting.empty() && entry.ao_lighting.size() != stride*stride) return 0;
+	if (enable_terrain_env) {update_terrain_params();}
+	wx1 = entry.wx1; wy1 = entry.wy1; wx2 = entry.wx2; wy2 = entry.wy2;
+	mzmin   = entry.mzmin;
+	mzmax   = entry.mzmax;
+	mesh_dz = entry.mesh_dz;
+	radius  = entry.radius;
+	memcpy(sub_zmin, entry.sub_zmin, sizeof(sub_zmin));
+	memcpy(sub_zmax, entry.sub_zmax, sizeof(sub_zmax));
+	ptzmax = dtzmax = mzmin; // no trees yet
+	no_trees    = entry.no_trees;
+	zvals       = std::move(entry.zvals);
+	ao_lighting = std::move(entry.ao_lighting);
+
+	if (!entry.mesh_weight_data.empty()) { // create_texture() will skip the weight calculation
+		has_any_grass    = entry.has_any_grass;
+		has_tunnel       = entry.has_tunnel;
+		mesh_weight_data = std::move(entry.mesh_weight_data);
+		grass_blocks     = std::move(entry.grass_blocks);
+		weights_from_cache = 1;
+	}
+	for (unsigned l = 0; l < NUM_LIGHT_SRC; ++l) { // only valid if the light hasn't moved since the shadows were computed
+		if (entry.smask[l].size() != zvals.size() || entry.light_pos[l] != get_light_pos(l)) continue;
+		smask[l] = std::move(entry.smask[l]);
+		for (unsigned d = 0; d < 2; ++d) {sh_out[l][d] = std::move(entry.sh_out[l][d]);}
+		shadow_light_pos[l] = entry.light_pos[l];
+	}
+	return 1;
+}
+
 void tile_t::get_z_minmax_for_area(point const &pos, float radius, float &zmin, float &zmax) const {
 
 	float const rx1(pos.x - radius), ry1(pos.y - radius), rx2(pos.x + radius), ry2(pos.y + radius);
@@ -658,6 +744,7 @@ void tile_t::calc_shadows_for_light(unsigned l) {
 	// calculate shadows of current tile
 	calc_mesh_shadows(l, lpos, &zvals.front(), &smask[l].front(), zvsize, zvsize,
 		sh_in[0], sh_in[1], &sh_out[l][0].front(), &sh_out[l][1].front());
+	shadow_light_pos[l] = lpos;
 	((l == LIGHT_SUN) ? sun_shadows_invalid : moon_shadows_invalid) = 1;
 }
 
@@ -702,10 +789,75 @@ void tile_t::calc_shadows(bool calc_sun, bool calc_moon, bool no_push) {
 		if (!smask[l].empty()) continue; // already calculated (cached)
 		smask[l].resize(zvals.size(), 0);
 		//if (normal_zmin < 1.0 && get_light_pos(l).get_norm().xy_mag() < normal_zmin) { // terrain slope lower than sun slope
-		if (no_push) {calc_shadows_for_light(l);} else {proc_tile_queue(this, l);}
+		if (tt_horizon_shadows && !is_distant) {calc_shadows_from_horizon(l);} // no dependency on adjacent tile shadows
+		else if (no_push) {calc_shadows_for_light(l);} else {proc_tile_queue(this, l);}
+	}
+}
+
+
+unsigned tile_t::get_horizon_adj_mask() const { // one bit for each of the 3x3 tiles centered on this one that have heights
+
+	unsigned mask(0);
+
+	for (int dy = -1; dy <= 1; ++dy) {
+		for (int dx = -1; dx <= 1; ++dx) {
+			if (dx == 0 && dy == 0) continue; // skip self
+			tile_t const *const adj_tile(get_tile_from_xy(get_tile_xy_pair(dx, dy)));
+			if (adj_tile && !adj_tile->is_distant && adj_tile->zvals.size() == zvals.size()) {mask |= (1U << (3*(dy+1) + (dx+1)));}
+		}
+	}
+	return mask;
+}
+
+void tile_t::calc_horizon_map(unsigned adj_mask) {
+
+	// include the heights of adjacent tiles so that they can cast shadows onto this tile; shadows are limited to a distance of one tile
+	int const border(size), ctx_sz(zvsize + 2*border);
+	vector<float> heights(ctx_sz*ctx_sz, -FAR_DISTANCE); // missing adjacent tiles don't cast shadows
+	tile_t const *adj_tiles[3][3] = {};
+
+	for (int dy = -1; dy <= 1; ++dy) {
+		for (int dx = -1; dx <= 1; ++dx) {
+			if (dx == 0 && dy == 0) {adj_tiles[1][1] = this;}
+			else if (adj_mask & (1U << (3*(dy+1) + (dx+1)))) {adj_tiles[dy+1][dx+1] = get_tile_from_xy(get_tile_xy_pair(dx, dy));}
+		}
+	}
+	for (int cy = 0; cy < ctx_sz; ++cy) {
+		int const y(cy - border), ty((y < 0) ? -1 : ((y >= (int)zvsize) ? 1 : 0)), ly(y - ty*int(size));
+
+		for (int cx = 0; cx < ctx_sz; ++cx) {
+			int const x(cx - border), tx((x < 0) ? -1 : ((x >= (int)zvsize) ? 1 : 0)), lx(x - tx*int(size));
+			tile_t const *const tile(adj_tiles[ty+1][tx+1]);
+			if (tile) {heights[cy*ctx_sz + cx] = tile->zvals[ly*zvsize + lx];}
+		}
+	}
+	bool const is_new(horizon_map.empty());
+	horizon_map.calc(&heights.front(), ctx_sz, ctx_sz, border, border, zvsize, zvsize, deltax, deltay);
+	horizon_adj_mask = adj_mask;
+	if (!is_new) return;
+
+	for (int dy = -1; dy <= 1; ++dy) { // this tile may cast shadows on adjacent tiles, so their horizons must be recalculated
+		for (int dx = -1; dx <= 1; ++dx) {
+			if (!(adj_mask & (1U << (3*(dy+1) + (dx+1))))) continue;
+			tile_t *const adj_tile(get_tile_from_xy(get_tile_xy_pair(dx, dy)));
+			if (adj_tile->horizon_map.empty()) continue; // not yet calculated
+			adj_tile->horizon_adj_mask = 0; // force recalculation
+			adj_tile->clear_shadows(1, 1, 1); // no_clear_adj=1
+		}
 	}
 }
 
+void tile_t::calc_shadows_from_horizon(unsigned l) {
+
+	assert(smask[l].size() == zvals.size());
+	unsigned const adj_mask(get_horizon_adj_mask());
+	if (horizon_map.empty() || (adj_mask & ~horizon_adj_mask)) {calc_horizon_map(adj_mask);} // new or adjacent tiles were added
+	point const lpos(get_light_pos(l));
+	horizon_map.calc_shadows(l, lpos, &smask[l].front());
+	shadow_light_pos[l] = lpos;
+	((l == LIGHT_SUN) ? sun_shadows_invalid : moon_shadows_invalid) = 1;
+}
+
 
 void tile_t::push_tree_ao_shadow(int dx, int dy, point const &pos, float tradius) const {
 
@@ -1027,7 +1179,7 @@ void tile_t::create_texture(mesh_xy_grid_cache_t &height_gen) {
 	int sand_tex_ix(-1), dirt_tex_ix(-1), grass_tex_ix(-1), rock_tex_ix(-1), snow_tex_ix(-1);
 	get_texture_ixs(sand_tex_ix, dirt_tex_ix, grass_tex_ix, rock_tex_ix, snow_tex_ix);
 
-	if (weight_tid == 0) { // create weights
+	if (weight_tid == 0 && !weights_from_cache) { // create weights
 		has_any_grass = has_tunnel = 0;
 		grass_blocks.clear();
 		mesh_weight_data.resize(4*num_texels); // RGBA
@@ -1158,8 +1310,9 @@ void tile_t::create_texture(mesh_xy_grid_cache_t &height_gen) {
 		} // for y
 	}
 	else { // use existing weights
-		assert(recalc_tree_grass_weights); // can only get here in this case
+		assert(recalc_tree_grass_weights || weights_from_cache); // can only get here in these cases
 		assert(mesh_weight_data.size() == 4*num_texels);
+		weights_from_cache = 0; // only used for the first texture creation
 	}
 	weight_data = mesh_weight_data; // deep copy so that tree_map doesn't alter original weights
 
@@ -1236,14 +1389,17 @@ void tile_t::calc_avg_mesh_color() {
 }
 
 
-bool tile_t::update_range(tile_shadow_map_manager &smap_manager) { // if returns 0, tile will be deleted
+bool tile_t::update_range(tile_shadow_map_manager &smap_manager, tile_cache_t *tile_cache) { // if returns 0, tile will be deleted
 
 	update_pine_tree_state(0); // can free pine tree vbos
 	update_animals(); // if any were generated
 	float const dist(get_rel_dist_to_camera());
 	
 	if (dist > CLEAR_DIST_TILES || mesh_height_invalid) {
-		if (!just_cleared) {clear_vbo_tid(&smap_manager);} // avoid clearing every frame
+		if (!just_cleared) { // avoid clearing every frame
+			if (tile_cache && can_cache()) {tile_cache->add(*this);} // save before shadows are cleared
+			clear_vbo_tid(&smap_manager);
+		}
 		just_cleared = 1;
 	}
 	else {just_cleared = 0;}
@@ -2125,6 +2281,8 @@ void tile_draw_t::clear(bool no_regen_buildings) {
 	to_draw.clear();
 	tiles.clear();
 	shadow_recomp_queue.clear();
+	bkg_gen_mgr.finish_all();
+	tile_cache.print_stats();
 	if (!no_regen_buildings && !have_cities()) {buildings_valid = 0;} // can't regenerate buildings after cities and cars have been placed
 }
 
@@ -2137,6 +2295,136 @@ void tile_draw_t::free_compute_shader() {
 	for (auto i = height_gens.begin(); i != height_gens.end(); ++i) {i->clear_context();}
 }
 
+// *** tile_bkg_gen_mgr_t ***
+
+float tile_gen_stats_t::get_latency_percentile(float pct) const {
+	if (latency_ms.empty()) return 0.0;
+	vector<float> sorted(latency_ms);
+	unsigned const ix(min(unsigned(pct*sorted.size()), unsigned(sorted.size()-1)));
+	std::nth_element(sorted.begin(), sorted.begin()+ix, sorted.end());
+	return sorted[ix];
+}
+void tile_gen_stats_t::print() const {
+	cout << "Tile gen: " << num_bkg << " background, " << num_main << " main thread, " << num_discarded << " discarded, max queue depth " << max_queue_depth
+		 << ", latency p50 " << get_latency_percentile(0.5) << "ms p90 " << get_latency_percentile(0.9) << "ms p99 " << get_latency_percentile(0.99)
+		 << "ms, frames over budget " << frames_over_budget << " of " << num_frames << endl;
+}
+
+void tile_bkg_gen_mgr_t::run_jobs() { // called on the worker thread
+	int const num_jobs(running.size());
+#pragma omp parallel for schedule(dynamic) num_threads(max(1U, NUM_THREADS-1)) // leave one thread for the main thread
+	for (int i = 0; i < num_jobs; ++i) {
+		mesh_xy_grid_cache_t height_gen; // CPU only, so no GL context is needed
+		tile_t *const tile(running[i].tile);
+		tile->create_zvals(height_gen, 0);
+		if (enable_tiled_mesh_ao) {tile->calc_mesh_ao_lighting();} // otherwise done in create_texture() on the main thread
+	}
+	worker_done = 1;
+}
+void tile_bkg_gen_mgr_t::join_worker() {
+	if (!needs_to_join) return;
+	worker.join();
+	needs_to_join = 0;
+	vector_add_to(running, completed);
+	running.clear();
+}
+void tile_bkg_gen_mgr_t::discard(request_t const &r) {
+	queued.erase(r.tile->get_tile_xy_pair());
+	delete r.tile;
+	++stats.num_discarded;
+}
+void tile_bkg_gen_mgr_t::record_latency(request_t const &r) {
+	stats.latency_ms.push_back(1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - r.req_time).count());
+	++stats.num_bkg;
+}
+
+void tile_bkg_gen_mgr_t::add_request(tile_t *tile) {
+	bool const did_ins(queued.insert(tile->get_tile_xy_pair()).second);
+	assert(did_ins);
+	pending.emplace_back(tile);
+}
+
+// removes a queued tile so that the caller can insert or generate it now, waiting for the worker thread if needed;
+// is_generated is set if the tile's zvals have been generated; returns nullptr if not queued
+tile_t *tile_bkg_gen_mgr_t::take(tile_xy_pair const &txy, bool &is_generated) {
+
+	if (!is_queued(txy)) return nullptr;
+	queued.erase(txy);
+	auto find_and_remove([&txy](vector<request_t> &v) -> request_t * {
+		for (auto i = v.begin(); i != v.end(); ++i) {
+			if (i->tile->get_tile_xy_pair() == txy) {std::swap(*i, v.back()); return &v.back();}
+		}
+		return nullptr;
+	});
+	request_t *r(find_and_remove(pending));
+
+	if (r != nullptr) { // not yet started
+		tile_t *const tile(r->tile);
+		pending.pop_back();
+		is_generated = 0;
+		return tile;
+	}
+	if (needs_to_join) { // may be running
+		for (request_t const &r : running) {
+			if (r.tile->get_tile_xy_pair() == txy) {join_worker(); break;}
+		}
+	}
+	r = find_and_remove(completed);
+	assert(r != nullptr); // must be completed
+	tile_t *const tile(r->tile);
+	record_latency(*r);
+	completed.pop_back();
+	is_generated = 1;
+	return tile;
+}
+
+// called once per frame on the main thread: returns tiles that are close enough to the camera to insert, discards tiles farther than keep_dist,
+// and starts the next batch of highest priority tiles on the worker thread
+void tile_bkg_gen_mgr_t::next_frame(vector<tile_t *> &ready, float keep_dist) {
+
+	if (needs_to_join && worker_done) {join_worker();}
+	max_eq(stats.max_queue_depth, get_queue_depth());
+	unsigned num_kept(0);
+
+	for (request_t const &r : completed) {
+		if (r.tile->rel_dist_to_camera_xy_lt(CREATE_DIST_TILES)) {
+			queued.erase(r.tile->get_tile_xy_pair());
+			ready.push_back(r.tile);
+			record_latency(r);
+		}
+		else if (!r.tile->rel_dist_to_camera_xy_lt(keep_dist)) {discard(r);} // camera moved away
+		else {completed[num_kept++] = r;} // prefetched tile that isn't needed yet
+	}
+	completed.erase(completed.begin()+num_kept, completed.end());
+	if (needs_to_join || pending.empty()) return; // worker is busy or nothing to do
+	num_kept = 0;
+
+	for (request_t &r : pending) {
+		if (!r.tile->rel_dist_to_camera_xy_lt(keep_dist)) {discard(r); continue;}
+		r.priority = r.tile->get_draw_priority(); // camera may have moved since the request was added
+		pending[num_kept++] = r;
+	}
+	pending.erase(pending.begin()+num_kept, pending.end());
+	if (pending.empty()) return;
+	unsigned const batch_size(min((unsigned)pending.size(), 2*max(1U, NUM_THREADS)));
+	sort(pending.begin(), pending.end());
+	running.assign(pending.begin(), pending.begin()+batch_size);
+	pending.erase(pending.begin(), pending.begin()+batch_size);
+	worker_done   = 0;
+	needs_to_join = 1;
+	worker = std::thread(&tile_bkg_gen_mgr_t::run_jobs, this);
+}
+
+void tile_bkg_gen_mgr_t::finish_all() { // discards all requests
+	join_worker();
+	for (request_t const &r : pending  ) {delete r.tile;}
+	for (request_t const &r : completed) {delete r.tile;}
+	pending  .clear();
+	completed.clear();
+	queued   .clear();
+}
+
+
 float tile_draw_t::update(float &min_camera_dist) { // view-independent updates; returns terrain zmin
 
 	//highres_timer_t timer("TT Update");
@@ -2145,15 +2433,9 @@ float tile_draw_t::update(float &min_camera_dist) { // view-independent updates;
 	unsigned const max_defer_tiles        = 8; // 0 = disable
 	if (height_gens.empty()) {height_gens.resize(max(max_defer_tiles, 1U));}
 
-	if (terrain_hmap_manager.maybe_load(mh_filename_tt, (invert_mh_image != 0))) {
-		read_default_hmap_modmap();
+	if (load_tiled_terrain_heightmap()) {
 		force_onto_surface_mesh(surface_pos); // move camera onto newly loaded terrain so that the first drawn frame is correct
 	}
-	else if (tiled_terrain_gen_heightmap_sz > 0) {
-		terrain_hmap_manager.proc_gen_heightmap(tiled_terrain_gen_heightmap_sz);
-		read_default_hmap_modmap();
-		// since the heightmap values should be the same as single point queries, we don't need to re-calculate the player's zval
-	}
 	if (!buildings_valid) {
 		gen_buildings();
 		gen_city_details(); // after building generation
@@ -2186,28 +2468,82 @@ float tile_draw_t::update(float &min_camera_dist) { // view-independent updates;
 		to_gen_zvals.clear();
 	}
 	for (tile_map::iterator i = tiles.begin(); i != tiles.end(); ) { // update tiles and free old tiles (Note: no ++i)
-		if (!i->second->update_range(smap_manager)) { // delete this tile
+		if (!i->second->update_range(smap_manager, &tile_cache)) { // delete this tile
 			i->second->clear();
 			tiles.erase(i++);
 			++num_erased;
 		} else {++i;}
 	}
+	bool const gpu_mode(mesh_gen_mode >= MGEN_SIMPLEX_GPU);
+	// background generation is only used for CPU height generation, and not when buildings modify the heightmap or the user is editing it
+	bool const bkg_gen(tt_bkg_tile_gen && !gpu_mode && !create_buildings_first && inf_terrain_fire_mode == FM_NONE);
+	auto const gen_start(high_resolution_clock::now());
+
+	if (bkg_gen) {
+		vector<tile_t *> ready;
+		bkg_gen_mgr.next_frame(ready, (CREATE_DIST_TILES + tt_tile_prefetch_dist));
+		for (tile_t *tile : ready) {insert_tile(tile);}
+	}
+	else if (bkg_gen_mgr.get_queue_depth() > 0) {bkg_gen_mgr.finish_all();} // background generation was disabled
+	// cached tiles can't be used when buildings modify the heightmap, since flattening depends on which tiles were created first
+	bool const use_cache(tile_cache.is_enabled() && !create_buildings_first);
+	
 	for (int y = y1; y <= y2; ++y ) { // create new tiles
 		for (int x = x1; x <= x2; ++x ) {
 			tile_xy_pair const txy(x, y);
 			if (tiles.find(txy) != tiles.end()) continue; // already exists
 			tile_t tile(get_tile_size(), x, y);
 			if (!tile.rel_dist_to_camera_xy_lt(CREATE_DIST_TILES)) continue; // too far away to create
+
+			if (use_cache && !(bkg_gen && bkg_gen_mgr.is_queued(txy))) { // check for a previously generated copy of this tile
+				tile_t *const cached_tile(tile_cache.restore(tile));
+				if (cached_tile != nullptr) {insert_tile(cached_tile); continue;}
+			}
+			if (bkg_gen) {
+				if (!tile.rel_dist_to_camera_xy_lt(DRAW_DIST_TILES)) { // not yet visible, generate on the background thread
+					if (!bkg_gen_mgr.is_queued(txy)) {bkg_gen_mgr.add_request(new tile_t(tile));}
+					continue;
+				}
+				bool is_generated(0);
+				tile_t *const queued_tile(bkg_gen_mgr.take(txy, is_generated)); // needed now, so take it from the background queue
+
+				if (queued_tile != nullptr) {
+					if (is_generated) {insert_tile(queued_tile);}
+					else {to_gen_zvals.push_back(make_pair(queued_tile->get_draw_priority(), queued_tile));}
+					continue;
+				}
+			}
 			tile_t *new_tile(new tile_t(tile));
 			to_gen_zvals.push_back(make_pair(new_tile->get_draw_priority(), new_tile));
 			// in this mode, we need to place buildings and flatten the heightmap before calculating tile heights
 			if (create_buildings_first) {create_buildings_tile(x, y, 1);}
 		} // for x
 	} // for y
+	point const camera_global(cpos - get_camera_coord_space_xlate()); // not affected by camera coordinate space shifts
+
+	if (bkg_gen && prev_camera_valid && tt_tile_prefetch_dist > 0.0) { // prefetch tiles ahead of the camera along its direction of motion
+		vector3d const move_dir(vector3d((camera_global.x - prev_camera_pos.x), (camera_global.y - prev_camera_pos.y), 0.0).get_norm()); // zero if not moving
+
+		if (move_dir != zero_vector) {
+			point const pred_pos(cpos + (tt_tile_prefetch_dist*get_scaled_tile_radius())*move_dir);
+			int const poffx(int(0.5*(pred_pos.x - get_tiled_terrain_model_xlate().x)/X_SCENE_SIZE)), poffy(int(0.5*(pred_pos.y - get_tiled_terrain_model_xlate().y)/Y_SCENE_SIZE));
+
+			for (int y = poffy - tile_radius; y <= poffy + tile_radius; ++y) {
+				for (int x = poffx - tile_radius; x <= poffx + tile_radius; ++x) {
+					tile_xy_pair const txy(x, y);
+					if (tiles.find(txy) != tiles.end() || bkg_gen_mgr.is_queued(txy)) continue; // already exists or queued
+					if (use_cache && tile_cache.in_memory(txy)) continue; // will be restored from the cache when needed
+					tile_t tile(get_tile_size(), x, y);
+					if (tile.rel_dist_to_pt_xy_lt(pred_pos, CREATE_DIST_TILES)) {bkg_gen_mgr.add_request(new tile_t(tile));}
+				}
+			}
+		}
+	}
+	prev_camera_pos   = camera_global;
+	prev_camera_valid = 1;
 	//if (to_gen_zvals.size() < max_cpu_tiles) {to_gen_zvals.clear();} // block until at least max_cpu_tiles tiles to generate (lower average gen time, but causes more slow frames/lag)
 	unsigned const num_to_gen(to_gen_zvals.size());
 	unsigned gen_this_frame(min(num_to_gen, max_tile_gen_per_frame));
-	bool const gpu_mode(mesh_gen_mode >= MGEN_SIMPLEX_GPU);
 	
 	// to balance tile gen time across frames, generate a number of tiles equal to the average of this frame and the previous frame
 	if (gen_this_frame > 1 && gen_this_frame < max_tile_gen_per_frame && inf_terrain_fire_mode == FM_NONE) { // disable this mode when editing mesh height to prevent visual artifacts
@@ -2234,15 +2570,26 @@ float tile_draw_t::update(float &min_camera_dist) { // view-independent updates;
 		if (gpu_mode && gen_this_frame <= max_cpu_tiles) {mesh_gen_mode = MGEN_SIMPLEX;} // GPU simplex => CPU simplex
 		if (gen_this_frame < num_to_gen) {sort(to_gen_zvals.begin(), to_gen_zvals.end());} // sort by priority if not all generated
 
+		if (bkg_gen) {sort(to_gen_zvals.begin(), to_gen_zvals.end());} // generate closest first within the time budget
+
 		for (unsigned i = 0; i < num_to_gen; ++i) {
 			tile_t *tile(to_gen_zvals[i].second);
 			if (i >= gen_this_frame) {delete tile; continue;} // delete these tiles - they will be created in a later frame
+			// in background mode, always generate at least one tile so that we make progress
+			if (bkg_gen && i > 0 && 1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - gen_start).count() > tt_tile_gen_budget_ms) {delete tile; continue;}
 			tile->create_zvals(height_gens[0], 0); // generate these tiles
 			insert_tile(tile);
+			++bkg_gen_mgr.stats.num_main;
 		}
 		to_gen_zvals.clear();
 		mesh_gen_mode = prev_mesh_gen_mode;
 	}
+	if (num_to_gen > 0 || bkg_gen) { // count frames that generated tiles on the main thread, or could have in background mode
+		tile_gen_stats_t &stats(bkg_gen_mgr.stats);
+		++stats.num_frames;
+		if (1000.0f*duration_cast<duration<float>>(high_resolution_clock::now() - gen_start).count() > tt_tile_gen_budget_ms) {++stats.frames_over_budget;}
+		if (bkg_gen && bkg_gen_mgr.get_queue_depth() == 0 && stats.num_bkg >= last_tile_stats_num_printed + 16) {stats.print(); last_tile_stats_num_printed = stats.num_bkg;}
+	}
 	for (tile_map::iterator i = tiles.begin(); i != tiles.end(); ++i) { // calculate terrain_zmin and updated building tiles
 		float const rel_dist(i->second->get_rel_dist_to_camera());
 
@@ -2265,13 +2612,13 @@ float tile_draw_t::update(float &min_camera_dist) { // view-independent updates;
 	moon_change &= (dot_product(moon_pos.get_norm(), last_moon.get_norm()) < toler);
 
 	if (mesh_shadows_enabled() && (sun_change || moon_change) && shadow_recomp_queue.empty()) { // light source change
-		if (auto_time_adv && !moon_change) { // auto time advance shadow map update for sun change only - triger a shadow recompute
+		if (auto_time_adv && !moon_change && !tt_horizon_shadows) { // auto time advance shadow map update for sun change only - triger a shadow recompute
 			for (auto i = tiles.begin(); i != tiles.end(); ++i) { // triger a shadow recompute
 				shadow_recomp_queue.emplace_back(-p2p_dist(sun_pos, i->second->get_center()), i->second->get_tile_xy_pair());
 			}
 			sort(shadow_recomp_queue.begin(), shadow_recomp_queue.end()); // sort by decreasing distance to light source
 		}
-		else { // invalidate and recompute all shadows on moon change (infrequent) or user sun pos change
+		else { // invalidate and recompute all shadows on moon change (infrequent), user sun pos change, or when using horizon maps (fast)
 			for (tile_map::iterator i = tiles.begin(); i != tiles.end(); ++i) {i->second->clear_shadows(sun_change, moon_change);}
 		}
 		last_sun  = sun_pos;
@@ -2606,6 +2953,12 @@ void tile_draw_t::occluder_pts_t::calc_cube_top_points(cube_t const &bcube) { //
 
 unsigned in_mb(unsigned long long v) {return v/1024/1024;}
 
+uint64_t tile_draw_t::get_tiles_gpu_mem() const { // includes shadow maps
+	uint64_t mem(0);
+	for (tile_map::const_iterator i = tiles.begin(); i != tiles.end(); ++i) {mem += i->second->get_gpu_mem();}
+	return mem;
+}
+
 tile_draw_t::occluder_cubes_t::occluder_cubes_t(tile_t const *const tile_) : tile(tile_), bcube(tile->get_mesh_bcube()) {
 	for (unsigned s = 0; s < 16; ++s) {
 		cube_t &sub_cube(sub_cubes[s]);
@@ -3424,6 +3777,9 @@ bool tile_smap_data_t::needs_update(point const &lpos) {
 
 
 tile_t *get_tile_from_xy  (tile_xy_pair const &tp) {return terrain_tile_draw.get_tile_from_xy(tp);}
+unsigned get_num_tiled_terrain_tiles() {return terrain_tile_draw.get_num_tiles();}
+uint64_t get_tiled_terrain_gpu_mem() {return terrain_tile_draw.get_tiles_gpu_mem();}
+void disable_tile_cache() {terrain_tile_draw.disable_tile_cache();}
 float update_tiled_terrain(float &min_camera_dist) {return terrain_tile_draw.update(min_camera_dist);}
 void pre_draw_tiled_terrain() {terrain_tile_draw.pre_draw();}
 
@@ -3520,6 +3876,9 @@ void draw_tiled_terrain(int reflection_pass) {
 void draw_tiled_terrain_lightning(bool reflection_pass) {terrain_tile_draw.update_lightning(reflection_pass);}
 void end_tiled_terrain_lightning() {terrain_tile_draw.end_lightning();}
 void clear_tiled_terrain(bool no_regen_buildings) {terrain_tile_draw.clear(no_regen_buildings);}
+void flush_tiled_terrain_cache() {terrain_tile_draw.flush_tile_cache();}
+void print_tiled_terrain_cache_stats() {terrain_tile_draw.print_tile_cache_stats();}
+void invalidate_tile_cache_file_stats() {terrain_tile_draw.invalidate_tile_cache_file_stats();}
 void draw_tiled_terrain_clouds(bool reflection_pass) {terrain_tile_draw.draw_tile_clouds(reflection_pass);}
 void draw_tiled_terrain_decid_tree_shadows() {terrain_tile_draw.draw_decid_tree_shadows();}
 void reset_tiled_terrain_state() {terrain_tile_draw.clear_vbos_tids();}
@@ -3833,6 +4192,6 @@ void flatten_hmap_region(cube_t const &cube) {
 	if (using_tiled_terrain_hmap_tex()) {terrain_hmap_manager.flatten_region(cube);}
 }
 
-void write_heightmap_png(string const &fn) {terrain_hmap_manager.write_png(fn);}
+void write_heightmap_png(string const &fn) {terrain_hmap_manager.write_png(fn); invalidate_tile_cache_file_stats();}
 
 
@@ -13,8 +13,13 @@
 #include "tree_3dw.h"
 #include "shadow_map.h"
 #include "animals.h"
+#include "horizon_map.h"
 #include <unordered_map>
 #include <unordered_set>
+#include <list>
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 
 bool const ENABLE_TREE_LOD    = 1; // faster but has popping artifacts
@@ -69,6 +74,7 @@ public:
 
 
 class tile_t;
+class tile_cache_t;
 
 struct tile_smap_data_t : public smap_data_t {
 
@@ -115,6 +121,8 @@ struct hash_tile_xy_pair {
 };
 
 tile_t *get_tile_from_xy(tile_xy_pair const &tp);
+void disable_tile_cache();
+void invalidate_tile_cache_file_stats();
 
 
 struct tile_cloud_t : public volume_part_cloud {
@@ -173,7 +181,7 @@ private:
 	unsigned size, stride, zvsize, base_tsize, gen_tsize, smap_lod_level;
 	float radius, mzmin, mzmax, mesh_dz, ptzmax, dtzmax, trmax, xstart, ystart, min_normal_z, deltax, deltay;
 	bool sun_shadows_invalid, moon_shadows_invalid, recalc_tree_grass_weights, mesh_height_invalid, in_queue, last_occluded, has_any_grass;
-	bool is_distant, no_trees, just_cleared, has_tunnel;
+	bool is_distant, no_trees, just_cleared, has_tunnel, weights_from_cache;
 	colorRGB avg_mesh_tex_color;
 	tile_offset_t mesh_off, ptree_off, dtree_off, scenery_off;
 	float sub_zmin[4][4] = {0}, sub_zmax[4][4] = {0};
@@ -182,6 +190,9 @@ private:
 	vector<unsigned char> mesh_weight_data, weight_data, ao_lighting;
 	vector<unsigned char> smask[NUM_LIGHT_SRC];
 	vector<float> sh_out[NUM_LIGHT_SRC][2];
+	point shadow_light_pos[NUM_LIGHT_SRC]; // light positions used for smask
+	horizon_map_t horizon_map; // used for mesh shadows when tt_horizon_shadows=1
+	unsigned horizon_adj_mask=0; // adjacent tiles whose heights were included in horizon_map
 	vect_smap_t<tile_smap_data_t> smap_data;
 	small_tree_group pine_trees;
 	scenery_group scenery;
@@ -200,6 +211,25 @@ private:
 
 	vector<grass_block_t> grass_blocks;
 
+public:
+	struct cache_entry_t { // generated tile data that doesn't depend on trees or GPU state; stored in tile_cache_t
+		int x1=0, y1=0, wx1=0, wy1=0, wx2=0, wy2=0;
+		unsigned size=0;
+		float mzmin=0.0, mzmax=0.0, mesh_dz=0.0, radius=0.0;
+		float sub_zmin[4][4] = {0}, sub_zmax[4][4] = {0};
+		bool has_any_grass=0, has_tunnel=0, no_trees=0;
+		vector<float> zvals;
+		vector<unsigned char> ao_lighting, mesh_weight_data; // may be empty if not yet generated
+		vector<grass_block_t> grass_blocks;
+		vector<unsigned char> smask[NUM_LIGHT_SRC]; // only valid for the light positions below
+		vector<float> sh_out[NUM_LIGHT_SRC][2];
+		point light_pos[NUM_LIGHT_SRC];
+
+		size_t get_mem() const;
+		bool write(std::string const &fn, uint64_t params_hash) const;
+		bool read (std::string const &fn, uint64_t params_hash);
+	};
+private:
 	struct terrain_params_t { // settings for different biomes
 		float hoff, hscale, veg, grass, dirt;
 		terrain_params_t() : hoff(0.0), hscale(1.0), veg(1.0), grass(1.0), dirt(0.0) {}
@@ -291,6 +321,9 @@ public:
 	void clear_vbo_tid(tile_shadow_map_manager *smap_manager);
 	void clear_pine_tree_vbos() {pine_trees.clear_vbos();}
 	bool create_zvals(mesh_xy_grid_cache_t &height_gen, bool no_wait);
+	bool can_cache() const {return (!zvals.empty() && !mesh_height_invalid && !is_distant);}
+	void write_cache_entry(cache_entry_t &entry) const;
+	bool read_cache_entry(cache_entry_t &entry); // moves data out of entry
 	void get_z_minmax_for_area(point const &pos, float radius, float &zmin, float &zmax) const;
 	float get_zval_at(float x, float y, bool in_global_space) const;
 
@@ -304,6 +337,9 @@ public:
 	void calc_mesh_ao_lighting();
 	void calc_shadows_for_light(unsigned l);
 	static void proc_tile_queue(tile_t *init_tile, unsigned l);
+	unsigned get_horizon_adj_mask() const;
+	void calc_horizon_map(unsigned adj_mask);
+	void calc_shadows_from_horizon(unsigned l);
 	void calc_shadows(bool calc_sun, bool calc_moon, bool no_push=0);
 
 	tile_xy_pair get_tile_xy_pair(int dx=0, int dy=0) const {
@@ -340,13 +376,14 @@ public:
 	float get_rel_dist_to_camera(bool xy_dist=1) const {
 		return max(0.0f, (xy_dist ? p2p_dist_xy(get_camera_pos(), get_center()) : p2p_dist(get_camera_pos(), get_center())) - radius)/get_scaled_tile_radius();
 	}
-	bool rel_dist_to_camera_xy_lt(float rel_dist) const {
-		return dist_xy_less_than(get_camera_pos(), get_center(), (rel_dist*get_scaled_tile_radius() + radius));
+	bool rel_dist_to_pt_xy_lt(point const &pt, float rel_dist) const {
+		return dist_xy_less_than(pt, get_center(), (rel_dist*get_scaled_tile_radius() + radius));
 	}
+	bool rel_dist_to_camera_xy_lt(float rel_dist) const {return rel_dist_to_pt_xy_lt(get_camera_pos(), rel_dist);}
 	float get_bsphere_radius_inc_water() const;
 	bool use_as_occluder() const;
 	bool mesh_sphere_intersect(point const &pos, float rradius) const;
-	bool update_range(tile_shadow_map_manager &smap_manager);
+	bool update_range(tile_shadow_map_manager &smap_manager, tile_cache_t *tile_cache=nullptr);
 	bool is_visible() const {return camera_pdu.sphere_and_cube_visible_test(get_center(), get_bsphere_radius_inc_water(), get_bcube());}
 	bool is_smap_bounds_visible() const {return camera_pdu.cube_visible(get_shadow_bcube());}
 	float get_dist_to_camera_in_tiles(bool xy_dist=1) const {return get_rel_dist_to_camera(xy_dist)*TILE_RADIUS;}
@@ -423,6 +460,87 @@ public:
 }; // tile_t
 
 
+struct tile_gen_stats_t {
+	unsigned num_bkg=0, num_main=0, num_discarded=0, num_frames=0, frames_over_budget=0, max_queue_depth=0;
+	vector<float> latency_ms; // request to insert time of background generated tiles
+	float get_latency_percentile(float pct) const;
+	void print() const;
+};
+
+// generates zvals and AO lighting on a background thread for tiles near and ahead of the camera;
+// textures, trees, and shadows are still created on the main thread when the tile is first drawn
+class tile_bkg_gen_mgr_t {
+	struct request_t {
+		tile_t *tile;
+		float priority=0.0;
+		std::chrono::high_resolution_clock::time_point req_time;
+		request_t(tile_t *tile_) : tile(tile_), req_time(std::chrono::high_resolution_clock::now()) {}
+		bool operator<(request_t const &r) const {return (priority < r.priority);} // sort highest priority (lowest value) first
+	};
+	vector<request_t> pending, running, completed; // running is only accessed by the worker thread while it's active
+	unordered_set<tile_xy_pair, hash_tile_xy_pair> queued; // tiles in any of the above vectors
+	std::thread worker;
+	std::atomic<bool> worker_done;
+	bool needs_to_join=0;
+
+	void run_jobs();
+	void join_worker();
+	void discard(request_t const &r);
+	void record_latency(request_t const &r);
+public:
+	tile_gen_stats_t stats;
+
+	tile_bkg_gen_mgr_t() : worker_done(0) {}
+	~tile_bkg_gen_mgr_t() {finish_all();}
+	bool is_queued(tile_xy_pair const &txy) const {return (queued.find(txy) != queued.end());}
+	unsigned get_queue_depth() const {return (pending.size() + running.size() + completed.size());}
+	void add_request(tile_t *tile);
+	tile_t *take(tile_xy_pair const &txy, bool &is_generated);
+	void next_frame(vector<tile_t *> &ready, float keep_dist);
+	void finish_all();
+};
+
+
+struct tile_cache_stats_t {
+	unsigned mem_hits=0, disk_hits=0, misses=0, num_stored=0, num_evicted=0, disk_writes=0, disk_errors=0;
+	size_t mem_bytes=0;
+	uint64_t disk_bytes=0;
+	unsigned get_num_lookups() const {return (mem_hits + disk_hits + misses);}
+	float get_hit_rate() const {unsigned const num(get_num_lookups()); return (num ? float(mem_hits + disk_hits)/num : 0.0f);}
+	void print() const;
+};
+
+// in-memory LRU of recently removed tiles, backed by an optional directory of compressed tile files;
+// keyed by tile xy and a hash of the terrain generation parameters, so that revisited tiles skip height, AO, weight, and shadow generation
+class tile_cache_t {
+	typedef pair<tile_xy_pair, tile_t::cache_entry_t> lru_entry_t;
+	std::list<lru_entry_t> lru; // most recently used first
+	unordered_map<tile_xy_pair, std::list<lru_entry_t>::iterator, hash_tile_xy_pair> lru_map;
+	unordered_set<tile_xy_pair, hash_tile_xy_pair> on_disk, missed; // tiles known to be written to disk for this params_hash; tiles already looked up and not found
+	map<std::string, pair<uint64_t, uint64_t>> file_stats; // cached {mod time, size} for each input file
+	uint64_t params_hash=0;
+	int params_frame=-1;
+	bool disabled=0, disk_init=0, disk_ok=0;
+
+	std::string get_fn(tile_xy_pair const &txy) const;
+	bool init_disk();
+	void update_params();
+	void write_to_disk(lru_entry_t const &e);
+	void evict_to(size_t max_bytes);
+public:
+	tile_cache_stats_t stats;
+
+	bool is_enabled() const;
+	bool in_memory(tile_xy_pair const &txy) const {return (lru_map.find(txy) != lru_map.end());}
+	void add(tile_t const &tile);
+	tile_t *restore(tile_t const &tile); // returns a new tile with the cached data, or nullptr if not cached
+	void flush(); // writes memory entries to disk and clears them
+	void disable(); // for the rest of the session, called when the heightmap is edited
+	void invalidate_file_stats() {file_stats.clear(); params_frame = -1;} // called when the heightmap or modmap file is written
+	void print_stats() const {if (stats.get_num_lookups() > 0) {stats.print();}}
+};
+
+
 class tile_draw_t : public indexed_vbo_manager_t {
 
 	typedef unordered_map<tile_xy_pair, unique_ptr<tile_t>, hash_tile_xy_pair> tile_map;
@@ -443,6 +561,11 @@ class tile_draw_t : public indexed_vbo_manager_t {
 	crack_ibuf_t crack_ibuf;
 	tile_shadow_map_manager smap_manager;
 	vector<pair<float, tile_xy_pair>> shadow_recomp_queue;
+	tile_bkg_gen_mgr_t bkg_gen_mgr;
+	tile_cache_t tile_cache;
+	point prev_camera_pos; // in global space
+	bool prev_camera_valid=0;
+	unsigned last_tile_stats_num_printed=0;
 
 	struct occluder_pts_t {
 		point cube_pts[4];
@@ -463,6 +586,14 @@ public:
 	void clear(bool no_regen_buildings);
 	void free_compute_shader();
 	float update(float &min_camera_dist);
+	tile_gen_stats_t const &get_tile_gen_stats() const {return bkg_gen_mgr.stats;}
+	tile_cache_stats_t const &get_tile_cache_stats() const {return tile_cache.stats;}
+	void disable_tile_cache() {tile_cache.disable();}
+	void flush_tile_cache() {tile_cache.flush();}
+	void print_tile_cache_stats() const {tile_cache.print_stats();}
+	void invalidate_tile_cache_file_stats() {tile_cache.invalidate_file_stats();}
+	unsigned get_num_tiles() const {return tiles.size();}
+	uint64_t get_tiles_gpu_mem() const;
 private:
 	static void setup_terrain_textures(shader_t &s, unsigned start_tu_id);
 	static void shared_shader_lighting_setup(shader_t &s, unsigned lighting_shader);